@@ -21,6 +21,7 @@
 
 #include "analyse_audio_job.h"
 #include "audio_analysis.h"
+#include "audio_content.h"
 #include "compose.hpp"
 #include "dcpomatic_log.h"
 #include "film.h"
@@ -28,6 +29,9 @@
 #include "player.h"
 #include "playlist.h"
 #include "config.h"
+#include "util.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #include "i18n.h"
@@ -38,9 +42,12 @@ using std::dynamic_pointer_cast;
 using std::make_shared;
 using std::max;
 using std::min;
+using std::pair;
+using std::pow;
 using std::shared_ptr;
 using std::string;
 using std::vector;
+using boost::optional;
 using namespace dcpomatic;
 #if BOOST_VERSION >= 106100
 using namespace boost::placeholders;
@@ -83,32 +90,254 @@ AnalyseAudioJob::run ()
 {
 	LOG_DEBUG_AUDIO_ANALYSIS_NC("AnalyseAudioJob::run");
 
-	auto player = make_shared<Player>(_film, _playlist);
+	/* Analyses of content which has been removed or changed will never be used again */
+	_film->remove_stale_content_audio_analyses ();
+
+	if (can_analyse_by_content()) {
+		analyse_by_content ();
+	} else {
+		analyse (_playlist, _analyser);
+		_analyser.finish ();
+		auto analysis = _analyser.get();
+		analysis.write (_path);
+	}
+
+	LOG_DEBUG_AUDIO_ANALYSIS_NC("Job finished");
+	set_progress (1);
+	set_state (FINISHED_OK);
+}
+
+
+/** Play a playlist through an analyser */
+void
+AnalyseAudioJob::analyse (shared_ptr<const Playlist> playlist, AudioAnalyser& analyser)
+{
+	auto player = make_shared<Player>(_film, playlist);
 	player->set_ignore_video ();
 	player->set_ignore_text ();
 	player->set_fast ();
 	player->set_play_referenced ();
-	player->Audio.connect (bind(&AudioAnalyser::analyse, &_analyser, _1, _2));
+	player->Audio.connect (bind(&AudioAnalyser::analyse, &analyser, _1, _2));
 
 	bool has_any_audio = false;
-	for (auto c: _playlist->content()) {
+	for (auto c: playlist->content()) {
 		if (c->audio) {
 			has_any_audio = true;
 		}
 	}
 
 	if (has_any_audio) {
-		player->seek (_analyser.start(), true);
+		player->seek (analyser.start(), true);
 		while (!player->pass ()) {}
 	}
 
 	LOG_DEBUG_AUDIO_ANALYSIS_NC("Loop complete");
+}
 
-	_analyser.finish ();
-	auto analysis = _analyser.get();
-	analysis.write (_path);
 
-	LOG_DEBUG_AUDIO_ANALYSIS_NC("Job finished");
-	set_progress (1);
-	set_state (FINISHED_OK);
+/** @return true if our playlist's audio can be analysed piece-by-piece; i.e. there is
+ *  more than one piece of content with audio, no two pieces overlap, and we are not
+ *  measuring EBU R128 integrated loudness and loudness range.  Those are gated, so they
+ *  can't be worked out from the values for each piece of content.
+ */
+bool
+AnalyseAudioJob::can_analyse_by_content () const
+{
+	if (Config::instance()->analyse_ebur128()) {
+		return false;
+	}
+
+	vector<DCPTimePeriod> periods;
+	for (auto i: _playlist->content()) {
+		if (i->audio) {
+			periods.push_back (DCPTimePeriod(i->position(), i->end(_film)));
+		}
+	}
+
+	if (periods.size() < 2) {
+		return false;
+	}
+
+	std::sort (periods.begin(), periods.end(), [](DCPTimePeriod const& a, DCPTimePeriod const& b) {
+		return a.from < b.from;
+	});
+
+	for (size_t i = 1; i < periods.size(); ++i) {
+		if (periods[i].from < periods[i - 1].to) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/** @return Analysis of a single piece of content without its gain, either from a
+ *  previous run or by analysing it now.
+ */
+AudioAnalysis
+AnalyseAudioJob::content_analysis (shared_ptr<Content> content, std::function<void (float)> set_progress)
+{
+	auto const path = _film->content_audio_analysis_path (content);
+
+	if (boost::filesystem::exists(path)) {
+		try {
+			return AudioAnalysis (path);
+		} catch (std::exception& e) {
+			LOG_DEBUG_AUDIO_ANALYSIS("Could not use existing analysis of %1 (%2)", content->summary(), e.what());
+		}
+	}
+
+	auto playlist = make_shared<Playlist>();
+	playlist->add (_film, content);
+
+	AudioAnalyser analyser (_film, playlist, false, set_progress);
+	analyse (playlist, analyser);
+	analyser.finish ();
+
+	auto analysis = analyser.get ();
+	analysis.write (path);
+	return analysis;
+}
+
+
+/** @return The range of samples [first, second) that AudioAnalyser used to make point
+ *  @p point, counting from the start of its analysis.  The analyser emits a point
+ *  whenever its sample count is a multiple of @p samples_per_point, so the first point
+ *  covers just the first sample and every later one covers the following
+ *  @p samples_per_point samples.
+ */
+static
+pair<Frame, Frame>
+point_range (Frame point, Frame samples_per_point)
+{
+	if (point == 0) {
+		return { 0, 1 };
+	}
+
+	return { (point - 1) * samples_per_point + 1, point * samples_per_point + 1 };
+}
+
+
+/** Analyse each piece of content in our playlist separately (or re-use previous
+ *  analyses of them) and combine the results into an analysis of the whole playlist.
+ *  This should only be called if can_analyse_by_content() returns true.
+ */
+void
+AnalyseAudioJob::analyse_by_content ()
+{
+	int const channels = _film->audio_channels ();
+	int const frame_rate = _film->audio_frame_rate ();
+	auto const start = _analyser.start ();
+	Frame const total = (_playlist->length(_film) - start).frames_round(frame_rate);
+	Frame const samples_per_point = _analyser.samples_per_point ();
+	Frame const points = (total + samples_per_point - 1) / samples_per_point;
+
+	/* The analyser clamps silence to this level */
+	float const silence = 10e-7;
+
+	vector<vector<float>> peak (channels, vector<float>(points, silence));
+	/* Sums of squares of sample values for each point */
+	vector<vector<double>> energy (channels, vector<double>(points, 0));
+
+	vector<optional<AudioAnalysis::PeakTime>> sample_peak (channels);
+	/* Sum of (frames * 10^(Leq(m) / 10)) for each piece of content */
+	double leqm = 0;
+	bool have_leqm = true;
+
+	vector<shared_ptr<Content>> content;
+	DCPTime content_length;
+	for (auto i: _playlist->content()) {
+		if (i->audio) {
+			content.push_back (i);
+			content_length += i->end(_film) - i->position();
+		}
+	}
+
+	DCPTime done;
+	for (auto i: content) {
+		auto const length = i->end(_film) - i->position();
+		auto const progress_from = done.seconds() / max(content_length.seconds(), 1.0);
+		auto const progress_scale = length.seconds() / max(content_length.seconds(), 1.0);
+		auto analysis = content_analysis (i, [this, progress_from, progress_scale](float p) {
+			set_progress (progress_from + p * progress_scale, false);
+		});
+		done += length;
+
+		/* Correction for any change in gain since the analysis was made */
+		double const gain_db = i->audio->gain() - analysis.analysis_gain().get_value_or(i->audio->gain());
+		double const gain = db_to_linear (gain_db);
+
+		Frame const offset = (i->position() - start).frames_round(frame_rate);
+		Frame const frames = length.frames_round(frame_rate);
+		Frame const content_samples_per_point = analysis.samples_per_point ();
+
+		for (int c = 0; c < std::min(channels, analysis.channels()); ++c) {
+			for (int j = 0; j < analysis.points(c); ++j) {
+				auto point = analysis.get_point (c, j);
+				auto const range = point_range (j, content_samples_per_point);
+				Frame const from = offset + range.first;
+				Frame const to = min (total, offset + range.second);
+				if (from >= to) {
+					continue;
+				}
+				/* The analyser divides every point's sum of squares by its samples-per-point,
+				   even the first one which covers a single sample.
+				*/
+				double const point_energy = pow(point[AudioPoint::RMS] * gain, 2) * content_samples_per_point;
+				double const energy_per_sample = point_energy / (range.second - range.first);
+				for (Frame k = from == 0 ? 0 : (from - 1) / samples_per_point + 1; k < points; ++k) {
+					auto const out = point_range (k, samples_per_point);
+					if (out.first >= to) {
+						break;
+					}
+					Frame const overlap = min(to, out.second) - max(from, out.first);
+					if (overlap <= 0) {
+						continue;
+					}
+					peak[c][k] = max (peak[c][k], static_cast<float>(point[AudioPoint::PEAK] * gain));
+					energy[c][k] += energy_per_sample * overlap;
+				}
+			}
+		}
+
+		auto const content_sample_peak = analysis.sample_peak ();
+		for (int c = 0; c < std::min(channels, static_cast<int>(content_sample_peak.size())); ++c) {
+			float const p = content_sample_peak[c].peak * gain;
+			if (!sample_peak[c] || p > sample_peak[c]->peak) {
+				sample_peak[c] = AudioAnalysis::PeakTime (p, i->position() - start + content_sample_peak[c].time);
+			}
+		}
+
+		if (analysis.leqm()) {
+			leqm += frames * pow(10, (*analysis.leqm() + gain_db) / 10);
+		} else {
+			have_leqm = false;
+		}
+	}
+
+	AudioAnalysis analysis (channels);
+	for (int c = 0; c < channels; ++c) {
+		for (Frame k = 0; k < points; ++k) {
+			AudioPoint point;
+			point[AudioPoint::PEAK] = peak[c][k];
+			point[AudioPoint::RMS] = max (silence, static_cast<float>(sqrt(energy[c][k] / samples_per_point)));
+			analysis.add_point (c, point);
+		}
+	}
+
+	vector<AudioAnalysis::PeakTime> peaks;
+	for (auto const& i: sample_peak) {
+		peaks.push_back (i.get_value_or(AudioAnalysis::PeakTime(0, DCPTime())));
+	}
+	analysis.set_sample_peak (peaks);
+
+	/* Leq(m) is not gated, so silence between the content counts towards it */
+	if (have_leqm && total > 0) {
+		analysis.set_leqm (10 * log10(leqm / total));
+	}
+
+	analysis.set_samples_per_point (samples_per_point);
+	analysis.set_sample_rate (frame_rate);
+	analysis.write (_path);
 }
@@ -35,6 +35,7 @@
 
 class AudioBuffers;
 class AudioAnalysis;
+class Content;
 class Playlist;
 class AudioPoint;
 class AudioFilterGraph;
@@ -47,6 +48,11 @@ class Filter;
  *
  *  After computing the peak and RMS levels the job will write a file
  *  to Film::audio_analysis_path.
+ *
+ *  If the playlist's audio content does not overlap, and EBU R128 analysis
+ *  is turned off, each piece of content is analysed separately (or its analysis
+ *  is taken from a previous run) and the results are combined, so that only
+ *  content which has changed since the last analysis needs to be played again.
  */
 class AnalyseAudioJob : public Job
 {
@@ -66,6 +72,11 @@ public:
 	}
 
 private:
+	void analyse (std::shared_ptr<const Playlist> playlist, AudioAnalyser& analyser);
+	bool can_analyse_by_content () const;
+	void analyse_by_content ();
+	AudioAnalysis content_analysis (std::shared_ptr<Content> content, std::function<void (float)> set_progress);
+
 	AudioAnalyser _analyser;
 
 	std::shared_ptr<const Playlist> _playlist;
@@ -51,6 +51,10 @@ public:
 		return _start;
 	}
 
+	Frame samples_per_point () const {
+		return _samples_per_point;
+	}
+
 	void finish ();
 
 	AudioAnalysis get () const {
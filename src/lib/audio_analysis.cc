@@ -24,15 +24,19 @@
 #include "util.h"
 #include "playlist.h"
 #include "audio_content.h"
+#include "exceptions.h"
 #include "warnings.h"
 #include <dcp/raw_convert.h>
 DCPOMATIC_DISABLE_WARNINGS
 #include <libxml++/libxml++.h>
 DCPOMATIC_ENABLE_WARNINGS
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <stdint.h>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <inttypes.h>
 
@@ -55,6 +59,13 @@ using namespace dcpomatic;
 
 
 int const AudioAnalysis::_current_state_version = 3;
+int const AudioAnalysis::_current_binary_version = 1;
+char const AudioAnalysis::_binary_magic[8] = { 'D', 'C', 'P', 'O', 'M', 'A', 'A', 'N' };
+uint32_t const AudioAnalysis::_binary_byte_order_mark = 0x01020304;
+uint32_t const AudioAnalysis::_binary_has_integrated_loudness = 0x1;
+uint32_t const AudioAnalysis::_binary_has_loudness_range = 0x2;
+uint32_t const AudioAnalysis::_binary_has_analysis_gain = 0x4;
+uint32_t const AudioAnalysis::_binary_has_leqm = 0x8;
 
 
 AudioAnalysis::AudioAnalysis (int channels)
@@ -63,7 +74,32 @@ AudioAnalysis::AudioAnalysis (int channels)
 }
 
 
+/** Read an analysis from a file in either the binary or the old XML format */
 AudioAnalysis::AudioAnalysis (boost::filesystem::path filename)
+{
+	char magic[sizeof(_binary_magic)];
+	{
+		auto f = fopen_boost (filename, "rb");
+		if (!f) {
+			throw OpenFileError (filename, errno, OpenFileError::READ);
+		}
+		auto const n = fread (magic, 1, sizeof(magic), f);
+		fclose (f);
+		if (n < sizeof(magic)) {
+			memset (magic, 0, sizeof(magic));
+		}
+	}
+
+	if (memcmp(magic, _binary_magic, sizeof(magic)) == 0) {
+		read_binary (filename);
+	} else {
+		read_xml (filename);
+	}
+}
+
+
+void
+AudioAnalysis::read_xml (boost::filesystem::path filename)
 {
 	cxml::Document f ("AudioAnalysis");
 	f.read_file (filename);
@@ -106,9 +142,150 @@ AudioAnalysis::AudioAnalysis (boost::filesystem::path filename)
 }
 
 
+/** Reader of values from a memory-mapped binary analysis file */
+class BinaryReader
+{
+public:
+	BinaryReader (uint8_t const * data, size_t size)
+		: _data (data)
+		, _size (size)
+	{}
+
+	template <class T>
+	T get ()
+	{
+		T t;
+		check (sizeof(T));
+		memcpy (&t, _data + _offset, sizeof(T));
+		_offset += sizeof(T);
+		return t;
+	}
+
+	template <class T>
+	optional<T> get_optional (bool present)
+	{
+		auto t = get<T>();
+		if (!present) {
+			return {};
+		}
+		return t;
+	}
+
+	/** Skip some bytes and return a pointer to the start of them */
+	uint8_t const * skip (size_t size)
+	{
+		check (size);
+		auto p = _data + _offset;
+		_offset += size;
+		return p;
+	}
+
+private:
+	void check (size_t size) const
+	{
+		if (_offset + size > _size) {
+			/* Truncated, so get the caller to re-run the analysis */
+			throw OldFormatError ("Audio analysis file is corrupt");
+		}
+	}
+
+	uint8_t const * _data;
+	size_t _size;
+	size_t _offset = 0;
+};
+
+
+void
+AudioAnalysis::read_binary (boost::filesystem::path filename)
+{
+	using namespace boost::interprocess;
+
+	uint8_t const * data = nullptr;
+	size_t size = 0;
+
+#ifdef DCPOMATIC_WINDOWS
+	/* On Windows boost::interprocess can't open paths which aren't in the current code page, and
+	   a mapped file can't be replaced by write_binary(), so just read the whole thing in.
+	*/
+	auto f = fopen_boost (filename, "rb");
+	if (!f) {
+		throw OpenFileError (filename, errno, OpenFileError::READ);
+	}
+	_file_data.resize (boost::filesystem::file_size(filename));
+	auto const done = fread (_file_data.data(), 1, _file_data.size(), f);
+	fclose (f);
+	if (done != _file_data.size()) {
+		throw ReadFileError (filename, errno);
+	}
+	data = _file_data.data();
+	size = _file_data.size();
+#else
+	_file_mapping = make_shared<file_mapping>(filename.c_str(), read_only);
+	_mapped_region = make_shared<mapped_region>(*_file_mapping, read_only);
+	data = reinterpret_cast<uint8_t const *>(_mapped_region->get_address());
+	size = _mapped_region->get_size();
+#endif
+
+	_binary = true;
+
+	BinaryReader reader (data, size);
+
+	reader.skip (sizeof(_binary_magic));
+	if (reader.get<uint32_t>() != static_cast<uint32_t>(_current_binary_version)) {
+		throw OldFormatError ("Audio analysis file is too old");
+	}
+	if (reader.get<uint32_t>() != _binary_byte_order_mark) {
+		/* Written on a machine with different endianness */
+		throw OldFormatError ("Audio analysis file has the wrong byte order");
+	}
+
+	auto const channels = reader.get<uint32_t>();
+	auto const flags = reader.get<uint32_t>();
+	_samples_per_point = reader.get<int64_t>();
+	_sample_rate = reader.get<int32_t>();
+	_integrated_loudness = reader.get_optional<float>(flags & _binary_has_integrated_loudness);
+	_loudness_range = reader.get_optional<float>(flags & _binary_has_loudness_range);
+	_analysis_gain = reader.get_optional<double>(flags & _binary_has_analysis_gain);
+	_leqm = reader.get_optional<double>(flags & _binary_has_leqm);
+
+	auto const sample_peaks = reader.get<uint32_t>();
+	for (uint32_t i = 0; i < sample_peaks; ++i) {
+		auto const peak = reader.get<float>();
+		auto const time = reader.get<int64_t>();
+		_sample_peak.push_back (PeakTime(peak, DCPTime(time)));
+	}
+
+	auto const true_peaks = reader.get<uint32_t>();
+	for (uint32_t i = 0; i < true_peaks; ++i) {
+		_true_peak.push_back (reader.get<float>());
+	}
+
+	for (uint32_t i = 0; i < channels; ++i) {
+		auto const points = reader.get<uint32_t>();
+		auto const offset = static_cast<size_t>(reader.skip(points * AudioPoint::COUNT * sizeof(float)) - data);
+		_mapped_data.push_back (make_pair(offset, static_cast<int>(points)));
+	}
+}
+
+
+/** @return the start of the file that we read, if it was in the binary format */
+uint8_t const *
+AudioAnalysis::binary_data () const
+{
+	DCPOMATIC_ASSERT (_binary);
+
+	if (_mapped_region) {
+		return reinterpret_cast<uint8_t const *>(_mapped_region->get_address());
+	}
+
+	return _file_data.data();
+}
+
+
 void
 AudioAnalysis::add_point (int c, AudioPoint const & p)
 {
+	DCPOMATIC_ASSERT (!_binary);
 	DCPOMATIC_ASSERT (c < channels ());
 	_data[c].push_back (p);
 }
@@ -118,6 +295,17 @@ AudioPoint
 AudioAnalysis::get_point (int c, int p) const
 {
 	DCPOMATIC_ASSERT (p < points(c));
+
+	if (_binary) {
+		float values[AudioPoint::COUNT];
+		memcpy (values, binary_data() + _mapped_data[c].first + p * sizeof(values), sizeof(values));
+		AudioPoint point;
+		for (int i = 0; i < AudioPoint::COUNT; ++i) {
+			point[i] = values[i];
+		}
+		return point;
+	}
+
 	return _data[c][p];
 }
 
@@ -125,6 +313,10 @@ AudioAnalysis::get_point (int c, int p) const
 int
 AudioAnalysis::channels () const
 {
+	if (_binary) {
+		return _mapped_data.size ();
+	}
+
 	return _data.size ();
 }
 
@@ -133,6 +325,11 @@ int
 AudioAnalysis::points (int c) const
 {
 	DCPOMATIC_ASSERT (c < channels());
+
+	if (_binary) {
+		return _mapped_data[c].second;
+	}
+
 	return _data[c].size ();
 }
 
@@ -140,48 +337,103 @@ AudioAnalysis::points (int c) const
 void
 AudioAnalysis::write (boost::filesystem::path filename)
 {
-	auto doc = make_shared<xmlpp::Document>();
-	xmlpp::Element* root = doc->create_root_node ("AudioAnalysis");
-
-	root->add_child("Version")->add_child_text(raw_convert<string>(_current_state_version));
+	write_binary (filename);
+}
 
-	for (auto& i: _data) {
-		auto channel = root->add_child ("Channel");
-		for (auto& j: i) {
-			j.as_xml (channel->add_child ("Point"));
-		}
-	}
 
-	for (size_t i = 0; i < _sample_peak.size(); ++i) {
-		auto n = root->add_child("SamplePeak");
-		n->add_child_text (raw_convert<string> (_sample_peak[i].peak));
-		n->set_attribute ("Time", raw_convert<string> (_sample_peak[i].time.get()));
-	}
+/** Write this analysis in our binary format, which is:
+ *
+ *  magic (8 bytes), version (uint32), byte order mark (uint32), channels (uint32),
+ *  flags saying which optional values are valid (uint32), samples per point (int64),
+ *  sample rate (int32), integrated loudness (float), loudness range (float),
+ *  analysis gain (double), Leq(m) (double), number of sample peaks (uint32),
+ *  then each sample peak (float) and its time (int64), number of true peaks (uint32),
+ *  then each true peak (float), then for each channel its number of points (uint32)
+ *  followed by the points as AudioPoint::COUNT floats each.
+ *
+ *  Values are written in the native byte order.
+ */
+void
+AudioAnalysis::write_binary (boost::filesystem::path filename) const
+{
+	auto tmp = filename;
+	tmp += ".tmp";
 
-	for (auto i: _true_peak) {
-		root->add_child("TruePeak")->add_child_text (raw_convert<string> (i));
+	auto f = fopen_boost (tmp, "wb");
+	if (!f) {
+		throw OpenFileError (tmp, errno, OpenFileError::WRITE);
 	}
 
-	if (_integrated_loudness) {
-		root->add_child("IntegratedLoudness")->add_child_text (raw_convert<string> (_integrated_loudness.get ()));
-	}
+	auto put = [f, tmp](void const * data, size_t size) {
+		checked_fwrite (data, size, f, tmp);
+	};
+
+	auto put_uint32 = [put](uint32_t v) { put(&v, sizeof(v)); };
+	auto put_int32 = [put](int32_t v) { put(&v, sizeof(v)); };
+	auto put_int64 = [put](int64_t v) { put(&v, sizeof(v)); };
+	auto put_float = [put](float v) { put(&v, sizeof(v)); };
+	auto put_double = [put](double v) { put(&v, sizeof(v)); };
+
+	try {
+		put (_binary_magic, sizeof(_binary_magic));
+		put_uint32 (_current_binary_version);
+		put_uint32 (_binary_byte_order_mark);
+		put_uint32 (channels());
+
+		uint32_t flags = 0;
+		if (_integrated_loudness) {
+			flags |= _binary_has_integrated_loudness;
+		}
+		if (_loudness_range) {
+			flags |= _binary_has_loudness_range;
+		}
+		if (_analysis_gain) {
+			flags |= _binary_has_analysis_gain;
+		}
+		if (_leqm) {
+			flags |= _binary_has_leqm;
+		}
+		put_uint32 (flags);
+
+		put_int64 (_samples_per_point);
+		put_int32 (_sample_rate);
+		put_float (_integrated_loudness.get_value_or(0));
+		put_float (_loudness_range.get_value_or(0));
+		put_double (_analysis_gain.get_value_or(0));
+		put_double (_leqm.get_value_or(0));
+
+		put_uint32 (_sample_peak.size());
+		for (auto const& i: _sample_peak) {
+			put_float (i.peak);
+			put_int64 (i.time.get());
+		}
 
-	if (_loudness_range) {
-		root->add_child("LoudnessRange")->add_child_text (raw_convert<string> (_loudness_range.get ()));
-	}
+		put_uint32 (_true_peak.size());
+		for (auto i: _true_peak) {
+			put_float (i);
+		}
 
-	if (_analysis_gain) {
-		root->add_child("AnalysisGain")->add_child_text (raw_convert<string> (_analysis_gain.get ()));
+		for (int c = 0; c < channels(); ++c) {
+			put_uint32 (points(c));
+			for (int p = 0; p < points(c); ++p) {
+				auto point = get_point (c, p);
+				for (int i = 0; i < AudioPoint::COUNT; ++i) {
+					put_float (point[i]);
+				}
+			}
+		}
+	} catch (...) {
+		fclose (f);
+		boost::filesystem::remove (tmp);
+		throw;
 	}
 
-	root->add_child("SamplesPerPoint")->add_child_text (raw_convert<string> (_samples_per_point));
-	root->add_child("SampleRate")->add_child_text (raw_convert<string> (_sample_rate));
-
-	if (_leqm) {
-		root->add_child("Leqm")->add_child_text(raw_convert<string>(*_leqm));
-	}
+	fclose (f);
 
-	doc->write_to_file_formatted (filename.string ());
+	/* This is safe even if filename is mapped by us or another AudioAnalysis, as on
+	   POSIX the mapping keeps the old file alive, and on Windows we never map.
+	*/
+	boost::filesystem::rename (tmp, filename);
 }
 
 
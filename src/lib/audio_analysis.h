@@ -28,6 +28,8 @@
 #include <libcxml/cxml.h>
 #include <boost/optional.hpp>
 #include <boost/filesystem.hpp>
+#include <memory>
+#include <stdint.h>
 #include <vector>
 
 
@@ -35,10 +37,24 @@ namespace xmlpp {
 	class Element;
 }
 
+namespace boost {
+	namespace interprocess {
+		class file_mapping;
+		class mapped_region;
+	}
+}
+
 
 class Playlist;
 
 
+/** @class AudioAnalysis
+ *  @brief Results of an audio analysis.
+ *
+ *  These are written to disk in a compact binary format; when they are read
+ *  back the file is memory-mapped and the per-point data is only read as
+ *  get_point() asks for it.  Older XML analysis files can still be read.
+ */
 class AudioAnalysis
 {
 public:
@@ -134,7 +150,27 @@ public:
 	float gain_correction (std::shared_ptr<const Playlist> playlist);
 
 private:
+	void read_xml (boost::filesystem::path filename);
+	void read_binary (boost::filesystem::path filename);
+	void write_binary (boost::filesystem::path filename) const;
+	uint8_t const * binary_data () const;
+
+	/** point data for each channel, if it is held in memory */
 	std::vector<std::vector<AudioPoint>> _data;
+	/** true if we were read from a file in the binary format, in which case the point data
+	 *  is in _mapped_region or _file_data rather than _data.
+	 */
+	bool _binary = false;
+	/** mapping of the file that we were read from, if it was in the binary format and we could map it */
+	std::shared_ptr<boost::interprocess::file_mapping> _file_mapping;
+	std::shared_ptr<boost::interprocess::mapped_region> _mapped_region;
+	/** contents of the file that we were read from, if it was in the binary format and we did not map it */
+	std::vector<uint8_t> _file_data;
+	/** for each channel, the offset of its point data within _mapped_region or _file_data
+	 *  (as floats, AudioPoint::COUNT per point) and the number of points.  These are offsets
+	 *  rather than pointers so that copies of this object don't point into the original's data.
+	 */
+	std::vector<std::pair<size_t, int>> _mapped_data;
 	std::vector<PeakTime> _sample_peak;
 	std::vector<float> _true_peak;
 	boost::optional<float> _integrated_loudness;
@@ -149,6 +185,13 @@ private:
 	int _sample_rate = 0;
 
 	static int const _current_state_version;
+	static int const _current_binary_version;
+	static char const _binary_magic[8];
+	static uint32_t const _binary_byte_order_mark;
+	static uint32_t const _binary_has_integrated_loudness;
+	static uint32_t const _binary_has_loudness_range;
+	static uint32_t const _binary_has_analysis_gain;
+	static uint32_t const _binary_has_leqm;
 };
 
 
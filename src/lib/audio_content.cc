@@ -28,7 +28,10 @@
 #include <dcp/raw_convert.h>
 #include <libcxml/cxml.h>
 #include <libxml++/libxml++.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <iterator>
 
 #include "i18n.h"
 
@@ -363,6 +366,37 @@ AudioContent::stream () const
 }
 
 
+/** @return Streams which can contribute to the DCP, i.e. those which have something mapped.
+ *  If there are none of these we return the first stream, so that decoders still have something
+ *  to fill out the content's audio with (even if it is all silent).
+ */
+vector<AudioStreamPtr>
+AudioContent::used_streams () const
+{
+	auto all = streams ();
+
+	vector<AudioStreamPtr> used;
+	std::copy_if (all.begin(), all.end(), std::back_inserter(used), [](AudioStreamPtr stream) {
+		static float const minus_96_db = 0.000015849;
+		auto const mapping = stream->mapping ();
+		for (int i = 0; i < mapping.input_channels(); ++i) {
+			for (int j = 0; j < mapping.output_channels(); ++j) {
+				if (std::abs(mapping.get(i, j)) > minus_96_db) {
+					return true;
+				}
+			}
+		}
+		return false;
+	});
+
+	if (used.empty() && !all.empty()) {
+		used.push_back (all.front());
+	}
+
+	return used;
+}
+
+
 void
 AudioContent::add_stream (AudioStreamPtr stream)
 {
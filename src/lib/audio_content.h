@@ -84,6 +84,8 @@ public:
 		return _streams;
 	}
 
+	std::vector<AudioStreamPtr> used_streams () const;
+
 	void add_stream (AudioStreamPtr stream);
 	void set_stream (AudioStreamPtr stream);
 	void set_streams (std::vector<AudioStreamPtr> streams);
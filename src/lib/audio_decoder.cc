@@ -43,8 +43,8 @@ AudioDecoder::AudioDecoder (Decoder* parent, shared_ptr<const AudioContent> cont
 	, _content (content)
 	, _fast (fast)
 {
-	/* Set up _positions so that we have one for each stream */
-	for (auto i: content->streams ()) {
+	/* Set up _positions so that we have one for each stream that we will emit data for */
+	for (auto i: content->used_streams ()) {
 		_positions[i] = 0;
 	}
 }
@@ -191,7 +191,7 @@ AudioDecoder::flush ()
 void
 AudioDecoder::silence (int milliseconds)
 {
-	for (auto i: _content->streams()) {
+	for (auto i: _content->used_streams()) {
 		int const samples = ContentTime::from_seconds(milliseconds / 1000.0).frames_round(i->frame_rate());
 		auto silence = make_shared<AudioBuffers>(i->channels(), samples);
 		silence->make_silent ();
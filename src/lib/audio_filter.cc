@@ -22,19 +22,24 @@
 #include "audio_filter.h"
 #include "audio_buffers.h"
 #include "util.h"
+#include <algorithm>
 #include <cmath>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 
+using std::complex;
 using std::make_shared;
 using std::min;
 using std::shared_ptr;
+using std::vector;
 
 
 std::vector<float>
 AudioFilter::sinc_blackman (float cutoff, bool invert) const
 {
-	auto ir = std::vector<float>();
-	ir.reserve(_M + 1);
+	auto ir = std::vector<float>(_M + 1);
 
 	/* Impulse response */
 
@@ -83,34 +88,192 @@ AudioFilter::run (shared_ptr<const AudioBuffers> in)
 		_tail->make_silent ();
 	}
 
+	switch (_method) {
+	case Method::DIRECT:
+		run_direct (in, out);
+		break;
+	case Method::FFT:
+		run_fft (in, out);
+		break;
+	}
+
+	int const amount = min (in->frames(), _tail->frames());
+	if (amount < _tail->frames ()) {
+		_tail->move (_tail->frames() - amount, amount, 0);
+	}
+	_tail->copy_from (in.get(), amount, in->frames() - amount, _tail->frames () - amount);
+
+	return out;
+}
+
+
+/** Put the last _M samples of a channel's tail followed by its input into output, so that
+ *  output[_M + j] is input sample j and output[_M + j - k] is the sample k before it.
+ */
+void
+AudioFilter::fill_input (float const* tail, float const* in, int frames, vector<float>& output) const
+{
+	output.resize (_M + frames);
+	std::copy (tail + 1, tail + _M + 1, output.begin());
+	std::copy (in, in + frames, output.begin() + _M);
+}
+
+
+void
+AudioFilter::run_direct (shared_ptr<const AudioBuffers> in, shared_ptr<AudioBuffers> out)
+{
 	int const channels = in->channels ();
 	int const frames = in->frames ();
+	auto const ir = _ir.data();
 
 	for (int i = 0; i < channels; ++i) {
-		auto tail_p = _tail->data (i);
-		auto in_p = in->data (i);
+		fill_input (_tail->data(i), in->data(i), frames, _input_a);
+		auto const input = _input_a.data() + _M;
 		auto out_p = out->data (i);
-		for (int j = 0; j < frames; ++j) {
+
+		/* Each output sample has its terms added in the same order in both of these loops,
+		   so the results are the same whether or not we use SSE.
+		*/
+		int j = 0;
+#ifdef __SSE__
+		/* 8 outputs at once */
+		for (; (j + 8) <= frames; j += 8) {
+			auto a = _mm_setzero_ps ();
+			auto b = _mm_setzero_ps ();
+			for (int k = 0; k <= _M; ++k) {
+				auto const h = _mm_set1_ps (ir[k]);
+				a = _mm_add_ps (a, _mm_mul_ps(h, _mm_loadu_ps(input + j - k)));
+				b = _mm_add_ps (b, _mm_mul_ps(h, _mm_loadu_ps(input + j + 4 - k)));
+			}
+			_mm_storeu_ps (out_p + j, a);
+			_mm_storeu_ps (out_p + j + 4, b);
+		}
+#endif
+		for (; j < frames; ++j) {
 			float s = 0;
 			for (int k = 0; k <= _M; ++k) {
-				if ((j - k) < 0) {
-					s += tail_p[j - k + _M + 1] * _ir[k];
-				} else {
-					s += in_p[j - k] * _ir[k];
-				}
+				s += input[j - k] * ir[k];
 			}
-
 			out_p[j] = s;
 		}
 	}
+}
 
-	int const amount = min (in->frames(), _tail->frames());
-	if (amount < _tail->frames ()) {
-		_tail->move (_tail->frames() - amount, amount, 0);
+
+static inline complex<float>
+multiply (complex<float> a, complex<float> b)
+{
+	/* Written out to avoid the checks for infinities that std::complex's operator* does */
+	return complex<float>(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+
+/** In-place radix-2 forward FFT of _fft_size points, without any scaling */
+void
+AudioFilter::fft (vector<complex<float>>& data) const
+{
+	int const n = _fft_size;
+	auto d = data.data();
+	auto twiddles = _twiddles.data();
+
+	for (int i = 1, j = 0; i < n; ++i) {
+		int bit = n >> 1;
+		for (; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+		if (i < j) {
+			std::swap (d[i], d[j]);
+		}
 	}
-	_tail->copy_from (in.get(), amount, in->frames() - amount, _tail->frames () - amount);
 
-	return out;
+	for (int length = 2; length <= n; length <<= 1) {
+		int const half = length / 2;
+		auto const w = twiddles + half - 1;
+		for (int i = 0; i < n; i += length) {
+			for (int j = 0; j < half; ++j) {
+				auto const u = d[i + j];
+				auto const v = multiply (d[i + j + half], w[j]);
+				d[i + j] = u + v;
+				d[i + j + half] = u - v;
+			}
+		}
+	}
+}
+
+
+/** Filter using overlap-save.  As the filter is real we can filter two channels at once by
+ *  putting one in the real part of the FFT input and the other in the imaginary part.
+ */
+void
+AudioFilter::run_fft (shared_ptr<const AudioBuffers> in, shared_ptr<AudioBuffers> out)
+{
+	if (_fft_size == 0) {
+		/* Use a FFT of at least 4 times the filter length, so that most of each
+		   segment's output is useful.
+		*/
+		_fft_size = 1;
+		while (_fft_size < (_M + 1) * 4) {
+			_fft_size *= 2;
+		}
+
+		for (int half = 1; half < _fft_size; half *= 2) {
+			for (int i = 0; i < half; ++i) {
+				_twiddles.push_back (complex<float>(std::polar(1.0, -M_PI * i / half)));
+			}
+		}
+
+		_ir_spectrum.assign (_fft_size, complex<float>());
+		for (int i = 0; i <= _M; ++i) {
+			_ir_spectrum[i] = _ir[i] / _fft_size;
+		}
+		fft (_ir_spectrum);
+
+		_segment.resize (_fft_size);
+	}
+
+	int const channels = in->channels ();
+	int const frames = in->frames ();
+	int const input_length = _M + frames;
+	/* Number of output samples from each segment */
+	int const step = _fft_size - _M;
+
+	for (int i = 0; i < channels; i += 2) {
+		bool const pair = (i + 1) < channels;
+		fill_input (_tail->data(i), in->data(i), frames, _input_a);
+		if (pair) {
+			fill_input (_tail->data(i + 1), in->data(i + 1), frames, _input_b);
+		}
+
+		for (int j = 0; j < frames; j += step) {
+			/* Input for outputs j to j + step - 1, with _M samples before it */
+			int const available = min (_fft_size, input_length - j);
+			for (int k = 0; k < available; ++k) {
+				_segment[k] = complex<float>(_input_a[j + k], pair ? _input_b[j + k] : 0);
+			}
+			std::fill (_segment.begin() + available, _segment.end(), complex<float>());
+
+			fft (_segment);
+			/* Multiply by the filter's spectrum, then do the inverse FFT as conj(FFT(conj(x))) */
+			for (int k = 0; k < _fft_size; ++k) {
+				_segment[k] = std::conj (multiply(_segment[k], _ir_spectrum[k]));
+			}
+			fft (_segment);
+
+			/* The first _M outputs have wrapped around, so they are discarded */
+			int const this_step = min (step, frames - j);
+			auto out_a = out->data(i) + j;
+			for (int k = 0; k < this_step; ++k) {
+				out_a[k] = _segment[k + _M].real();
+			}
+			if (pair) {
+				auto out_b = out->data(i + 1) + j;
+				for (int k = 0; k < this_step; ++k) {
+					out_b[k] = -_segment[k + _M].imag();
+				}
+			}
+		}
+	}
 }
 
 
@@ -141,7 +304,7 @@ BandPassAudioFilter::BandPassAudioFilter (float transition_bandwidth, float lowe
 	auto lpf = sinc_blackman (lower, false);
 	auto hpf = sinc_blackman (higher, true);
 
-	_ir.reserve (_M + 1);
+	_ir.resize (_M + 1);
 	for (int i = 0; i <= _M; ++i) {
 		_ir[i] = lpf[i] + hpf[i];
 	}
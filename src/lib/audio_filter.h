@@ -22,6 +22,7 @@
 #define DCPOMATIC_AUDIO_FILTER_H
 
 
+#include <complex>
 #include <memory>
 #include <vector>
 
@@ -36,12 +37,18 @@ struct audio_filter_impulse_input_test;
 class AudioFilter
 {
 public:
+	enum class Method {
+		DIRECT, ///< direct convolution, which is quicker for short filters
+		FFT     ///< overlap-save convolution using FFTs, which is quicker for long filters
+	};
+
 	explicit AudioFilter (float transition_bandwidth)
 	{
 		_M = 4 / transition_bandwidth;
 		if (_M % 2) {
 			++_M;
 		}
+		_method = (_M + 1) >= 128 ? Method::FFT : Method::DIRECT;
 	}
 
 	virtual ~AudioFilter () {}
@@ -50,6 +57,11 @@ public:
 
 	void flush ();
 
+	/** Override the choice of convolution method; this is only useful for tests and benchmarks */
+	void set_method (Method method) {
+		_method = method;
+	}
+
 protected:
 	friend struct audio_filter_impulse_kernel_test;
 	friend struct audio_filter_impulse_input_test;
@@ -59,6 +71,30 @@ protected:
 	std::vector<float> _ir;
 	int _M;
 	std::shared_ptr<AudioBuffers> _tail;
+
+private:
+	void fill_input (float const* tail, float const* in, int frames, std::vector<float>& output) const;
+	void run_direct (std::shared_ptr<const AudioBuffers> in, std::shared_ptr<AudioBuffers> out);
+	void run_fft (std::shared_ptr<const AudioBuffers> in, std::shared_ptr<AudioBuffers> out);
+	void fft (std::vector<std::complex<float>>& data) const;
+
+	Method _method;
+
+	/* Things for the FFT method, which are set up from _ir on the first run() */
+
+	/** size of each FFT */
+	int _fft_size = 0;
+	/** twiddle factors for each stage of the FFT, one after the other; the stage which
+	 *  combines pairs of FFTs of size h has e^(-pi i k / h) for 0 <= k < h.
+	 */
+	std::vector<std::complex<float>> _twiddles;
+	/** spectrum of _ir, scaled so that the inverse FFT needs no scaling */
+	std::vector<std::complex<float>> _ir_spectrum;
+
+	/* Scratch space for run() */
+	std::vector<float> _input_a;
+	std::vector<float> _input_b;
+	std::vector<std::complex<float>> _segment;
 };
 
 
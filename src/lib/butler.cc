@@ -27,6 +27,7 @@
 #include "cross.h"
 #include "compose.hpp"
 #include "exceptions.h"
+#include "trace.h"
 #include "video_content.h"
 
 
@@ -36,6 +37,7 @@ using std::make_pair;
 using std::string;
 using std::weak_ptr;
 using std::shared_ptr;
+using std::vector;
 using boost::bind;
 using boost::optional;
 using std::function;
@@ -53,6 +55,11 @@ using namespace boost::placeholders;
 #define MINIMUM_AUDIO_READAHEAD (48000 * MINIMUM_VIDEO_READAHEAD / 24)
 /** Maximum audio readahead in frames; should never be exceeded (by much) unless there are bugs in Player */
 #define MAXIMUM_AUDIO_READAHEAD (48000 * MAXIMUM_VIDEO_READAHEAD / 24)
+/** Capacity of our audio ring in frames.  should_run() lets the audio grow to 10 times its maximum
+ *  readahead before it gives up with a ProgrammingError that says what happened, so the ring must be
+ *  bigger than that (with room for the audio from one more pass of the player) or it would overflow first.
+ */
+#define AUDIO_RING_CAPACITY (MAXIMUM_AUDIO_READAHEAD * 10 + 48000)
 
 
 /** @param pixel_format Pixel format functor that will be used when calling ::image on PlayerVideos coming out of this
@@ -73,6 +80,7 @@ Butler::Butler (
 	)
 	: _film (film)
 	, _player (player)
+	, _audio (audio_channels, AUDIO_RING_CAPACITY)
 	, _prepare_work (new boost::asio::io_service::work(_prepare_service))
 	, _pending_seek_accurate (false)
 	, _suspended (0)
@@ -87,6 +95,7 @@ Butler::Butler (
 	, _alignment (alignment)
 	, _fast (fast)
 	, _prepare_only_proxy (prepare_only_proxy)
+	, _trace_session (0)
 {
 	_player_video_connection = _player->Video.connect (bind (&Butler::video, this, _1, _2));
 	_player_audio_connection = _player->Audio.connect (bind (&Butler::audio, this, _1, _2, _3));
@@ -109,6 +118,8 @@ Butler::Butler (
 	for (size_t i = 0; i < boost::thread::hardware_concurrency() * 2; ++i) {
 		_prepare_pool.create_thread (bind (&boost::asio::io_service::run, &_prepare_service));
 	}
+
+	_metrics_source = Metrics::instance()->add_source (bind(&Butler::add_metrics, this, _1));
 }
 
 
@@ -116,6 +127,12 @@ Butler::~Butler ()
 {
 	boost::this_thread::disable_interruption dis;
 
+	Metrics::instance()->remove_source (_metrics_source);
+
+	if (_audio.underruns()) {
+		LOG_GENERAL ("Butler audio underran %1 times (%2 frames of silence)", _audio.underruns(), _audio.underrun_frames());
+	}
+
 	{
 		boost::mutex::scoped_lock lm (_mutex);
 		_stop_thread = true;
@@ -209,6 +226,7 @@ try
 		*/
 		while (should_run() && !_pending_seek_position) {
 			lm.unlock ();
+			Trace::set_thread_session (_trace_session);
 			bool const r = _player->pass ();
 			lm.lock ();
 			if (r) {
@@ -325,6 +343,8 @@ try
 	/* If the weak_ptr cannot be locked the video obviously no longer requires any work */
 	if (video) {
 		LOG_TIMING("start-prepare in %1", thread_id());
+		Trace::set_thread_session (_trace_session);
+		TRACE_SCOPE ("butler-prepare");
 		video->prepare (_pixel_format, _video_range, _alignment, _fast, _prepare_only_proxy);
 		LOG_TIMING("finish-prepare in %1", thread_id());
 	}
@@ -357,6 +377,7 @@ Butler::video (shared_ptr<PlayerVideo> video, DCPTime time)
 	_prepare_service.post (bind(&Butler::prepare, this, weak_ptr<PlayerVideo>(video)));
 
 	_video.put (video, time);
+	TRACE_COUNTER ("butler-video", _video.size());
 }
 
 
@@ -370,25 +391,37 @@ Butler::audio (shared_ptr<AudioBuffers> audio, DCPTime time, int frame_rate)
 	}
 
 	_audio.put (remap(audio, _audio_channels, _audio_mapping), time, frame_rate);
+	TRACE_COUNTER ("butler-audio", _audio.size());
 }
 
 
 /** Try to get `frames' frames of audio and copy it into `out'.
+ *  Only one thread may call this at a time.
  *  @param behaviour BLOCKING if we should block until audio is available.  If behaviour is NON_BLOCKING
  *  and no audio is immediately available the buffer will be filled with silence and boost::none
- *  will be returned.
+ *  will be returned.  NON_BLOCKING calls take no locks so they are safe to make from a real-time
+ *  audio callback.
  *  @return time of this audio, or unset if blocking was false and no data was available.
  */
 optional<DCPTime>
 Butler::get_audio (Behaviour behaviour, float* out, Frame frames)
 {
+	if (behaviour == Behaviour::NON_BLOCKING) {
+		/* Don't summon the butler thread here, as that can mean waiting for _mutex.
+		   It will be summoned by the next get_video(), which is soon enough as the
+		   audio readahead is much longer than a video frame.  Once the player has
+		   finished, running out of audio is expected and not an underrun.
+		*/
+		return _audio.get (out, frames, !_finished);
+	}
+
 	boost::mutex::scoped_lock lm (_mutex);
 
-	while (behaviour == Behaviour::BLOCKING && !_finished && !_died && _audio.size() < frames) {
+	while (!_finished && !_died && _audio.size() < frames) {
 		_arrived.wait (lm);
 	}
 
-	auto t = _audio.get (out, _audio_channels, frames);
+	auto t = _audio.get (out, frames, !_finished);
 	_summon.notify_all ();
 	return t;
 }
@@ -410,6 +443,17 @@ Butler::memory_used () const
 }
 
 
+void
+Butler::add_metrics (vector<Metrics::Metric>& metrics) const
+{
+	metrics.push_back ({"dcpomatic_butler_video_memory_bytes", "Memory used by video frames waiting in the butler", Metrics::Type::GAUGE, static_cast<double>(memory_used().first)});
+	metrics.push_back ({"dcpomatic_butler_video_frames", "Video frames waiting in the butler", Metrics::Type::GAUGE, static_cast<double>(_video.size())});
+	metrics.push_back ({"dcpomatic_butler_audio_frames", "Audio frames waiting in the butler", Metrics::Type::GAUGE, static_cast<double>(_audio.size())});
+	metrics.push_back ({"dcpomatic_butler_audio_underruns_total", "Requests for audio which the butler could not completely satisfy", Metrics::Type::COUNTER, static_cast<double>(_audio.underruns())});
+	metrics.push_back ({"dcpomatic_butler_audio_underrun_frames_total", "Frames of silence given out by the butler because audio was not ready", Metrics::Type::COUNTER, static_cast<double>(_audio.underrun_frames())});
+}
+
+
 void
 Butler::player_change (ChangeType type, int property)
 {
@@ -20,15 +20,17 @@
 
 
 #include "audio_mapping.h"
-#include "audio_ring_buffers.h"
 #include "change_signaller.h"
 #include "exception_store.h"
+#include "interleaved_audio_ring_buffer.h"
+#include "metrics.h"
 #include "text_ring_buffers.h"
 #include "video_ring_buffers.h"
 #include <boost/asio.hpp>
 #include <boost/signals2.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/condition.hpp>
+#include <atomic>
 
 
 class Player;
@@ -85,7 +87,13 @@ public:
 
 	std::pair<size_t, std::string> memory_used () const;
 
+	/** Record our threads' trace events in a given session from now on */
+	void set_trace_session (int session) {
+		_trace_session = session;
+	}
+
 private:
+	void add_metrics (std::vector<Metrics::Metric>& metrics) const;
 	void thread ();
 	void video (std::shared_ptr<PlayerVideo> video, dcpomatic::DCPTime time);
 	void audio (std::shared_ptr<AudioBuffers> audio, dcpomatic::DCPTime time, int frame_rate);
@@ -100,21 +108,26 @@ private:
 	boost::thread _thread;
 
 	VideoRingBuffers _video;
-	AudioRingBuffers _audio;
+	/** audio, already mapped to our output channels; this is read by get_audio() without
+	 *  taking _mutex so that a real-time audio callback is never held up by the butler thread.
+	 */
+	InterleavedAudioRingBuffer _audio;
 	TextRingBuffers _closed_caption;
 
 	boost::thread_group _prepare_pool;
 	boost::asio::io_service _prepare_service;
 	std::shared_ptr<boost::asio::io_service::work> _prepare_work;
 
-	/** mutex to protect _pending_seek_position, _pending_seek_accurate, _finished, _died, _stop_thread */
+	/** mutex to protect _pending_seek_position, _pending_seek_accurate, _finished, _died, _stop_thread.
+	 *  _finished is also read without the lock by get_audio().
+	 */
 	boost::mutex _mutex;
 	boost::condition _summon;
 	boost::condition _arrived;
 	boost::optional<dcpomatic::DCPTime> _pending_seek_position;
 	bool _pending_seek_accurate;
 	int _suspended;
-	bool _finished;
+	std::atomic<bool> _finished;
 	bool _died;
 	std::string _died_message;
 	bool _stop_thread;
@@ -137,6 +150,12 @@ private:
 	 */
 	bool _prepare_only_proxy = false;
 
+	int _metrics_source;
+	/** Trace session that our threads should record their events in; our threads
+	 *  are started before anybody starts tracing, so they check this as they go.
+	 */
+	std::atomic<int> _trace_session;
+
 	/** If we are waiting to be refilled following a seek, this is the time we were
 	    seeking to.
 	*/
@@ -68,6 +68,7 @@ using dcp::raw_convert;
 
 Config* Config::_instance = 0;
 int const Config::_current_version = 3;
+int const Config::_default_read_ahead_size = 8;
 boost::signals2::signal<void ()> Config::FailedToLoad;
 boost::signals2::signal<void (string)> Config::Warning;
 boost::signals2::signal<bool (Config::BadReason)> Config::Bad;
@@ -86,6 +87,7 @@ Config::set_defaults ()
 {
 	_master_encoding_threads = max (2U, boost::thread::hardware_concurrency ());
 	_server_encoding_threads = max (2U, boost::thread::hardware_concurrency ());
+	_server_numa_pinning = false;
 	_server_port_base = 6192;
 	_use_any_servers = true;
 	_servers.clear ();
@@ -95,6 +97,7 @@ Config::set_defaults ()
 	_tms_path = ".";
 	_tms_user = "";
 	_tms_password = "";
+	_tms_connections = 4;
 	_allow_any_dcp_frame_rate = false;
 	_allow_any_container = false;
 	_allow_96khz_audio = false;
@@ -161,6 +164,10 @@ Config::set_defaults ()
 	   use about 240Mb with 72 encoding threads.
 	*/
 	_frames_in_memory_multiplier = 3;
+	_read_ahead_size = _default_read_ahead_size;
+	_image_prefetch_size = 256;
+	_ffmpeg_decode_threads = 0;
+	_ffmpeg_decode_threads_overrides.clear ();
 	_decode_reduction = optional<int>();
 	_default_notify = false;
 	for (int i = 0; i < NOTIFICATION_COUNT; ++i) {
@@ -233,7 +240,7 @@ Config::backup ()
 		while (n < 100 && exists(add_number(path_to_copy, n))) {
 			++n;
 		}
-		copy_file(path_to_copy, add_number(path_to_copy, n));
+		copy_in_bits (path_to_copy, add_number(path_to_copy, n), {});
 	};
 
 	/* Make a backup copy of any config.xml, cinemas.xml, dkdm_recipients.xml that we might be about
@@ -275,6 +282,8 @@ try
 		_server_encoding_threads = f.number_child<int>("ServerEncodingThreads");
 	}
 
+	_server_numa_pinning = f.optional_bool_child("ServerNUMAPinning").get_value_or(false);
+
 	_default_directory = f.optional_string_child ("DefaultDirectory");
 	if (_default_directory && _default_directory->empty ()) {
 		/* We used to store an empty value for this to mean "none set" */
@@ -304,6 +313,7 @@ try
 	_tms_path = f.string_child ("TMSPath");
 	_tms_user = f.string_child ("TMSUser");
 	_tms_password = f.string_child ("TMSPassword");
+	_tms_connections = f.optional_number_child<int>("TMSConnections").get_value_or(4);
 
 	_language = f.optional_string_child ("Language");
 
@@ -531,6 +541,12 @@ try
 		}
 	}
 	_frames_in_memory_multiplier = f.optional_number_child<int>("FramesInMemoryMultiplier").get_value_or(3);
+	_read_ahead_size = f.optional_number_child<int>("ReadAheadSize").get_value_or(_default_read_ahead_size);
+	_image_prefetch_size = f.optional_number_child<int>("ImagePrefetchSize").get_value_or(256);
+	_ffmpeg_decode_threads = f.optional_number_child<int>("FFmpegDecodeThreads").get_value_or(0);
+	for (auto i: f.node_children("FFmpegDecodeThreadsOverride")) {
+		_ffmpeg_decode_threads_overrides[i->string_attribute("codec")] = raw_convert<int>(i->content());
+	}
 	_decode_reduction = f.optional_number_child<int>("DecodeReduction");
 	_default_notify = f.optional_bool_child("DefaultNotify").get_value_or(false);
 
@@ -645,6 +661,12 @@ Config::write_config () const
 	root->add_child("MasterEncodingThreads")->add_child_text (raw_convert<string> (_master_encoding_threads));
 	/* [XML] ServerEncodingThreads Number of encoding threads to use when running as server. */
 	root->add_child("ServerEncodingThreads")->add_child_text (raw_convert<string> (_server_encoding_threads));
+	if (_server_numa_pinning) {
+		/* [XML:opt] ServerNUMAPinning 1 to run a separate set of encoding threads on each NUMA node of a server,
+		 * pinned to that node's CPUs.  Like Win32Console this is only written if it's true.
+		 */
+		root->add_child("ServerNUMAPinning")->add_child_text ("1");
+	}
 	if (_default_directory) {
 		/* [XML:opt] DefaultDirectory Default directory when creating a new film in the GUI. */
 		root->add_child("DefaultDirectory")->add_child_text (_default_directory->string ());
@@ -678,6 +700,12 @@ Config::write_config () const
 	root->add_child("TMSUser")->add_child_text (_tms_user);
 	/* [XML] TMSPassword Password to log into the TMS with. */
 	root->add_child("TMSPassword")->add_child_text (_tms_password);
+	if (_tms_connections != 4) {
+		/* [XML:opt] TMSConnections Number of files to send to the TMS at the same time, each over its own connection;
+		 * only written if it is not the default of 4.
+		 */
+		root->add_child("TMSConnections")->add_child_text (raw_convert<string>(_tms_connections));
+	}
 	if (_language) {
 		/* [XML:opt] Language Language to use in the GUI e.g. <code>fr_FR</code>. */
 		root->add_child("Language")->add_child_text (_language.get());
@@ -920,6 +948,34 @@ Config::write_config () const
 	   frames to be held in memory at once.
 	*/
 	root->add_child("FramesInMemoryMultiplier")->add_child_text(raw_convert<string>(_frames_in_memory_multiplier));
+	if (_read_ahead_size != _default_read_ahead_size) {
+		/* [XML:opt] ReadAheadSize size in MB of the buffer that each playing or encoding decoder uses to read its content
+		   file ahead of the decoding, or 0 to read only when asked.  This is only written if it is not the default, so that
+		   configs which don't change it are written as they were before it existed.
+		*/
+		root->add_child("ReadAheadSize")->add_child_text(raw_convert<string>(_read_ahead_size));
+	}
+	if (_image_prefetch_size != 256) {
+		/* [XML:opt] ImagePrefetchSize maximum size in MB of the image sequence files that each decoder loads ahead of
+		   the decoding, or 0 to load each file only when it is needed.  Only written if it is not the default of 256.
+		*/
+		root->add_child("ImagePrefetchSize")->add_child_text(raw_convert<string>(_image_prefetch_size));
+	}
+	if (_ffmpeg_decode_threads) {
+		/* [XML:opt] FFmpegDecodeThreads number of threads that each FFmpeg video decoder should use; if this is
+		   not present (or is 0) the number is decided automatically from the number of CPU cores and the number
+		   of decoders that are open at once.
+		*/
+		root->add_child("FFmpegDecodeThreads")->add_child_text(raw_convert<string>(_ffmpeg_decode_threads));
+	}
+	for (auto const& i: _ffmpeg_decode_threads_overrides) {
+		/* [XML:opt] FFmpegDecodeThreadsOverride number of decoding threads to use for the FFmpeg codec named
+		   in the <code>codec</code> attribute (e.g. <code>hevc</code>), overriding FFmpegDecodeThreads.
+		*/
+		auto e = root->add_child("FFmpegDecodeThreadsOverride");
+		e->set_attribute("codec", i.first);
+		e->add_child_text(raw_convert<string>(i.second));
+	}
 
 	/* [XML] DecodeReduction power of 2 to reduce DCP images by before decoding in the player. */
 	if (_decode_reduction) {
@@ -1401,7 +1457,7 @@ void
 Config::copy_and_link (boost::filesystem::path new_file) const
 {
 	write ();
-	boost::filesystem::copy_file (config_read_file(), new_file, boost::filesystem::copy_option::overwrite_if_exists);
+	copy_in_bits (config_read_file(), new_file, {});
 	link (new_file);
 }
 
@@ -60,6 +60,11 @@ public:
 		return _server_encoding_threads;
 	}
 
+	/** @return true if a server should give each NUMA node its own set of encoding threads */
+	bool server_numa_pinning () const {
+		return _server_numa_pinning;
+	}
+
 	boost::optional<boost::filesystem::path> default_directory () const {
 		return _default_directory;
 	}
@@ -141,6 +146,11 @@ public:
 		return _tms_password;
 	}
 
+	/** @return Number of connections to use at once when copying DCPs to the TMS */
+	int tms_connections () const {
+		return _tms_connections;
+	}
+
 	std::list<std::shared_ptr<Cinema>> cinemas () const {
 		return _cinemas;
 	}
@@ -453,6 +463,30 @@ public:
 		return _frames_in_memory_multiplier;
 	}
 
+	/** @return size of the buffer used to read content files ahead of the decoders, in MB */
+	int read_ahead_size () const {
+		return _read_ahead_size;
+	}
+
+	/** @return maximum size of the image sequence files that each decoder reads ahead, in MB */
+	int image_prefetch_size () const {
+		return _image_prefetch_size;
+	}
+
+	/** @return number of threads for each FFmpeg video decoder to use, or 0 to choose
+	 *  automatically based on the number of cores and the number of decoders that are open.
+	 */
+	int ffmpeg_decode_threads () const {
+		return _ffmpeg_decode_threads;
+	}
+
+	/** @return map of FFmpeg codec name (e.g. hevc, prores) to the number of decoding threads
+	 *  to use for that codec, overriding ffmpeg_decode_threads().
+	 */
+	std::map<std::string, int> ffmpeg_decode_threads_overrides () const {
+		return _ffmpeg_decode_threads_overrides;
+	}
+
 	boost::optional<int> decode_reduction () const {
 		return _decode_reduction;
 	}
@@ -562,6 +596,10 @@ public:
 		maybe_set (_server_encoding_threads, n);
 	}
 
+	void set_server_numa_pinning (bool p) {
+		maybe_set (_server_numa_pinning, p);
+	}
+
 	void set_default_directory (boost::filesystem::path d) {
 		if (_default_directory && *_default_directory == d) {
 			return;
@@ -603,6 +641,10 @@ public:
 		maybe_set (_tms_password, p);
 	}
 
+	void set_tms_connections (int c) {
+		maybe_set (_tms_connections, c);
+	}
+
 	void add_cinema (std::shared_ptr<Cinema> c) {
 		_cinemas.push_back (c);
 		changed (CINEMAS);
@@ -897,6 +939,22 @@ public:
 		maybe_set (_frames_in_memory_multiplier, m);
 	}
 
+	void set_read_ahead_size (int s) {
+		maybe_set (_read_ahead_size, s);
+	}
+
+	void set_image_prefetch_size (int s) {
+		maybe_set (_image_prefetch_size, s);
+	}
+
+	void set_ffmpeg_decode_threads (int t) {
+		maybe_set (_ffmpeg_decode_threads, t);
+	}
+
+	void set_ffmpeg_decode_threads_overrides (std::map<std::string, int> const& overrides) {
+		maybe_set (_ffmpeg_decode_threads_overrides, overrides);
+	}
+
 	void set_decode_reduction (boost::optional<int> r) {
 		maybe_set (_decode_reduction, r);
 	}
@@ -1143,6 +1201,7 @@ private:
 	int _master_encoding_threads;
 	/** number of threads which a server should use for J2K encoding on the local machine */
 	int _server_encoding_threads;
+	bool _server_numa_pinning;
 	/** default directory to put new films in */
 	boost::optional<boost::filesystem::path> _default_directory;
 	/** base port number to use for J2K encoding servers;
@@ -1163,6 +1222,8 @@ private:
 	std::string _tms_user;
 	/** Password to log into the TMS with */
 	std::string _tms_password;
+	/** Number of connections to use at once when copying DCPs to the TMS */
+	int _tms_connections;
 	/** The list of possible DCP frame rates that DCP-o-matic will use */
 	std::list<int> _allowed_dcp_frame_rates;
 	/** Allow any video frame rate for the DCP; if true, overrides _allowed_dcp_frame_rates */
@@ -1252,6 +1313,10 @@ private:
 	boost::optional<KDMWriteType> _last_kdm_write_type;
 	boost::optional<DKDMWriteType> _last_dkdm_write_type;
 	int _frames_in_memory_multiplier;
+	int _read_ahead_size;
+	int _image_prefetch_size;
+	int _ffmpeg_decode_threads;
+	std::map<std::string, int> _ffmpeg_decode_threads_overrides;
 	boost::optional<int> _decode_reduction;
 	bool _default_notify;
 	bool _notification[NOTIFICATION_COUNT];
@@ -1280,6 +1345,8 @@ private:
 	double _auto_crop_threshold;
 
 	static int const _current_version;
+	/** default size of the read-ahead buffer in MB */
+	static int const _default_read_ahead_size;
 
 	/** Singleton instance, or 0 */
 	static Config* _instance;
@@ -31,6 +31,7 @@
 #include "video_content.h"
 #include "audio_content.h"
 #include "text_content.h"
+#include "examined_content_cache.h"
 #include "exceptions.h"
 #include "film.h"
 #include "job.h"
@@ -171,9 +172,10 @@ Content::calculate_digest () const
 {
 	/* Some content files are very big, so we use a poor man's
 	   digest here: a digest of the first and last 1e6 bytes with the
-	   size of the first file tacked on the end as a string.
+	   size of the first file tacked on the end as a string.  Even that can
+	   take a while for lots of files on a slow disk, so we keep the results.
 	*/
-	return simple_digest (paths());
+	return ExaminedContentCache::instance()->digest(paths());
 }
 
 
@@ -31,6 +31,8 @@
 #include <boost/filesystem.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/optional.hpp>
+#include <functional>
+#include <vector>
 
 #ifdef DCPOMATIC_WINDOWS
 #define WEXITSTATUS(w) (w)
@@ -60,6 +62,19 @@ extern int dcpomatic_fseek (FILE *, int64_t, int);
 extern void start_batch_converter ();
 extern void start_player ();
 extern uint64_t thread_id ();
+/** @return CPU numbers in each NUMA node, or an empty vector if there is only one node
+ *  or we can't find out.
+ */
+extern std::vector<std::vector<int>> numa_node_cpus ();
+/** Restrict the calling thread to run only on some CPUs */
+extern void set_thread_cpus (std::vector<int> const& cpus);
+/** Try to copy a file without its data passing through our address space; by cloning it if
+ *  the filesystem allows, or otherwise by asking the kernel to do the copy.  Any existing
+ *  file at to will be overwritten.
+ *  @param progress Called with progress from 0 to 1, or empty.
+ *  @return true if the file was copied, false if the caller should copy it some other way.
+ */
+extern bool kernel_copy_file (boost::filesystem::path from, boost::filesystem::path to, std::function<void (float)> progress);
 extern int avio_open_boost (AVIOContext** s, boost::filesystem::path file, int flags);
 extern boost::filesystem::path home_directory ();
 extern bool running_32_on_64 ();
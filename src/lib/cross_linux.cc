@@ -39,9 +39,13 @@ DCPOMATIC_ENABLE_WARNINGS
 #include <boost/dll/runtime_symbol_info.hpp>
 #endif
 #include <unistd.h>
+#include <fcntl.h>
 #include <mntent.h>
+#include <sched.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/mount.h>
+#include <linux/fs.h>
 #include <ifaddrs.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -50,6 +54,13 @@ DCPOMATIC_ENABLE_WARNINGS
 #include "i18n.h"
 
 
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 27)
+#define DCPOMATIC_HAVE_COPY_FILE_RANGE
+#endif
+#endif
+
+
 using std::cerr;
 using std::cout;
 using std::ifstream;
@@ -271,6 +282,129 @@ thread_id ()
 }
 
 
+vector<vector<int>>
+numa_node_cpus ()
+{
+	vector<vector<int>> nodes;
+
+	for (int node = 0; ; ++node) {
+		/* This use of ifstream is ok; the filename can never be non-Latin */
+		ifstream f (String::compose("/sys/devices/system/node/node%1/cpulist", node));
+		if (!f.good()) {
+			break;
+		}
+
+		/* e.g. 0-7,16-23 */
+		string list;
+		getline (f, list);
+		boost::algorithm::trim (list);
+		vector<string> ranges;
+		boost::algorithm::split (ranges, list, boost::is_any_of(","));
+
+		vector<int> cpus;
+		for (auto const& i: ranges) {
+			if (i.empty()) {
+				continue;
+			}
+			auto const dash = i.find('-');
+			auto const first = dcp::raw_convert<int>(i.substr(0, dash));
+			auto const last = dash == string::npos ? first : dcp::raw_convert<int>(i.substr(dash + 1));
+			for (auto j = first; j <= last; ++j) {
+				cpus.push_back (j);
+			}
+		}
+
+		if (!cpus.empty()) {
+			nodes.push_back (cpus);
+		}
+	}
+
+	if (nodes.size() < 2) {
+		nodes.clear ();
+	}
+
+	return nodes;
+}
+
+
+void
+set_thread_cpus (vector<int> const& cpus)
+{
+	cpu_set_t set;
+	CPU_ZERO (&set);
+	for (auto i: cpus) {
+		CPU_SET (i, &set);
+	}
+
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+		LOG_WARNING_NC ("Could not set thread CPU affinity");
+	}
+}
+
+
+bool
+kernel_copy_file (boost::filesystem::path from, boost::filesystem::path to, std::function<void (float)> progress)
+{
+	auto const in = open (from.c_str(), O_RDONLY | O_CLOEXEC);
+	if (in < 0) {
+		return false;
+	}
+
+	auto const out = open (to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (out < 0) {
+		close (in);
+		return false;
+	}
+
+	bool ok = false;
+
+#ifdef FICLONE
+	/* On btrfs, XFS and the like this makes the copy share the original's extents, which is instant */
+	ok = ioctl(out, FICLONE, in) == 0;
+	if (ok && progress) {
+		progress (1);
+	}
+#endif
+
+#ifdef DCPOMATIC_HAVE_COPY_FILE_RANGE
+	if (!ok) {
+		/* Otherwise the kernel may still be able to copy without the data coming up to us, and
+		   network filesystems may be able to do it on the server.
+		*/
+		boost::system::error_code ec;
+		auto const total = boost::filesystem::file_size (from, ec);
+		if (!ec) {
+			/* on the order of a second's worth of copying, as in copy_in_bits */
+			size_t const chunk = 20 * 1024 * 1024;
+			auto remaining = total;
+			ok = true;
+			while (remaining) {
+				auto const N = copy_file_range (in, nullptr, out, nullptr, std::min(static_cast<boost::uintmax_t>(chunk), remaining), 0);
+				if (N <= 0) {
+					/* We get EXDEV, EOPNOTSUPP and so on if this sort of copy is not possible, or 0 if the
+					   source is shorter than we thought; either way let the caller do it another way.
+					*/
+					ok = false;
+					break;
+				}
+				remaining -= N;
+				if (progress) {
+					progress (1 - float(remaining) / total);
+				}
+			}
+		}
+	}
+#endif
+
+	close (in);
+	if (close(out) != 0) {
+		ok = false;
+	}
+
+	return ok;
+}
+
+
 int
 avio_open_boost (AVIOContext** s, boost::filesystem::path file, int flags)
 {
@@ -248,6 +248,29 @@ thread_id ()
 }
 
 
+vector<vector<int>>
+numa_node_cpus ()
+{
+	/* Not implemented; just treat the machine as one node */
+	return {};
+}
+
+
+void
+set_thread_cpus (vector<int> const&)
+{
+
+}
+
+
+bool
+kernel_copy_file (boost::filesystem::path, boost::filesystem::path, std::function<void (float)>)
+{
+	/* Not implemented; the caller will copy the data itself */
+	return false;
+}
+
+
 int
 avio_open_boost (AVIOContext** s, boost::filesystem::path file, int flags)
 {
@@ -354,6 +354,29 @@ thread_id ()
 }
 
 
+vector<vector<int>>
+numa_node_cpus ()
+{
+	/* Not implemented; just treat the machine as one node */
+	return {};
+}
+
+
+void
+set_thread_cpus (vector<int> const&)
+{
+
+}
+
+
+bool
+kernel_copy_file (boost::filesystem::path, boost::filesystem::path, std::function<void (float)>)
+{
+	/* Not implemented; the caller will copy the data itself */
+	return false;
+}
+
+
 static string
 wchar_to_utf8 (wchar_t const * s)
 {
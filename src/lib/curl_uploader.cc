@@ -24,6 +24,7 @@
 #include "config.h"
 #include "cross.h"
 #include "compose.hpp"
+#include <curl/curl.h>
 #include <iostream>
 
 #include "i18n.h"
@@ -32,85 +33,126 @@
 using std::string;
 using std::cout;
 using std::function;
+using std::make_shared;
+using std::shared_ptr;
+using boost::optional;
 
 
-static size_t
-read_callback (void* ptr, size_t size, size_t nmemb, void* object)
+/** @class CurlConnection
+ *  @brief A connection to an FTP server using libcurl.
+ */
+class CurlConnection : public Uploader::Connection
 {
-	CurlUploader* u = reinterpret_cast<CurlUploader*> (object);
-	return u->read_callback (ptr, size, nmemb);
-}
+public:
+	CurlConnection ()
+	{
+		_curl = curl_easy_init ();
+		if (!_curl) {
+			throw NetworkError (_("Could not start transfer"));
+		}
+
+		curl_easy_setopt (_curl, CURLOPT_READFUNCTION, &CurlConnection::read_callback);
+		curl_easy_setopt (_curl, CURLOPT_FTP_CREATE_MISSING_DIRS, 1L);
+		curl_easy_setopt (_curl, CURLOPT_USERNAME, Config::instance()->tms_user().c_str());
+		curl_easy_setopt (_curl, CURLOPT_PASSWORD, Config::instance()->tms_password().c_str());
+	}
 
+	~CurlConnection ()
+	{
+		curl_easy_cleanup (_curl);
+	}
 
-CurlUploader::CurlUploader (function<void (string)> set_status, function<void (float)> set_progress)
-	: Uploader (set_status, set_progress)
-{
-	_curl = curl_easy_init ();
-	if (!_curl) {
-		throw NetworkError (_("Could not start transfer"));
+	CurlConnection (CurlConnection const&) = delete;
+	CurlConnection& operator= (CurlConnection const&) = delete;
+
+	optional<boost::uintmax_t> remote_size (boost::filesystem::path to) override
+	{
+		set_url (to);
+		curl_easy_setopt (_curl, CURLOPT_UPLOAD, 0L);
+		curl_easy_setopt (_curl, CURLOPT_NOBODY, 1L);
+
+		auto const r = curl_easy_perform (_curl);
+		if (r == CURLE_REMOTE_FILE_NOT_FOUND || r == CURLE_REMOTE_ACCESS_DENIED) {
+			/* The file, or (in the case of access denied) the directory that it should be in,
+			   does not exist yet; the directory will be made when we upload the file.
+			*/
+			return boost::uintmax_t(0);
+		} else if (r != CURLE_OK) {
+			throw NetworkError (String::compose(_("Could not get size of remote file (%1)"), curl_easy_strerror(r)));
+		}
+
+		double size = -1;
+		curl_easy_getinfo (_curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &size);
+		if (size < 0) {
+			/* The server didn't tell us, so we can't resume */
+			return {};
+		}
+
+		return static_cast<boost::uintmax_t>(size);
 	}
 
-	curl_easy_setopt (_curl, CURLOPT_READFUNCTION, ::read_callback);
-	curl_easy_setopt (_curl, CURLOPT_READDATA, this);
-	curl_easy_setopt (_curl, CURLOPT_UPLOAD, 1L);
-	curl_easy_setopt (_curl, CURLOPT_FTP_CREATE_MISSING_DIRS, 1L);
-	curl_easy_setopt (_curl, CURLOPT_READDATA, this);
-	curl_easy_setopt (_curl, CURLOPT_USERNAME, Config::instance()->tms_user().c_str());
-	curl_easy_setopt (_curl, CURLOPT_PASSWORD, Config::instance()->tms_password().c_str());
-}
+	void upload_file (Uploader::Source& source, boost::filesystem::path to) override
+	{
+		set_url (to);
+		curl_easy_setopt (_curl, CURLOPT_NOBODY, 0L);
+		curl_easy_setopt (_curl, CURLOPT_UPLOAD, 1L);
+		curl_easy_setopt (_curl, CURLOPT_READDATA, &source);
+		/* If we're carrying on from a previous attempt, append to what the server already has */
+		curl_easy_setopt (_curl, CURLOPT_APPEND, source.offset() > 0 ? 1L : 0L);
+		curl_easy_setopt (_curl, CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t>(source.size()));
+
+		auto const r = curl_easy_perform (_curl);
+		if (r == CURLE_ABORTED_BY_CALLBACK && source.cancelled()) {
+			return;
+		} else if (r != CURLE_OK) {
+			throw NetworkError (String::compose(_("Could not write to remote file (%1)"), curl_easy_strerror(r)));
+		}
+	}
 
+private:
+	void set_url (boost::filesystem::path to)
+	{
+		curl_easy_setopt (
+			_curl, CURLOPT_URL,
+			/* Use generic_string so that we get forward-slashes in the path, even on Windows */
+			String::compose ("ftp://%1/%2/%3", Config::instance()->tms_ip(), Config::instance()->tms_path(), to.generic_string ()).c_str ()
+			);
+	}
 
-CurlUploader::~CurlUploader ()
-{
-	if (_file) {
-		fclose (_file);
+	static size_t read_callback (void* ptr, size_t size, size_t nmemb, void* object)
+	{
+		auto source = reinterpret_cast<Uploader::Source*>(object);
+		if (source->cancelled()) {
+			return CURL_READFUNC_ABORT;
+		}
+		/* Source::read can throw, which we must not let through libcurl */
+		try {
+			return source->read (reinterpret_cast<uint8_t*>(ptr), size * nmemb);
+		} catch (...) {
+			return CURL_READFUNC_ABORT;
+		}
 	}
-	curl_easy_cleanup (_curl);
-}
 
+	CURL* _curl;
+};
 
-void
-CurlUploader::create_directory (boost::filesystem::path)
+
+CurlUploader::CurlUploader (function<void (string)> set_status, function<void (float)> set_progress)
+	: Uploader (set_status, set_progress)
 {
-	/* this is done by libcurl */
+
 }
 
 
 void
-CurlUploader::upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size)
+CurlUploader::create_directory (boost::filesystem::path)
 {
-	curl_easy_setopt (
-		_curl, CURLOPT_URL,
-		/* Use generic_string so that we get forward-slashes in the path, even on Windows */
-		String::compose ("ftp://%1/%2/%3", Config::instance()->tms_ip(), Config::instance()->tms_path(), to.generic_string ()).c_str ()
-		);
-
-	_file = fopen_boost (from, "rb");
-	if (!_file) {
-		throw NetworkError (String::compose (_("Could not open %1 to send"), from));
-	}
-	_transferred = &transferred;
-	_total_size = total_size;
-
-	auto const r = curl_easy_perform (_curl);
-	if (r != CURLE_OK) {
-		throw NetworkError (String::compose (_("Could not write to remote file (%1)"), curl_easy_strerror (r)));
-	}
-
-	fclose (_file);
-	_file = 0;
+	/* this is done by libcurl */
 }
 
 
-size_t
-CurlUploader::read_callback (void* ptr, size_t size, size_t nmemb)
+shared_ptr<Uploader::Connection>
+CurlUploader::connect ()
 {
-	size_t const r = fread (ptr, size, nmemb, _file);
-	*_transferred += size * nmemb;
-
-	if (_total_size > 0) {
-		_set_progress ((double) *_transferred / _total_size);
-	}
-
-	return r;
+	return make_shared<CurlConnection>();
 }
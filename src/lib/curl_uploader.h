@@ -20,25 +20,14 @@
 
 
 #include "uploader.h"
-#include <curl/curl.h>
 
 
 class CurlUploader : public Uploader
 {
 public:
 	CurlUploader (std::function<void (std::string)> set_status, std::function<void (float)> set_progress);
-	~CurlUploader ();
-
-	size_t read_callback (void* ptr, size_t size, size_t nmemb);
 
 protected:
-	virtual void create_directory (boost::filesystem::path directory);
-	virtual void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size);
-
-private:
-	CURL* _curl;
-
-	FILE* _file = nullptr;
-	boost::uintmax_t* _transferred = nullptr;
-	boost::uintmax_t _total_size = 0;
+	void create_directory (boost::filesystem::path directory) override;
+	std::shared_ptr<Connection> connect () override;
 };
@@ -42,11 +42,12 @@
 #include "log.h"
 #include "player_video.h"
 #include "rng.h"
+#include "trace.h"
 #include "warnings.h"
+#include "xyz_converter.h"
 #include <libcxml/cxml.h>
 #include <dcp/raw_convert.h>
 #include <dcp/openjpeg_image.h>
-#include <dcp/rgb_xyz.h>
 #include <dcp/j2k_transcode.h>
 DCPOMATIC_DISABLE_WARNINGS
 #include <libxml++/libxml++.h>
@@ -103,22 +104,16 @@ DCPVideo::DCPVideo (shared_ptr<const PlayerVideo> frame, shared_ptr<const cxml::
 shared_ptr<dcp::OpenJPEGImage>
 DCPVideo::convert_to_xyz (shared_ptr<const PlayerVideo> frame, dcp::NoteHandler note)
 {
-	shared_ptr<dcp::OpenJPEGImage> xyz;
-
-	auto image = frame->image (bind(&PlayerVideo::keep_xyz_or_rgb, _1), VideoRange::FULL, false);
 	if (frame->colour_conversion()) {
-		xyz = dcp::rgb_to_xyz (
-			image->data()[0],
-			image->size(),
-			image->stride()[0],
-			frame->colour_conversion().get(),
-			note
-			);
-	} else {
-		xyz = make_shared<dcp::OpenJPEGImage>(image->data()[0], image->size(), image->stride()[0]);
+		/* Leave whatever we can (crop, padding, text and fade) to the converter so that it is done
+		   in the same pass as the conversion.
+		*/
+		auto parts = frame->parts (bind(&PlayerVideo::keep_xyz_or_rgb, _1), VideoRange::FULL, false);
+		return XYZConverter::get(frame->colour_conversion().get())->convert(parts.image, parts.crop, parts.out_size, parts.text, frame->fade(), note);
 	}
 
-	return xyz;
+	auto image = frame->image (bind(&PlayerVideo::keep_xyz_or_rgb, _1), VideoRange::FULL, false);
+	return make_shared<dcp::OpenJPEGImage>(image->data()[0], image->size(), image->stride()[0]);
 }
 
 /** J2K-encode this frame on the local host.
@@ -233,6 +228,7 @@ DCPVideo::encode_remotely (EncodeServerDescription serv, int timeout) const
 
 		/* Send binary data */
 		LOG_TIMING("start-remote-send thread=%1", thread_id ());
+		TRACE_SCOPE ("remote-send");
 		_frame->write_to_socket (socket);
 	}
 
@@ -241,9 +237,16 @@ DCPVideo::encode_remotely (EncodeServerDescription serv, int timeout) const
 	*/
 	Socket::ReadDigestScope ds (socket);
 	LOG_TIMING("start-remote-encode thread=%1", thread_id ());
-	ArrayData e (socket->read_uint32 ());
+	ArrayData e;
+	{
+		TRACE_SCOPE ("remote-wait");
+		e = ArrayData (socket->read_uint32 ());
+	}
 	LOG_TIMING("start-remote-receive thread=%1", thread_id ());
-	socket->read (e.data(), e.size());
+	{
+		TRACE_SCOPE ("remote-receive");
+		socket->read (e.data(), e.size());
+	}
 	LOG_TIMING("finish-remote-receive thread=%1", thread_id ());
 	if (!ds.check()) {
 		throw NetworkError ("Checksums do not match");
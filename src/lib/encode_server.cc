@@ -49,6 +49,7 @@ DCPOMATIC_ENABLE_WARNINGS
 #ifdef HAVE_VALGRIND_H
 #include <valgrind/memcheck.h>
 #endif
+#include <cmath>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -59,6 +60,7 @@ DCPOMATIC_ENABLE_WARNINGS
 using std::string;
 using std::vector;
 using std::list;
+using std::max;
 using std::cout;
 using std::cerr;
 using std::fixed;
@@ -73,6 +75,9 @@ using dcp::Size;
 using dcp::raw_convert;
 
 
+int const EncodeServer::_read_ahead = 1;
+
+
 EncodeServer::EncodeServer (bool verbose, int num_threads)
 #if !defined(RUNNING_ON_VALGRIND) || RUNNING_ON_VALGRIND == 0
 	: Server (ENCODE_FRAME_PORT)
@@ -81,8 +86,11 @@ EncodeServer::EncodeServer (bool verbose, int num_threads)
 #endif
 	, _verbose (verbose)
 	, _num_threads (num_threads)
+	, _numa_pinning (Config::instance()->server_numa_pinning())
 {
-
+	_metrics_source = Metrics::instance()->add_source ([this](vector<Metrics::Metric>& metrics) {
+		add_metrics (metrics);
+	});
 }
 
 
@@ -90,15 +98,22 @@ EncodeServer::~EncodeServer ()
 {
 	boost::this_thread::disable_interruption dis;
 
+	Metrics::instance()->remove_source (_metrics_source);
+
 	{
 		boost::mutex::scoped_lock lm (_mutex);
 		_terminate = true;
-		_empty_condition.notify_all ();
 		_full_condition.notify_all ();
+		_network_condition.notify_all ();
+		_encode_condition.notify_all ();
 	}
 
 	try {
-		_worker_threads.join_all ();
+		_network_threads.join_all ();
+	} catch (...) {}
+
+	try {
+		_encode_threads.join_all ();
 	} catch (...) {}
 
 	{
@@ -117,12 +132,25 @@ EncodeServer::~EncodeServer ()
 }
 
 
-/** @param after_read Filled in with gettimeofday() after reading the input from the network.
- *  @param after_encode Filled in with gettimeofday() after encoding the image.
+static double
+seconds_now ()
+{
+	struct timeval t;
+	gettimeofday (&t, 0);
+	return seconds (t);
+}
+
+
+/** Read a request from a socket.
+ *  @return Request, or nullptr if the request should be ignored.
  */
-int
-EncodeServer::process (shared_ptr<Socket> socket, struct timeval& after_read, struct timeval& after_encode)
+shared_ptr<EncodeServer::Request>
+EncodeServer::receive (shared_ptr<Socket> socket)
 {
+	auto request = make_shared<Request>();
+	request->socket = socket;
+	gettimeofday (&request->start, 0);
+
 	Socket::ReadDigestScope ds (socket);
 
 	auto length = socket->read_uint32 ();
@@ -138,7 +166,7 @@ EncodeServer::process (shared_ptr<Socket> socket, struct timeval& after_read, st
 	if (xml->number_child<int> ("Version") != SERVER_LINK_VERSION) {
 		cerr << "Mismatched server/client versions\n";
 		LOG_ERROR_NC ("Mismatched server/client versions");
-		return -1;
+		return {};
 	}
 
 	auto pvf = make_shared<PlayerVideo>(xml, socket);
@@ -147,93 +175,239 @@ EncodeServer::process (shared_ptr<Socket> socket, struct timeval& after_read, st
 		throw NetworkError ("Checksums do not match");
 	}
 
-	DCPVideo dcp_video_frame (pvf, xml);
-
-	gettimeofday (&after_read, 0);
+	request->frame = make_shared<DCPVideo>(pvf, xml);
+	request->ip = socket->socket().remote_endpoint().address().to_string();
 
-	auto encoded = dcp_video_frame.encode_locally ();
+	gettimeofday (&request->after_read, 0);
+	return request;
+}
 
-	gettimeofday (&after_encode, 0);
 
+/** Send an encoded frame back to the client that asked for it */
+void
+EncodeServer::send (shared_ptr<Request> request)
+{
 	try {
-		Socket::WriteDigestScope ds (socket);
-		socket->write (encoded.size());
-		socket->write (encoded.data(), encoded.size());
+		Socket::WriteDigestScope ds (request->socket);
+		request->socket->write (request->encoded.size());
+		request->socket->write (request->encoded.data(), request->encoded.size());
 	} catch (std::exception& e) {
-		cerr << "Send failed; frame " << dcp_video_frame.index() << "\n";
-		LOG_ERROR ("Send failed; frame %1", dcp_video_frame.index());
-		throw;
+		cerr << "Send failed; frame " << request->frame->index() << "\n";
+		LOG_ERROR ("Send failed; frame %1", request->frame->index());
+		boost::mutex::scoped_lock lm (_mutex);
+		++_errors;
+		return;
+	}
+
+	struct timeval end;
+	gettimeofday (&end, 0);
+
+	/* Close the connection */
+	request->socket.reset ();
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	++_frames_encoded;
+	_read_time += seconds(request->after_read) - seconds(request->start);
+	_encode_time += seconds(request->after_encode) - seconds(request->after_read);
+	_write_time += seconds(end) - seconds(request->after_encode);
+
+	auto e = make_shared<EncodedLogEntry>(
+		request->frame->index(), request->ip,
+		seconds(request->after_read) - seconds(request->start),
+		seconds(request->after_encode) - seconds(request->after_read),
+		seconds(end) - seconds(request->after_encode)
+		);
+
+	if (_verbose) {
+		cout << e->get() << "\n";
 	}
 
-	return dcp_video_frame.index ();
+	dcpomatic_log->log (e);
+
+	maybe_report ();
+}
+
+
+/** Say how busy the encode threads have been, if we haven't done so for a while.
+ *  Must be called with _mutex held.
+ */
+void
+EncodeServer::maybe_report ()
+{
+	auto const now = seconds_now ();
+	if ((now - _last_report_time) < 60) {
+		return;
+	}
+
+	if (_last_report_time > 0) {
+		auto const busy = (_encode_time - _last_report_encode_time) * 100 / ((now - _last_report_time) * _num_threads);
+		LOG_GENERAL ("Encode threads %1%% busy; %2 frames waiting to be encoded", lrint(busy), waiting_to_encode());
+		if (_verbose) {
+			cout << "Encode threads " << lrint(busy) << "% busy; " << waiting_to_encode() << " frames waiting to be encoded.\n";
+		}
+	}
+
+	_last_report_time = now;
+	_last_report_encode_time = _encode_time;
 }
 
 
+/** @return Number of requests which have been read and are waiting to be encoded.
+ *  Must be called with _mutex held.
+ */
+size_t
+EncodeServer::waiting_to_encode () const
+{
+	size_t n = 0;
+	for (auto const& i: _nodes) {
+		n += i.to_encode.size();
+	}
+	return n;
+}
+
+
+/** Thread to read requests from the network, for the encode threads of one node, and
+ *  send back the results.  Sending back is done in preference to reading so that finished
+ *  frames don't hang around.
+ *  @param node_index Index into _nodes.
+ */
 void
-EncodeServer::worker_thread ()
+EncodeServer::network_thread (int node_index)
 {
+	auto& node = _nodes[node_index];
+	if (!node.cpus.empty()) {
+		set_thread_cpus (node.cpus);
+	}
+
+	/* Requests which have been read but not yet encoded are limited to this number */
+	auto const max_waiting = static_cast<size_t>(node.encode_threads * _read_ahead);
+
 	while (true) {
 		boost::mutex::scoped_lock lock (_mutex);
-		while (_queue.empty () && !_terminate) {
-			_empty_condition.wait (lock);
+		while (!_terminate && _to_send.empty() && (_queue.empty() || (node.to_encode.size() + node.reading) >= max_waiting)) {
+			_network_condition.wait (lock);
 		}
 
 		if (_terminate) {
 			return;
 		}
 
+		if (!_to_send.empty()) {
+			auto request = _to_send.front ();
+			_to_send.pop_front ();
+			lock.unlock ();
+			send (request);
+			continue;
+		}
+
 		auto socket = _queue.front ();
 		_queue.pop_front ();
+		++node.reading;
+		_full_condition.notify_all ();
 
 		lock.unlock ();
 
-		int frame = -1;
-		string ip;
-
-		struct timeval start;
-		struct timeval after_read;
-		struct timeval after_encode;
-		struct timeval end;
-
-		gettimeofday (&start, 0);
-
+		shared_ptr<Request> request;
 		try {
-			frame = process (socket, after_read, after_encode);
-			ip = socket->socket().remote_endpoint().address().to_string();
+			request = receive (socket);
 		} catch (std::exception& e) {
 			cerr << "Error: " << e.what() << "\n";
 			LOG_ERROR ("Error: %1", e.what());
 		}
 
-		gettimeofday (&end, 0);
+		lock.lock ();
+		--node.reading;
+		if (request) {
+			node.to_encode.push_back (request);
+			/* All, since the encode threads waiting may not all be on this node */
+			_encode_condition.notify_all ();
+		} else {
+			++_errors;
+			_network_condition.notify_all ();
+		}
+	}
+}
 
-		socket.reset ();
 
-		lock.lock ();
+/** Thread to encode requests which have been read by one of its node's network threads.
+ *  @param node_index Index into _nodes.
+ */
+void
+EncodeServer::encode_thread (int node_index)
+{
+	auto& node = _nodes[node_index];
+	if (!node.cpus.empty()) {
+		set_thread_cpus (node.cpus);
+	}
+
+	while (true) {
+		boost::mutex::scoped_lock lock (_mutex);
 
-		if (frame >= 0) {
-			struct timeval end;
-			gettimeofday (&end, 0);
+		auto const wait_start = seconds_now ();
+		while (node.to_encode.empty() && !_terminate) {
+			_encode_condition.wait (lock);
+		}
 
-			auto e = make_shared<EncodedLogEntry>(
-				frame, ip,
-				seconds(after_read) - seconds(start),
-				seconds(after_encode) - seconds(after_read),
-				seconds(end) - seconds(after_encode)
-				);
+		if (_terminate) {
+			return;
+		}
 
-			if (_verbose) {
-				cout << e->get() << "\n";
-			}
+		_idle_time += seconds_now() - wait_start;
 
-			dcpomatic_log->log (e);
+		auto request = node.to_encode.front ();
+		node.to_encode.pop_front ();
+		++_encoding;
+		/* There's now space for a network thread to read another request */
+		_network_condition.notify_all ();
+
+		lock.unlock ();
+
+		bool ok = true;
+		try {
+			request->encoded = request->frame->encode_locally ();
+		} catch (std::exception& e) {
+			cerr << "Error: " << e.what() << "\n";
+			LOG_ERROR ("Error: %1", e.what());
+			ok = false;
 		}
 
-		_full_condition.notify_all ();
+		gettimeofday (&request->after_encode, 0);
+
+		lock.lock ();
+		--_encoding;
+		if (ok) {
+			_to_send.push_back (request);
+			_network_condition.notify_all ();
+		} else {
+			++_errors;
+		}
 	}
 }
 
 
+void
+EncodeServer::add_metrics (vector<Metrics::Metric>& metrics)
+{
+	using Metric = Metrics::Metric;
+	auto const counter = Metrics::Type::COUNTER;
+	auto const gauge = Metrics::Type::GAUGE;
+
+	boost::mutex::scoped_lock lm (_mutex);
+	metrics.push_back (Metric("dcpomatic_server_frames_total", "Frames encoded for remote clients", counter, _frames_encoded));
+	metrics.push_back (Metric("dcpomatic_server_errors_total", "Requests from remote clients which failed", counter, _errors));
+	metrics.push_back (Metric("dcpomatic_server_read_seconds_total", "Time spent receiving frames", counter, _read_time));
+	metrics.push_back (Metric("dcpomatic_server_encode_seconds_total", "Time spent encoding frames", counter, _encode_time));
+	metrics.push_back (Metric("dcpomatic_server_write_seconds_total", "Time spent sending encoded frames back", counter, _write_time));
+	metrics.push_back (Metric("dcpomatic_server_encode_idle_seconds_total", "Time encode threads have spent waiting for frames", counter, _idle_time));
+	metrics.push_back (Metric("dcpomatic_server_queue_length", "Connections waiting to be read", gauge, _queue.size()));
+	metrics.push_back (Metric("dcpomatic_server_encode_queue_length", "Frames waiting to be encoded", gauge, waiting_to_encode()));
+	metrics.push_back (Metric("dcpomatic_server_send_queue_length", "Encoded frames waiting to be sent back", gauge, _to_send.size()));
+	metrics.push_back (Metric("dcpomatic_server_encode_threads", "Encode threads", gauge, _num_threads));
+	metrics.push_back (Metric("dcpomatic_server_encode_threads_busy", "Encode threads which are currently encoding", gauge, _encoding));
+}
+
+
 void
 EncodeServer::run ()
 {
@@ -242,12 +416,49 @@ EncodeServer::run ()
 		cout << "DCP-o-matic server starting with " << _num_threads << " threads.\n";
 	}
 
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		if (_numa_pinning) {
+			for (auto const& i: numa_node_cpus()) {
+				if (static_cast<int>(_nodes.size()) < _num_threads) {
+					_nodes.push_back (Node());
+					_nodes.back().cpus = i;
+				}
+			}
+			LOG_GENERAL ("Spreading encode threads over %1 NUMA nodes", _nodes.size());
+		}
+
+		if (_nodes.empty()) {
+			_nodes.push_back (Node());
+		}
+
+		for (int i = 0; i < _num_threads; ++i) {
+			++_nodes[i % _nodes.size()].encode_threads;
+		}
+	}
+
 	for (int i = 0; i < _num_threads; ++i) {
+		int const node = i % _nodes.size();
+#ifdef DCPOMATIC_LINUX
+		boost::thread* t = _encode_threads.create_thread (bind(&EncodeServer::encode_thread, this, node));
+		pthread_setname_np (t->native_handle(), "encode-server-encode");
+#else
+		_encode_threads.create_thread (bind(&EncodeServer::encode_thread, this, node));
+#endif
+	}
+
+	/* These threads spend most of their time waiting for the network, so we can have
+	   plenty of them; we want enough to read and write all the requests that the
+	   encode threads can handle.  Each node gets at least one as there are at least
+	   as many of these as there are encode threads.
+	*/
+	for (int i = 0; i < max(2, _num_threads); ++i) {
+		int const node = i % _nodes.size();
 #ifdef DCPOMATIC_LINUX
-		boost::thread* t = _worker_threads.create_thread (bind(&EncodeServer::worker_thread, this));
-		pthread_setname_np (t->native_handle(), "encode-server-worker");
+		boost::thread* t = _network_threads.create_thread (bind(&EncodeServer::network_thread, this, node));
+		pthread_setname_np (t->native_handle(), "encode-server-network");
 #else
-		_worker_threads.create_thread (bind(&EncodeServer::worker_thread, this));
+		_network_threads.create_thread (bind(&EncodeServer::network_thread, this, node));
 #endif
 	}
 
@@ -294,7 +505,10 @@ EncodeServer::broadcast_received ()
 		/* Reply to the client saying what we can do */
 		xmlpp::Document doc;
 		auto root = doc.create_root_node ("ServerAvailable");
-		root->add_child("Threads")->add_child_text (raw_convert<string> (_worker_threads.size ()));
+		/* Ask for enough simultaneous requests to keep our encode threads busy while
+		   others are being sent to us, or sent back.
+		*/
+		root->add_child("Threads")->add_child_text (raw_convert<string> (advertised_threads()));
 		root->add_child("Version")->add_child_text (raw_convert<string> (SERVER_LINK_VERSION));
 		auto xml = doc.write_to_string ("UTF-8");
 
@@ -340,10 +554,10 @@ EncodeServer::handle (shared_ptr<Socket> socket)
 	waker.nudge ();
 
 	/* Wait until the queue has gone down a bit */
-	while (_queue.size() >= _worker_threads.size() * 2 && !_terminate) {
+	while (_queue.size() >= _network_threads.size() * 2 && !_terminate) {
 		_full_condition.wait (lock);
 	}
 
 	_queue.push_back (socket);
-	_empty_condition.notify_all ();
+	_network_condition.notify_one ();
 }
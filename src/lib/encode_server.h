@@ -30,12 +30,17 @@
 
 #include "server.h"
 #include "exception_store.h"
+#include "metrics.h"
+#include <dcp/array_data.h>
 #include <boost/thread.hpp>
 #include <boost/asio.hpp>
 #include <boost/thread/condition.hpp>
+#include <list>
 #include <string>
+#include <vector>
 
 
+class DCPVideo;
 class Socket;
 class Log;
 
@@ -43,6 +48,10 @@ class Log;
 /** @class EncodeServer
  *  @brief A class to run a server which can accept requests to perform JPEG2000
  *  encoding work.
+ *
+ *  Network threads read requests and send back replies while a separate set of
+ *  encode threads does the encoding, so that the encode threads need not wait
+ *  for the network.  A limited number of requests are read ahead of the encoders.
  */
 class EncodeServer : public Server, public ExceptionStore
 {
@@ -52,19 +61,98 @@ public:
 
 	void run ();
 
+	/** @return the number of requests that we ask each client to send us at once: one for each
+	 *  encode thread, plus the ones that are read ahead for them.
+	 */
+	int advertised_threads () const {
+		return _num_threads * (1 + _read_ahead);
+	}
+
 private:
+	/** A request which has been read from the network, and which is waiting to be encoded
+	 *  or has been encoded and is waiting to be sent back.
+	 */
+	struct Request
+	{
+		std::shared_ptr<Socket> socket;
+		std::string ip;
+		std::shared_ptr<DCPVideo> frame;
+		dcp::ArrayData encoded;
+		struct timeval start;
+		struct timeval after_read;
+		struct timeval after_encode;
+	};
+
+	/** A set of encode threads and the network threads which read requests for them.  When NUMA
+	 *  pinning is enabled there is one of these for each NUMA node, with all its threads pinned
+	 *  to the node's CPUs, so that frames are received into memory on the node which encodes them.
+	 *  Otherwise there is just one.
+	 */
+	struct Node
+	{
+		/** CPUs that this node's threads should run on, or empty to run anywhere */
+		std::vector<int> cpus;
+		/** number of encode threads */
+		int encode_threads = 0;
+		/** requests which have been read and are waiting to be encoded */
+		std::list<std::shared_ptr<Request>> to_encode;
+		/** number of requests currently being read by network threads */
+		int reading = 0;
+	};
+
 	void handle (std::shared_ptr<Socket>);
-	void worker_thread ();
-	int process (std::shared_ptr<Socket> socket, struct timeval &, struct timeval &);
+	void network_thread (int node);
+	void encode_thread (int node);
+	size_t waiting_to_encode () const;
+	std::shared_ptr<Request> receive (std::shared_ptr<Socket> socket);
+	void send (std::shared_ptr<Request> request);
+	void maybe_report ();
 	void broadcast_thread ();
 	void broadcast_received ();
+	void add_metrics (std::vector<Metrics::Metric>& metrics);
 
-	boost::thread_group _worker_threads;
+	boost::thread_group _network_threads;
+	boost::thread_group _encode_threads;
+	/** connections which have been accepted but not yet read */
 	std::list<std::shared_ptr<Socket>> _queue;
+	/** this is set up before any threads are started, and only the contents of
+	 *  its Nodes change after that
+	 */
+	std::vector<Node> _nodes;
+	/** requests which have been encoded and are waiting to be sent back */
+	std::list<std::shared_ptr<Request>> _to_send;
+	/** number of encode threads which are currently encoding */
+	int _encoding = 0;
+	/** used to wait for space in _queue */
 	boost::condition _full_condition;
-	boost::condition _empty_condition;
+	/** used to wake network threads when there is something for them to do */
+	boost::condition _network_condition;
+	/** used to wake encode threads when there is something for them to do */
+	boost::condition _encode_condition;
 	bool _verbose;
 	int _num_threads;
+	bool _numa_pinning;
+
+	/** number of requests to read ahead for each encode thread, so that it can start on
+	 *  another as soon as it finishes one rather than waiting for the network
+	 */
+	static int const _read_ahead;
+
+	/* Totals for metrics; protected by _mutex */
+	int64_t _frames_encoded = 0;
+	int64_t _errors = 0;
+	double _read_time = 0;
+	double _encode_time = 0;
+	double _write_time = 0;
+	/** total time that encode threads have spent waiting for something to encode */
+	double _idle_time = 0;
+
+	/** time of our last report of how busy the encode threads are */
+	double _last_report_time = 0;
+	/** value of _encode_time at _last_report_time */
+	double _last_report_encode_time = 0;
+
+	int _metrics_source;
 
 	struct Broadcast {
 
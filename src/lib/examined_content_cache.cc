@@ -0,0 +1,452 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/examined_content_cache.cc
+ *  @brief ExaminedContentCache class.
+ */
+
+
+#include "cross.h"
+#include "digester.h"
+#include "examined_content_cache.h"
+#include "exceptions.h"
+#include "util.h"
+#include "warnings.h"
+#include <dcp/raw_convert.h>
+#include <libcxml/cxml.h>
+DCPOMATIC_DISABLE_WARNINGS
+#include <libxml++/libxml++.h>
+DCPOMATIC_ENABLE_WARNINGS
+#include <boost/algorithm/string.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <algorithm>
+#include <ctime>
+
+#include "i18n.h"
+
+
+using std::make_pair;
+using std::map;
+using std::string;
+using std::vector;
+using boost::algorithm::trim;
+using boost::optional;
+using dcp::raw_convert;
+
+
+ExaminedContentCache* ExaminedContentCache::_instance;
+/** Increment this when an examiner starts to find something different in the same files,
+ *  so that the old results are no longer used.
+ */
+int const ExaminedContentCache::_current_version = 1;
+size_t const ExaminedContentCache::_max_entries = 4096;
+size_t const ExaminedContentCache::_max_size = 64 * 1024 * 1024;
+int const ExaminedContentCache::_write_delay = 5;
+
+
+ExaminedContentCache::ExaminedContentCache ()
+{
+	_writer_thread = boost::thread (boost::bind(&ExaminedContentCache::writer, this));
+}
+
+
+ExaminedContentCache::~ExaminedContentCache ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_stop = true;
+	_writer_condition.notify_all ();
+	lm.unlock ();
+
+	try {
+		_writer_thread.join ();
+	} catch (...) {}
+
+	flush ();
+}
+
+
+/** @return a key for some files, or none if they should not be cached */
+optional<string>
+ExaminedContentCache::key (vector<boost::filesystem::path> const& paths) const
+{
+	if (paths.empty()) {
+		return {};
+	}
+
+	auto const now = time (nullptr);
+
+	Digester digester;
+	for (auto const& i: paths) {
+		boost::system::error_code ec;
+		auto const size = boost::filesystem::file_size (i, ec);
+		if (ec) {
+			return {};
+		}
+		auto const last_write = boost::filesystem::last_write_time (i, ec);
+		if (ec || last_write > now - 2) {
+			return {};
+		}
+		digester.add (boost::filesystem::absolute(i).string());
+		digester.add (static_cast<uint64_t>(size));
+		digester.add (static_cast<int64_t>(last_write));
+	}
+
+	return digester.get ();
+}
+
+
+/** Must be called with a lock held on _mutex */
+ExaminedContentCache::Entry*
+ExaminedContentCache::find (string key)
+{
+	auto i = _entries.find (key);
+	if (i == _entries.end()) {
+		return nullptr;
+	}
+
+	i->second.last_use = ++_uses;
+	return &i->second;
+}
+
+
+string
+ExaminedContentCache::digest (vector<boost::filesystem::path> const& paths)
+{
+	auto const k = key (paths);
+	if (k) {
+		boost::mutex::scoped_lock lm (_mutex);
+		auto entry = find (*k);
+		if (entry && !entry->digest.empty()) {
+			return entry->digest;
+		}
+	}
+
+	auto const d = simple_digest (paths);
+
+	if (k) {
+		boost::mutex::scoped_lock lm (_mutex);
+		auto& entry = _entries[*k];
+		entry.digest = d;
+		entry.last_use = ++_uses;
+		lm.unlock ();
+		changed ();
+	}
+
+	return d;
+}
+
+
+optional<string>
+ExaminedContentCache::examination (vector<boost::filesystem::path> const& paths, string type)
+{
+	auto const k = key (paths);
+	if (!k) {
+		return {};
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	auto entry = find (*k);
+	if (!entry) {
+		return {};
+	}
+
+	auto i = entry->examinations.find (type);
+	if (i == entry->examinations.end()) {
+		return {};
+	}
+
+	return i->second;
+}
+
+
+void
+ExaminedContentCache::set_examination (vector<boost::filesystem::path> const& paths, string type, string xml)
+{
+	auto const k = key (paths);
+	if (!k) {
+		return;
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	auto& entry = _entries[*k];
+	entry.examinations[type] = xml;
+	entry.last_use = ++_uses;
+	lm.unlock ();
+
+	changed ();
+}
+
+
+void
+ExaminedContentCache::clear ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_entries.clear ();
+	_cleared = true;
+	lm.unlock ();
+
+	changed ();
+}
+
+
+/** Discard the least-recently-used entries if we have too many.  Must be called with a lock held on _mutex */
+void
+ExaminedContentCache::discard_old_entries ()
+{
+	auto entry_size = [](Entry const& entry) {
+		auto size = entry.digest.size();
+		for (auto const& i: entry.examinations) {
+			size += i.second.size();
+		}
+		return size;
+	};
+
+	size_t total_size = 0;
+	for (auto const& i: _entries) {
+		total_size += entry_size(i.second);
+	}
+
+	if (_entries.size() > _max_entries || total_size > _max_size) {
+		vector<std::pair<int64_t, string>> uses;
+		for (auto const& i: _entries) {
+			uses.push_back (make_pair(i.second.last_use, i.first));
+		}
+		std::sort (uses.begin(), uses.end());
+		/* Go down to 3/4 of the limits so that we don't have to do this every time */
+		auto i = uses.begin();
+		while (i != uses.end() && (_entries.size() > _max_entries * 3 / 4 || total_size > _max_size * 3 / 4)) {
+			auto entry = _entries.find (i->second);
+			total_size -= entry_size(entry->second);
+			_entries.erase (entry);
+			++i;
+		}
+	}
+}
+
+
+/** Discard old entries if necessary and ask for ourselves to be written out soon */
+void
+ExaminedContentCache::changed ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	discard_old_entries ();
+	if (!_dirty) {
+		_dirty = true;
+		_writer_condition.notify_all ();
+	}
+}
+
+
+/** Thread which writes our changes to disk a little while after they are made */
+void
+ExaminedContentCache::writer ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	while (true) {
+		while (!_dirty && !_stop) {
+			_writer_condition.wait (lm);
+		}
+
+		if (_stop) {
+			/* Our destructor will write any outstanding changes */
+			return;
+		}
+
+		/* Wait for more changes so that we write them all at once */
+		auto const until = boost::get_system_time() + boost::posix_time::seconds(_write_delay);
+		while (!_stop && _writer_condition.timed_wait(lm, until)) {}
+
+		lm.unlock ();
+		flush ();
+		lm.lock ();
+	}
+}
+
+
+/** Merge any entries that another process has written into our file, then write ourselves
+ *  out, if we have any changes.
+ */
+void
+ExaminedContentCache::flush ()
+{
+	boost::mutex::scoped_lock wm (_write_mutex);
+
+	boost::mutex::scoped_lock lm (_mutex);
+	if (!_dirty) {
+		return;
+	}
+	_dirty = false;
+	auto const cleared = _cleared;
+	_cleared = false;
+	lm.unlock ();
+
+	try {
+		auto const path = write_path("examined_content.xml");
+
+		/* Stop other processes changing the file between our reading and replacing it */
+		auto lock_path = path;
+		lock_path += ".lock";
+		if (auto f = fopen_boost(lock_path, "a")) {
+			fclose (f);
+		}
+		boost::interprocess::file_lock file_lock (lock_path.string().c_str());
+		boost::interprocess::scoped_lock<boost::interprocess::file_lock> flm (file_lock);
+
+		map<string, Entry> on_disk;
+		int64_t uses = 0;
+		if (!cleared && read_file(path, on_disk, uses)) {
+			lm.lock ();
+			_uses = std::max (_uses, uses);
+			for (auto const& i: on_disk) {
+				auto& entry = _entries[i.first];
+				if (entry.digest.empty()) {
+					entry.digest = i.second.digest;
+				}
+				for (auto const& j: i.second.examinations) {
+					entry.examinations.insert (j);
+				}
+				entry.last_use = std::max (entry.last_use, i.second.last_use);
+			}
+			discard_old_entries ();
+			lm.unlock ();
+		}
+
+		write ();
+	} catch (...) {
+		/* The cache is only there to save time, so never mind */
+	}
+}
+
+
+void
+ExaminedContentCache::write () const
+{
+	xmlpp::Document doc;
+	auto root = doc.create_root_node ("ExaminedContentCache");
+
+	root->add_child("Version")->add_child_text(raw_convert<string>(_current_version));
+
+	boost::mutex::scoped_lock lm (_mutex);
+	root->add_child("Uses")->add_child_text(raw_convert<string>(_uses));
+	for (auto const& i: _entries) {
+		auto node = root->add_child("Entry");
+		node->add_child("Key")->add_child_text(i.first);
+		if (!i.second.digest.empty()) {
+			node->add_child("Digest")->add_child_text(i.second.digest);
+		}
+		for (auto const& j: i.second.examinations) {
+			auto examination = node->add_child("Examination");
+			examination->set_attribute("type", j.first);
+			examination->add_child_text(j.second);
+		}
+		node->add_child("LastUse")->add_child_text(raw_convert<string>(i.second.last_use));
+	}
+	lm.unlock ();
+
+	/* Write to a temporary file then rename so that another process reading the cache
+	 * never sees half of it.
+	 */
+	auto const path = write_path("examined_content.xml");
+	auto tmp = path;
+	tmp += ".tmp";
+	try {
+		doc.write_to_file_formatted(tmp.string());
+	} catch (xmlpp::exception& e) {
+		string s = e.what ();
+		trim (s);
+		throw FileError (s, tmp);
+	}
+
+	boost::system::error_code ec;
+	boost::filesystem::rename (tmp, path, ec);
+	if (ec) {
+		throw FileError (ec.message(), path);
+	}
+}
+
+
+/** Read entries from a cache file.
+ *  @return true if the file was read, false if it did not exist, was from a different version or was damaged.
+ */
+bool
+ExaminedContentCache::read_file (boost::filesystem::path path, map<string, Entry>& entries, int64_t& uses)
+try
+{
+	cxml::Document f ("ExaminedContentCache");
+	f.read_file (path);
+	if (f.number_child<int>("Version") != _current_version) {
+		return false;
+	}
+
+	uses = f.number_child<int64_t>("Uses");
+	for (auto i: f.node_children("Entry")) {
+		Entry entry;
+		entry.digest = i->optional_string_child("Digest").get_value_or("");
+		for (auto j: i->node_children("Examination")) {
+			entry.examinations[j->string_attribute("type")] = j->content();
+		}
+		entry.last_use = i->number_child<int64_t>("LastUse");
+		entries[i->string_child("Key")] = entry;
+	}
+
+	return true;
+} catch (...) {
+	return false;
+}
+
+
+void
+ExaminedContentCache::read ()
+{
+	map<string, Entry> entries;
+	int64_t uses = 0;
+	if (!read_file(read_path("examined_content.xml"), entries, uses)) {
+		/* Never mind; we'll just start again */
+		return;
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	_uses = uses;
+	_entries = entries;
+}
+
+
+ExaminedContentCache*
+ExaminedContentCache::instance ()
+{
+	static boost::mutex instance_mutex;
+	boost::mutex::scoped_lock lm (instance_mutex);
+	if (!_instance) {
+		_instance = new ExaminedContentCache();
+		_instance->read();
+	}
+
+	return _instance;
+}
+
+
+void
+ExaminedContentCache::drop ()
+{
+	delete _instance;
+	_instance = nullptr;
+}
@@ -0,0 +1,125 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_EXAMINED_CONTENT_CACHE_H
+#define DCPOMATIC_EXAMINED_CONTENT_CACHE_H
+
+
+/** @file  src/lib/examined_content_cache.h
+ *  @brief ExaminedContentCache class.
+ */
+
+
+#include "state.h"
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+
+/** @class ExaminedContentCache
+ *  @brief A machine-wide store of content digests and examination results.
+ *
+ *  Results are kept against the paths, sizes and modification times of the content's
+ *  files, so they are not used once any of the files change.  Files which were modified
+ *  in the last few seconds are not cached, since another change in the same second
+ *  would not alter their modification time.
+ *
+ *  Changes are written to disk by a background thread a few seconds after they are made,
+ *  so that a run of changes is written once.  Before writing we merge in whatever another
+ *  process has written to the file in the meantime.
+ */
+class ExaminedContentCache : public State
+{
+public:
+	ExaminedContentCache ();
+	~ExaminedContentCache ();
+
+	ExaminedContentCache (ExaminedContentCache const&) = delete;
+	ExaminedContentCache& operator= (ExaminedContentCache const&) = delete;
+
+	/** @return the digest of some files, as calculated by simple_digest(), from the cache if possible */
+	std::string digest (std::vector<boost::filesystem::path> const& paths);
+
+	/** @param type Type of examination, so that different examiners of the same files can use the cache.
+	 *  @return XML written by an earlier examination of some files, if we have it.
+	 */
+	boost::optional<std::string> examination (std::vector<boost::filesystem::path> const& paths, std::string type);
+	void set_examination (std::vector<boost::filesystem::path> const& paths, std::string type, std::string xml);
+
+	void clear ();
+
+	void read () override;
+	void write () const override;
+	void flush ();
+
+	static ExaminedContentCache* instance ();
+	/** Write any unsaved changes and destroy the instance */
+	static void drop ();
+
+private:
+	struct Entry
+	{
+		std::string digest;
+		std::map<std::string, std::string> examinations;
+		/** value of _uses when this entry was last used */
+		int64_t last_use = 0;
+	};
+
+	boost::optional<std::string> key (std::vector<boost::filesystem::path> const& paths) const;
+	Entry* find (std::string key);
+	void changed ();
+	void discard_old_entries ();
+	void writer ();
+	static bool read_file (boost::filesystem::path path, std::map<std::string, Entry>& entries, int64_t& uses);
+
+	/** mutex to protect our entries */
+	mutable boost::mutex _mutex;
+	std::map<std::string, Entry> _entries;
+	/** number of times that we have been used, to decide which entries to discard */
+	int64_t _uses = 0;
+	/** true if we have changes which have not been written to disk */
+	bool _dirty = false;
+	/** true if clear() has been called since we last wrote to disk, so that entries on
+	 *  disk should not be merged back in.
+	 */
+	bool _cleared = false;
+	bool _stop = false;
+	boost::condition _writer_condition;
+	boost::thread _writer_thread;
+	/** mutex to stop more than one thread writing our file at the same time */
+	boost::mutex _write_mutex;
+
+	static ExaminedContentCache* _instance;
+	static int const _current_version;
+	static size_t const _max_entries;
+	/** maximum total size of our digests and examinations, in bytes */
+	static size_t const _max_size;
+	/** time to wait after a change, for more changes, before writing to disk, in seconds */
+	static int const _write_delay;
+};
+
+
+#endif
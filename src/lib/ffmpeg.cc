@@ -38,6 +38,8 @@ extern "C" {
 #include <libswscale/swscale.h>
 }
 #include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
 #include <iostream>
 
 #include "i18n.h"
@@ -54,6 +56,7 @@ using namespace dcpomatic;
 
 
 boost::mutex FFmpeg::_mutex;
+int FFmpeg::_open_video_decoders = 0;
 
 
 FFmpeg::FFmpeg (std::shared_ptr<const FFmpegContent> c)
@@ -68,6 +71,10 @@ FFmpeg::~FFmpeg ()
 {
 	boost::mutex::scoped_lock lm (_mutex);
 
+	if (_counted_video_decoder) {
+		--_open_video_decoders;
+	}
+
 	for (auto& i: _codec_context) {
 		avcodec_free_context (&i);
 	}
@@ -219,8 +226,15 @@ FFmpeg::setup_decoders ()
 				throw DecodeError ("avcodec_parameters_to_context", "FFmpeg::setup_decoders", r);
 			}
 
-			context->thread_count = 8;
-			context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+			if (_video_stream && i == static_cast<uint32_t>(*_video_stream)) {
+				context->thread_count = video_decode_threads (codec);
+				context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+				LOG_GENERAL ("Decoding %1 video using %2 thread(s)", codec->name, context->thread_count);
+			} else {
+				/* Audio and subtitle decoding is cheap enough that threads won't help */
+				context->thread_count = 1;
+				context->thread_type = 0;
+			}
 
 			AVDictionary* options = nullptr;
 			/* This option disables decoding of DCA frame footers in our patched version
@@ -243,6 +257,39 @@ FFmpeg::setup_decoders ()
 			dcpomatic_log->log (String::compose ("No codec found for stream %1", i), LogEntry::TYPE_WARNING);
 		}
 	}
+
+	/* Only count our video decoder once nothing else can throw, since our destructor
+	   (which takes it off the count) won't be called if the constructor throws.
+	*/
+	if (_video_stream && _codec_context[*_video_stream]) {
+		++_open_video_decoders;
+		_counted_video_decoder = true;
+	}
+}
+
+
+/** @return Number of threads that a new video decoder for codec should use; must be called with _mutex held */
+int
+FFmpeg::video_decode_threads (AVCodec const* codec) const
+{
+	auto config = Config::instance();
+
+	auto overrides = config->ffmpeg_decode_threads_overrides();
+	auto i = overrides.find (codec->name);
+	if (i != overrides.end()) {
+		return std::max (1, i->second);
+	}
+
+	if (config->ffmpeg_decode_threads() > 0) {
+		return config->ffmpeg_decode_threads();
+	}
+
+	/* Share the cores between all the video decoders that are open (including this one),
+	   up to a limit beyond which FFmpeg's frame threading costs more in latency and memory
+	   than it gives back.
+	*/
+	int const cores = std::max (1U, boost::thread::hardware_concurrency());
+	return std::max (1, std::min (16, cores / (_open_video_decoders + 1)));
 }
 
 
@@ -69,7 +69,7 @@ protected:
 	std::shared_ptr<const FFmpegContent> _ffmpeg_content;
 
 	uint8_t* _avio_buffer = nullptr;
-	int _avio_buffer_size = 4096;
+	int _avio_buffer_size = 65536;
 	AVIOContext* _avio_context = nullptr;
 	FileGroup _file_group;
 
@@ -88,10 +88,15 @@ protected:
 	   it is.
 	*/
 	static boost::mutex _mutex;
+	/** number of FFmpeg objects with an open video decoder; protected by _mutex */
+	static int _open_video_decoders;
+	/** true if we are counted in _open_video_decoders */
+	bool _counted_video_decoder = false;
 
 private:
 	void setup_general ();
 	void setup_decoders ();
+	int video_decode_threads (AVCodec const* codec) const;
 
 	static void ffmpeg_log_callback (void* ptr, int level, const char* fmt, va_list vl);
 	static std::weak_ptr<Log> _ffmpeg_log;
@@ -22,6 +22,8 @@
 #include "ffmpeg_content.h"
 #include "video_content.h"
 #include "audio_content.h"
+#include "examined_content_cache.h"
+#include "ffmpeg_examination.h"
 #include "ffmpeg_examiner.h"
 #include "ffmpeg_subtitle_stream.h"
 #include "ffmpeg_audio_stream.h"
@@ -43,6 +45,7 @@ extern "C" {
 }
 #include <libxml++/libxml++.h>
 #include <iostream>
+#include <sstream>
 
 #include "i18n.h"
 
@@ -129,6 +132,14 @@ FFmpegContent::FFmpegContent (cxml::ConstNodePtr node, int version, list<string>
 	_color_trc = get_optional_enum<AVColorTransferCharacteristic>(node, "ColorTransferCharacteristic");
 	_colorspace = get_optional_enum<AVColorSpace>(node, "Colorspace");
 	_bits_per_pixel = node->optional_number_child<int> ("BitsPerPixel");
+
+	if (auto keyframes = node->optional_string_child("VideoKeyframes")) {
+		std::istringstream s (*keyframes);
+		int64_t k;
+		while (s >> k) {
+			_video_keyframes.push_back (k);
+		}
+	}
 }
 
 
@@ -251,6 +262,16 @@ FFmpegContent::as_xml (xmlpp::Node* node, bool with_paths) const
 	if (_bits_per_pixel) {
 		node->add_child("BitsPerPixel")->add_child_text(raw_convert<string>(*_bits_per_pixel));
 	}
+	if (!_video_keyframes.empty()) {
+		string keyframes;
+		for (auto i: _video_keyframes) {
+			if (!keyframes.empty()) {
+				keyframes += " ";
+			}
+			keyframes += raw_convert<string>(i);
+		}
+		node->add_child("VideoKeyframes")->add_child_text(keyframes);
+	}
 }
 
 
@@ -266,7 +287,21 @@ FFmpegContent::examine (shared_ptr<const Film> film, shared_ptr<Job> job)
 
 	Content::examine (film, job);
 
-	auto examiner = make_shared<FFmpegExaminer>(shared_from_this (), job);
+	auto cache = ExaminedContentCache::instance ();
+
+	shared_ptr<FFmpegExamination> examiner;
+	if (auto xml = cache->examination(paths(), "FFmpeg")) {
+		try {
+			examiner = make_shared<FFmpegExamination>(*xml);
+		} catch (std::exception &) {
+			/* Something is wrong with the cache, so examine again */
+		}
+	}
+
+	if (!examiner) {
+		examiner = make_shared<FFmpegExamination>(FFmpegExaminer(shared_from_this(), job));
+		cache->set_examination (paths(), "FFmpeg", examiner->as_xml());
+	}
 
 	if (examiner->has_video ()) {
 		video.reset (new VideoContent (this));
@@ -285,6 +320,7 @@ FFmpegContent::examine (shared_ptr<const Film> film, shared_ptr<Job> job)
 			_color_trc = examiner->color_trc ();
 			_colorspace = examiner->colorspace ();
 			_bits_per_pixel = examiner->bits_per_pixel ();
+			_video_keyframes = examiner->video_keyframes ();
 
 			if (examiner->rotation()) {
 				auto rot = *examiner->rotation ();
@@ -97,6 +97,14 @@ public:
 		return _first_video;
 	}
 
+	/** @return timestamps of the video keyframes, in the video stream's time base, or
+	 *  an empty vector if they are not known.
+	 */
+	std::vector<int64_t> video_keyframes () const {
+		boost::mutex::scoped_lock lm (_mutex);
+		return _video_keyframes;
+	}
+
 	void signal_subtitle_stream_changed ();
 
 private:
@@ -116,6 +124,8 @@ private:
 	boost::optional<AVColorTransferCharacteristic> _color_trc;
 	boost::optional<AVColorSpace> _colorspace;
 	boost::optional<int> _bits_per_pixel;
+	/** Keyframe index from FFmpegExaminer */
+	std::vector<int64_t> _video_keyframes;
 };
 
 #endif
@@ -28,6 +28,7 @@
 #include "audio_content.h"
 #include "audio_decoder.h"
 #include "compose.hpp"
+#include "config.h"
 #include "dcpomatic_log.h"
 #include "exceptions.h"
 #include "ffmpeg_audio_stream.h"
@@ -54,6 +55,7 @@ extern "C" {
 #include <libavformat/avformat.h>
 }
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <vector>
@@ -81,6 +83,7 @@ FFmpegDecoder::FFmpegDecoder (shared_ptr<const Film> film, shared_ptr<const FFmp
 	if (c->video && c->video->use()) {
 		video = make_shared<VideoDecoder>(this, c);
 		_pts_offset = pts_offset (c->ffmpeg_audio_streams(), c->first_video(), c->active_video_frame_rate(film));
+		_video_keyframes = c->video_keyframes ();
 		/* It doesn't matter what size or pixel format this is, it just needs to be black */
 		_black_image = make_shared<Image>(AV_PIX_FMT_RGB24, dcp::Size (128, 128), Image::Alignment::PADDED);
 		_black_image->make_black ();
@@ -90,6 +93,11 @@ FFmpegDecoder::FFmpegDecoder (shared_ptr<const Film> film, shared_ptr<const FFmp
 
 	if (c->audio) {
 		audio = make_shared<AudioDecoder>(this, c->audio, fast);
+		for (auto i: c->audio->used_streams()) {
+			auto stream = dynamic_pointer_cast<FFmpegAudioStream>(i);
+			DCPOMATIC_ASSERT (stream);
+			_audio_streams.push_back (stream);
+		}
 	}
 
 	if (c->only_text()) {
@@ -103,6 +111,17 @@ FFmpegDecoder::FFmpegDecoder (shared_ptr<const Film> film, shared_ptr<const FFmp
 }
 
 
+/** Read our content ahead of the decoding in a background thread.  This costs a thread and
+ *  a buffer of Config::read_ahead_size() so it should only be used for decoders which are
+ *  going to be read steadily, i.e. ones which are playing or encoding.
+ */
+void
+FFmpegDecoder::enable_read_ahead ()
+{
+	_file_group.set_read_ahead (int64_t(Config::instance()->read_ahead_size()) * 1024 * 1024);
+}
+
+
 bool
 FFmpegDecoder::flush ()
 {
@@ -115,7 +134,7 @@ FFmpegDecoder::flush ()
 		}
 	}
 
-	for (auto i: ffmpeg_content()->ffmpeg_audio_streams()) {
+	for (auto i: _audio_streams) {
 		auto context = _codec_context[i->index(_format_context)];
 		int r = avcodec_send_packet (context, nullptr);
 		if (r < 0 && r != AVERROR_EOF) {
@@ -149,7 +168,7 @@ FFmpegDecoder::flush ()
 		}
 	}
 
-	for (auto i: _ffmpeg_content->ffmpeg_audio_streams ()) {
+	for (auto i: _audio_streams) {
 		auto a = audio->stream_position(film(), i);
 		/* Unfortunately if a is 0 that really means that we don't know the stream position since
 		   there has been no data on it since the last seek.  In this case we'll just do nothing
@@ -205,8 +224,14 @@ FFmpegDecoder::pass ()
 		decode_and_process_video_packet (packet);
 	} else if (fc->subtitle_stream() && fc->subtitle_stream()->uses_index(_format_context, si) && !only_text()->ignore()) {
 		decode_and_process_subtitle_packet (packet);
-	} else {
+	} else if (audio && !audio->ignore() && audio_stream_from_index(si)) {
 		decode_and_process_audio_packet (packet);
+	} else if (!_video_stream || si != _video_stream.get()) {
+		/* Nothing will use this stream (an audio stream with nothing mapped, or a subtitle stream that
+		   is not being used) so ask FFmpeg not to give us any more of it.  We keep reading video even
+		   if it is ignored since we may still use it to seek.
+		*/
+		_format_context->streams[si]->discard = AVDISCARD_ALL;
 	}
 
 	av_packet_free (&packet);
@@ -362,17 +387,6 @@ FFmpegDecoder::seek (ContentTime time, bool accurate)
 {
 	Decoder::seek (time, accurate);
 
-	/* If we are doing an `accurate' seek, we need to use pre-roll, as
-	   we don't really know what the seek will give us.
-	*/
-
-	auto pre_roll = accurate ? ContentTime::from_seconds (2) : ContentTime (0);
-	time -= pre_roll;
-
-	/* XXX: it seems debatable whether PTS should be used here...
-	   http://www.mjbshaw.com/2012/04/seeking-in-ffmpeg-know-your-timestamp.html
-	*/
-
 	optional<int> stream;
 
 	if (_video_stream) {
@@ -387,16 +401,41 @@ FFmpegDecoder::seek (ContentTime time, bool accurate)
 
 	DCPOMATIC_ASSERT (stream);
 
-	auto u = time - _pts_offset;
-	if (u < ContentTime ()) {
-		u = ContentTime ();
+	auto const time_base = av_q2d (_format_context->streams[stream.get()]->time_base);
+	int64_t seek_to = 0;
+
+	if (stream == _video_stream && !_video_keyframes.empty()) {
+		/* We know where the keyframes are, so we can seek straight to the one before the
+		   time we want.  For accurate seeks leave a little margin for audio which is
+		   interleaved ahead of its video, and for indices which give keyframes' decode
+		   rather than presentation times.
+		*/
+		auto const margin = accurate ? ContentTime::from_seconds(1) : ContentTime();
+		auto const target = llrint ((time - margin - _pts_offset).seconds() / time_base);
+		auto keyframe = std::upper_bound (_video_keyframes.begin(), _video_keyframes.end(), target);
+		if (keyframe != _video_keyframes.begin()) {
+			--keyframe;
+		}
+		seek_to = *keyframe;
+	} else {
+		/* If we are doing an `accurate' seek, we need to use pre-roll, as
+		   we don't really know what the seek will give us.
+		*/
+		auto pre_roll = accurate ? ContentTime::from_seconds (2) : ContentTime (0);
+		time -= pre_roll;
+
+		/* XXX: it seems debatable whether PTS should be used here...
+		   http://www.mjbshaw.com/2012/04/seeking-in-ffmpeg-know-your-timestamp.html
+		*/
+
+		auto u = time - _pts_offset;
+		if (u < ContentTime ()) {
+			u = ContentTime ();
+		}
+		seek_to = u.seconds() / time_base;
 	}
-	av_seek_frame (
-		_format_context,
-		stream.get(),
-		u.seconds() / av_q2d (_format_context->streams[stream.get()]->time_base),
-		AVSEEK_FLAG_BACKWARD
-		);
+
+	av_seek_frame (_format_context, stream.get(), seek_to, AVSEEK_FLAG_BACKWARD);
 
 	{
 		/* Force re-creation of filter graphs to reset them and hence to make sure
@@ -426,17 +465,15 @@ FFmpegDecoder::seek (ContentTime time, bool accurate)
 }
 
 
+/** @return The audio stream that we are using with the given index, or 0 */
 shared_ptr<FFmpegAudioStream>
 FFmpegDecoder::audio_stream_from_index (int index) const
 {
-	/* XXX: inefficient */
-	auto streams = ffmpeg_content()->ffmpeg_audio_streams();
-	auto stream = streams.begin();
-	while (stream != streams.end() && !(*stream)->uses_index(_format_context, index)) {
-		++stream;
-	}
+	auto stream = std::find_if (_audio_streams.begin(), _audio_streams.end(), [this, index](shared_ptr<FFmpegAudioStream> s) {
+		return s->uses_index(_format_context, index);
+	});
 
-	if (stream == streams.end ()) {
+	if (stream == _audio_streams.end ()) {
 		return {};
 	}
 
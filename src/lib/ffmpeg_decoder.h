@@ -29,6 +29,7 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 }
 #include <boost/thread/mutex.hpp>
+#include <vector>
 #include <stdint.h>
 
 class Log;
@@ -49,6 +50,8 @@ public:
 	bool pass () override;
 	void seek (dcpomatic::ContentTime time, bool) override;
 
+	void enable_read_ahead ();
+
 private:
 	friend struct ::ffmpeg_pts_offset_test;
 
@@ -77,11 +80,16 @@ private:
 	boost::mutex _filter_graphs_mutex;
 
 	dcpomatic::ContentTime _pts_offset;
+	/** Keyframe index of the video stream, in its time base; may be empty */
+	std::vector<int64_t> _video_keyframes;
 	boost::optional<dcpomatic::ContentTime> _current_subtitle_to;
 	/** true if we have a subtitle which has not had emit_stop called for it yet */
 	bool _have_current_subtitle = false;
 
 	std::shared_ptr<Image> _black_image;
 
+	/** Audio streams which can contribute to the output; we don't decode the others */
+	std::vector<std::shared_ptr<FFmpegAudioStream>> _audio_streams;
+
 	std::map<std::shared_ptr<FFmpegAudioStream>, boost::optional<dcpomatic::ContentTime>> _next_time;
 };
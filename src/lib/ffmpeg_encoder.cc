@@ -28,6 +28,7 @@
 #include "log.h"
 #include "player.h"
 #include "player_video.h"
+#include "trace.h"
 #include "compose.hpp"
 #include <iostream>
 
@@ -122,6 +123,8 @@ FFmpegEncoder::go ()
 		job->sub (_("Encoding"));
 	}
 
+	_butler->set_trace_session (Trace::thread_session());
+
 	Waker waker;
 
 	list<FileEncoderSet> file_encoders;
@@ -0,0 +1,178 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/ffmpeg_examination.cc
+ *  @brief FFmpegExamination class.
+ */
+
+
+#include "ffmpeg_audio_stream.h"
+#include "ffmpeg_examination.h"
+#include "ffmpeg_examiner.h"
+#include "ffmpeg_subtitle_stream.h"
+#include "film.h"
+#include "warnings.h"
+#include <dcp/raw_convert.h>
+#include <libcxml/cxml.h>
+DCPOMATIC_DISABLE_WARNINGS
+#include <libxml++/libxml++.h>
+DCPOMATIC_ENABLE_WARNINGS
+#include <sstream>
+
+
+using std::make_shared;
+using std::string;
+using dcp::raw_convert;
+
+
+FFmpegExamination::FFmpegExamination (FFmpegExaminer const& examiner)
+	: _has_video (examiner.has_video())
+	, _subtitle_streams (examiner.subtitle_streams())
+	, _audio_streams (examiner.audio_streams())
+	, _first_video (examiner.first_video())
+	, _rotation (examiner.rotation())
+	, _pulldown (examiner.pulldown())
+	, _video_keyframes (examiner.video_keyframes())
+{
+	if (_has_video) {
+		_video_frame_rate = examiner.video_frame_rate ();
+		_video_size = examiner.video_size ();
+		_video_length = examiner.video_length ();
+		_sample_aspect_ratio = examiner.sample_aspect_ratio ();
+		_yuv = examiner.yuv ();
+		_range = examiner.range ();
+		_pixel_quanta = examiner.pixel_quanta ();
+		_color_range = examiner.color_range ();
+		_color_primaries = examiner.color_primaries ();
+		_color_trc = examiner.color_trc ();
+		_colorspace = examiner.colorspace ();
+		_bits_per_pixel = examiner.bits_per_pixel ();
+	}
+}
+
+
+FFmpegExamination::FFmpegExamination (string xml)
+{
+	auto node = make_shared<cxml::Document>("FFmpegExamination");
+	node->read_string (xml);
+
+	/* The streams are written as they would be in a film's metadata */
+	auto const version = Film::current_state_version;
+
+	_has_video = node->bool_child("HasVideo");
+	if (_has_video) {
+		_video_frame_rate = node->optional_number_child<double>("VideoFrameRate");
+		_video_size = dcp::Size (node->number_child<int>("VideoWidth"), node->number_child<int>("VideoHeight"));
+		_video_length = node->number_child<Frame>("VideoLength");
+		_sample_aspect_ratio = node->optional_number_child<double>("SampleAspectRatio");
+		_yuv = node->bool_child("YUV");
+		_range = static_cast<VideoRange>(node->number_child<int>("Range"));
+		_pixel_quanta = PixelQuanta (node->node_child("PixelQuanta"));
+		_color_range = static_cast<AVColorRange>(node->number_child<int>("ColorRange"));
+		_color_primaries = static_cast<AVColorPrimaries>(node->number_child<int>("ColorPrimaries"));
+		_color_trc = static_cast<AVColorTransferCharacteristic>(node->number_child<int>("ColorTransferCharacteristic"));
+		_colorspace = static_cast<AVColorSpace>(node->number_child<int>("Colorspace"));
+		_bits_per_pixel = node->optional_number_child<int>("BitsPerPixel");
+	}
+
+	for (auto i: node->node_children("SubtitleStream")) {
+		_subtitle_streams.push_back (make_shared<FFmpegSubtitleStream>(i, version));
+	}
+
+	for (auto i: node->node_children("AudioStream")) {
+		_audio_streams.push_back (make_shared<FFmpegAudioStream>(i, version));
+	}
+
+	if (auto first_video = node->optional_number_child<dcpomatic::ContentTime::Type>("FirstVideo")) {
+		_first_video = dcpomatic::ContentTime (*first_video);
+	}
+
+	_rotation = node->optional_number_child<double>("Rotation");
+	_pulldown = node->bool_child("Pulldown");
+
+	std::istringstream s (node->optional_string_child("VideoKeyframes").get_value_or(""));
+	int64_t k;
+	while (s >> k) {
+		_video_keyframes.push_back (k);
+	}
+}
+
+
+string
+FFmpegExamination::as_xml () const
+{
+	xmlpp::Document doc;
+	auto root = doc.create_root_node ("FFmpegExamination");
+
+	root->add_child("HasVideo")->add_child_text(_has_video ? "1" : "0");
+	if (_has_video) {
+		if (_video_frame_rate) {
+			root->add_child("VideoFrameRate")->add_child_text(raw_convert<string>(*_video_frame_rate));
+		}
+		root->add_child("VideoWidth")->add_child_text(raw_convert<string>(_video_size.width));
+		root->add_child("VideoHeight")->add_child_text(raw_convert<string>(_video_size.height));
+		root->add_child("VideoLength")->add_child_text(raw_convert<string>(_video_length));
+		if (_sample_aspect_ratio) {
+			root->add_child("SampleAspectRatio")->add_child_text(raw_convert<string>(*_sample_aspect_ratio));
+		}
+		root->add_child("YUV")->add_child_text(_yuv ? "1" : "0");
+		root->add_child("Range")->add_child_text(raw_convert<string>(static_cast<int>(_range)));
+		_pixel_quanta.as_xml (root->add_child("PixelQuanta"));
+		root->add_child("ColorRange")->add_child_text(raw_convert<string>(static_cast<int>(_color_range)));
+		root->add_child("ColorPrimaries")->add_child_text(raw_convert<string>(static_cast<int>(_color_primaries)));
+		root->add_child("ColorTransferCharacteristic")->add_child_text(raw_convert<string>(static_cast<int>(_color_trc)));
+		root->add_child("Colorspace")->add_child_text(raw_convert<string>(static_cast<int>(_colorspace)));
+		if (_bits_per_pixel) {
+			root->add_child("BitsPerPixel")->add_child_text(raw_convert<string>(*_bits_per_pixel));
+		}
+	}
+
+	for (auto i: _subtitle_streams) {
+		i->as_xml (root->add_child("SubtitleStream"));
+	}
+
+	for (auto i: _audio_streams) {
+		i->as_xml (root->add_child("AudioStream"));
+	}
+
+	if (_first_video) {
+		root->add_child("FirstVideo")->add_child_text(raw_convert<string>(_first_video->get()));
+	}
+
+	if (_rotation) {
+		root->add_child("Rotation")->add_child_text(raw_convert<string>(*_rotation));
+	}
+
+	root->add_child("Pulldown")->add_child_text(_pulldown ? "1" : "0");
+
+	if (!_video_keyframes.empty()) {
+		string keyframes;
+		for (auto i: _video_keyframes) {
+			if (!keyframes.empty()) {
+				keyframes += " ";
+			}
+			keyframes += raw_convert<string>(i);
+		}
+		root->add_child("VideoKeyframes")->add_child_text(keyframes);
+	}
+
+	return doc.write_to_string ("UTF-8");
+}
@@ -0,0 +1,159 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_FFMPEG_EXAMINATION_H
+#define DCPOMATIC_FFMPEG_EXAMINATION_H
+
+
+/** @file  src/lib/ffmpeg_examination.h
+ *  @brief FFmpegExamination class.
+ */
+
+
+#include "dcpomatic_time.h"
+#include "video_examiner.h"
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+#include <boost/optional.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+class FFmpegAudioStream;
+class FFmpegExaminer;
+class FFmpegSubtitleStream;
+
+
+/** @class FFmpegExamination
+ *  @brief The results of an FFmpegExaminer, which can be written to and read back from XML
+ *  so that they can be kept in the ExaminedContentCache.
+ */
+class FFmpegExamination : public VideoExaminer
+{
+public:
+	explicit FFmpegExamination (FFmpegExaminer const& examiner);
+	/** Read from XML written by as_xml(); throws if the XML is not as we expect */
+	explicit FFmpegExamination (std::string xml);
+
+	std::string as_xml () const;
+
+	bool has_video () const override {
+		return _has_video;
+	}
+
+	boost::optional<double> video_frame_rate () const override {
+		return _video_frame_rate;
+	}
+
+	dcp::Size video_size () const override {
+		return _video_size;
+	}
+
+	Frame video_length () const override {
+		return _video_length;
+	}
+
+	boost::optional<double> sample_aspect_ratio () const override {
+		return _sample_aspect_ratio;
+	}
+
+	bool yuv () const override {
+		return _yuv;
+	}
+
+	VideoRange range () const override {
+		return _range;
+	}
+
+	PixelQuanta pixel_quanta () const override {
+		return _pixel_quanta;
+	}
+
+	std::vector<std::shared_ptr<FFmpegSubtitleStream>> subtitle_streams () const {
+		return _subtitle_streams;
+	}
+
+	std::vector<std::shared_ptr<FFmpegAudioStream>> audio_streams () const {
+		return _audio_streams;
+	}
+
+	boost::optional<dcpomatic::ContentTime> first_video () const {
+		return _first_video;
+	}
+
+	AVColorRange color_range () const {
+		return _color_range;
+	}
+
+	AVColorPrimaries color_primaries () const {
+		return _color_primaries;
+	}
+
+	AVColorTransferCharacteristic color_trc () const {
+		return _color_trc;
+	}
+
+	AVColorSpace colorspace () const {
+		return _colorspace;
+	}
+
+	boost::optional<int> bits_per_pixel () const {
+		return _bits_per_pixel;
+	}
+
+	boost::optional<double> rotation () const {
+		return _rotation;
+	}
+
+	bool pulldown () const {
+		return _pulldown;
+	}
+
+	std::vector<int64_t> video_keyframes () const {
+		return _video_keyframes;
+	}
+
+private:
+	bool _has_video = false;
+	boost::optional<double> _video_frame_rate;
+	dcp::Size _video_size;
+	Frame _video_length = 0;
+	boost::optional<double> _sample_aspect_ratio;
+	bool _yuv = false;
+	VideoRange _range = VideoRange::FULL;
+	PixelQuanta _pixel_quanta;
+	std::vector<std::shared_ptr<FFmpegSubtitleStream>> _subtitle_streams;
+	std::vector<std::shared_ptr<FFmpegAudioStream>> _audio_streams;
+	boost::optional<dcpomatic::ContentTime> _first_video;
+	AVColorRange _color_range = AVCOL_RANGE_UNSPECIFIED;
+	AVColorPrimaries _color_primaries = AVCOL_PRI_UNSPECIFIED;
+	AVColorTransferCharacteristic _color_trc = AVCOL_TRC_UNSPECIFIED;
+	AVColorSpace _colorspace = AVCOL_SPC_UNSPECIFIED;
+	boost::optional<int> _bits_per_pixel;
+	boost::optional<double> _rotation;
+	bool _pulldown = false;
+	std::vector<int64_t> _video_keyframes;
+};
+
+
+#endif
@@ -38,6 +38,7 @@ extern "C" {
 #include <libavutil/eval.h>
 }
 DCPOMATIC_ENABLE_WARNINGS
+#include <algorithm>
 #include <iostream>
 
 #include "i18n.h"
@@ -112,10 +113,23 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 		job->sub (_("Finding length"));
 	}
 
+	/* We need a keyframe index to make accurate seeks quick, unless the demuxer has
+	 * given us one or every frame is a keyframe anyway.
+	 */
+	bool need_keyframes = false;
+	if (_video_stream) {
+		auto const descriptor = avcodec_descriptor_get (_format_context->streams[*_video_stream]->codecpar->codec_id);
+		if (!descriptor || !(descriptor->props & AV_CODEC_PROP_INTRA_ONLY)) {
+			demuxer_keyframes ();
+			need_keyframes = _video_keyframes.empty();
+		}
+	}
+
 	/* Run through until we find:
 	 *   - the first video.
 	 *   - the first audio for each stream.
 	 *   - the top-field-first and repeat-first-frame values ("temporal_reference") for the first PULLDOWN_CHECK_FRAMES video frames.
+	 * and then, if we need them, carry on reading (but not decoding) to find the keyframes.
 	 */
 
 	int64_t const len = _file_group.length ();
@@ -124,6 +138,8 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 	 * and a string seems a reasonably neat way to do that.
 	 */
 	string temporal_reference;
+	/* true if we have everything we need apart from the keyframes */
+	bool examined = false;
 	while (true) {
 		auto packet = av_packet_alloc ();
 		DCPOMATIC_ASSERT (packet);
@@ -141,9 +157,23 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 			}
 		}
 
+		bool const video = _video_stream && packet->stream_index == _video_stream.get();
+
+		if (need_keyframes && video && (packet->flags & AV_PKT_FLAG_KEY)) {
+			auto const pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+			if (pts != AV_NOPTS_VALUE) {
+				_video_keyframes.push_back (pts);
+			}
+		}
+
+		if (examined) {
+			av_packet_free (&packet);
+			continue;
+		}
+
 		auto context = _codec_context[packet->stream_index];
 
-		if (_video_stream && packet->stream_index == _video_stream.get()) {
+		if (video) {
 			video_packet (context, temporal_reference, packet);
 		}
 
@@ -161,11 +191,20 @@ FFmpegExaminer::FFmpegExaminer (shared_ptr<const FFmpegContent> c, shared_ptr<Jo
 		av_packet_free (&packet);
 
 		if (_first_video && got_all_audio && temporal_reference.size() >= (PULLDOWN_CHECK_FRAMES * 2)) {
-			/* All done */
-			break;
+			if (!need_keyframes) {
+				/* All done */
+				break;
+			}
+			examined = true;
+			if (job) {
+				job->sub (_("Indexing keyframes"));
+			}
 		}
 	}
 
+	std::sort (_video_keyframes.begin(), _video_keyframes.end());
+	_video_keyframes.erase (std::unique(_video_keyframes.begin(), _video_keyframes.end()), _video_keyframes.end());
+
 	if (_video_stream) {
 		auto context = _codec_context[_video_stream.get()];
 		while (video_packet(context, temporal_reference, nullptr)) {}
@@ -282,6 +321,61 @@ FFmpegExaminer::audio_packet (AVCodecContext* context, shared_ptr<FFmpegAudioStr
 }
 
 
+/** Fill _video_keyframes from any index that the demuxer has made of the video stream,
+ *  if we can be sure that the index covers the whole stream.
+ */
+void
+FFmpegExaminer::demuxer_keyframes ()
+{
+	if (_format_context->iformat->flags & AVFMT_GENERIC_INDEX) {
+		/* This index is built up as packets are read, so all it can tell us about are
+		   the keyframes in the part of the file that was read when finding stream info.
+		*/
+		return;
+	}
+
+	auto stream = _format_context->streams[*_video_stream];
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+	int const entries = avformat_index_get_entries_count (stream);
+	for (int i = 0; i < entries; ++i) {
+		auto entry = avformat_index_get_entry (stream, i);
+		if (entry && (entry->flags & AVINDEX_KEYFRAME)) {
+			_video_keyframes.push_back (entry->timestamp);
+		}
+	}
+#else
+	for (int i = 0; i < stream->nb_index_entries; ++i) {
+		if (stream->index_entries[i].flags & AVINDEX_KEYFRAME) {
+			_video_keyframes.push_back (stream->index_entries[i].timestamp);
+		}
+	}
+#endif
+
+	if (_video_keyframes.empty()) {
+		return;
+	}
+
+	/* Even a demuxer's own index may not cover the whole file (if the file was truncated, say),
+	   and if it doesn't a seek past its end would have to start decoding from its last keyframe.
+	   Only use an index whose last keyframe is near the end of the stream.
+	*/
+	optional<double> end;
+	if (stream->duration != AV_NOPTS_VALUE) {
+		end = (stream->duration + (stream->start_time == AV_NOPTS_VALUE ? 0 : stream->start_time)) * av_q2d(stream->time_base);
+	} else if (_format_context->duration != AV_NOPTS_VALUE) {
+		auto const start = _format_context->start_time == AV_NOPTS_VALUE ? 0 : _format_context->start_time;
+		end = static_cast<double>(_format_context->duration + start) / AV_TIME_BASE;
+	}
+
+	/* Longest gap, in seconds, that we will accept between the last keyframe in the index and the end of the stream */
+	double const tolerance = 10;
+	auto const last = *std::max_element(_video_keyframes.begin(), _video_keyframes.end());
+	if (!end || *end - last * av_q2d(stream->time_base) > tolerance) {
+		_video_keyframes.clear ();
+	}
+}
+
+
 optional<ContentTime>
 FFmpegExaminer::frame_time (AVFrame* frame, AVStream* stream) const
 {
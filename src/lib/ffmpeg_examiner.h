@@ -85,6 +85,13 @@ public:
 		return _pulldown;
 	}
 
+	/** @return timestamps of the keyframes in the video stream, in the stream's time base,
+	 *  or an empty vector if we have no index (or need none because every frame is a keyframe).
+	 */
+	std::vector<int64_t> video_keyframes () const {
+		return _video_keyframes;
+	}
+
 private:
 	bool video_packet (AVCodecContext* context, std::string& temporal_reference, AVPacket* packet);
 	void audio_packet (AVCodecContext* context, std::shared_ptr<FFmpegAudioStream>, AVPacket* packet);
@@ -92,6 +99,7 @@ private:
 	std::string stream_name (AVStream* s) const;
 	std::string subtitle_stream_name (AVStream* s) const;
 	boost::optional<dcpomatic::ContentTime> frame_time (AVFrame* frame, AVStream* stream) const;
+	void demuxer_keyframes ();
 
 	std::vector<std::shared_ptr<FFmpegSubtitleStream>> _subtitle_streams;
 	std::vector<std::shared_ptr<FFmpegAudioStream>> _audio_streams;
@@ -104,6 +112,7 @@ private:
 
 	boost::optional<double> _rotation;
 	bool _pulldown;
+	std::vector<int64_t> _video_keyframes;
 
 	struct SubtitleStart
 	{
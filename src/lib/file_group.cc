@@ -29,8 +29,12 @@
 #include "dcpomatic_assert.h"
 #include "exceptions.h"
 #include "file_group.h"
+#include "read_ahead.h"
 #include <sndfile.h>
 #include <cstdio>
+#ifdef DCPOMATIC_LINUX
+#include <fcntl.h>
+#endif
 
 
 using std::vector;
@@ -76,6 +80,21 @@ FileGroup::set_paths (vector<boost::filesystem::path> const & p)
 	_paths = p;
 	ensure_open_path (0);
 	seek (0, SEEK_SET);
+	set_read_ahead (_read_ahead_size);
+}
+
+
+/** Set up reading ahead in the background.
+ *  @param size Size of buffer to read ahead into, in bytes, or 0 to read only when asked.
+ */
+void
+FileGroup::set_read_ahead (int64_t size)
+{
+	_read_ahead_size = size;
+	_read_ahead.reset ();
+	if (_read_ahead_size > 0 && !_paths.empty()) {
+		_read_ahead.reset (new ReadAhead(_paths, _read_ahead_size));
+	}
 }
 
 
@@ -98,6 +117,11 @@ FileGroup::ensure_open_path (size_t p) const
 		throw OpenFileError (_paths[_current_path], errno, OpenFileError::READ);
 	}
 	_current_size = boost::filesystem::file_size (_paths[_current_path]);
+
+#ifdef DCPOMATIC_LINUX
+	/* We will mostly be reading straight through */
+	posix_fadvise (fileno(_current_file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 }
 
 
@@ -116,6 +140,11 @@ FileGroup::seek (int64_t pos, int whence) const
 		break;
 	}
 
+	if (_read_ahead) {
+		/* _read_ahead will take care of it */
+		return _position;
+	}
+
 	/* Find an offset within one of the files, if _position is within a file */
 	size_t i = 0;
 	int64_t sub_pos = _position;
@@ -148,6 +177,19 @@ FileGroup::seek (int64_t pos, int whence) const
 int
 FileGroup::read (uint8_t* buffer, int amount) const
 {
+	if (_read_ahead) {
+		int read = 0;
+		while (read < amount) {
+			int const this_time = _read_ahead->read (_position, buffer + read, amount - read);
+			if (this_time == 0) {
+				break;
+			}
+			read += this_time;
+			_position += this_time;
+		}
+		return read;
+	}
+
 	int read = 0;
 	while (true) {
 
@@ -29,11 +29,18 @@
 
 
 #include <boost/filesystem.hpp>
+#include <memory>
 #include <vector>
 
 
+class ReadAhead;
+
+
 /** @class FileGroup
  *  @brief A class to make a list of files behave like they were concatenated.
+ *
+ *  If set_read_ahead() is called reads come from a ReadAhead, which fetches
+ *  data in the background.
  */
 class FileGroup
 {
@@ -47,6 +54,7 @@ public:
 	FileGroup& operator= (FileGroup const&) = delete;
 
 	void set_paths (std::vector<boost::filesystem::path> const &);
+	void set_read_ahead (int64_t size);
 
 	int64_t seek (int64_t, int) const;
 	int read (uint8_t*, int) const;
@@ -61,6 +69,9 @@ private:
 	mutable FILE* _current_file = nullptr;
 	mutable size_t _current_size = 0;
 	mutable int64_t _position = 0;
+	/** Size of read-ahead buffer in bytes, or 0 */
+	int64_t _read_ahead_size = 0;
+	std::unique_ptr<ReadAhead> _read_ahead;
 };
 
 
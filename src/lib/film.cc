@@ -114,6 +114,8 @@ using namespace dcpomatic;
 
 
 static constexpr char metadata_file[] = "metadata.xml";
+/** Prefix of the filenames of analyses made by content_audio_analysis_path() */
+static constexpr char content_audio_analysis_prefix[] = "content_";
 
 
 /* 5 -> 6
@@ -345,6 +347,70 @@ Film::audio_analysis_path (shared_ptr<const Playlist> playlist) const
 }
 
 
+/** @return Path of an analysis of the audio of a single piece of content, as it
+ *  would sound in this film but without its gain applied.  These analyses are
+ *  combined by AnalyseAudioJob to make analyses of whole playlists.
+ */
+boost::filesystem::path
+Film::content_audio_analysis_path (shared_ptr<const Content> content) const
+{
+	DCPOMATIC_ASSERT (content->audio);
+
+	auto p = dir ("analysis");
+
+	Digester digester;
+	digester.add ("content");
+	digester.add (content->digest());
+	digester.add (content->audio->mapping().digest());
+	digester.add (content->audio->delay());
+	digester.add (content->trim_start().get());
+	digester.add (content->trim_end().get());
+	digester.add (content->video_frame_rate().get_value_or(0));
+
+	if (audio_processor ()) {
+		digester.add (audio_processor()->id ());
+	}
+
+	digester.add (audio_channels());
+	digester.add (audio_frame_rate());
+	digester.add (video_frame_rate());
+
+	p /= content_audio_analysis_prefix + digester.get ();
+	return p;
+}
+
+
+/** Remove any analyses made by content_audio_analysis_path() which no longer
+ *  correspond to a piece of content in this film, either because the content
+ *  has been removed or because something that affects its analysis has changed.
+ *  This touches the disk so it is called by AnalyseAudioJob rather than from the GUI.
+ */
+void
+Film::remove_stale_content_audio_analyses () const
+{
+	if (!_directory) {
+		return;
+	}
+
+	set<boost::filesystem::path> current;
+	for (auto i: content()) {
+		if (i->audio) {
+			current.insert (content_audio_analysis_path(i).filename());
+		}
+	}
+
+	boost::system::error_code ec;
+	for (boost::filesystem::directory_iterator i(dir("analysis", false), ec); !ec && i != boost::filesystem::directory_iterator(); i.increment(ec)) {
+		auto const name = i->path().filename();
+		if (boost::algorithm::starts_with(name.string(), content_audio_analysis_prefix) && current.find(name) == current.end()) {
+			LOG_GENERAL ("Removing stale audio analysis %1", i->path().string());
+			boost::system::error_code remove_ec;
+			boost::filesystem::remove (i->path(), remove_ec);
+		}
+	}
+}
+
+
 boost::filesystem::path
 Film::subtitle_analysis_path (shared_ptr<const Content> content) const
 {
@@ -528,7 +594,7 @@ Film::read_metadata (optional<boost::filesystem::path> path)
 		auto const older = path->parent_path() / String::compose("metadata.%1.xml", _state_version);
 		if (!boost::filesystem::is_regular_file(older)) {
 			try {
-				boost::filesystem::copy_file(*path, older);
+				copy_in_bits (*path, older, {});
 			} catch (...) {
 				/* Never mind; at least we tried */
 			}
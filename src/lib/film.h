@@ -115,6 +115,8 @@ public:
 	boost::filesystem::path internal_video_asset_filename (dcpomatic::DCPTimePeriod p) const;
 
 	boost::filesystem::path audio_analysis_path (std::shared_ptr<const Playlist>) const;
+	boost::filesystem::path content_audio_analysis_path (std::shared_ptr<const Content>) const;
+	void remove_stale_content_audio_analyses () const;
 	boost::filesystem::path subtitle_analysis_path (std::shared_ptr<const Content>) const;
 
 	void send_dcp_to_tms ();
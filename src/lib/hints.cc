@@ -30,7 +30,9 @@
 #include "font.h"
 #include "font_data.h"
 #include "hints.h"
+#include "image.h"
 #include "player.h"
+#include "playlist.h"
 #include "ratio.h"
 #include "text_content.h"
 #include "types.h"
@@ -43,6 +45,7 @@
 #include <dcp/reel_closed_caption_asset.h>
 #include <dcp/reel_subtitle_asset.h>
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
 #include <iostream>
 
 #include "i18n.h"
@@ -50,9 +53,12 @@
 
 using std::cout;
 using std::make_shared;
+using std::map;
 using std::max;
+using std::pair;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 using std::weak_ptr;
 using boost::optional;
 using boost::bind;
@@ -73,9 +79,19 @@ using namespace boost::placeholders;
  */
 
 
+/** Maximum total size of the images in Hints::_scan_cache, in bytes */
+static size_t const max_scan_cache_bytes = 64 * 1024 * 1024;
+
+
+boost::mutex Hints::_cache_mutex;
+map<string, Hints::CachedScan> Hints::_scan_cache;
+size_t Hints::_scan_cache_bytes = 0;
+int64_t Hints::_scan_cache_uses = 0;
+map<string, Hints::TextAssetSizes> Hints::_text_asset_sizes_cache;
+
+
 Hints::Hints (weak_ptr<const Film> weak_film)
 	: WeakConstFilm (weak_film)
-	, _writer (new Writer(weak_film, weak_ptr<Job>(), true))
 	, _analyser (film(), film()->playlist(), true, [](float) {})
 	, _stop (false)
 {
@@ -368,19 +384,12 @@ Hints::check_out_of_range_markers ()
 }
 
 
-void
-Hints::thread ()
-try
+/** Run the checks which only need to look at the film's metadata, and at any audio analysis that is already there.
+ *  @return true if the loudness could be checked, false if it could not because no analysis was available.
+ */
+bool
+Hints::check_metadata ()
 {
-	start_of_thread ("Hints");
-
-	auto film = _film.lock ();
-	if (!film) {
-		return;
-	}
-
-	auto content = film->content ();
-
 	check_interop ();
 	check_big_font_files ();
 	check_few_audio_channels ();
@@ -398,22 +407,37 @@ try
 	check_out_of_range_markers ();
 	check_text_languages ();
 	check_audio_language ();
+	return check_loudness_done;
+}
 
-	if (check_loudness_done) {
-		emit (bind(boost::ref(Progress), _("Examining subtitles and closed captions")));
-	} else {
-		emit (bind(boost::ref(Progress), _("Examining audio, subtitles and closed captions")));
-	}
 
-	auto player = make_shared<Player>(film, Image::Alignment::COMPACT);
-	player->set_ignore_video ();
-	if (check_loudness_done || _disable_audio_analysis) {
-		/* We don't need to analyse audio because we already loaded a suitable analysis */
-		player->set_ignore_audio ();
+/** @return A key which changes whenever something changes that could alter the texts that a player
+ *  would emit for some content.
+ */
+static
+string
+scan_key (shared_ptr<const Film> film, shared_ptr<const Content> content)
+{
+	/* The size of bitmap texts depends on the film's frame size */
+	auto key = String::compose(
+		"%1_%2_%3_%4", content->identifier(), film->video_frame_rate(), resolution_to_string(film->resolution()), film->container()->id()
+		);
+	for (auto i: content->text) {
+		key += String::compose("_%1_%2_%3_%4", i->identifier(), i->use() ? 1 : 0, i->burn() ? 1 : 0, text_type_to_string(i->type()));
+		if (auto track = i->dcp_track()) {
+			key += "_" + track->name + "_" + (track->language ? track->language->to_string() : "");
+		}
 	}
-	player->Audio.connect (bind(&Hints::audio, this, _1, _2));
-	player->Text.connect (bind(&Hints::text, this, _1, _2, _3, _4));
+	return key;
+}
 
+
+/** Pass a player through to the end, giving pulses as we go.
+ *  @return true if we got to the end, false if we were asked to stop.
+ */
+bool
+Hints::pass (shared_ptr<Player> player)
+{
 	struct timeval last_pulse;
 	gettimeofday (&last_pulse, 0);
 
@@ -423,65 +447,247 @@ try
 		gettimeofday (&now, 0);
 		if ((seconds(now) - seconds(last_pulse)) > 1) {
 			if (_stop) {
-				return;
+				return false;
 			}
 			emit (bind (boost::ref(Pulse)));
 			last_pulse = now;
 		}
 	}
 
-	if (!check_loudness_done) {
-		_analyser.finish ();
-		_analyser.get().write(film->audio_analysis_path(film->playlist()));
-		check_loudness ();
+	return true;
+}
+
+
+/** @return The texts in some content, from the cache if we have scanned it before, or nullptr if we were asked to stop */
+shared_ptr<const Hints::ScannedContent>
+Hints::scan (shared_ptr<const Film> film, shared_ptr<Content> content)
+{
+	auto const key = scan_key (film, content);
+
+	{
+		boost::mutex::scoped_lock lm (_cache_mutex);
+		auto i = _scan_cache.find (key);
+		if (i != _scan_cache.end()) {
+			i->second.last_use = ++_scan_cache_uses;
+			return i->second.scan;
+		}
 	}
 
-	_writer->write (player->get_subtitle_fonts());
+	++_contents_scanned;
 
-	if (_long_subtitle && !_very_long_subtitle) {
-		hint (_("At least one of your subtitle lines has more than 52 characters.  It is recommended to make each line 52 characters at most in length."));
-	} else if (_very_long_subtitle) {
-		hint (_("At least one of your subtitle lines has more than 79 characters.  You should make each line 79 characters at most in length."));
+	auto playlist = make_shared<Playlist>();
+	playlist->add (film, content);
+
+	auto scanned = make_shared<ScannedContent>();
+
+	auto player = make_shared<Player>(film, playlist);
+	player->set_ignore_video ();
+	player->set_ignore_audio ();
+	player->Text.connect ([scanned](PlayerText text, TextType type, optional<DCPTextTrack> track, DCPTimePeriod period) {
+		scanned->texts.push_back (ScannedText{text, type, track, period});
+	});
+
+	if (!pass(player)) {
+		return {};
+	}
+
+	scanned->fonts = player->get_subtitle_fonts ();
+
+	/* Bitmap texts can take a lot of memory, so limit the size of the cache by the size of their images */
+	size_t bytes = 0;
+	for (auto const& i: scanned->texts) {
+		for (auto const& j: i.text.bitmap) {
+			bytes += j.image->memory_used();
+		}
+	}
+
+	if (bytes > max_scan_cache_bytes) {
+		return scanned;
+	}
+
+	boost::mutex::scoped_lock lm (_cache_mutex);
+
+	auto existing = _scan_cache.find (key);
+	if (existing != _scan_cache.end()) {
+		_scan_cache_bytes -= existing->second.bytes;
+		_scan_cache.erase (existing);
+	}
+
+	while (!_scan_cache.empty() && (_scan_cache_bytes + bytes) > max_scan_cache_bytes) {
+		auto oldest = std::min_element(_scan_cache.begin(), _scan_cache.end(), [](pair<const string, CachedScan> const& a, pair<const string, CachedScan> const& b) {
+			return a.second.last_use < b.second.last_use;
+		});
+		_scan_cache_bytes -= oldest->second.bytes;
+		_scan_cache.erase (oldest);
+	}
+
+	_scan_cache[key] = { scanned, bytes, ++_scan_cache_uses };
+	_scan_cache_bytes += bytes;
+	return scanned;
+}
+
+
+/** Write some texts to a partial DCP containing only the subtitles and closed captions that
+ *  our final DCP will have, so that we can see how big the files will be.
+ */
+Hints::TextAssetSizes
+Hints::text_asset_sizes (shared_ptr<const Film> film, vector<ScannedText const*> const& texts, vector<shared_ptr<const ScannedContent>> const& scanned)
+{
+	auto writer = make_shared<Writer>(film, weak_ptr<Job>(), true);
+
+	for (auto i: texts) {
+		writer->write (i->text, i->type, i->track, i->period);
 	}
 
-	bool ccap_xml_too_big = false;
-	bool ccap_mxf_too_big = false;
-	bool subs_mxf_too_big = false;
+	for (auto i: scanned) {
+		writer->write (i->fonts);
+	}
 
 	auto dcp_dir = film->dir("hints") / dcpomatic::get_process_id();
 	boost::filesystem::remove_all (dcp_dir);
 
-	_writer->finish (film->dir("hints") / dcpomatic::get_process_id());
+	writer->finish (dcp_dir);
+
+	TextAssetSizes sizes;
 
 	dcp::DCP dcp (dcp_dir);
 	dcp.read ();
 	DCPOMATIC_ASSERT (dcp.cpls().size() == 1);
 	for (auto reel: dcp.cpls()[0]->reels()) {
 		for (auto ccap: reel->closed_captions()) {
-			if (ccap->asset() && ccap->asset()->xml_as_string().length() > static_cast<size_t>(MAX_CLOSED_CAPTION_XML_SIZE - SIZE_SLACK) && !ccap_xml_too_big) {
-				hint (_(
-						"At least one of your closed caption files' XML part is larger than " MAX_CLOSED_CAPTION_XML_SIZE_TEXT
-						".  You should divide the DCP into shorter reels."
-				       ));
-				ccap_xml_too_big = true;
+			if (ccap->asset() && ccap->asset()->xml_as_string().length() > static_cast<size_t>(MAX_CLOSED_CAPTION_XML_SIZE - SIZE_SLACK)) {
+				sizes.ccap_xml_too_big = true;
+			}
+			if (subtitle_mxf_too_big(ccap->asset())) {
+				sizes.ccap_mxf_too_big = true;
+			}
+		}
+		if (reel->main_subtitle() && subtitle_mxf_too_big(reel->main_subtitle()->asset())) {
+			sizes.subs_mxf_too_big = true;
+		}
+	}
+	boost::filesystem::remove_all (dcp_dir);
+
+	return sizes;
+}
+
+
+void
+Hints::thread ()
+try
+{
+	start_of_thread ("Hints");
+
+	auto film = _film.lock ();
+	if (!film) {
+		return;
+	}
+
+	auto const check_loudness_done = check_metadata ();
+
+	if (!check_loudness_done && !_disable_audio_analysis) {
+		emit (bind(boost::ref(Progress), _("Examining audio")));
+
+		auto player = make_shared<Player>(film, Image::Alignment::COMPACT);
+		player->set_ignore_video ();
+		player->set_ignore_text ();
+		player->Audio.connect (bind(&Hints::audio, this, _1, _2));
+		if (!pass(player)) {
+			return;
+		}
+
+		_analyser.finish ();
+		_analyser.get().write(film->audio_analysis_path(film->playlist()));
+		check_loudness ();
+	}
+
+	emit (bind(boost::ref(Progress), _("Examining subtitles and closed captions")));
+
+	/* Scan each piece of content with texts that will go into the DCP on its own, so that
+	 * what we find can be kept and used again when the film changes without that content changing.
+	 */
+	vector<shared_ptr<const ScannedContent>> scanned;
+	string sizes_key;
+	for (auto content: film->content()) {
+		auto const used = std::any_of(content->text.begin(), content->text.end(), [](shared_ptr<const TextContent> text) {
+			return text->use() && !text->burn();
+		});
+		if (!used) {
+			continue;
+		}
+		auto texts = scan (film, content);
+		if (!texts) {
+			return;
+		}
+		scanned.push_back (texts);
+		sizes_key += scan_key(film, content) + "_";
+	}
+
+	vector<ScannedText const*> texts;
+	for (auto i: scanned) {
+		for (auto const& j: i->texts) {
+			texts.push_back (&j);
+		}
+	}
+
+	/* Put the texts from different content into the order that a player for the whole film would give them to us */
+	std::stable_sort (texts.begin(), texts.end(), [](ScannedText const* a, ScannedText const* b) {
+		return a->period.from < b->period.from;
+	});
+
+	for (auto i: texts) {
+		text (*i);
+	}
+
+	if (_long_subtitle && !_very_long_subtitle) {
+		hint (_("At least one of your subtitle lines has more than 52 characters.  It is recommended to make each line 52 characters at most in length."));
+	} else if (_very_long_subtitle) {
+		hint (_("At least one of your subtitle lines has more than 79 characters.  You should make each line 79 characters at most in length."));
+	}
+
+	if (!scanned.empty()) {
+		sizes_key += String::compose("%1_%2", film->interop() ? 1 : 0, film->encrypted() ? 1 : 0);
+		for (auto const& i: film->reels()) {
+			sizes_key += String::compose("_%1_%2", i.from.get(), i.to.get());
+		}
+
+		optional<TextAssetSizes> sizes;
+		{
+			boost::mutex::scoped_lock lm (_cache_mutex);
+			auto i = _text_asset_sizes_cache.find (sizes_key);
+			if (i != _text_asset_sizes_cache.end()) {
+				sizes = i->second;
 			}
-			if (subtitle_mxf_too_big(ccap->asset()) && !ccap_mxf_too_big) {
-				hint (_(
-						"At least one of your closed caption files is larger than " MAX_TEXT_MXF_SIZE_TEXT
-						" in total.  You should divide the DCP into shorter reels."
-				       ));
-				ccap_mxf_too_big = true;
+		}
+
+		if (!sizes) {
+			sizes = text_asset_sizes (film, texts, scanned);
+			boost::mutex::scoped_lock lm (_cache_mutex);
+			if (_text_asset_sizes_cache.size() > 64) {
+				_text_asset_sizes_cache.clear ();
 			}
+			_text_asset_sizes_cache[sizes_key] = *sizes;
+		}
+
+		if (sizes->ccap_xml_too_big) {
+			hint (_(
+					"At least one of your closed caption files' XML part is larger than " MAX_CLOSED_CAPTION_XML_SIZE_TEXT
+					".  You should divide the DCP into shorter reels."
+			       ));
+		}
+		if (sizes->ccap_mxf_too_big) {
+			hint (_(
+					"At least one of your closed caption files is larger than " MAX_TEXT_MXF_SIZE_TEXT
+					" in total.  You should divide the DCP into shorter reels."
+			       ));
 		}
-		if (reel->main_subtitle() && subtitle_mxf_too_big(reel->main_subtitle()->asset()) && !subs_mxf_too_big) {
+		if (sizes->subs_mxf_too_big) {
 			hint (_(
 					"At least one of your subtitle files is larger than " MAX_TEXT_MXF_SIZE_TEXT " in total.  "
 					"You should divide the DCP into shorter reels."
 			       ));
-			subs_mxf_too_big = true;
 		}
 	}
-	boost::filesystem::remove_all (dcp_dir);
 
 	emit (bind(boost::ref(Finished)));
 }
@@ -510,16 +716,14 @@ Hints::audio (shared_ptr<AudioBuffers> audio, DCPTime time)
 
 
 void
-Hints::text (PlayerText text, TextType type, optional<DCPTextTrack> track, DCPTimePeriod period)
+Hints::text (ScannedText const& text)
 {
-	_writer->write (text, type, track, period);
-
-	switch (type) {
+	switch (text.type) {
 	case TextType::CLOSED_CAPTION:
-		closed_caption (text, period);
+		closed_caption (text.text, text.period);
 		break;
 	case TextType::OPEN_SUBTITLE:
-		open_subtitle (text, period);
+		open_subtitle (text.text, text.period);
 		break;
 	default:
 		break;
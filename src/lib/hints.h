@@ -25,15 +25,19 @@
 #include "types.h"
 #include "dcp_text_track.h"
 #include "dcpomatic_time.h"
+#include "font_data.h"
 #include "weak_film.h"
 #include <boost/signals2.hpp>
 #include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
 #include <vector>
 #include <string>
 
 
+class Content;
 class Film;
-class Writer;
+class Player;
 
 
 class Hints : public Signaller, public ExceptionStore, public WeakConstFilm
@@ -54,17 +58,64 @@ public:
 	void disable_audio_analysis () {
 		_disable_audio_analysis = true;
 	}
+	/** @return number of pieces of content that had to be scanned for texts on this run,
+	 *  rather than being taken from the cache.
+	 */
+	int contents_scanned () const {
+		return _contents_scanned;
+	}
 
 private:
 	friend struct hint_subtitle_too_early;
 
+	/** A text which the player emitted when scanning some content */
+	struct ScannedText
+	{
+		PlayerText text;
+		TextType type;
+		boost::optional<DCPTextTrack> track;
+		dcpomatic::DCPTimePeriod period;
+	};
+
+	/** Everything that we need from a scan of one piece of content.  This depends only on the
+	 *  content and the film's video frame rate, resolution and container, so we can keep it
+	 *  and use it again when anything else changes.
+	 */
+	struct ScannedContent
+	{
+		std::vector<ScannedText> texts;
+		std::vector<dcpomatic::FontData> fonts;
+	};
+
+	/** A scan in _scan_cache */
+	struct CachedScan
+	{
+		std::shared_ptr<const ScannedContent> scan;
+		/** approximate memory used by the scan's bitmap images, in bytes */
+		size_t bytes;
+		/** value of _scan_cache_uses when this was last used */
+		int64_t last_use;
+	};
+
+	/** Results of writing the film's texts to a DCP to see how big the assets would be */
+	struct TextAssetSizes
+	{
+		bool ccap_xml_too_big = false;
+		bool ccap_mxf_too_big = false;
+		bool subs_mxf_too_big = false;
+	};
+
 	void thread ();
 	void hint (std::string h);
+	bool pass (std::shared_ptr<Player> player);
 	void audio (std::shared_ptr<AudioBuffers> audio, dcpomatic::DCPTime time);
-	void text (PlayerText text, TextType type, boost::optional<DCPTextTrack> track, dcpomatic::DCPTimePeriod period);
+	std::shared_ptr<const ScannedContent> scan (std::shared_ptr<const Film> film, std::shared_ptr<Content> content);
+	void text (ScannedText const& text);
 	void closed_caption (PlayerText text, dcpomatic::DCPTimePeriod period);
 	void open_subtitle (PlayerText text, dcpomatic::DCPTimePeriod period);
+	TextAssetSizes text_asset_sizes (std::shared_ptr<const Film> film, std::vector<ScannedText const*> const& texts, std::vector<std::shared_ptr<const ScannedContent>> const& scanned);
 
+	bool check_metadata ();
 	void check_interop ();
 	void check_big_font_files ();
 	void check_few_audio_channels ();
@@ -84,11 +135,6 @@ private:
 	void check_audio_language ();
 
 	boost::thread _thread;
-	/** This is used to make a partial DCP containing only the subtitles and closed captions that
-	 *  our final DCP will have.  This means we can see how big the files will be and warn if they
-	 *  will be too big.
-	 */
-	std::shared_ptr<Writer> _writer;
 
 	AudioAnalyser _analyser;
 
@@ -108,4 +154,18 @@ private:
 	boost::atomic<bool> _stop;
 
 	bool _disable_audio_analysis = false;
+	int _contents_scanned = 0;
+
+	/** mutex for _scan_cache and _text_asset_sizes_cache, which are shared by all Hints
+	 *  so that a new Hints for a film can use what an earlier one found out.
+	 */
+	static boost::mutex _cache_mutex;
+	/** scans of content, keyed by scan_key() */
+	static std::map<std::string, CachedScan> _scan_cache;
+	/** total of the bytes of everything in _scan_cache */
+	static size_t _scan_cache_bytes;
+	/** count of uses of _scan_cache, used to find the least recently used scan */
+	static int64_t _scan_cache_uses;
+	/** sizes of text assets, keyed by the scan keys of all the film's texts and the film's reels */
+	static std::map<std::string, TextAssetSizes> _text_asset_sizes_cache;
 };
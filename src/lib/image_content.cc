@@ -28,6 +28,7 @@
 #include "image_filename_sorter.h"
 #include "job.h"
 #include "video_content.h"
+#include <dcp/raw_convert.h>
 #include <libcxml/cxml.h>
 #include <libxml++/libxml++.h>
 #include <iostream>
@@ -41,6 +42,7 @@ using std::make_shared;
 using std::shared_ptr;
 using std::string;
 using std::vector;
+using dcp::raw_convert;
 using namespace dcpomatic;
 
 
@@ -62,6 +64,8 @@ ImageContent::ImageContent (cxml::ConstNodePtr node, int version)
 	: Content (node)
 {
 	video = VideoContent::from_xml (this, node, version);
+	_j2k_passthrough = node->optional_bool_child("J2KPassthrough");
+	_biggest_j2k_frame = node->optional_number_child<boost::uintmax_t>("BiggestJ2KFrame");
 }
 
 
@@ -105,6 +109,14 @@ ImageContent::as_xml (xmlpp::Node* node, bool with_paths) const
 	if (video) {
 		video->as_xml (node);
 	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	if (_j2k_passthrough) {
+		node->add_child("J2KPassthrough")->add_child_text(*_j2k_passthrough ? "1" : "0");
+	}
+	if (_biggest_j2k_frame) {
+		node->add_child("BiggestJ2KFrame")->add_child_text(raw_convert<string>(*_biggest_j2k_frame));
+	}
 }
 
 
@@ -137,6 +149,13 @@ ImageContent::examine (shared_ptr<const Film> film, shared_ptr<Job> job)
 
 	auto examiner = make_shared<ImageExaminer>(film, shared_from_this(), job);
 	video->take_from_examiner (examiner);
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_j2k_passthrough = examiner->j2k_passthrough ();
+		_biggest_j2k_frame = examiner->biggest_j2k_frame ();
+	}
+
 	set_default_colour_conversion ();
 }
 
@@ -172,6 +191,27 @@ ImageContent::still () const
 }
 
 
+bool
+ImageContent::j2k_passthrough (int video_frame_rate) const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	if (!_j2k_passthrough) {
+		/* We don't know (perhaps this content was examined by an older version) so carry on
+		   as we always used to.
+		*/
+		return true;
+	}
+
+	if (!*_j2k_passthrough || !_biggest_j2k_frame) {
+		return false;
+	}
+
+	/* The DCI limit of 250Mbit/s */
+	return *_biggest_j2k_frame * 8 * video_frame_rate <= 250000000;
+}
+
+
 void
 ImageContent::set_default_colour_conversion ()
 {
@@ -50,10 +50,21 @@ public:
 
 	bool still () const;
 
+	/** @param video_frame_rate Frame rate of the DCP that we are going into.
+	 *  @return true if our JPEG2000 files can be written straight into a DCP, without decoding them.
+	 */
+	bool j2k_passthrough (int video_frame_rate) const;
+
 private:
 	void add_properties (std::shared_ptr<const Film> film, std::list<UserProperty>& p) const;
 
 	boost::optional<boost::filesystem::path> _path_to_scan;
+	/** true if our files are JPEG2000 codestreams which meet the DCI profiles, false if they are not,
+	 *  or none if we have not been able to find out (in which case we assume that they do).
+	 */
+	boost::optional<bool> _j2k_passthrough;
+	/** size in bytes of our biggest JPEG2000 file, if _j2k_passthrough is true */
+	boost::optional<boost::uintmax_t> _biggest_j2k_frame;
 };
 
 #endif
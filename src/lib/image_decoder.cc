@@ -19,6 +19,7 @@
 */
 
 
+#include "config.h"
 #include "exceptions.h"
 #include "ffmpeg_image_proxy.h"
 #include "film.h"
@@ -26,6 +27,7 @@
 #include "image.h"
 #include "image_content.h"
 #include "image_decoder.h"
+#include "image_prefetcher.h"
 #include "j2k_image_proxy.h"
 #include "video_content.h"
 #include "video_decoder.h"
@@ -45,8 +47,49 @@ using namespace dcpomatic;
 ImageDecoder::ImageDecoder (shared_ptr<const Film> film, shared_ptr<const ImageContent> c)
 	: Decoder (film)
 	, _image_content (c)
+	, _j2k_passthrough (c->j2k_passthrough(film->video_frame_rate()))
 {
 	video = make_shared<VideoDecoder>(this, c);
+
+	auto const prefetch = Config::instance()->image_prefetch_size();
+	if (!c->still() && prefetch > 0) {
+		/* Opening a file is often slow (particularly on network storage) but it
+		   parallelises well, so use lots of threads.
+		*/
+		_prefetcher.reset (
+			new ImagePrefetcher([this](Frame frame) { return load(frame); }, c->video->length(), int64_t(prefetch) * 1024 * 1024, 8)
+			);
+	}
+}
+
+
+/* Out-of-line so that ImagePrefetcher is complete, and the prefetch threads stop before our members go */
+ImageDecoder::~ImageDecoder ()
+{
+	_prefetcher.reset ();
+}
+
+
+shared_ptr<ImageProxy>
+ImageDecoder::load (Frame frame) const
+{
+	auto path = _image_content->path (_image_content->still() ? 0 : frame);
+	if (valid_j2k_file (path)) {
+		AVPixelFormat pf;
+		if (_image_content->video->colour_conversion()) {
+			/* We have a specified colour conversion: assume the image is RGB */
+			pf = AV_PIX_FMT_RGB48LE;
+		} else {
+			/* No specified colour conversion: assume the image is XYZ */
+			pf = AV_PIX_FMT_XYZ12LE;
+		}
+		/* We can't extract image size from a JPEG2000 codestream without decoding it,
+		   so pass in the image content's size here.
+		*/
+		return make_shared<J2KImageProxy>(path, _image_content->video->size(), pf, _j2k_passthrough);
+	}
+
+	return make_shared<FFmpegImageProxy>(path);
 }
 
 
@@ -59,23 +102,7 @@ ImageDecoder::pass ()
 
 	if (!_image_content->still() || !_image) {
 		/* Either we need an image or we are using moving images, so load one */
-		auto path = _image_content->path (_image_content->still() ? 0 : _frame_video_position);
-		if (valid_j2k_file (path)) {
-			AVPixelFormat pf;
-			if (_image_content->video->colour_conversion()) {
-				/* We have a specified colour conversion: assume the image is RGB */
-				pf = AV_PIX_FMT_RGB48LE;
-			} else {
-				/* No specified colour conversion: assume the image is XYZ */
-				pf = AV_PIX_FMT_XYZ12LE;
-			}
-			/* We can't extract image size from a JPEG2000 codestream without decoding it,
-			   so pass in the image content's size here.
-			*/
-			_image = make_shared<J2KImageProxy>(path, _image_content->video->size(), pf);
-		} else {
-			_image = make_shared<FFmpegImageProxy>(path);
-		}
+		_image = _prefetcher ? _prefetcher->get(_frame_video_position) : load(_frame_video_position);
 	}
 
 	video->emit (film(), _image, _frame_video_position);
@@ -23,6 +23,7 @@
 
 
 class ImageContent;
+class ImagePrefetcher;
 class Log;
 class ImageProxy;
 
@@ -31,6 +32,7 @@ class ImageDecoder : public Decoder
 {
 public:
 	ImageDecoder (std::shared_ptr<const Film> film, std::shared_ptr<const ImageContent> c);
+	~ImageDecoder ();
 
 	std::shared_ptr<const ImageContent> content () {
 		return _image_content;
@@ -40,8 +42,13 @@ public:
 	void seek (dcpomatic::ContentTime, bool) override;
 
 private:
+	std::shared_ptr<ImageProxy> load (Frame frame) const;
 
 	std::shared_ptr<const ImageContent> _image_content;
 	std::shared_ptr<ImageProxy> _image;
+	/** used to load moving images, or null to load them as they are needed */
+	std::unique_ptr<ImagePrefetcher> _prefetcher;
+	/** true if JPEG2000 files can go into the DCP as they are */
+	bool _j2k_passthrough;
 	Frame _frame_video_position = 0;
 };
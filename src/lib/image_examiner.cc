@@ -28,6 +28,7 @@
 #include "image.h"
 #include "image_content.h"
 #include "image_examiner.h"
+#include "j2k_codestream.h"
 #include "job.h"
 #include <dcp/openjpeg_image.h>
 #include <dcp/exceptions.h>
@@ -39,17 +40,21 @@
 
 using std::cout;
 using std::list;
+using std::max;
 using std::shared_ptr;
 using std::sort;
+using std::string;
 using boost::optional;
 
 
-ImageExaminer::ImageExaminer (shared_ptr<const Film> film, shared_ptr<const ImageContent> content, shared_ptr<Job>)
+ImageExaminer::ImageExaminer (shared_ptr<const Film> film, shared_ptr<const ImageContent> content, shared_ptr<Job> job)
 	: _film (film)
 	, _image_content (content)
 {
 	auto path = content->path(0);
-	if (valid_j2k_file (path)) {
+	if (valid_j2k_file(path) && examine_j2k_codestreams(job)) {
+		/* We got everything we need from the codestream headers */
+	} else if (valid_j2k_file(path)) {
 		auto size = boost::filesystem::file_size (path);
 		auto f = fopen_boost (path, "rb");
 		if (!f) {
@@ -76,6 +81,50 @@ ImageExaminer::ImageExaminer (shared_ptr<const Film> film, shared_ptr<const Imag
 }
 
 
+/** Look at the main header of our first JPEG2000 file, and the sizes of all the others, to see
+ *  if they could be put into a DCP without being decoded and encoded again.
+ *  @return false if the first file is not a raw codestream that we understand.
+ */
+bool
+ImageExaminer::examine_j2k_codestreams (shared_ptr<Job> job)
+{
+	optional<string> problem;
+	try {
+		J2KCodestream codestream (_image_content->path(0));
+		_video_size = codestream.size ();
+		problem = codestream.dci_problem ();
+	} catch (DecodeError &) {
+		/* Perhaps a JP2 file, or something else that we must decode */
+		_j2k_passthrough = false;
+		return false;
+	}
+
+	_j2k_passthrough = !problem;
+	if (problem) {
+		return true;
+	}
+
+	/* We assume that the other files have the same parameters as the first, but the frame sizes
+	 * can vary a lot so we need to know the biggest to check against the DCI bit rate limit.
+	 */
+	auto const paths = _image_content->number_of_paths ();
+	if (job && paths > 1) {
+		job->sub (_("Checking JPEG2000 files"));
+	}
+
+	boost::uintmax_t biggest = 0;
+	for (size_t i = 0; i < paths; ++i) {
+		biggest = max (biggest, boost::filesystem::file_size(_image_content->path(i)));
+		if (job && (i % 1000) == 0) {
+			job->set_progress (float(i) / paths);
+		}
+	}
+
+	_biggest_j2k_frame = biggest;
+	return true;
+}
+
+
 dcp::Size
 ImageExaminer::video_size () const
 {
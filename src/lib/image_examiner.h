@@ -44,9 +44,25 @@ public:
 		return {};
 	}
 
+	/** @return true if our files are JPEG2000 codestreams which meet the DCI profiles, false if they
+	 *  are not, or none if we could not tell.
+	 */
+	boost::optional<bool> j2k_passthrough () const {
+		return _j2k_passthrough;
+	}
+
+	/** @return size in bytes of our biggest JPEG2000 file, if we have been able to use j2k_passthrough */
+	boost::optional<boost::uintmax_t> biggest_j2k_frame () const {
+		return _biggest_j2k_frame;
+	}
+
 private:
+	bool examine_j2k_codestreams (std::shared_ptr<Job> job);
+
 	std::weak_ptr<const Film> _film;
 	std::shared_ptr<const ImageContent> _image_content;
 	boost::optional<dcp::Size> _video_size;
 	Frame _video_length;
+	boost::optional<bool> _j2k_passthrough;
+	boost::optional<boost::uintmax_t> _biggest_j2k_frame;
 };
@@ -0,0 +1,194 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/image_prefetcher.cc
+ *  @brief ImagePrefetcher class.
+ */
+
+
+#include "compose.hpp"
+#include "dcpomatic_assert.h"
+#include "dcpomatic_log.h"
+#include "image_prefetcher.h"
+#include "image_proxy.h"
+#include "util.h"
+#include <chrono>
+
+#include "i18n.h"
+
+
+using std::shared_ptr;
+
+
+ImagePrefetcher::ImagePrefetcher (Loader loader, Frame length, int64_t max_bytes, int threads)
+	: _loader (loader)
+	, _length (length)
+	, _max_bytes (max_bytes)
+{
+	for (int i = 0; i < threads; ++i) {
+		_threads.create_thread (boost::bind(&ImagePrefetcher::thread, this));
+	}
+}
+
+
+ImagePrefetcher::~ImagePrefetcher ()
+{
+	boost::this_thread::disable_interruption dis;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+		_condition.notify_all ();
+	}
+
+	try {
+		_threads.join_all ();
+	} catch (...) {}
+
+	if (_frames_loaded > 0) {
+		LOG_GENERAL ("Prefetched %1 images; waited %2 times for %3s in total; restarted %4 times", _frames_loaded, _waits, _wait_seconds, _restarts);
+	}
+}
+
+
+/** @return true if a thread can start loading _next_to_load.  Must be called with _mutex held */
+bool
+ImagePrefetcher::can_start () const
+{
+	/* Limit on the number of frames to load ahead, in case they are tiny (or failing to load) */
+	int const max_frames_ahead = 256;
+
+	if (_next_to_load >= _length || (_next_to_load - _next_wanted) >= max_frames_ahead) {
+		return false;
+	}
+
+	if (_loading == 0 && _loaded.empty()) {
+		/* Always load at least one frame, however big it is */
+		return true;
+	}
+
+	return (_bytes + (_loading + 1) * _frame_bytes) <= _max_bytes;
+}
+
+
+void
+ImagePrefetcher::thread ()
+{
+	start_of_thread ("ImagePrefetcher");
+
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		while (!_stop && !can_start()) {
+			_condition.wait (lm);
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		auto const frame = _next_to_load++;
+		++_loading;
+		lm.unlock ();
+
+		shared_ptr<ImageProxy> proxy;
+		try {
+			proxy = _loader (frame);
+		} catch (...) {
+			/* get() will try again and report the error */
+		}
+
+		lm.lock ();
+		--_loading;
+		++_frames_loaded;
+		if (proxy) {
+			_frame_bytes = proxy->memory_used ();
+		}
+		/* Only keep this frame if it's still wanted; get() may have moved on, or started
+		   again from somewhere else.
+		*/
+		if (frame >= _next_wanted && frame < _next_to_load && _loaded.find(frame) == _loaded.end()) {
+			_loaded[frame] = proxy;
+			if (proxy) {
+				_bytes += proxy->memory_used();
+			}
+		}
+		_condition.notify_all ();
+	}
+}
+
+
+/** Get a frame, waiting for it to be loaded if necessary, and start loading the
+ *  frames after it.  Errors when loading are thrown from here.
+ */
+shared_ptr<ImageProxy>
+ImagePrefetcher::get (Frame frame)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	if (frame < _next_wanted || frame >= _next_to_load) {
+		/* We aren't loading this frame, so start again from it */
+		_loaded.clear ();
+		_bytes = 0;
+		_next_to_load = frame;
+		if (frame != _next_wanted) {
+			++_restarts;
+		}
+	} else {
+		/* Discard anything that has been skipped */
+		while (!_loaded.empty() && _loaded.begin()->first < frame) {
+			if (_loaded.begin()->second) {
+				_bytes -= _loaded.begin()->second->memory_used();
+			}
+			_loaded.erase (_loaded.begin());
+		}
+	}
+
+	_next_wanted = frame;
+	_condition.notify_all ();
+
+	auto i = _loaded.find (frame);
+	if (i == _loaded.end()) {
+		auto const start = std::chrono::steady_clock::now();
+		++_waits;
+		while (!_stop && i == _loaded.end()) {
+			_condition.wait (lm);
+			i = _loaded.find (frame);
+		}
+		_wait_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	DCPOMATIC_ASSERT (i != _loaded.end());
+	auto proxy = i->second;
+	if (proxy) {
+		_bytes -= proxy->memory_used();
+	}
+	_loaded.erase (i);
+	_next_wanted = frame + 1;
+	_condition.notify_all ();
+	lm.unlock ();
+
+	if (!proxy) {
+		/* Loading failed; do it again here so that any exception reaches the caller */
+		proxy = _loader (frame);
+	}
+
+	return proxy;
+}
@@ -0,0 +1,104 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_IMAGE_PREFETCHER_H
+#define DCPOMATIC_IMAGE_PREFETCHER_H
+
+
+/** @file  src/lib/image_prefetcher.h
+ *  @brief ImagePrefetcher class.
+ */
+
+
+#include "types.h"
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdint.h>
+
+
+class ImageProxy;
+
+
+/** @class ImagePrefetcher
+ *  @brief Loader of the frames of an image sequence which loads the frames after the
+ *  last one asked for using several threads at once.
+ *
+ *  Each file of a sequence is read when its ImageProxy is made, and on network storage
+ *  the time taken to open each file can be much more than the time taken to read it.
+ *  Loading several files at the same time hides this latency.
+ */
+class ImagePrefetcher
+{
+public:
+	typedef std::function<std::shared_ptr<ImageProxy> (Frame)> Loader;
+
+	/** @param loader Function to load a frame; this will be called from the prefetch threads.
+	 *  @param length Number of frames in the sequence.
+	 *  @param max_bytes Maximum number of bytes of loaded data to hold (roughly).
+	 *  @param threads Number of threads to load with.
+	 */
+	ImagePrefetcher (Loader loader, Frame length, int64_t max_bytes, int threads);
+	~ImagePrefetcher ();
+
+	ImagePrefetcher (ImagePrefetcher const&) = delete;
+	ImagePrefetcher& operator= (ImagePrefetcher const&) = delete;
+
+	std::shared_ptr<ImageProxy> get (Frame frame);
+
+private:
+	void thread ();
+	bool can_start () const;
+
+	Loader _loader;
+	Frame const _length;
+	int64_t const _max_bytes;
+
+	/** mutex for everything below here */
+	boost::mutex _mutex;
+	boost::condition _condition;
+	/** loaded frames which have not yet been asked for; a null proxy means that loading failed */
+	std::map<Frame, std::shared_ptr<ImageProxy>> _loaded;
+	/** total memory used by _loaded */
+	int64_t _bytes = 0;
+	/** memory used by the last frame that was loaded, as a guess for the frames being loaded now */
+	int64_t _frame_bytes = 0;
+	/** next frame that get() will be asked for, if playback is continuous */
+	Frame _next_wanted = 0;
+	/** next frame that a thread will load */
+	Frame _next_to_load = 0;
+	/** number of frames being loaded now */
+	int _loading = 0;
+	bool _stop = false;
+
+	/* Statistics, to see how well we are doing */
+	int64_t _frames_loaded = 0;
+	double _wait_seconds = 0;
+	int _waits = 0;
+	int _restarts = 0;
+
+	boost::thread_group _threads;
+};
+
+
+#endif
@@ -0,0 +1,242 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/interleaved_audio_ring_buffer.cc
+ *  @brief InterleavedAudioRingBuffer class.
+ */
+
+
+#include "audio_buffers.h"
+#include "compose.hpp"
+#include "dcpomatic_assert.h"
+#include "exceptions.h"
+#include "interleaved_audio_ring_buffer.h"
+#include <algorithm>
+#include <cstring>
+
+#include "i18n.h"
+
+
+using std::max;
+using std::min;
+using std::shared_ptr;
+using boost::optional;
+using namespace dcpomatic;
+
+
+/** Number of times get() will try to read a consistent view of the producer's state
+ *  before giving up and returning silence.  The producer only holds the state
+ *  inconsistent for a few stores, so this should only run out if the producer
+ *  thread is pre-empted at just the wrong moment.
+ */
+static int const snapshot_attempts = 64;
+
+
+InterleavedAudioRingBuffer::InterleavedAudioRingBuffer (int channels, Frame capacity)
+	: _channels (channels)
+	, _write (0)
+	, _read (0)
+	, _sequence (0)
+	, _clear_to (0)
+	, _segment_start (0)
+	, _segment_time (0)
+	, _segment_frame_rate (0)
+	, _underruns (0)
+	, _underrun_frames (0)
+{
+	DCPOMATIC_ASSERT (channels >= 0);
+	DCPOMATIC_ASSERT (capacity > 0);
+
+	Frame rounded = 1;
+	while (rounded < capacity) {
+		rounded <<= 1;
+	}
+
+	_mask = rounded - 1;
+	_data.resize (rounded * channels);
+}
+
+
+void
+InterleavedAudioRingBuffer::begin_update ()
+{
+	_sequence.fetch_add (1, std::memory_order_relaxed);
+	std::atomic_thread_fence (std::memory_order_release);
+}
+
+
+void
+InterleavedAudioRingBuffer::end_update ()
+{
+	_sequence.fetch_add (1, std::memory_order_release);
+}
+
+
+/** @param frame_rate Frame rate in use; this is used to work out the time of data returned by get() */
+void
+InterleavedAudioRingBuffer::put (shared_ptr<const AudioBuffers> data, DCPTime time, int frame_rate)
+{
+	DCPOMATIC_ASSERT (data->channels() == _channels);
+
+	auto const write = _write.load (std::memory_order_relaxed);
+	auto const frames = data->frames ();
+
+	/* Anything before _clear_to is free for us to overwrite, even if get() has not read past it yet */
+	auto const used = write - max(_read.load(std::memory_order_acquire), _clear_to.load(std::memory_order_relaxed));
+	if (used + frames > capacity()) {
+		throw ProgrammingError (__FILE__, __LINE__, String::compose("Audio ring buffer overflowed (%1 + %2 frames with capacity %3)", used, frames, capacity()));
+	}
+
+	auto const segment_frame_rate = _segment_frame_rate.load (std::memory_order_relaxed);
+	if (segment_frame_rate == 0) {
+		begin_update ();
+		_segment_start.store (write, std::memory_order_relaxed);
+		_segment_time.store (time.get(), std::memory_order_relaxed);
+		_segment_frame_rate.store (frame_rate, std::memory_order_relaxed);
+		end_update ();
+	} else {
+		auto const end = DCPTime(_segment_time.load(std::memory_order_relaxed)) + DCPTime::from_frames(write - _segment_start.load(std::memory_order_relaxed), segment_frame_rate);
+		auto const error = end.get() - time.get();
+		DCPOMATIC_ASSERT (error > -2 && error < 2);
+	}
+
+	auto const in = data->data ();
+	for (int i = 0; i < frames; ++i) {
+		auto out = _data.data() + ((write + i) & _mask) * _channels;
+		for (int j = 0; j < _channels; ++j) {
+			*out++ = in[j][i];
+		}
+	}
+
+	_write.store (write + frames, std::memory_order_release);
+}
+
+
+/** Copy some audio into `out', filling anything that is not available with silence.
+ *  @param out Buffer to write `frames' frames of interleaved audio to.
+ *  @param count_underrun true to count it in underruns() and underrun_frames() if we can't give all the frames asked for.
+ *  @return time of the returned data; if it's not set this indicates an underrun
+ */
+optional<DCPTime>
+InterleavedAudioRingBuffer::get (float* out, Frame frames, bool count_underrun)
+{
+	auto read = _read.load (std::memory_order_relaxed);
+
+	uint64_t sequence = 0;
+	Frame write = 0;
+	Frame clear_to = 0;
+	Frame segment_start = 0;
+	DCPTime::Type segment_time = 0;
+	int segment_frame_rate = 0;
+	bool consistent = false;
+
+	for (int i = 0; i < snapshot_attempts && !consistent; ++i) {
+		sequence = _sequence.load (std::memory_order_acquire);
+		if (sequence & 1) {
+			continue;
+		}
+		clear_to = _clear_to.load (std::memory_order_relaxed);
+		segment_start = _segment_start.load (std::memory_order_relaxed);
+		segment_time = _segment_time.load (std::memory_order_relaxed);
+		segment_frame_rate = _segment_frame_rate.load (std::memory_order_relaxed);
+		write = _write.load (std::memory_order_acquire);
+		std::atomic_thread_fence (std::memory_order_acquire);
+		consistent = _sequence.load(std::memory_order_relaxed) == sequence;
+	}
+
+	Frame to_do = 0;
+	if (consistent && segment_frame_rate) {
+		read = max (read, clear_to);
+		to_do = min (frames, write - read);
+	}
+
+	/* Copy in at most two pieces, as the data we want may wrap around the end of _data */
+	Frame done = 0;
+	while (done < to_do) {
+		auto const offset = (read + done) & _mask;
+		auto const this_time = min (to_do - done, _mask + 1 - offset);
+		memcpy (out + done * _channels, _data.data() + offset * _channels, this_time * _channels * sizeof(float));
+		done += this_time;
+	}
+
+	/* If clear() was called while we were copying the producer may have overwritten what we were
+	 * reading, and in any case it has been discarded; give silence instead.
+	 */
+	std::atomic_thread_fence (std::memory_order_acquire);
+	if (to_do && _sequence.load(std::memory_order_relaxed) != sequence) {
+		to_do = 0;
+	}
+
+	std::fill (out + to_do * _channels, out + frames * _channels, 0.0f);
+
+	if (count_underrun && to_do < frames) {
+		++_underruns;
+		_underrun_frames += frames - to_do;
+	}
+
+	if (to_do == 0) {
+		return {};
+	}
+
+	_read.store (read + to_do, std::memory_order_release);
+	return DCPTime(segment_time) + DCPTime::from_frames(read - segment_start, segment_frame_rate);
+}
+
+
+/** Must only be called by the producer.
+ *  @return time of the next frame that get() will return, if there is one.
+ */
+optional<DCPTime>
+InterleavedAudioRingBuffer::peek () const
+{
+	auto const segment_frame_rate = _segment_frame_rate.load (std::memory_order_relaxed);
+	if (segment_frame_rate == 0) {
+		return {};
+	}
+
+	auto const write = _write.load (std::memory_order_relaxed);
+	auto const read = max (_read.load(std::memory_order_acquire), _clear_to.load(std::memory_order_relaxed));
+	if (read == write) {
+		return {};
+	}
+
+	return DCPTime(_segment_time.load(std::memory_order_relaxed)) + DCPTime::from_frames(read - _segment_start.load(std::memory_order_relaxed), segment_frame_rate);
+}
+
+
+/** Discard everything that has been put() but not yet got() */
+void
+InterleavedAudioRingBuffer::clear ()
+{
+	begin_update ();
+	_clear_to.store (_write.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	_segment_frame_rate.store (0, std::memory_order_relaxed);
+	end_update ();
+}
+
+
+Frame
+InterleavedAudioRingBuffer::size () const
+{
+	auto const write = _write.load (std::memory_order_acquire);
+	auto const read = max (_read.load(std::memory_order_acquire), _clear_to.load(std::memory_order_acquire));
+	return max (write - read, Frame(0));
+}
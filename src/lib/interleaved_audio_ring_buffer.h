@@ -0,0 +1,119 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_INTERLEAVED_AUDIO_RING_BUFFER_H
+#define DCPOMATIC_INTERLEAVED_AUDIO_RING_BUFFER_H
+
+
+/** @file  src/lib/interleaved_audio_ring_buffer.h
+ *  @brief InterleavedAudioRingBuffer class.
+ */
+
+
+#include "dcpomatic_time.h"
+#include "types.h"
+#include <boost/optional.hpp>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+
+class AudioBuffers;
+
+
+/** @class InterleavedAudioRingBuffer
+ *  @brief Fixed-size single-producer, single-consumer ring of interleaved float audio.
+ *
+ *  This is written for a real-time consumer such as an audio device callback:
+ *  get() never takes a lock, never allocates and does a bounded amount of work.
+ *  The audio is stored in the layout that the consumer wants (already mapped
+ *  to its channels) so that get() is just a copy.
+ *
+ *  put(), clear() and peek() are the producer side and must not be called
+ *  from more than one thread at a time.  get() is the consumer side and has
+ *  the same restriction.  size() and the underrun counts may be called from anywhere.
+ */
+class InterleavedAudioRingBuffer
+{
+public:
+	/** @param channels Number of channels in the audio that will be put() and get().
+	 *  @param capacity Minimum capacity in frames; this will be rounded up to a power of 2.
+	 */
+	InterleavedAudioRingBuffer (int channels, Frame capacity);
+
+	InterleavedAudioRingBuffer (InterleavedAudioRingBuffer const&) = delete;
+	InterleavedAudioRingBuffer& operator= (InterleavedAudioRingBuffer const&) = delete;
+
+	void put (std::shared_ptr<const AudioBuffers> data, dcpomatic::DCPTime time, int frame_rate);
+	boost::optional<dcpomatic::DCPTime> get (float* out, Frame frames, bool count_underrun = true);
+	boost::optional<dcpomatic::DCPTime> peek () const;
+
+	void clear ();
+	/** @return number of frames currently available */
+	Frame size () const;
+
+	Frame capacity () const {
+		return _mask + 1;
+	}
+
+	/** @return number of calls to get() which could not be completely satisfied */
+	uint64_t underruns () const {
+		return _underruns;
+	}
+
+	/** @return total number of frames of silence that get() has had to give out */
+	uint64_t underrun_frames () const {
+		return _underrun_frames;
+	}
+
+private:
+	void begin_update ();
+	void end_update ();
+
+	int const _channels;
+	Frame _mask;
+	std::vector<float> _data;
+
+	/** index of the next frame that put() will write; only written by the producer */
+	std::atomic<Frame> _write;
+	/** index of the next frame that get() will read; only written by the consumer */
+	std::atomic<Frame> _read;
+
+	/* The remaining state is only written by the producer, and only between
+	 * begin_update() and end_update(), so that the consumer can tell when it
+	 * has read an inconsistent set (like a seqlock).
+	 */
+	std::atomic<uint64_t> _sequence;
+	/** frames before this index have been discarded by clear() */
+	std::atomic<Frame> _clear_to;
+	/** index of the first frame put() after the last clear() */
+	std::atomic<Frame> _segment_start;
+	/** time of the frame at _segment_start */
+	std::atomic<dcpomatic::DCPTime::Type> _segment_time;
+	/** frame rate of the audio since the last clear(), or 0 if there has been no put() since then */
+	std::atomic<int> _segment_frame_rate;
+
+	std::atomic<uint64_t> _underruns;
+	std::atomic<uint64_t> _underrun_frames;
+};
+
+
+#endif
@@ -0,0 +1,193 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/j2k_codestream.cc
+ *  @brief J2KCodestream class.
+ */
+
+
+#include "compose.hpp"
+#include "cross.h"
+#include "exceptions.h"
+#include "j2k_codestream.h"
+#include <algorithm>
+#include <vector>
+
+#include "i18n.h"
+
+
+using std::string;
+using std::vector;
+using boost::optional;
+
+
+/* Values of Rsiz for the DCI profiles */
+static int const RSIZ_CINEMA_2K = 3;
+static int const RSIZ_CINEMA_4K = 4;
+/* Value of the progression order in COD for component-position-resolution-layer */
+static int const PROGRESSION_CPRL = 4;
+
+
+J2KCodestream::J2KCodestream (uint8_t const* data, int size)
+{
+	read (data, size);
+}
+
+
+J2KCodestream::J2KCodestream (boost::filesystem::path file)
+{
+	/* The main header is normally a few hundred bytes, so this should be plenty */
+	auto const size = std::min(boost::filesystem::file_size(file), static_cast<boost::uintmax_t>(65536));
+	auto f = fopen_boost (file, "rb");
+	if (!f) {
+		throw FileError (_("Could not open file for reading"), file);
+	}
+	vector<uint8_t> buffer (size);
+	checked_fread (buffer.data(), size, f, file);
+	fclose (f);
+
+	try {
+		read (buffer.data(), size);
+	} catch (DecodeError& e) {
+		throw DecodeError (String::compose(_("Could not read JPEG2000 header from %1 (%2)"), file.string(), e.what()));
+	}
+}
+
+
+void
+J2KCodestream::read (uint8_t const* p, int size)
+{
+	auto u8 = [p, size](int offset) {
+		if (offset >= size) {
+			throw DecodeError ("codestream header is truncated");
+		}
+		return static_cast<int>(p[offset]);
+	};
+
+	auto u16 = [u8](int offset) {
+		return (u8(offset) << 8) | u8(offset + 1);
+	};
+
+	auto u32 = [u16](int offset) {
+		return (static_cast<uint32_t>(u16(offset)) << 16) | u16(offset + 2);
+	};
+
+	if (u16(0) != 0xff4f) {
+		throw DecodeError ("missing SOC marker");
+	}
+	if (u16(2) != 0xff51) {
+		throw DecodeError ("missing SIZ marker after SOC");
+	}
+
+	/* SIZ is Lsiz (2 bytes), Rsiz (2), Xsiz (4), Ysiz (4), XOsiz (4), YOsiz (4), XTsiz (4), YTsiz (4),
+	 * XTOsiz (4), YTOsiz (4), Csiz (2), then Ssiz, XRsiz and YRsiz (1 byte each) for each component.
+	 */
+	_rsiz = u16(6);
+	auto const width = u32(8);
+	auto const height = u32(12);
+	auto const x_offset = u32(16);
+	auto const y_offset = u32(20);
+	_size = dcp::Size (width - x_offset, height - y_offset);
+	_offset = x_offset != 0 || y_offset != 0;
+	_tiled = u32(24) < width || u32(28) < height || u32(32) != 0 || u32(36) != 0;
+	_components = u16(40);
+	for (int i = 0; i < _components; ++i) {
+		auto const component = 42 + i * 3;
+		/* Ssiz is the bit depth minus one, with the top bit set for signed values */
+		if (u8(component) != 11) {
+			_12_bit_unsigned = false;
+		}
+		if (u8(component + 1) != 1 || u8(component + 2) != 1) {
+			_subsampled = true;
+		}
+	}
+
+	/* Look through the rest of the main header (which ends at the first SOT) for COD */
+	int marker = 4 + u16(4);
+	while (true) {
+		auto const type = u16(marker);
+		if (type == 0xff90) {
+			break;
+		}
+		if (type == 0xff52) {
+			/* COD is Lcod (2), Scod (1), progression order (1), layers (2), MCT (1), levels (1),
+			 * code block width (1), code block height (1), code block style (1), transform (1)
+			 */
+			_progression = u8(marker + 5);
+			_layers = u16(marker + 6);
+			_mct = u8(marker + 8) == 1;
+			_levels = u8(marker + 9);
+			_code_block_width = 1 << (u8(marker + 10) + 2);
+			_code_block_height = 1 << (u8(marker + 11) + 2);
+			_irreversible = u8(marker + 13) == 0;
+		}
+		auto const length = u16(marker + 2);
+		if (length < 2) {
+			throw DecodeError ("bad marker segment length");
+		}
+		marker += 2 + length;
+	}
+
+	if (_progression == -1) {
+		throw DecodeError ("missing COD marker");
+	}
+}
+
+
+optional<string>
+J2KCodestream::dci_problem () const
+{
+	if (_rsiz != RSIZ_CINEMA_2K && _rsiz != RSIZ_CINEMA_4K) {
+		return String::compose("profile %1 is not DCI 2K or 4K", _rsiz);
+	}
+
+	auto const fourk = _rsiz == RSIZ_CINEMA_4K;
+	auto const max_size = fourk ? dcp::Size(4096, 2160) : dcp::Size(2048, 1080);
+	if (_size.width > max_size.width || _size.height > max_size.height) {
+		return String::compose("image size %1x%2 is too big for its profile", _size.width, _size.height);
+	}
+
+	if (_components != 3 || !_12_bit_unsigned || _subsampled) {
+		return string("image is not three 12-bit unsigned components without subsampling");
+	}
+
+	if (_offset || _tiled) {
+		return string("image is offset or has more than one tile");
+	}
+
+	if (_progression != PROGRESSION_CPRL) {
+		return string("progression order is not CPRL");
+	}
+
+	if (_layers != 1 || !_mct || !_irreversible) {
+		return string("coding style is not one layer with the irreversible transform");
+	}
+
+	if (_levels < 1 || _levels > (fourk ? 6 : 5)) {
+		return String::compose("%1 decomposition levels is not allowed", _levels);
+	}
+
+	if (_code_block_width != 32 || _code_block_height != 32) {
+		return string("code blocks are not 32x32");
+	}
+
+	return {};
+}
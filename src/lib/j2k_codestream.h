@@ -0,0 +1,86 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_J2K_CODESTREAM_H
+#define DCPOMATIC_J2K_CODESTREAM_H
+
+
+/** @file  src/lib/j2k_codestream.h
+ *  @brief J2KCodestream class.
+ */
+
+
+#include <dcp/types.h>
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <string>
+#include <stdint.h>
+
+
+/** @class J2KCodestream
+ *  @brief The parameters from the main header of a JPEG2000 codestream.
+ *
+ *  Only the SIZ and COD marker segments are read, so this is cheap enough to use
+ *  on every file of an image sequence without decoding any pixels.
+ */
+class J2KCodestream
+{
+public:
+	/** Read the main header from some codestream data.
+	 *  @param data Start of the codestream; this must be a raw codestream, not a JP2 file.
+	 *  @param size Number of bytes available at data, which need only cover the main header.
+	 *  Throws DecodeError if the header cannot be read.
+	 */
+	J2KCodestream (uint8_t const* data, int size);
+
+	/** Read the main header from the start of a file containing a raw codestream */
+	explicit J2KCodestream (boost::filesystem::path file);
+
+	dcp::Size size () const {
+		return _size;
+	}
+
+	/** @return a description of why this codestream could not go into a DCP as it is,
+	 *  or none if it meets the DCI 2K or 4K profile.
+	 */
+	boost::optional<std::string> dci_problem () const;
+
+private:
+	void read (uint8_t const* data, int size);
+
+	int _rsiz = 0;
+	dcp::Size _size;
+	bool _offset = false;
+	bool _tiled = false;
+	int _components = 0;
+	bool _12_bit_unsigned = true;
+	bool _subsampled = false;
+	int _progression = -1;
+	int _layers = 0;
+	bool _mct = false;
+	int _levels = 0;
+	int _code_block_width = 0;
+	int _code_block_height = 0;
+	bool _irreversible = false;
+};
+
+
+#endif
@@ -36,6 +36,7 @@
 #include "log.h"
 #include "player.h"
 #include "player_video.h"
+#include "trace.h"
 #include "util.h"
 #include "writer.h"
 #include <libcxml/cxml.h>
@@ -49,9 +50,14 @@ using std::exception;
 using std::list;
 using std::make_shared;
 using std::shared_ptr;
+using std::string;
+using std::vector;
 using std::weak_ptr;
 using boost::optional;
 using dcp::Data;
+#if BOOST_VERSION >= 106100
+using namespace boost::placeholders;
+#endif
 using namespace dcpomatic;
 
 
@@ -62,13 +68,17 @@ J2KEncoder::J2KEncoder (shared_ptr<const Film> film, shared_ptr<Writer> writer)
 	: _film (film)
 	, _history (200)
 	, _writer (writer)
+	, _trace_session (Trace::thread_session())
 {
 	servers_list_changed ();
+	_metrics_source = Metrics::instance()->add_source (boost::bind(&J2KEncoder::add_metrics, this, _1));
 }
 
 
 J2KEncoder::~J2KEncoder ()
 {
+	Metrics::instance()->remove_source (_metrics_source);
+
 	boost::mutex::scoped_lock lm (_threads_mutex);
 	terminate_threads ();
 }
@@ -173,11 +183,33 @@ J2KEncoder::video_frames_enqueued () const
 }
 
 
-/** Should be called when a frame has been encoded successfully */
+/** Should be called when a frame has been encoded successfully.
+ *  @param server Host name of the server that encoded the frame, or localhost.
+ */
 void
-J2KEncoder::frame_done ()
+J2KEncoder::frame_done (string server)
 {
 	_history.event ();
+
+	boost::mutex::scoped_lock lm (_queue_mutex);
+	++_frames_encoded[server];
+}
+
+
+void
+J2KEncoder::add_metrics (vector<Metrics::Metric>& metrics) const
+{
+	auto const film = _film->name ();
+
+	if (auto rate = current_encoding_rate()) {
+		metrics.push_back ({"dcpomatic_encoder_frames_per_second", "Recent rate of JPEG2000 encoding", Metrics::Type::GAUGE, *rate, {{"film", film}}});
+	}
+
+	boost::mutex::scoped_lock lm (_queue_mutex);
+	metrics.push_back ({"dcpomatic_encoder_queue_length", "Frames waiting to be encoded", Metrics::Type::GAUGE, static_cast<double>(_queue.size()), {{"film", film}}});
+	for (auto const& i: _frames_encoded) {
+		metrics.push_back ({"dcpomatic_encoder_frames_total", "Frames encoded, by server", Metrics::Type::COUNTER, static_cast<double>(i.second), {{"film", film}, {"server", i.first}}});
+	}
 }
 
 
@@ -207,7 +239,10 @@ J2KEncoder::encode (shared_ptr<PlayerVideo> pv, DCPTime time)
 	*/
 	while (_queue.size() >= (threads * 2) + 1) {
 		LOG_TIMING ("decoder-sleep queue=%1 threads=%2", _queue.size(), threads);
-		_full_condition.wait (queue_lock);
+		{
+			TRACE_SCOPE ("decoder-sleep");
+			_full_condition.wait (queue_lock);
+		}
 		LOG_TIMING ("decoder-wake queue=%1 threads=%2", _queue.size(), threads);
 	}
 
@@ -244,6 +279,7 @@ J2KEncoder::encode (shared_ptr<PlayerVideo> pv, DCPTime time)
 				_film->j2k_bandwidth(),
 				_film->resolution()
 				));
+		TRACE_COUNTER ("encoder-queue", _queue.size());
 
 		/* The queue might not be empty any more, so notify anything which is
 		   waiting on that.
@@ -284,6 +320,7 @@ J2KEncoder::encoder_thread (optional<EncodeServerDescription> server)
 try
 {
 	start_of_thread ("J2KEncoder");
+	Trace::set_thread_session (_trace_session);
 
 	if (server) {
 		LOG_TIMING ("start-encoder-thread thread=%1 server=%2", thread_id (), server->host_name ());
@@ -301,8 +338,11 @@ try
 
 		LOG_TIMING ("encoder-sleep thread=%1", thread_id ());
 		boost::mutex::scoped_lock lock (_queue_mutex);
-		while (_queue.empty ()) {
-			_empty_condition.wait (lock);
+		{
+			TRACE_SCOPE ("encoder-sleep");
+			while (_queue.empty ()) {
+				_empty_condition.wait (lock);
+			}
 		}
 
 		LOG_TIMING ("encoder-wake thread=%1 queue=%2", thread_id(), _queue.size());
@@ -317,6 +357,7 @@ try
 
 			LOG_TIMING ("encoder-pop thread=%1 frame=%2 eyes=%3", thread_id(), vf.index(), static_cast<int>(vf.eyes()));
 			_queue.pop_front ();
+			TRACE_COUNTER ("encoder-queue", _queue.size());
 
 			lock.unlock ();
 
@@ -325,6 +366,7 @@ try
 			/* We need to encode this input */
 			if (server) {
 				try {
+					TRACE_SCOPE ("remote-encode");
 					encoded = make_shared<dcp::ArrayData>(vf.encode_remotely(server.get()));
 
 					if (remote_backoff > 0) {
@@ -348,6 +390,7 @@ try
 			} else {
 				try {
 					LOG_TIMING ("start-local-encode thread=%1 frame=%2", thread_id(), vf.index());
+					TRACE_SCOPE ("local-encode");
 					encoded = make_shared<dcp::ArrayData>(vf.encode_locally());
 					LOG_TIMING ("finish-local-encode thread=%1 frame=%2", thread_id(), vf.index());
 				} catch (std::exception& e) {
@@ -359,7 +402,7 @@ try
 
 			if (encoded) {
 				_writer->write (encoded, vf.index(), vf.eyes());
-				frame_done ();
+				frame_done (server ? server->host_name() : "localhost");
 			} else {
 				lock.lock ();
 				LOG_GENERAL (N_("[%1] J2KEncoder thread pushes frame %2 back onto queue after failure"), thread_id(), vf.index());
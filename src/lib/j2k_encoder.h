@@ -31,6 +31,7 @@
 #include "util.h"
 #include "cross.h"
 #include "event_history.h"
+#include "metrics.h"
 #include "exception_store.h"
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition.hpp>
@@ -38,6 +39,7 @@
 #include <boost/optional.hpp>
 #include <boost/signals2.hpp>
 #include <list>
+#include <map>
 #include <stdint.h>
 
 
@@ -82,7 +84,8 @@ private:
 
 	static void call_servers_list_changed (std::weak_ptr<J2KEncoder> encoder);
 
-	void frame_done ();
+	void frame_done (std::string server);
+	void add_metrics (std::vector<Metrics::Metric>& metrics) const;
 
 	void encoder_thread (boost::optional<EncodeServerDescription>);
 	void terminate_threads ();
@@ -97,6 +100,8 @@ private:
 
 	mutable boost::mutex _queue_mutex;
 	std::list<DCPVideo> _queue;
+	/** number of frames that have been encoded by each server (or localhost); protected by _queue_mutex */
+	std::map<std::string, int64_t> _frames_encoded;
 	/** condition to manage thread wakeups when we have nothing to do */
 	boost::condition _empty_condition;
 	/** condition to manage thread wakeups when we have too much to do */
@@ -104,6 +109,9 @@ private:
 
 	std::shared_ptr<Writer> _writer;
 	Waker _waker;
+	int _metrics_source;
+	/** Trace session that our threads should record their events in */
+	int _trace_session;
 
 	std::shared_ptr<PlayerVideo> _last_player_video[static_cast<int>(Eyes::COUNT)];
 	boost::optional<dcpomatic::DCPTime> _last_player_video_time;
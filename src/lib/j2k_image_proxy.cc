@@ -52,11 +52,12 @@ using dcp::raw_convert;
 
 
 /** Construct a J2KImageProxy from a JPEG2000 file */
-J2KImageProxy::J2KImageProxy (boost::filesystem::path path, dcp::Size size, AVPixelFormat pixel_format)
+J2KImageProxy::J2KImageProxy (boost::filesystem::path path, dcp::Size size, AVPixelFormat pixel_format, bool passthrough)
 	: _data (new dcp::ArrayData(path))
 	, _size (size)
 	, _pixel_format (pixel_format)
 	, _error (false)
+	, _passthrough (passthrough)
 {
 	/* ::image assumes 16bpp */
 	DCPOMATIC_ASSERT (_pixel_format == AV_PIX_FMT_RGB48 || _pixel_format == AV_PIX_FMT_XYZ12LE);
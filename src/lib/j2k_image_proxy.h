@@ -34,7 +34,8 @@ namespace dcp {
 class J2KImageProxy : public ImageProxy
 {
 public:
-	J2KImageProxy (boost::filesystem::path path, dcp::Size, AVPixelFormat pixel_format);
+	/** @param passthrough true if the file can go into a DCP as it is, false if it must be decoded and encoded again */
+	J2KImageProxy (boost::filesystem::path path, dcp::Size, AVPixelFormat pixel_format, bool passthrough = true);
 
 	J2KImageProxy (
 		std::shared_ptr<const dcp::MonoPictureFrame> frame,
@@ -79,6 +80,10 @@ public:
 		return _eye;
 	}
 
+	bool passthrough () const {
+		return _passthrough;
+	}
+
 	size_t memory_used () const;
 
 private:
@@ -93,4 +98,5 @@ private:
 	boost::optional<int> _forced_reduction;
 	/** true if an error occurred while decoding the JPEG2000 data, false if not */
 	mutable bool _error;
+	bool _passthrough = true;
 };
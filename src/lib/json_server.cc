@@ -23,6 +23,7 @@
 #include "job.h"
 #include "job_manager.h"
 #include "json_server.h"
+#include "metrics.h"
 #include "transcode_job.h"
 #include "util.h"
 #include <dcp/raw_convert.h>
@@ -167,8 +168,17 @@ JSONServer::request (string url, shared_ptr<tcp::socket> socket)
 		action = r["action"];
 	}
 
+	auto const path = url.substr(0, url.find('?'));
+
 	string json;
-	if (action == "status") {
+	string content_type = "application/json";
+	if (path == "/api/v1/metrics" || (action == "metrics" && r["format"] == "json")) {
+		json = Metrics::instance()->json();
+	} else if (path == "/metrics" || action == "metrics") {
+		/* Prometheus text exposition format */
+		json = Metrics::instance()->prometheus();
+		content_type = "text/plain; version=0.0.4";
+	} else if (action == "status") {
 
 		auto jobs = JobManager::instance()->get();
 
@@ -200,9 +210,8 @@ JSONServer::request (string url, shared_ptr<tcp::socket> socket)
 
 	string reply = "HTTP/1.1 200 OK\r\n"
 		"Content-Length: " + raw_convert<string>(json.length()) + "\r\n"
-		"Content-Type: application/json\r\n"
+		"Content-Type: " + content_type + "\r\n"
 		"\r\n"
 		+ json + "\r\n";
-	cout << "reply: " << json << "\n";
 	boost::asio::write (*socket, boost::asio::buffer(reply.c_str(), reply.length()));
 }
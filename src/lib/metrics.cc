@@ -0,0 +1,192 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/metrics.cc
+ *  @brief Metrics class.
+ */
+
+
+#include "metrics.h"
+#include <dcp/raw_convert.h>
+#include <algorithm>
+#include <cmath>
+
+#include "i18n.h"
+
+
+using std::string;
+using std::vector;
+using dcp::raw_convert;
+
+
+Metrics* Metrics::_instance = nullptr;
+
+
+Metrics*
+Metrics::instance ()
+{
+	static boost::mutex instance_mutex;
+	boost::mutex::scoped_lock lm (instance_mutex);
+	if (!_instance) {
+		_instance = new Metrics ();
+	}
+
+	return _instance;
+}
+
+
+int
+Metrics::add_source (Source source)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	auto const id = _next_id++;
+	_sources[id] = source;
+	return id;
+}
+
+
+void
+Metrics::remove_source (int id)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_sources.erase (id);
+}
+
+
+/** @return All current metrics, with metrics of the same name next to each other */
+vector<Metrics::Metric>
+Metrics::get () const
+{
+	vector<Metric> metrics;
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		for (auto const& i: _sources) {
+			i.second (metrics);
+		}
+	}
+
+	std::stable_sort (metrics.begin(), metrics.end(), [](Metric const& a, Metric const& b) {
+		return a.name < b.name;
+	});
+
+	return metrics;
+}
+
+
+static string
+escape (string s, bool json)
+{
+	string out;
+	for (auto c: s) {
+		if (c == '\\' || c == '"') {
+			out += '\\';
+			out += c;
+		} else if (c == '\n') {
+			out += "\\n";
+		} else if (json && static_cast<unsigned char>(c) < 0x20) {
+			/* Other control characters shouldn't turn up, so just drop them */
+		} else {
+			out += c;
+		}
+	}
+	return out;
+}
+
+
+/** @return value as it should appear in the Prometheus text format, which has its own
+ *  spellings of infinity and NaN.
+ */
+static string
+format_prometheus_value (double value)
+{
+	if (std::isnan(value)) {
+		return "NaN";
+	} else if (std::isinf(value)) {
+		return value > 0 ? "+Inf" : "-Inf";
+	}
+
+	return raw_convert<string>(value, 16);
+}
+
+
+/** @return value as a JSON number, or null if it is infinite or NaN since JSON has no way to write those */
+static string
+format_json_value (double value)
+{
+	if (!std::isfinite(value)) {
+		return "null";
+	}
+
+	return raw_convert<string>(value, 16);
+}
+
+
+string
+Metrics::prometheus () const
+{
+	string out;
+	string last_name;
+	for (auto const& i: get()) {
+		if (i.name != last_name) {
+			out += "# HELP " + i.name + " " + i.help + "\n";
+			out += "# TYPE " + i.name + " " + (i.type == Type::COUNTER ? "counter" : "gauge") + "\n";
+			last_name = i.name;
+		}
+		out += i.name;
+		if (!i.labels.empty()) {
+			out += "{";
+			for (auto j = i.labels.begin(); j != i.labels.end(); ++j) {
+				if (j != i.labels.begin()) {
+					out += ",";
+				}
+				out += j->first + "=\"" + escape(j->second, false) + "\"";
+			}
+			out += "}";
+		}
+		out += " " + format_prometheus_value(i.value) + "\n";
+	}
+	return out;
+}
+
+
+string
+Metrics::json () const
+{
+	string out = "{ \"metrics\": [";
+	auto const metrics = get ();
+	for (auto i = metrics.begin(); i != metrics.end(); ++i) {
+		if (i != metrics.begin()) {
+			out += ", ";
+		}
+		out += "{ \"name\": \"" + i->name + "\", ";
+		out += "\"type\": \"" + string(i->type == Type::COUNTER ? "counter" : "gauge") + "\", ";
+		out += "\"labels\": {";
+		for (auto j = i->labels.begin(); j != i->labels.end(); ++j) {
+			if (j != i->labels.begin()) {
+				out += ", ";
+			}
+			out += " \"" + j->first + "\": \"" + escape(j->second, true) + "\"";
+		}
+		out += " }, \"value\": " + format_json_value(i->value) + " }";
+	}
+	out += "] }";
+	return out;
+}
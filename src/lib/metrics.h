@@ -0,0 +1,103 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_METRICS_H
+#define DCPOMATIC_METRICS_H
+
+
+/** @file  src/lib/metrics.h
+ *  @brief Metrics class.
+ */
+
+
+#include <boost/thread/mutex.hpp>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/** @class Metrics
+ *  @brief Collection of counters and gauges from around the program, for monitoring.
+ *
+ *  Things that want to export metrics add a source, which is a function that is only
+ *  called when somebody asks for the metrics; this means that keeping metrics costs
+ *  almost nothing when nobody is looking at them.  The metrics can be formatted in the
+ *  Prometheus text exposition format or as JSON.
+ */
+class Metrics
+{
+public:
+	Metrics (Metrics const&) = delete;
+	Metrics& operator= (Metrics const&) = delete;
+
+	enum class Type {
+		COUNTER, ///< value which only goes up
+		GAUGE    ///< value which can go up or down
+	};
+
+	struct Metric
+	{
+		Metric (std::string name_, std::string help_, Type type_, double value_, std::vector<std::pair<std::string, std::string>> labels_ = {})
+			: name (name_)
+			, help (help_)
+			, type (type_)
+			, value (value_)
+			, labels (labels_)
+		{}
+
+		std::string name;
+		std::string help;
+		Type type;
+		double value;
+		std::vector<std::pair<std::string, std::string>> labels;
+	};
+
+	typedef std::function<void (std::vector<Metric>&)> Source;
+
+	/** Add a source of metrics.  It may be called from any thread, until remove_source() returns.
+	 *  @return ID to pass to remove_source().
+	 */
+	int add_source (Source source);
+	void remove_source (int id);
+
+	std::vector<Metric> get () const;
+	std::string prometheus () const;
+	std::string json () const;
+
+	static Metrics* instance ();
+
+private:
+	Metrics () {}
+
+	/** mutex for _sources and _next_id; it is held while sources are being called so that
+	 *  remove_source() can't return while its source is in use.
+	 */
+	mutable boost::mutex _mutex;
+	std::map<int, Source> _sources;
+	int _next_id = 0;
+
+	static Metrics* _instance;
+};
+
+
+#endif
@@ -23,13 +23,16 @@
 #define DCPOMATIC_PIECE_H
 
 
+#include "audio_stream.h"
 #include "dcpomatic_time.h"
 #include "frame_rate_change.h"
 #include "types.h"
+#include <map>
 
 
 class Content;
 class Decoder;
+class TextContent;
 
 
 class Piece
@@ -43,7 +46,20 @@ public:
 	{}
 
 	std::shared_ptr<Content> content;
+	/** Our decoder, or 0 if it has not yet been made or has been closed; see Player::open_decoder */
 	std::shared_ptr<Decoder> decoder;
+	/** Seek to make when the decoder is next made */
+	boost::optional<dcpomatic::ContentTime> seek_time;
+	bool seek_accurate = false;
+	/** Value of Player::_decoder_uses when the decoder was last used */
+	int64_t last_use = 0;
+	/** When a decoder is closed before it is done these are set to how far each of its
+	 *  audio streams and texts had got, so that anything the re-opened decoder gives us
+	 *  before them can be discarded rather than emitted again.  Video needs no such help
+	 *  as Player already discards video from before the last frame it emitted.
+	 */
+	std::map<AudioStreamPtr, dcpomatic::ContentTime> audio_emitted;
+	std::map<std::shared_ptr<const TextContent>, dcpomatic::ContentTime> text_emitted;
 	boost::optional<dcpomatic::DCPTimePeriod> ignore_video;
 	FrameRateChange frc;
 	bool done;
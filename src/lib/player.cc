@@ -30,11 +30,14 @@
 #include "content_video.h"
 #include "dcp_content.h"
 #include "dcp_decoder.h"
+#include "dcp_subtitle_content.h"
 #include "dcpomatic_log.h"
 #include "decoder.h"
 #include "decoder_factory.h"
 #include "ffmpeg_content.h"
+#include "ffmpeg_decoder.h"
 #include "film.h"
+#include "font_data.h"
 #include "frame_rate_change.h"
 #include "image.h"
 #include "image_decoder.h"
@@ -49,6 +52,7 @@
 #include "referenced_reel_asset.h"
 #include "render_text.h"
 #include "shuffler.h"
+#include "string_text_file_content.h"
 #include "text_content.h"
 #include "text_decoder.h"
 #include "timer.h"
@@ -60,6 +64,7 @@
 #include <dcp/reel_subtitle_asset.h>
 #include <algorithm>
 #include <iostream>
+#include <unordered_map>
 #include <stdint.h>
 
 #include "i18n.h"
@@ -94,6 +99,9 @@ int const PlayerProperty::FILM_VIDEO_FRAME_RATE = 703;
 int const PlayerProperty::DCP_DECODE_REDUCTION = 704;
 int const PlayerProperty::PLAYBACK_LENGTH = 705;
 
+/** Number of decoders to keep open at once if there are not more pieces than this overlapping */
+static int const default_max_open_decoders = 32;
+
 
 Player::Player (shared_ptr<const Film> film, Image::Alignment subtitle_alignment)
 	: _film (film)
@@ -162,8 +170,29 @@ Player::setup_pieces_unlocked ()
 {
 	_playback_length = _playlist ? _playlist->length(_film) : _film->length();
 
-	auto old_pieces = _pieces;
+	std::unordered_map<shared_ptr<Content>, shared_ptr<Decoder>> old_decoders;
+	for (auto i: _pieces) {
+		if (i->decoder) {
+			old_decoders[i->content] = i->decoder;
+		}
+	}
 	_pieces.clear ();
+	_open_decoders = 0;
+
+	/* Every piece which overlaps another must be able to have its decoder open at the same time */
+	vector<pair<DCPTime, int>> edges;
+	for (auto i: playlist()->content()) {
+		edges.push_back ({i->position(), 1});
+		edges.push_back ({i->end(_film), -1});
+	}
+	/* Ends sort before starts at the same time, so that abutting pieces do not count as overlapping */
+	std::sort (edges.begin(), edges.end());
+	int overlapping = 0;
+	_max_open_decoders = default_max_open_decoders;
+	for (auto const& i: edges) {
+		overlapping += i.second;
+		_max_open_decoders = max (_max_open_decoders, overlapping);
+	}
 
 	_shuffler.reset (new Shuffler());
 	_shuffler->Video.connect(bind(&Player::video, this, _1, _2));
@@ -179,103 +208,47 @@ Player::setup_pieces_unlocked ()
 			continue;
 		}
 
-		shared_ptr<Decoder> old_decoder;
-		for (auto j: old_pieces) {
-			if (j->content == i) {
-				old_decoder = j->decoder;
-				break;
-			}
-		}
-
-		auto decoder = decoder_factory (_film, i, _fast, _tolerant, old_decoder);
-		DCPOMATIC_ASSERT (decoder);
-
-		FrameRateChange frc (_film, i);
-
-		if (decoder->video && _ignore_video) {
-			decoder->video->set_ignore (true);
-		}
-
-		if (decoder->audio && _ignore_audio) {
-			decoder->audio->set_ignore (true);
-		}
-
-		if (_ignore_text) {
-			for (auto i: decoder->text) {
-				i->set_ignore (true);
-			}
-		}
-
-		auto dcp = dynamic_pointer_cast<DCPDecoder> (decoder);
-		if (dcp) {
-			dcp->set_decode_referenced (_play_referenced);
-			if (_play_referenced) {
-				dcp->set_forced_reduction (_dcp_decode_reduction);
-			}
-		}
-
-		auto piece = make_shared<Piece>(i, decoder, frc);
+		auto piece = make_shared<Piece>(i, shared_ptr<Decoder>(), FrameRateChange(_film, i));
 		_pieces.push_back (piece);
 
-		if (decoder->video) {
-			if (i->video->frame_type() == VideoFrameType::THREE_D_LEFT || i->video->frame_type() == VideoFrameType::THREE_D_RIGHT) {
-				/* We need a Shuffler to cope with 3D L/R video data arriving out of sequence */
-				decoder->video->Data.connect (bind(&Shuffler::video, _shuffler.get(), weak_ptr<Piece>(piece), _1));
-			} else {
-				decoder->video->Data.connect (bind(&Player::video, this, weak_ptr<Piece>(piece), _1));
-			}
-		}
-
-		if (decoder->audio) {
-			decoder->audio->Data.connect (bind (&Player::audio, this, weak_ptr<Piece> (piece), _1, _2));
-		}
-
-		auto j = decoder->text.begin();
-
-		while (j != decoder->text.end()) {
-			(*j)->BitmapStart.connect (
-				bind(&Player::bitmap_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
-			(*j)->PlainStart.connect (
-				bind(&Player::plain_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
-			(*j)->Stop.connect (
-				bind(&Player::subtitle_stop, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>((*j)->content()), _1)
-				);
-
-			++j;
-		}
-
-		if (decoder->atmos) {
-			decoder->atmos->Data.connect (bind(&Player::atmos, this, weak_ptr<Piece>(piece), _1));
+		/* Decoders are otherwise made when they are first needed, but if we already had one
+		   for this content we make its replacement now so that it can take whatever it can
+		   from the old one.
+		*/
+		auto old = old_decoders.find (i);
+		if (old != old_decoders.end()) {
+			open_decoder (piece, old->second);
 		}
 	}
 
 	_stream_states.clear ();
 	for (auto i: _pieces) {
 		if (i->content->audio) {
-			for (auto j: i->content->audio->streams()) {
+			for (auto j: i->content->audio->used_streams()) {
 				_stream_states[j] = StreamState (i, i->content->position ());
 			}
 		}
 	}
 
-	for (auto i = _pieces.begin(); i != _pieces.end(); ++i) {
-		if (auto video = (*i)->content->video) {
-			if (video->use() && video->frame_type() != VideoFrameType::THREE_D_LEFT && video->frame_type() != VideoFrameType::THREE_D_RIGHT) {
-				/* Look for content later in the content list with in-use video that overlaps this */
-				auto period = DCPTimePeriod((*i)->content->position(), (*i)->content->end(_film));
-				auto j = i;
-				++j;
-				for (; j != _pieces.end(); ++j) {
-					if ((*j)->content->video && (*j)->content->video->use()) {
-						(*i)->ignore_video = DCPTimePeriod((*j)->content->position(), (*j)->content->end(_film)).overlap(period);
-					}
-				}
+	/* Find the last piece in the content list with in-use video; earlier pieces with in-use video are
+	   ignored where they overlap it.
+	*/
+	auto last_video = std::find_if(_pieces.rbegin(), _pieces.rend(), [](shared_ptr<const Piece> piece) {
+		return piece->content->video && piece->content->video->use();
+	});
+
+	if (last_video != _pieces.rend()) {
+		auto const last_video_period = DCPTimePeriod((*last_video)->content->position(), (*last_video)->content->end(_film));
+		for (auto i = std::next(last_video); i != _pieces.rend(); ++i) {
+			auto video = (*i)->content->video;
+			if (video && video->use() && video->frame_type() != VideoFrameType::THREE_D_LEFT && video->frame_type() != VideoFrameType::THREE_D_RIGHT) {
+				(*i)->ignore_video = last_video_period.overlap(DCPTimePeriod((*i)->content->position(), (*i)->content->end(_film)));
 			}
 		}
 	}
 
+	setup_schedule ();
+
 	_black = Empty (_film, playlist(), bind(&have_video, _1), _playback_length);
 	_silent = Empty (_film, playlist(), bind(&have_audio, _1), _playback_length);
 
@@ -475,8 +448,23 @@ Player::get_subtitle_fonts ()
 		/* XXX: things may go wrong if there are duplicate font IDs
 		   with different font files.
 		*/
-		auto f = i->decoder->fonts ();
-		copy (f.begin(), f.end(), back_inserter(fonts));
+		if (i->decoder) {
+			auto f = i->decoder->fonts ();
+			copy (f.begin(), f.end(), back_inserter(fonts));
+		} else if (dynamic_pointer_cast<DCPContent>(i->content) || dynamic_pointer_cast<DCPSubtitleContent>(i->content)) {
+			/* These may have fonts inside their files which only a decoder will find.  Use a temporary
+			   one rather than opening one for the piece, which could mean closing one that is in use.
+			*/
+			auto f = decoder_factory(_film, i->content, _fast, _tolerant, shared_ptr<Decoder>())->fonts();
+			copy (f.begin(), f.end(), back_inserter(fonts));
+		} else if (dynamic_pointer_cast<StringTextFileContent>(i->content)) {
+			/* The decoder would just give us the content's fonts */
+			for (auto j: i->content->text) {
+				for (auto k: j->fonts()) {
+					fonts.push_back (FontData(k));
+				}
+			}
+		}
 	}
 
 	return fonts;
@@ -653,24 +641,9 @@ Player::pass ()
 	shared_ptr<Piece> earliest_content;
 	optional<DCPTime> earliest_time;
 
-	for (auto i: _pieces) {
-		if (i->done) {
-			continue;
-		}
-
-		auto const t = content_time_to_dcp (i, max(i->decoder->position(), i->content->trim_start()));
-		if (t > i->content->end(_film)) {
-			i->done = true;
-		} else {
-
-			/* Given two choices at the same time, pick the one with texts so we see it before
-			   the video.
-			*/
-			if (!earliest_time || t < *earliest_time || (t == *earliest_time && !i->decoder->text.empty())) {
-				earliest_time = t;
-				earliest_content = i;
-			}
-		}
+	if (!_schedule.empty()) {
+		earliest_content = _schedule.front().piece;
+		earliest_time = _schedule.front().time;
 	}
 
 	bool done = false;
@@ -700,7 +673,16 @@ Player::pass ()
 	case CONTENT:
 	{
 		LOG_DEBUG_PLAYER ("Calling pass() on %1", earliest_content->content->path(0));
+		std::pop_heap (_schedule.begin(), _schedule.end(), &ScheduledPiece::later);
+		auto const index = _schedule.back().index;
+		_schedule.pop_back ();
+		open_decoder (earliest_content);
 		earliest_content->done = earliest_content->decoder->pass ();
+		if (earliest_content->done) {
+			close_decoder (earliest_content);
+		} else {
+			schedule (earliest_content, index);
+		}
 		auto dcp = dynamic_pointer_cast<DCPContent>(earliest_content->content);
 		if (dcp && !_play_referenced && dcp->reference_audio()) {
 			/* We are skipping some referenced DCP audio content, so we need to update _last_audio_time
@@ -1006,6 +988,21 @@ Player::audio (weak_ptr<Piece> wp, AudioStreamPtr stream, ContentAudio content_a
 
 	int const rfr = content->resampled_frame_rate (_film);
 
+	/* Discard anything we already emitted before this piece's decoder was closed and re-opened */
+	auto emitted = piece->audio_emitted.find (stream);
+	if (emitted != piece->audio_emitted.end()) {
+		Frame const emitted_frame = emitted->second.frames_round(rfr);
+		if (content_audio.frame + content_audio.audio->frames() <= emitted_frame) {
+			return;
+		}
+		if (content_audio.frame < emitted_frame) {
+			auto const cut = emitted_frame - content_audio.frame;
+			content_audio.audio = make_shared<AudioBuffers>(content_audio.audio, content_audio.audio->frames() - cut, cut);
+			content_audio.frame = emitted_frame;
+		}
+		piece->audio_emitted.erase (emitted);
+	}
+
 	/* Compute time in the DCP */
 	auto time = resampled_audio_to_dcp (piece, content_audio.frame);
 	LOG_DEBUG_PLAYER("Received audio frame %1 at %2", content_audio.frame, to_string(time));
@@ -1074,6 +1071,10 @@ Player::bitmap_text_start (weak_ptr<Piece> wp, weak_ptr<const TextContent> wc, C
 		return;
 	}
 
+	if (already_emitted(piece, text, subtitle.from())) {
+		return;
+	}
+
 	/* Apply content's subtitle offsets */
 	subtitle.sub.rectangle.x += text->x_offset ();
 	subtitle.sub.rectangle.y += text->y_offset ();
@@ -1117,6 +1118,10 @@ Player::plain_text_start (weak_ptr<Piece> wp, weak_ptr<const TextContent> wc, Co
 		return;
 	}
 
+	if (already_emitted(piece, text, subtitle.from())) {
+		return;
+	}
+
 	PlayerText ps;
 	DCPTime const from (content_time_to_dcp (piece, subtitle.from()));
 
@@ -1153,6 +1158,26 @@ Player::plain_text_start (weak_ptr<Piece> wp, weak_ptr<const TextContent> wc, Co
 }
 
 
+/** @return true if a text starting at @p from was emitted before the decoder of
+ *  @p piece was closed and re-opened.
+ */
+bool
+Player::already_emitted (shared_ptr<Piece> piece, shared_ptr<const TextContent> text, ContentTime from) const
+{
+	auto emitted = piece->text_emitted.find (text);
+	if (emitted == piece->text_emitted.end()) {
+		return false;
+	}
+
+	if (from <= emitted->second) {
+		return true;
+	}
+
+	piece->text_emitted.erase (emitted);
+	return false;
+}
+
+
 void
 Player::subtitle_stop (weak_ptr<Piece> wp, weak_ptr<const TextContent> wc, ContentTime to)
 {
@@ -1222,18 +1247,21 @@ Player::seek (DCPTime time, bool accurate)
 			   content we may not start right at the beginning of the next, causing a gap (if the next content has
 			   been trimmed to a point between keyframes, or something).
 			*/
-			i->decoder->seek (dcp_to_content_time (i, i->content->position()), true);
+			seek_piece (i, dcp_to_content_time(i, i->content->position()), true);
 			i->done = false;
 		} else if (i->content->position() <= time && time < i->content->end(_film)) {
 			/* During; seek to position */
-			i->decoder->seek (dcp_to_content_time (i, time), accurate);
+			seek_piece (i, dcp_to_content_time(i, time), accurate);
 			i->done = false;
 		} else {
 			/* After; this piece is done */
 			i->done = true;
+			close_decoder (i);
 		}
 	}
 
+	setup_schedule ();
+
 	if (accurate) {
 		_last_video_time = time;
 		_last_video_eyes = Eyes::LEFT;
@@ -1383,6 +1411,222 @@ Player::set_dcp_decode_reduction (optional<int> reduction)
 }
 
 
+/** @return true if a should be passed after b */
+bool
+Player::ScheduledPiece::later (ScheduledPiece const& a, ScheduledPiece const& b)
+{
+	if (a.time != b.time) {
+		return a.time > b.time;
+	}
+
+	/* Given two choices at the same time, pick the one with texts so we see it before
+	   the video.  Between two with texts pick the later in the content list, otherwise
+	   the earlier.
+	*/
+	if (a.text != b.text) {
+		return !a.text;
+	}
+
+	return a.text ? a.index < b.index : a.index > b.index;
+}
+
+
+/** Add a piece to _schedule at the time of the next data from its decoder, or mark it done
+ *  if that is after its end.
+ *  @param index Index of the piece in _pieces.
+ */
+void
+Player::schedule (shared_ptr<Piece> piece, int index)
+{
+	ContentTime position;
+	if (piece->decoder) {
+		position = piece->decoder->position ();
+	} else if (piece->seek_time) {
+		position = *piece->seek_time;
+	}
+
+	auto const t = content_time_to_dcp (piece, max(position, piece->content->trim_start()));
+	if (t > piece->content->end(_film)) {
+		piece->done = true;
+		close_decoder (piece);
+		return;
+	}
+
+	_schedule.push_back ({t, index, !piece->content->text.empty(), piece});
+	std::push_heap (_schedule.begin(), _schedule.end(), &ScheduledPiece::later);
+}
+
+
+/** Make sure that a piece has a decoder, making one if necessary and closing the least
+ *  recently used one if we then have too many open.
+ *  @param old_decoder Decoder that a new decoder may take things from, or 0.
+ */
+void
+Player::open_decoder (shared_ptr<Piece> piece, shared_ptr<Decoder> old_decoder)
+{
+	piece->last_use = ++_decoder_uses;
+
+	if (piece->decoder) {
+		return;
+	}
+
+	while (_open_decoders >= _max_open_decoders) {
+		shared_ptr<Piece> oldest;
+		for (auto i: _pieces) {
+			if (i->decoder && (!oldest || i->last_use < oldest->last_use)) {
+				oldest = i;
+			}
+		}
+		DCPOMATIC_ASSERT (oldest);
+		LOG_DEBUG_PLAYER ("Closing decoder for %1 to make room", oldest->content->path(0));
+		close_decoder (oldest);
+	}
+
+	auto decoder = decoder_factory (_film, piece->content, _fast, _tolerant, old_decoder);
+	DCPOMATIC_ASSERT (decoder);
+
+	if (decoder->video && _ignore_video) {
+		decoder->video->set_ignore (true);
+	}
+
+	if (decoder->audio && _ignore_audio) {
+		decoder->audio->set_ignore (true);
+	}
+
+	if (_ignore_text) {
+		for (auto i: decoder->text) {
+			i->set_ignore (true);
+		}
+	}
+
+	auto dcp = dynamic_pointer_cast<DCPDecoder> (decoder);
+	if (dcp) {
+		dcp->set_decode_referenced (_play_referenced);
+		if (_play_referenced) {
+			dcp->set_forced_reduction (_dcp_decode_reduction);
+		}
+	}
+
+	auto ffmpeg = dynamic_pointer_cast<FFmpegDecoder>(decoder);
+	if (ffmpeg) {
+		/* We're going to pass() this decoder until it's done or closed, so it's worth reading ahead */
+		ffmpeg->enable_read_ahead ();
+	}
+
+	if (decoder->video) {
+		auto const frame_type = piece->content->video->frame_type();
+		if (frame_type == VideoFrameType::THREE_D_LEFT || frame_type == VideoFrameType::THREE_D_RIGHT) {
+			/* We need a Shuffler to cope with 3D L/R video data arriving out of sequence */
+			decoder->video->Data.connect (bind(&Shuffler::video, _shuffler.get(), weak_ptr<Piece>(piece), _1));
+		} else {
+			decoder->video->Data.connect (bind(&Player::video, this, weak_ptr<Piece>(piece), _1));
+		}
+	}
+
+	if (decoder->audio) {
+		decoder->audio->Data.connect (bind (&Player::audio, this, weak_ptr<Piece> (piece), _1, _2));
+	}
+
+	for (auto i: decoder->text) {
+		i->BitmapStart.connect (
+			bind(&Player::bitmap_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>(i->content()), _1)
+			);
+		i->PlainStart.connect (
+			bind(&Player::plain_text_start, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>(i->content()), _1)
+			);
+		i->Stop.connect (
+			bind(&Player::subtitle_stop, this, weak_ptr<Piece>(piece), weak_ptr<const TextContent>(i->content()), _1)
+			);
+	}
+
+	if (decoder->atmos) {
+		decoder->atmos->Data.connect (bind(&Player::atmos, this, weak_ptr<Piece>(piece), _1));
+	}
+
+	piece->decoder = decoder;
+	++_open_decoders;
+
+	if (piece->seek_time) {
+		decoder->seek (*piece->seek_time, piece->seek_accurate);
+		piece->seek_time = boost::none;
+	}
+}
+
+
+/** Close a piece's decoder, if it has one.  If the piece is not done its decoder
+ *  will be seeked back to where it was when it is next opened.
+ */
+void
+Player::close_decoder (shared_ptr<Piece> piece)
+{
+	if (!piece->decoder) {
+		return;
+	}
+
+	if (piece->done) {
+		piece->seek_time = boost::none;
+	} else {
+		auto decoder = piece->decoder;
+		piece->seek_time = decoder->position ();
+		piece->seek_accurate = true;
+		/* The seek will go back to the earliest of the decoder's streams, so remember where
+		   the others had got to.
+		*/
+		if (decoder->audio && !decoder->audio->ignore()) {
+			for (auto i: piece->content->audio->used_streams()) {
+				auto& emitted = piece->audio_emitted[i];
+				emitted = max (emitted, decoder->audio->stream_position(_film, i));
+			}
+		}
+		for (auto i: decoder->text) {
+			auto const position = i->position(_film);
+			if (position && !i->ignore()) {
+				auto& emitted = piece->text_emitted[i->content()];
+				emitted = max (emitted, *position);
+			}
+		}
+	}
+
+	piece->decoder.reset ();
+	--_open_decoders;
+}
+
+
+/** Seek a piece's decoder, or arrange for it to be seeked when it is made */
+void
+Player::seek_piece (shared_ptr<Piece> piece, ContentTime time, bool accurate)
+{
+	piece->audio_emitted.clear ();
+	piece->text_emitted.clear ();
+
+	if (piece->decoder) {
+		piece->decoder->seek (time, accurate);
+	} else {
+		piece->seek_time = time;
+		piece->seek_accurate = accurate;
+	}
+}
+
+
+/** Rebuild _schedule from _pieces; this must be called whenever the pieces change or
+ *  their decoders are seeked, since the time of a piece in _schedule is only otherwise
+ *  updated when it is passed.
+ */
+void
+Player::setup_schedule ()
+{
+	_schedule.clear ();
+
+	int index = 0;
+	for (auto i: _pieces) {
+		if (!i->done) {
+			schedule (i, index);
+		}
+		++index;
+	}
+}
+
+
 optional<DCPTime>
 Player::content_time_to_dcp (shared_ptr<const Content> content, ContentTime t)
 {
@@ -39,6 +39,7 @@
 #include "shuffler.h"
 #include <boost/atomic.hpp>
 #include <list>
+#include <vector>
 
 
 namespace dcp {
@@ -52,10 +53,12 @@ namespace dcpomatic {
 class AtmosContent;
 class AudioBuffers;
 class Content;
+class Decoder;
 class Piece;
 class PlayerVideo;
 class Playlist;
 class ReferencedReelAsset;
+class TextContent;
 
 
 class PlayerProperty
@@ -129,10 +132,19 @@ private:
 	friend struct empty_test2;
 	friend struct check_reuse_old_data_test;
 	friend struct overlap_video_test1;
+	friend struct player_lazy_decoders_test;
+	friend struct player_overlapping_decoders_test;
+	friend struct player_reopened_decoders_test;
 
 	void construct ();
 	void setup_pieces ();
 	void setup_pieces_unlocked ();
+	void setup_schedule ();
+	void schedule (std::shared_ptr<Piece> piece, int index);
+	void open_decoder (std::shared_ptr<Piece> piece, std::shared_ptr<Decoder> old_decoder = std::shared_ptr<Decoder>());
+	void close_decoder (std::shared_ptr<Piece> piece);
+	void seek_piece (std::shared_ptr<Piece> piece, dcpomatic::ContentTime time, bool accurate);
+	bool already_emitted (std::shared_ptr<Piece> piece, std::shared_ptr<const TextContent> text, dcpomatic::ContentTime from) const;
 	void film_change (ChangeType, Film::Property);
 	void playlist_change (ChangeType);
 	void playlist_content_change (ChangeType, int, bool);
@@ -176,6 +188,36 @@ private:
 	boost::atomic<int> _suspended;
 	std::list<std::shared_ptr<Piece>> _pieces;
 
+	/** A piece which is waiting to be passed */
+	struct ScheduledPiece
+	{
+		/** time of the next data from this piece's decoder */
+		dcpomatic::DCPTime time;
+		/** index of the piece in _pieces */
+		int index;
+		/** true if the piece's decoder has any text */
+		bool text;
+		std::shared_ptr<Piece> piece;
+
+		static bool later (ScheduledPiece const& a, ScheduledPiece const& b);
+	};
+
+	/** Heap of pieces which are not done, with the piece that should be passed next
+	 *  at the front.  This saves looking at every piece on each pass(), which is slow
+	 *  when there are hundreds of them.
+	 */
+	std::vector<ScheduledPiece> _schedule;
+
+	/** Number of pieces which currently have decoders */
+	int _open_decoders = 0;
+	/** Count of calls to open_decoder(), used to find the least recently used decoder */
+	int64_t _decoder_uses = 0;
+	/** Maximum number of decoders to keep open at once; this is never less than the
+	 *  number of pieces which overlap, otherwise we would be closing and re-opening
+	 *  decoders on every pass.
+	 */
+	int _max_open_decoders = 0;
+
 	/** Size of the image we are rendering to; this may be the DCP frame size, or
 	 *  the size of preview in a window.
 	 */
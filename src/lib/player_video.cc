@@ -116,18 +116,60 @@ PlayerVideo::set_text (PositionImage image)
 
 
 shared_ptr<Image>
-PlayerVideo::image (function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast) const
+PlayerVideo::image (function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast, bool apply_fade, bool apply_text) const
 {
-	/* XXX: this assumes that image() and prepare() are only ever called with the same parameters (except crop, inter size, out size, fade) */
+	/* XXX: this assumes that image() and prepare() are only ever called with the same parameters (except crop, inter size, out size, fade, text) */
+
+	auto const fade = apply_fade ? _fade : optional<double>();
+	bool const text = apply_text && _text;
 
 	boost::mutex::scoped_lock lm (_mutex);
-	if (!_image || _crop != _image_crop || _inter_size != _image_inter_size || _out_size != _image_out_size || _fade != _image_fade) {
-		make_image (pixel_format, video_range, fast);
+	if (!_image || _crop != _image_crop || _inter_size != _image_inter_size || _out_size != _image_out_size || fade != _image_fade || text != _image_text) {
+		make_image (pixel_format, video_range, fast, fade, text);
 	}
 	return _image;
 }
 
 
+/** @return the parts of this frame, before any fade, for XYZConverter to put together.
+ *  If the image from our ImageProxy is already RGB48LE at the right size (as it is for
+ *  e.g. 16-bit TIFF sequences) it is returned as-is, to be cropped and padded by the
+ *  converter; otherwise it is cropped, scaled and padded by image().  Either way, any
+ *  text is left to the converter if the image is RGB48LE.
+ */
+PlayerVideo::Parts
+PlayerVideo::parts (function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast) const
+{
+	auto prox = _in->image (Image::Alignment::PADDED, _inter_size);
+	auto const in_format = prox.image->pixel_format ();
+	auto const out_format = pixel_format (in_format);
+	auto const crop = total_crop (prox);
+	auto const in_size = prox.image->size ();
+
+	if (
+		in_format == AV_PIX_FMT_RGB48LE &&
+		out_format == AV_PIX_FMT_RGB48LE &&
+		!(_video_range == VideoRange::VIDEO && video_range == VideoRange::FULL) &&
+		(crop.left + crop.right) < (in_size.width - 4) &&
+		(crop.top + crop.bottom) < (in_size.height - 4) &&
+		crop.apply(in_size) == _inter_size
+	   ) {
+		/* crop_scale_window would only copy the pixels, so leave that to the converter */
+		boost::mutex::scoped_lock lm (_mutex);
+		_error = prox.error;
+		return { prox.image, crop, _out_size, _text };
+	}
+
+	bool const converter_blends = out_format == AV_PIX_FMT_RGB48LE;
+	return {
+		image(pixel_format, video_range, fast, false, !converter_blends),
+		Crop(),
+		_out_size,
+		converter_blends ? _text : optional<PositionImage>()
+	};
+}
+
+
 shared_ptr<const Image>
 PlayerVideo::raw_image () const
 {
@@ -140,18 +182,46 @@ PlayerVideo::raw_image () const
  *  it is passed the pixel format of the input image from the ImageProxy, and should return the desired
  *  output pixel format.  Two functions force and keep_xyz_or_rgb are provided for use here.
  *  @param fast true to be fast at the expense of quality.
+ *  @param fade Fade to apply to the image, if any.
+ *  @param text true to blend _text onto the image.
  */
 void
-PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast) const
+PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast, optional<double> fade, bool text) const
 {
 	_image_crop = _crop;
 	_image_inter_size = _inter_size;
 	_image_out_size = _out_size;
-	_image_fade = _fade;
+	_image_fade = fade;
+	_image_text = text;
 
 	auto prox = _in->image (Image::Alignment::PADDED, _inter_size);
 	_error = prox.error;
 
+	dcp::YUVToRGB yuv_to_rgb = dcp::YUVToRGB::REC601;
+	if (_colour_conversion) {
+		yuv_to_rgb = _colour_conversion.get().yuv_to_rgb();
+	}
+
+	_image = prox.image->crop_scale_window (
+		total_crop(prox), _inter_size, _out_size, yuv_to_rgb, _video_range, pixel_format (prox.image->pixel_format()), video_range, Image::Alignment::COMPACT, fast
+		);
+
+	if (text) {
+		_image->alpha_blend (_text->image, _text->position);
+	}
+
+	if (fade) {
+		_image->fade (fade.get());
+	}
+}
+
+
+/** @return crop to apply to the image in prox, taking into account _part and any scaling
+ *  that the ImageProxy has done.
+ */
+Crop
+PlayerVideo::total_crop (ImageProxy::Result const& prox) const
+{
 	auto total_crop = _crop;
 	switch (_part) {
 	case Part::LEFT_HALF:
@@ -179,22 +249,7 @@ PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, V
 		total_crop.bottom /= r;
 	}
 
-	dcp::YUVToRGB yuv_to_rgb = dcp::YUVToRGB::REC601;
-	if (_colour_conversion) {
-		yuv_to_rgb = _colour_conversion.get().yuv_to_rgb();
-	}
-
-	_image = prox.image->crop_scale_window (
-		total_crop, _inter_size, _out_size, yuv_to_rgb, _video_range, pixel_format (prox.image->pixel_format()), video_range, Image::Alignment::COMPACT, fast
-		);
-
-	if (_text) {
-		_image->alpha_blend (_text->image, _text->position);
-	}
-
-	if (_fade) {
-		_image->fade (_fade.get ());
-	}
+	return total_crop;
 }
 
 
@@ -242,7 +297,7 @@ PlayerVideo::has_j2k () const
 	/* XXX: maybe other things */
 
 	auto j2k = dynamic_pointer_cast<const J2KImageProxy> (_in);
-	if (!j2k) {
+	if (!j2k || !j2k->passthrough()) {
 		return false;
 	}
 
@@ -317,7 +372,7 @@ PlayerVideo::prepare (function<AVPixelFormat (AVPixelFormat)> pixel_format, Vide
 	_in->prepare (alignment, _inter_size);
 	boost::mutex::scoped_lock lm (_mutex);
 	if (!_image && !proxy_only) {
-		make_image (pixel_format, video_range, fast);
+		make_image (pixel_format, video_range, fast, _fade, static_cast<bool>(_text));
 	}
 }
 
@@ -26,6 +26,7 @@
 #include "colour_conversion.h"
 #include "dcpomatic_time.h"
 #include "image.h"
+#include "image_proxy.h"
 #include "position.h"
 #include "position_image.h"
 #include "types.h"
@@ -36,7 +37,6 @@ extern "C" {
 
 
 class Image;
-class ImageProxy;
 class Film;
 class Socket;
 
@@ -76,7 +76,22 @@ public:
 	}
 
 	void prepare (std::function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, Image::Alignment alignment, bool fast, bool proxy_only);
-	std::shared_ptr<Image> image (std::function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast) const;
+	std::shared_ptr<Image> image (
+		std::function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast, bool apply_fade = true, bool apply_text = true
+		) const;
+
+	/** The parts of a frame which XYZConverter can put together itself; see parts() */
+	struct Parts
+	{
+		/** image, which still needs to be cropped by crop and then put in the middle of out_size */
+		std::shared_ptr<const Image> image;
+		Crop crop;
+		dcp::Size out_size;
+		/** text which still needs to be blended on, if any */
+		boost::optional<PositionImage> text;
+	};
+
+	Parts parts (std::function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast) const;
 	std::shared_ptr<const Image> raw_image () const;
 
 	static AVPixelFormat force (AVPixelFormat);
@@ -102,6 +117,10 @@ public:
 		return _colour_conversion;
 	}
 
+	boost::optional<double> fade () const {
+		return _fade;
+	}
+
 	/** @return Position of the content within the overall image once it has been scaled up */
 	Position<int> inter_position () const;
 
@@ -127,7 +146,8 @@ public:
 	}
 
 private:
-	void make_image (std::function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast) const;
+	void make_image (std::function<AVPixelFormat (AVPixelFormat)> pixel_format, VideoRange video_range, bool fast, boost::optional<double> fade, bool text) const;
+	Crop total_crop (ImageProxy::Result const& prox) const;
 
 	std::shared_ptr<const ImageProxy> _in;
 	Crop _crop;
@@ -152,8 +172,10 @@ private:
 	mutable dcp::Size _image_inter_size;
 	/** _out_size that was used to make _image */
 	mutable dcp::Size _image_out_size;
-	/** _fade that was used to make _image */
+	/** fade that was applied to _image, if any */
 	mutable boost::optional<double> _image_fade;
+	/** true if _text was blended onto _image */
+	mutable bool _image_text = false;
 	/** true if there was an error when decoding our image */
 	mutable bool _error;
 };
@@ -0,0 +1,198 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/read_ahead.cc
+ *  @brief ReadAhead class.
+ */
+
+
+#include "compose.hpp"
+#include "dcpomatic_log.h"
+#include "exceptions.h"
+#include "read_ahead.h"
+#include "util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "i18n.h"
+
+
+using std::min;
+using std::vector;
+
+
+ReadAhead::ReadAhead (vector<boost::filesystem::path> paths, int64_t size)
+	: _paths (paths)
+	, _file (paths)
+	, _block_size (static_cast<int>(min(size, int64_t(1024 * 1024))))
+	, _max_blocks (std::max(int64_t(2), size / _block_size))
+	, _end (_file.length())
+{
+	_thread = boost::thread (boost::bind(&ReadAhead::thread, this));
+}
+
+
+ReadAhead::~ReadAhead ()
+{
+	boost::this_thread::disable_interruption dis;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+		_condition.notify_all ();
+	}
+
+	try {
+		_thread.join ();
+	} catch (...) {}
+
+	if (_bytes_fetched > 0) {
+		LOG_GENERAL (
+			"Read ahead of %1: %2MB at %3MB/s; waited %4 times for %5s in total; restarted %6 times",
+			_paths.front().string(),
+			_bytes_fetched / 1000000,
+			_fetch_seconds > 0 ? int(_bytes_fetched / (_fetch_seconds * 1000000)) : 0,
+			_waits,
+			_wait_seconds,
+			_restarts
+			);
+	}
+}
+
+
+void
+ReadAhead::thread ()
+try
+{
+	start_of_thread ("ReadAhead");
+
+	/* Where the file is positioned, so that we only seek when we must */
+	int64_t file_position = 0;
+
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		while (!_stop && (_blocks.size() >= _max_blocks || _fetch_position >= _end)) {
+			_condition.wait (lm);
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		auto const generation = _generation;
+		Block block;
+		block.position = _fetch_position;
+		lm.unlock ();
+
+		auto const start = std::chrono::steady_clock::now();
+		if (block.position != file_position) {
+			_file.seek (block.position, SEEK_SET);
+		}
+		block.data.resize (_block_size);
+		int const got = _file.read (block.data.data(), _block_size);
+		block.data.resize (got);
+		file_position = block.position + got;
+		auto const taken = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		lm.lock ();
+		_bytes_fetched += got;
+		_fetch_seconds += taken;
+		if (generation == _generation) {
+			if (got == 0) {
+				/* The files must be shorter than they were */
+				_end = block.position;
+			} else {
+				_fetch_position += got;
+				_blocks.push_back (std::move(block));
+			}
+		}
+		_condition.notify_all ();
+	}
+}
+catch (...)
+{
+	store_current ();
+	boost::mutex::scoped_lock lm (_mutex);
+	_failed = true;
+	_condition.notify_all ();
+}
+
+
+/** Read some data.
+ *  @param position Position to read from.
+ *  @param buffer Buffer to write data to.
+ *  @param amount Maximum number of bytes to read.
+ *  @return Number of bytes read, which will only be 0 at the end of the data.
+ */
+int
+ReadAhead::read (int64_t position, uint8_t* buffer, int amount)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	bool const buffered = _blocks.empty() ? position == _fetch_position : (_blocks.front().position <= position && position < _fetch_position);
+	if (!buffered) {
+		/* Start again from the new position */
+		_blocks.clear ();
+		_fetch_position = position;
+		++_generation;
+		++_restarts;
+		_condition.notify_all ();
+	}
+
+	if (!_failed && position >= _fetch_position && _fetch_position < _end) {
+		auto const start = std::chrono::steady_clock::now();
+		++_waits;
+		while (!_failed && position >= _fetch_position && _fetch_position < _end) {
+			_condition.wait (lm);
+		}
+		_wait_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	if (_failed) {
+		lm.unlock ();
+		rethrow ();
+		throw FileError (_("Could not read file"), _paths.front());
+	}
+
+	while (!_blocks.empty() && (_blocks.front().position + static_cast<int64_t>(_blocks.front().data.size())) <= position) {
+		_blocks.pop_front ();
+	}
+
+	int done = 0;
+	for (auto const& i: _blocks) {
+		if (done == amount) {
+			break;
+		}
+		auto const offset = position + done - i.position;
+		auto const this_time = static_cast<int>(min(int64_t(amount - done), static_cast<int64_t>(i.data.size()) - offset));
+		memcpy (buffer + done, i.data.data() + offset, this_time);
+		done += this_time;
+	}
+
+	/* Drop anything that has been completely read so that the thread can fetch more */
+	while (!_blocks.empty() && (_blocks.front().position + static_cast<int64_t>(_blocks.front().data.size())) <= (position + done)) {
+		_blocks.pop_front ();
+	}
+
+	_condition.notify_all ();
+	return done;
+}
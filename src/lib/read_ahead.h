@@ -0,0 +1,104 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_READ_AHEAD_H
+#define DCPOMATIC_READ_AHEAD_H
+
+
+/** @file  src/lib/read_ahead.h
+ *  @brief ReadAhead class.
+ */
+
+
+#include "exception_store.h"
+#include "file_group.h"
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <deque>
+#include <vector>
+#include <stdint.h>
+
+
+/** @class ReadAhead
+ *  @brief Reader of a group of files which fetches the data after the last read
+ *  in a background thread, in large blocks.
+ *
+ *  This means that a caller reading sequentially in small pieces (as FFmpeg does)
+ *  gets its data from memory, and the I/O overlaps with whatever the caller is
+ *  doing with the data.
+ */
+class ReadAhead : public ExceptionStore
+{
+public:
+	/** @param paths Files to read, as if they were concatenated.
+	 *  @param size Maximum number of bytes to buffer.
+	 */
+	ReadAhead (std::vector<boost::filesystem::path> paths, int64_t size);
+	~ReadAhead ();
+
+	ReadAhead (ReadAhead const&) = delete;
+	ReadAhead& operator= (ReadAhead const&) = delete;
+
+	int read (int64_t position, uint8_t* buffer, int amount);
+
+private:
+	void thread ();
+
+	struct Block
+	{
+		/** position of the first byte of data */
+		int64_t position = 0;
+		std::vector<uint8_t> data;
+	};
+
+	std::vector<boost::filesystem::path> _paths;
+	/** reader used only by the thread */
+	FileGroup _file;
+	int const _block_size;
+	size_t const _max_blocks;
+
+	/** mutex for everything below here */
+	boost::mutex _mutex;
+	boost::condition _condition;
+	/** contiguous blocks of data, ending at _fetch_position */
+	std::deque<Block> _blocks;
+	/** position of the next data that the thread will fetch */
+	int64_t _fetch_position = 0;
+	/** position of the end of the data */
+	int64_t _end;
+	/** incremented when _blocks is discarded so that the thread knows to discard what it is reading */
+	int _generation = 0;
+	bool _stop = false;
+	bool _failed = false;
+
+	/* Statistics, to see how well we are doing */
+	int64_t _bytes_fetched = 0;
+	double _fetch_seconds = 0;
+	double _wait_seconds = 0;
+	int _waits = 0;
+	int _restarts = 0;
+
+	boost::thread _thread;
+};
+
+
+#endif
@@ -28,10 +28,11 @@
 #include "film.h"
 #include "font_data.h"
 #include "image.h"
-#include "image_png.h"
 #include "job.h"
 #include "log.h"
 #include "reel_writer.h"
+#include "subtitle_image_encoder.h"
+#include "write_verifier.h"
 #include <dcp/atmos_asset.h>
 #include <dcp/atmos_asset_writer.h>
 #include <dcp/certificate_chain.h>
@@ -105,9 +106,19 @@ mxf_metadata ()
  *  @param text_only true to enable a special mode where the writer will expect only subtitles and closed captions to be written
  *  (no picture nor sound) and not give errors in that case.  This is used by the hints system to check the potential sizes of
  *  subtitle / closed caption files.
+ *  @param subtitle_image_encoder Encoder to use to make PNGs of bitmap subtitles; the caller must call
+ *  flush() with our reel index on this before create_reel().
+ *  @param verifier WriteVerifier to tell about what we write, or nullptr.
  */
 ReelWriter::ReelWriter (
-	weak_ptr<const Film> weak_film, DCPTimePeriod period, shared_ptr<Job> job, int reel_index, int reel_count, bool text_only
+	weak_ptr<const Film> weak_film,
+	DCPTimePeriod period,
+	shared_ptr<Job> job,
+	int reel_index,
+	int reel_count,
+	bool text_only,
+	shared_ptr<SubtitleImageEncoder> subtitle_image_encoder,
+	shared_ptr<WriteVerifier> verifier
 	)
 	: WeakConstFilm (weak_film)
 	, _period (period)
@@ -116,6 +127,8 @@ ReelWriter::ReelWriter (
 	, _content_summary (film()->content_summary(period))
 	, _job (job)
 	, _text_only (text_only)
+	, _subtitle_image_encoder (subtitle_image_encoder)
+	, _verifier (verifier)
 {
 	/* Create or find our picture asset in a subdirectory, named
 	   according to those film's parameters which affect the video
@@ -136,12 +149,12 @@ ReelWriter::ReelWriter (
 		   #1126.
 		*/
 		if (boost::filesystem::exists(asset) && boost::filesystem::hard_link_count(asset) > 1) {
+			std::function<void (float)> progress;
 			if (job) {
 				job->sub (_("Copying old video file"));
-				copy_in_bits (asset, asset.string() + ".tmp", bind(&Job::set_progress, job.get(), _1, false));
-			} else {
-				boost::filesystem::copy_file (asset, asset.string() + ".tmp");
+				progress = bind(&Job::set_progress, job.get(), _1, false);
 			}
+			copy_in_bits (asset, asset.string() + ".tmp", progress);
 			boost::filesystem::remove (asset);
 			boost::filesystem::rename (asset.string() + ".tmp", asset);
 		}
@@ -321,6 +334,10 @@ ReelWriter::write (shared_ptr<const Data> encoded, Frame frame, Eyes eyes)
 	auto fin = _picture_asset_writer->write (encoded->data(), encoded->size());
 	write_frame_info (frame, eyes, fin);
 	_last_written[static_cast<int>(eyes)] = encoded;
+
+	if (_verifier) {
+		_verifier->picture_frame (_reel_index, encoded);
+	}
 }
 
 
@@ -349,6 +366,10 @@ ReelWriter::fake_write (int size)
 	}
 
 	_picture_asset_writer->fake_write (size);
+
+	if (_verifier) {
+		_verifier->picture_frame_size (_reel_index, size);
+	}
 }
 
 
@@ -398,20 +419,16 @@ ReelWriter::finish (boost::filesystem::path output_dcp)
 		if (ec) {
 			LOG_WARNING_NC ("Hard-link failed; copying instead");
 			auto job = _job.lock ();
+			std::function<void (float)> progress;
 			if (job) {
 				job->sub (_("Copying video file into DCP"));
-				try {
-					copy_in_bits (video_from, video_to, bind(&Job::set_progress, job.get(), _1, false));
-				} catch (exception& e) {
-					LOG_ERROR ("Failed to copy video file from %1 to %2 (%3)", video_from.string(), video_to.string(), e.what());
-					throw FileError (e.what(), video_from);
-				}
-			} else {
-				boost::filesystem::copy_file (video_from, video_to, ec);
-				if (ec) {
-					LOG_ERROR ("Failed to copy video file from %1 to %2 (%3)", video_from.string(), video_to.string(), ec.message());
-					throw FileError (ec.message(), video_from);
-				}
+				progress = bind(&Job::set_progress, job.get(), _1, false);
+			}
+			try {
+				copy_in_bits (video_from, video_to, progress);
+			} catch (exception& e) {
+				LOG_ERROR ("Failed to copy video file from %1 to %2 (%3)", video_from.string(), video_to.string(), e.what());
+				throw FileError (e.what(), video_from);
 			}
 		}
 
@@ -538,6 +555,38 @@ maybe_add_text (
 }
 
 
+int64_t
+ReelWriter::subtitle_image_bytes () const
+{
+	/* Images which were the same share their data, so count each piece of data once */
+	set<uint8_t const*> seen;
+	int64_t bytes = 0;
+	for (auto i: _subtitle_images) {
+		auto const& png = i->png_image();
+		if (png.size() > 0 && seen.insert(png.data()).second) {
+			bytes += png.size();
+		}
+	}
+
+	return bytes;
+}
+
+
+void
+ReelWriter::release_subtitle_images ()
+{
+	/* Interop PNGs are listed in the PKL, so libdcp needs their data until the DCP's XML is written */
+	if (film()->interop()) {
+		return;
+	}
+
+	for (auto i: _subtitle_images) {
+		i->set_png_image (dcp::ArrayData());
+	}
+	_subtitle_images.clear ();
+}
+
+
 shared_ptr<dcp::ReelPictureAsset>
 ReelWriter::create_reel_picture (shared_ptr<dcp::Reel> reel, list<ReferencedReelAsset> const & refs) const
 {
@@ -650,6 +699,10 @@ ReelWriter::create_reel_text (
 		_subtitle_asset, duration, reel, refs, fonts, _default_font, film(), _period, output_dcp, _text_only
 		);
 
+	if (_subtitle_asset && _verifier) {
+		_verifier->text_asset (_subtitle_asset, TextType::OPEN_SUBTITLE);
+	}
+
 	if (subtitle) {
 		/* We have a subtitle asset that we either made or are referencing */
 		if (auto main_language = film()->subtitle_languages().first) {
@@ -681,6 +734,10 @@ ReelWriter::create_reel_text (
 			a->set_language (i.first.language.get());
 		}
 
+		if (_verifier) {
+			_verifier->text_asset (i.second, TextType::CLOSED_CAPTION);
+		}
+
 		ensure_closed_captions.erase (i.first);
 	}
 
@@ -909,15 +966,24 @@ ReelWriter::write (PlayerText subs, TextType type, optional<DCPTextTrack> track,
 	}
 
 	for (auto i: subs.bitmap) {
-		asset->add (
-			make_shared<dcp::SubtitleImage>(
-				image_as_png(i.image),
-				dcp::Time(period.from.seconds() - _period.from.seconds(), tcr),
-				dcp::Time(period.to.seconds() - _period.from.seconds(), tcr),
-				i.rectangle.x, dcp::HAlign::LEFT, i.rectangle.y, dcp::VAlign::TOP,
+		/* PNG encoding is slow, so hand it to the encoder's threads and add the subtitle when
+		   the Writer flushes this reel's images, just before our assets are written.  The asset
+		   sorts subtitles by time when writing, so it doesn't matter that these will be added
+		   after any strings.
+		*/
+		auto const in = dcp::Time(period.from.seconds() - _period.from.seconds(), tcr);
+		auto const out = dcp::Time(period.to.seconds() - _period.from.seconds(), tcr);
+		auto const rectangle = i.rectangle;
+		/* Writer never re-allocates its ReelWriters once it has made them, so it's safe to keep `this' */
+		_subtitle_image_encoder->encode (i.image, [this, asset, in, out, rectangle](dcp::ArrayData png) {
+			auto image = make_shared<dcp::SubtitleImage>(
+				png, in, out,
+				rectangle.x, dcp::HAlign::LEFT, rectangle.y, dcp::VAlign::TOP,
 				dcp::Time(), dcp::Time()
-				)
-			);
+				);
+			_subtitle_images.push_back (image);
+			asset->add (image);
+		}, _reel_index);
 	}
 }
 
@@ -36,6 +36,8 @@ class Film;
 class Job;
 class AudioBuffers;
 class InfoFileHandle;
+class SubtitleImageEncoder;
+class WriteVerifier;
 struct write_frame_info_test;
 
 namespace dcp {
@@ -48,6 +50,7 @@ namespace dcp {
 	class SoundAsset;
 	class SoundAssetWriter;
 	class SubtitleAsset;
+	class SubtitleImage;
 	class AtmosAsset;
 	class ReelAsset;
 	class Reel;
@@ -63,7 +66,9 @@ public:
 		std::shared_ptr<Job> job,
 		int reel_index,
 		int reel_count,
-		bool text_only
+		bool text_only,
+		std::shared_ptr<SubtitleImageEncoder> subtitle_image_encoder,
+		std::shared_ptr<WriteVerifier> verifier
 		);
 
 	void write (std::shared_ptr<const dcp::Data> encoded, Frame frame, Eyes eyes);
@@ -83,6 +88,13 @@ public:
 		);
 	void calculate_digests (std::function<void (float)> set_progress);
 
+	/** @return number of bytes of PNG data held by the bitmap subtitles in our text assets */
+	int64_t subtitle_image_bytes () const;
+	/** Drop the PNG data of the subtitle images in our text assets; this must only be called
+	 *  once our reel has been created and its assets written.
+	 */
+	void release_subtitle_images ();
+
 	Frame start () const;
 
 	dcpomatic::DCPTimePeriod period () const {
@@ -130,6 +142,10 @@ private:
 	boost::optional<std::string> _content_summary;
 	std::weak_ptr<Job> _job;
 	bool _text_only;
+	/** encoder for bitmap subtitles, shared with the other reels */
+	std::shared_ptr<SubtitleImageEncoder> _subtitle_image_encoder;
+	/** checker of what we write, shared with the other reels, or nullptr */
+	std::shared_ptr<WriteVerifier> _verifier;
 
 	dcp::ArrayData _default_font;
 
@@ -140,6 +156,10 @@ private:
 	std::shared_ptr<dcp::SoundAssetWriter> _sound_asset_writer;
 	std::shared_ptr<dcp::SubtitleAsset> _subtitle_asset;
 	std::map<DCPTextTrack, std::shared_ptr<dcp::SubtitleAsset>> _closed_caption_assets;
+	/** bitmap subtitles that we have added to our text assets, so that we can drop their PNG
+	 *  data once the assets are written.
+	 */
+	std::vector<std::shared_ptr<dcp::SubtitleImage>> _subtitle_images;
 	std::shared_ptr<dcp::AtmosAsset> _atmos_asset;
 	std::shared_ptr<dcp::AtmosAssetWriter> _atmos_asset_writer;
 
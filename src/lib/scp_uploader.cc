@@ -24,55 +24,199 @@
 #include "cross.h"
 #include "exceptions.h"
 #include "job.h"
+#include "scope_guard.h"
 #include "scp_uploader.h"
 #include "warnings.h"
+#include <boost/algorithm/string.hpp>
 #include <sys/stat.h>
+#include <algorithm>
+#include <cctype>
 
 #include "i18n.h"
 
 
 using std::function;
+using std::make_shared;
 using std::min;
 using std::shared_ptr;
 using std::string;
+using std::vector;
+using boost::optional;
 
 
-SCPUploader::SCPUploader (function<void (string)> set_status, function<void (float)> set_progress)
-	: Uploader (set_status, set_progress)
+/** @return A new, authenticated session with the TMS */
+static ssh_session
+open_session ()
 {
-	_session = ssh_new ();
-	if (!_session) {
+	auto session = ssh_new ();
+	if (!session) {
 		throw NetworkError (String::compose(_("SSH error [%1]"), "ssh_new"));
 	}
 
-	ssh_options_set (_session, SSH_OPTIONS_HOST, Config::instance()->tms_ip().c_str());
-	ssh_options_set (_session, SSH_OPTIONS_USER, Config::instance()->tms_user().c_str());
+	ssh_options_set (session, SSH_OPTIONS_HOST, Config::instance()->tms_ip().c_str());
+	ssh_options_set (session, SSH_OPTIONS_USER, Config::instance()->tms_user().c_str());
 	int const port = 22;
-	ssh_options_set (_session, SSH_OPTIONS_PORT, &port);
+	ssh_options_set (session, SSH_OPTIONS_PORT, &port);
 
-	int r = ssh_connect (_session);
+	int r = ssh_connect (session);
 	if (r != SSH_OK) {
-		throw NetworkError (String::compose(_("Could not connect to server %1 (%2)"), Config::instance()->tms_ip(), ssh_get_error(_session)));
+		auto const error = String::compose(_("Could not connect to server %1 (%2)"), Config::instance()->tms_ip(), ssh_get_error(session));
+		ssh_free (session);
+		throw NetworkError (error);
 	}
 
 DCPOMATIC_DISABLE_WARNINGS
-	r = ssh_is_server_known (_session);
+	r = ssh_is_server_known (session);
 	if (r == SSH_SERVER_ERROR) {
-		throw NetworkError (String::compose(_("SSH error [%1] (%2)"), "ssh_is_server_known", ssh_get_error(_session)));
+		auto const error = String::compose(_("SSH error [%1] (%2)"), "ssh_is_server_known", ssh_get_error(session));
+		ssh_disconnect (session);
+		ssh_free (session);
+		throw NetworkError (error);
 	}
 DCPOMATIC_ENABLE_WARNINGS
 
-	r = ssh_userauth_password (_session, 0, Config::instance()->tms_password().c_str ());
+	r = ssh_userauth_password (session, 0, Config::instance()->tms_password().c_str ());
 	if (r != SSH_AUTH_SUCCESS) {
-		throw NetworkError (String::compose(_("Failed to authenticate with server (%1)"), ssh_get_error(_session)));
+		auto const error = String::compose(_("Failed to authenticate with server (%1)"), ssh_get_error(session));
+		ssh_disconnect (session);
+		ssh_free (session);
+		throw NetworkError (error);
+	}
+
+	return session;
+}
+
+
+/** @class SCPConnection
+ *  @brief A connection which sends files using SCP.  SCP has no way to ask the size of
+ *  a remote file, or to append to one, so we can't resume uploads with this.
+ */
+class SCPConnection : public Uploader::Connection
+{
+public:
+	SCPConnection ()
+		: _session (open_session())
+	{
+
+	}
+
+	~SCPConnection ()
+	{
+		ssh_disconnect (_session);
+		ssh_free (_session);
+	}
+
+	SCPConnection (SCPConnection const&) = delete;
+	SCPConnection& operator= (SCPConnection const&) = delete;
+
+	optional<boost::uintmax_t> remote_size (boost::filesystem::path) override
+	{
+		return {};
+	}
+
+	/** Ask the server to hash the file with sha1sum; if it can't (because it has no shell,
+	 *  or no sha1sum) we just return none.
+	 */
+	optional<vector<uint8_t>> remote_digest (boost::filesystem::path to) override
+	{
+		auto channel = ssh_channel_new (_session);
+		if (!channel) {
+			return {};
+		}
+
+		ScopeGuard sg ([channel]() { ssh_channel_free(channel); });
+
+		if (ssh_channel_open_session(channel) != SSH_OK) {
+			return {};
+		}
+
+		/* Quote the path for the remote shell */
+		auto path = (boost::filesystem::path(Config::instance()->tms_path()) / to).generic_string();
+		boost::algorithm::replace_all (path, "'", "'\\''");
+		auto const command = String::compose("sha1sum '%1'", path);
+		if (ssh_channel_request_exec(channel, command.c_str()) != SSH_OK) {
+			return {};
+		}
+
+		string output;
+		char buffer[256];
+		int read = 0;
+		while ((read = ssh_channel_read(channel, buffer, sizeof(buffer), 0)) > 0) {
+			output.append (buffer, read);
+		}
+
+		/* We should get the digest in hex, then a space and the filename */
+		auto const hex_length = SHA1_DIGEST_SIZE * 2;
+		if (read < 0 || ssh_channel_get_exit_status(channel) != 0 || output.length() < hex_length) {
+			return {};
+		}
+
+		if (!std::all_of(output.begin(), output.begin() + hex_length, [](char c) { return isxdigit(c); })) {
+			return {};
+		}
+
+		vector<uint8_t> digest (SHA1_DIGEST_SIZE);
+		for (size_t i = 0; i < digest.size(); ++i) {
+			digest[i] = std::stoi(output.substr(i * 2, 2), nullptr, 16);
+		}
+
+		return digest;
 	}
 
+	void upload_file (Uploader::Source& source, boost::filesystem::path to) override
+	{
+		/* Use generic_string so that we get forward-slashes in the path, even on Windows */
+		auto const directory = (boost::filesystem::path(Config::instance()->tms_path()) / to.parent_path()).generic_string();
+		auto scp = ssh_scp_new (_session, SSH_SCP_WRITE, directory.c_str());
+		if (!scp) {
+			throw NetworkError (String::compose(_("SSH error [%1] (%2)"), "ssh_scp_new", ssh_get_error(_session)));
+		}
+
+		try {
+			if (ssh_scp_init(scp) != SSH_OK) {
+				throw NetworkError (String::compose(_("SSH error [%1] (%2)"), "ssh_scp_init", ssh_get_error(_session)));
+			}
+
+			if (ssh_scp_push_file(scp, to.filename().generic_string().c_str(), source.size(), S_IRUSR | S_IWUSR) != SSH_OK) {
+				throw NetworkError (String::compose(_("Could not write to remote file (%1)"), ssh_get_error(_session)));
+			}
+
+			uint8_t buffer[64 * 1024];
+			while (!source.cancelled()) {
+				auto const read = source.read (buffer, sizeof(buffer));
+				if (read == 0) {
+					break;
+				}
+				if (ssh_scp_write(scp, buffer, read) != SSH_OK) {
+					throw NetworkError (String::compose(_("Could not write to remote file (%1)"), ssh_get_error(_session)));
+				}
+			}
+		} catch (...) {
+			ssh_scp_free (scp);
+			throw;
+		}
+
+		ssh_scp_close (scp);
+		ssh_scp_free (scp);
+	}
+
+private:
+	ssh_session _session;
+};
+
+
+SCPUploader::SCPUploader (function<void (string)> set_status, function<void (float)> set_progress)
+	: Uploader (set_status, set_progress)
+{
+	/* This session is used to make directories; the files are sent using SCPConnections */
+	_session = open_session ();
+
 	_scp = ssh_scp_new (_session, SSH_SCP_WRITE | SSH_SCP_RECURSIVE, Config::instance()->tms_path().c_str());
 	if (!_scp) {
 		throw NetworkError (String::compose(_("SSH error [%1] (%2)"), "ssh_scp_new", ssh_get_error(_session)));
 	}
 
-	r = ssh_scp_init (_scp);
+	int const r = ssh_scp_init (_scp);
 	if (r != SSH_OK) {
 		throw NetworkError (String::compose(_("SSH error [%1] (%2)"), "ssh_scp_init", ssh_get_error(_session)));
 	}
@@ -90,49 +234,38 @@ SCPUploader::~SCPUploader ()
 void
 SCPUploader::create_directory (boost::filesystem::path directory)
 {
-	/* Use generic_string so that we get forward-slashes in the path, even on Windows */
-	int const r = ssh_scp_push_directory (_scp, directory.generic_string().c_str(), S_IRWXU);
-	if (r != SSH_OK) {
-		throw NetworkError (String::compose(_("Could not create remote directory %1 (%2)"), directory, ssh_get_error(_session)));
+	/* SCP works like cd: pushing a directory creates it and goes into it, and we must leave
+	   it again to get back to its parent.  Go back up to the parent that our current directory
+	   has in common with the new one, then create and go into the new one's components one by one.
+	*/
+	vector<string> target;
+	for (auto i: directory) {
+		target.push_back (i.string());
 	}
-}
-
-
-void
-SCPUploader::upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size)
-{
-	auto to_do = boost::filesystem::file_size (from);
-	/* Use generic_string so that we get forward-slashes in the path, even on Windows */
-	ssh_scp_push_file (_scp, to.generic_string().c_str(), to_do, S_IRUSR | S_IWUSR);
 
-	auto f = fopen_boost (from, "rb");
-	if (f == nullptr) {
-		throw NetworkError (String::compose(_("Could not open %1 to send"), from));
+	size_t common = 0;
+	while (common < _directory.size() && common < target.size() && _directory[common] == target[common]) {
+		++common;
 	}
 
-	boost::uintmax_t buffer_size = 64 * 1024;
-	char buffer[buffer_size];
-
-	while (to_do > 0) {
-		int const t = min (to_do, buffer_size);
-		size_t const read = fread (buffer, 1, t, f);
-		if (read != size_t (t)) {
-			fclose (f);
-			throw ReadFileError (from);
-		}
-
-		int const r = ssh_scp_write (_scp, buffer, t);
-		if (r != SSH_OK) {
-			fclose (f);
-			throw NetworkError (String::compose(_("Could not write to remote file (%1)"), ssh_get_error(_session)));
+	while (_directory.size() > common) {
+		if (ssh_scp_leave_directory(_scp) != SSH_OK) {
+			throw NetworkError (String::compose(_("SSH error [%1] (%2)"), "ssh_scp_leave_directory", ssh_get_error(_session)));
 		}
-		to_do -= t;
-		transferred += t;
+		_directory.pop_back ();
+	}
 
-		if (total_size > 0) {
-			_set_progress ((double) transferred / total_size);
+	for (auto i = target.begin() + common; i != target.end(); ++i) {
+		if (ssh_scp_push_directory(_scp, i->c_str(), S_IRWXU) != SSH_OK) {
+			throw NetworkError (String::compose(_("Could not create remote directory %1 (%2)"), directory, ssh_get_error(_session)));
 		}
+		_directory.push_back (*i);
 	}
+}
+
 
-	fclose (f);
+shared_ptr<Uploader::Connection>
+SCPUploader::connect ()
+{
+	return make_shared<SCPConnection>();
 }
@@ -31,9 +31,11 @@ public:
 
 protected:
 	virtual void create_directory (boost::filesystem::path directory) override;
-	virtual void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size) override;
+	virtual std::shared_ptr<Connection> connect () override;
 
 private:
 	ssh_session _session;
 	ssh_scp _scp;
+	/** components of the remote directory that _scp is currently in, relative to the upload root */
+	std::vector<std::string> _directory;
 };
@@ -0,0 +1,256 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/subtitle_image_encoder.cc
+ *  @brief SubtitleImageEncoder class.
+ */
+
+
+#include "cross.h"
+#include "dcpomatic_assert.h"
+#include "dcpomatic_log.h"
+#include "digester.h"
+#include "exceptions.h"
+#include "image.h"
+#include "image_png.h"
+#include "subtitle_image_encoder.h"
+#include "util.h"
+#include <boost/bind/bind.hpp>
+#include <algorithm>
+#include <cerrno>
+
+#include "i18n.h"
+
+
+using std::function;
+using std::make_pair;
+using std::make_shared;
+using std::map;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using boost::optional;
+
+
+SubtitleImageEncoder::SubtitleImageEncoder (optional<boost::filesystem::path> spool)
+	: _spool_path (spool)
+{
+
+}
+
+
+SubtitleImageEncoder::~SubtitleImageEncoder ()
+{
+	boost::this_thread::disable_interruption dis;
+
+	_work.reset ();
+	try {
+		_pool.join_all ();
+	} catch (...) {}
+	_service.stop ();
+
+	if (_spool) {
+		fclose (_spool);
+		boost::system::error_code ec;
+		boost::filesystem::remove (*_spool_path, ec);
+	}
+}
+
+
+void
+SubtitleImageEncoder::start_threads ()
+{
+	/* Most of the machine is likely to be busy with JPEG2000 encoding, so just use a few threads */
+	int const threads = std::max (2U, boost::thread::hardware_concurrency() / 4);
+
+	_work = make_shared<boost::asio::io_service::work>(_service);
+	for (int i = 0; i < threads; ++i) {
+		_pool.create_thread (boost::bind(&boost::asio::io_service::run, &_service));
+	}
+}
+
+
+static string
+image_digest (shared_ptr<const Image> image)
+{
+	Digester digester;
+	digester.add (image->pixel_format());
+	digester.add (image->size().width);
+	digester.add (image->size().height);
+	for (int i = 0; i < image->planes(); ++i) {
+		auto const lines = image->sample_size(i).height;
+		for (int y = 0; y < lines; ++y) {
+			digester.add (image->data()[i] + y * image->stride()[i], image->line_size()[i]);
+		}
+	}
+	return digester.get ();
+}
+
+
+void
+SubtitleImageEncoder::encode (shared_ptr<const Image> image, function<void (dcp::ArrayData)> handler, int group)
+{
+	/* Hashing is much quicker than PNG encoding so we do it here, which saves keeping
+	   duplicate images hanging around while they wait for a thread.
+	*/
+	auto const digest = image_digest (image);
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	auto existing = _entries.find (digest);
+	if (existing != _entries.end()) {
+		++_duplicates;
+		_handlers.push_back ({existing->second, handler, group});
+		return;
+	}
+
+	if (!_work) {
+		start_threads ();
+	}
+
+	auto entry = make_shared<Entry>();
+	_entries[digest] = entry;
+	_handlers.push_back ({entry, handler, group});
+	++_pending;
+	_service.post (boost::bind(&SubtitleImageEncoder::encode_thread, this, image, entry));
+}
+
+
+void
+SubtitleImageEncoder::encode_thread (shared_ptr<const Image> image, shared_ptr<Entry> entry)
+try
+{
+	auto png = image_as_png (image);
+
+	optional<int64_t> offset;
+	if (_spool_path) {
+		boost::mutex::scoped_lock lm (_spool_mutex);
+		if (!_spool) {
+			_spool = fopen_boost (*_spool_path, "w+b");
+			if (!_spool) {
+				throw OpenFileError (*_spool_path, errno, OpenFileError::WRITE);
+			}
+		}
+		dcpomatic_fseek (_spool, _spool_size, SEEK_SET);
+		if (fwrite (png.data(), 1, png.size(), _spool) != static_cast<size_t>(png.size())) {
+			throw WriteFileError (*_spool_path, errno);
+		}
+		offset = _spool_size;
+		_spool_size += png.size();
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	if (offset) {
+		entry->offset = offset;
+		_bytes_spooled += png.size();
+	} else {
+		entry->png = png;
+		_bytes_in_memory += png.size();
+	}
+	entry->size = png.size();
+	++_encoded;
+	--_pending;
+	_done.notify_all ();
+}
+catch (...)
+{
+	store_current ();
+	boost::mutex::scoped_lock lm (_mutex);
+	--_pending;
+	_done.notify_all ();
+}
+
+
+dcp::ArrayData
+SubtitleImageEncoder::read_spool (Entry const& entry)
+{
+	boost::mutex::scoped_lock lm (_spool_mutex);
+	DCPOMATIC_ASSERT (_spool);
+	dcp::ArrayData png (entry.size);
+	dcpomatic_fseek (_spool, *entry.offset, SEEK_SET);
+	checked_fread (png.data(), entry.size, _spool, *_spool_path);
+	return png;
+}
+
+
+void
+SubtitleImageEncoder::flush (optional<int> group)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	while (_pending > 0) {
+		_done.wait (lm);
+	}
+
+	rethrow ();
+
+	if (!_handlers.empty()) {
+		LOG_GENERAL (
+			"Encoded %1 subtitle images as PNG; %2 were duplicates; %3 bytes in memory, %4 bytes spooled",
+			_encoded, _duplicates, _bytes_in_memory, _bytes_spooled
+			);
+	}
+
+	vector<Handler> handlers;
+	vector<Handler> keep;
+	for (auto const& i: _handlers) {
+		if (!group || i.group == *group) {
+			handlers.push_back (i);
+		} else {
+			keep.push_back (i);
+		}
+	}
+	_handlers = keep;
+	lm.unlock ();
+
+	/* Data that we have read back from the spool, so that duplicates can share it as they
+	   would if it had stayed in memory.
+	*/
+	map<Entry*, dcp::ArrayData> spooled;
+
+	for (auto const& i: handlers) {
+		if (i.entry->png) {
+			i.handler (*i.entry->png);
+		} else {
+			DCPOMATIC_ASSERT (i.entry->offset);
+			auto data = spooled.find (i.entry.get());
+			if (data == spooled.end()) {
+				data = spooled.insert(make_pair(i.entry.get(), read_spool(*i.entry))).first;
+			}
+			i.handler (data->second);
+		}
+	}
+}
+
+
+int64_t
+SubtitleImageEncoder::bytes_in_memory () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _bytes_in_memory;
+}
+
+
+int64_t
+SubtitleImageEncoder::bytes_spooled () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _bytes_spooled;
+}
@@ -0,0 +1,140 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_SUBTITLE_IMAGE_ENCODER_H
+#define DCPOMATIC_SUBTITLE_IMAGE_ENCODER_H
+
+
+/** @file  src/lib/subtitle_image_encoder.h
+ *  @brief SubtitleImageEncoder class.
+ */
+
+
+#include "exception_store.h"
+#include <dcp/array_data.h>
+#include <boost/asio.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+class Image;
+
+
+/** @class SubtitleImageEncoder
+ *  @brief Encoder of bitmap subtitle images to PNG using a pool of threads.
+ *
+ *  Bitmap subtitles (e.g. from PGS or DVB) often show the same image many times,
+ *  so each image is PNG-encoded only once and the resulting data is shared
+ *  between all the subtitles that use it.
+ *
+ *  If a spool file is given, the PNGs are written to it as soon as they are
+ *  encoded and read back when they are needed, so that a long film with lots of
+ *  bitmap subtitles does not need to keep them all in memory.
+ */
+class SubtitleImageEncoder : public ExceptionStore
+{
+public:
+	/** @param spool File to keep PNG data in until it is needed, or none to keep it in memory.
+	 *  The file will be created if needed, and deleted when we are destroyed.
+	 */
+	explicit SubtitleImageEncoder (boost::optional<boost::filesystem::path> spool = boost::none);
+	~SubtitleImageEncoder ();
+
+	SubtitleImageEncoder (SubtitleImageEncoder const&) = delete;
+	SubtitleImageEncoder& operator= (SubtitleImageEncoder const&) = delete;
+
+	/** Start encoding an image.
+	 *  @param image Image to encode.
+	 *  @param handler Handler to be called with the PNG data; this will be called from flush().
+	 *  @param group Group that this handler belongs to, so that it can be flushed separately from the others.
+	 */
+	void encode (std::shared_ptr<const Image> image, std::function<void (dcp::ArrayData)> handler, int group = 0);
+
+	/** Wait for all encoding to finish then call the handlers which were passed to encode(),
+	 *  in the order that they were passed, from the calling thread.
+	 *  @param group Group of handlers to call, or none to call them all.
+	 */
+	void flush (boost::optional<int> group = boost::none);
+
+	/** @return number of bytes of PNG data that we are holding in memory */
+	int64_t bytes_in_memory () const;
+	/** @return number of bytes of PNG data that we have written to our spool file */
+	int64_t bytes_spooled () const;
+
+private:
+	struct Entry
+	{
+		/** PNG data, if we are holding it in memory */
+		boost::optional<dcp::ArrayData> png;
+		/** offset of the PNG data in the spool file, if it is there */
+		boost::optional<int64_t> offset;
+		int size = 0;
+	};
+
+	struct Handler
+	{
+		std::shared_ptr<Entry> entry;
+		std::function<void (dcp::ArrayData)> handler;
+		int group;
+	};
+
+	void start_threads ();
+	void encode_thread (std::shared_ptr<const Image> image, std::shared_ptr<Entry> entry);
+	dcp::ArrayData read_spool (Entry const& entry);
+
+	boost::thread_group _pool;
+	boost::asio::io_service _service;
+	std::shared_ptr<boost::asio::io_service::work> _work;
+
+	boost::optional<boost::filesystem::path> _spool_path;
+	/** mutex for _spool and _spool_size */
+	boost::mutex _spool_mutex;
+	FILE* _spool = nullptr;
+	int64_t _spool_size = 0;
+
+	/** mutex for everything below here */
+	mutable boost::mutex _mutex;
+	/** condition which is signalled when an encode finishes */
+	boost::condition _done;
+	/** images that we have seen, keyed by digest */
+	std::map<std::string, std::shared_ptr<Entry>> _entries;
+	/** handlers to call in flush(), in the order that encode() was called */
+	std::vector<Handler> _handlers;
+	/** number of encodes that have been posted but have not finished */
+	int _pending = 0;
+	/** number of images that have been encoded */
+	int _encoded = 0;
+	/** number of images that were the same as one we had already seen */
+	int _duplicates = 0;
+	int64_t _bytes_in_memory = 0;
+	int64_t _bytes_spooled = 0;
+};
+
+
+#endif
@@ -0,0 +1,250 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/trace.cc
+ *  @brief Trace class.
+ */
+
+
+#include "dcpomatic_assert.h"
+#include "trace.h"
+#include <boost/filesystem/fstream.hpp>
+#include <algorithm>
+
+#include "i18n.h"
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+
+/** Maximum number of events that we will keep for each thread (about 8MB) */
+static size_t const max_events_per_thread = 262144;
+
+/** Session that events from this thread are recorded in, or 0 */
+static thread_local int current_session = 0;
+
+
+Trace::Trace ()
+	: _enabled (false)
+	, _epoch (std::chrono::steady_clock::now())
+{
+
+}
+
+
+Trace*
+Trace::instance ()
+{
+	/* Initialisation of a static local is thread-safe, so after the first call this is just
+	   a load.  The Trace is never deleted so that threads can still use it during exit.
+	*/
+	static auto instance = new Trace ();
+	return instance;
+}
+
+
+void
+Trace::set_thread_session (int session)
+{
+	current_session = session;
+}
+
+
+int
+Trace::thread_session ()
+{
+	return current_session;
+}
+
+
+int64_t
+Trace::now () const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _epoch).count();
+}
+
+
+/** Caller must hold a lock on _buffers_mutex */
+void
+Trace::clear_buffers ()
+{
+	for (auto i: _buffers) {
+		boost::mutex::scoped_lock blm (i->mutex);
+		i->events.clear ();
+		i->events.shrink_to_fit ();
+		i->dropped.clear ();
+		i->dropped_open = 0;
+	}
+}
+
+
+int
+Trace::start ()
+{
+	boost::mutex::scoped_lock lm (_buffers_mutex);
+	if (_sessions++ == 0) {
+		/* Nobody else is recording, so we can throw away anything left over */
+		clear_buffers ();
+		_enabled = true;
+	}
+
+	auto const session = _next_session++;
+	set_thread_session (session);
+	return session;
+}
+
+
+Trace::ThreadBuffer*
+Trace::thread_buffer ()
+{
+	/* A shared_ptr rather than a raw pointer so that a buffer lives on in _buffers
+	   after its thread has gone.
+	*/
+	thread_local shared_ptr<ThreadBuffer> buffer;
+	if (!buffer) {
+		boost::mutex::scoped_lock lm (_buffers_mutex);
+		buffer = make_shared<ThreadBuffer>(static_cast<int>(_buffers.size()) + 1);
+		_buffers.push_back (buffer);
+	}
+
+	return buffer.get();
+}
+
+
+void
+Trace::add (char const* name, char phase, int64_t value)
+{
+	auto const session = current_session;
+	if (!_enabled || session == 0) {
+		return;
+	}
+
+	auto const time = now ();
+	auto buffer = thread_buffer ();
+	boost::mutex::scoped_lock lm (buffer->mutex);
+
+	if (buffer->events.size() >= max_events_per_thread) {
+		/* We're full, but still record the ends of spans whose beginnings we have
+		   so that the spans in the output are balanced.  There can only be as many
+		   of those as there are nested TRACE_SCOPEs.
+		*/
+		if (phase == 'E' && buffer->dropped_open == 0) {
+			buffer->events.push_back (Event(session, name, phase, time, value));
+		} else {
+			if (phase == 'B') {
+				++buffer->dropped_open;
+			} else if (phase == 'E') {
+				--buffer->dropped_open;
+			}
+			++buffer->dropped[session];
+		}
+		return;
+	}
+
+	buffer->events.push_back (Event(session, name, phase, time, value));
+}
+
+
+void
+Trace::begin (char const* name)
+{
+	add (name, 'B', 0);
+}
+
+
+void
+Trace::end (char const* name)
+{
+	add (name, 'E', 0);
+}
+
+
+void
+Trace::counter (char const* name, int64_t value)
+{
+	add (name, 'C', value);
+}
+
+
+void
+Trace::stop (int session, boost::filesystem::path output)
+{
+	boost::mutex::scoped_lock lm (_buffers_mutex);
+
+	DCPOMATIC_ASSERT (_sessions > 0);
+	bool const last = --_sessions == 0;
+	if (last) {
+		_enabled = false;
+	}
+
+	boost::filesystem::ofstream f (output);
+	if (f.good()) {
+		f << "{\"traceEvents\":[\n";
+
+		bool first = true;
+		int64_t dropped = 0;
+		for (auto buffer: _buffers) {
+			boost::mutex::scoped_lock blm (buffer->mutex);
+			for (auto const& event: buffer->events) {
+				if (event.session != session) {
+					continue;
+				}
+				if (!first) {
+					f << ",\n";
+				}
+				first = false;
+				f << "{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase << "\",\"ts\":" << event.time
+				  << ",\"pid\":1,\"tid\":" << buffer->id;
+				if (event.phase == 'C') {
+					f << ",\"args\":{\"value\":" << event.value << "}";
+				}
+				f << "}";
+			}
+			auto i = buffer->dropped.find (session);
+			if (i != buffer->dropped.end()) {
+				dropped += i->second;
+			}
+		}
+
+		f << "\n],\"otherData\":{\"dropped_events\":" << dropped << "}}\n";
+	}
+
+	if (last) {
+		clear_buffers ();
+	} else {
+		/* Other sessions are still recording, so just forget about this one's events */
+		for (auto buffer: _buffers) {
+			boost::mutex::scoped_lock blm (buffer->mutex);
+			auto& events = buffer->events;
+			events.erase (
+				std::remove_if(events.begin(), events.end(), [session](Event const& e) { return e.session == session; }),
+				events.end()
+				);
+			buffer->dropped.erase (session);
+		}
+	}
+
+	if (current_session == session) {
+		set_thread_session (0);
+	}
+}
@@ -0,0 +1,191 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_TRACE_H
+#define DCPOMATIC_TRACE_H
+
+
+/** @file  src/lib/trace.h
+ *  @brief Trace class and TRACE_* macros.
+ */
+
+
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+
+/** @class Trace
+ *  @brief Low-overhead recorder of spans and counters from the encode path.
+ *
+ *  Each thread records events into its own buffer, so recording an event
+ *  does not contend with other threads.  When tracing is stopped the events
+ *  are written out in the Chrome trace event format, which can be loaded
+ *  into chrome://tracing or ui.perfetto.dev.
+ *
+ *  Several callers (e.g. transcode jobs) may be tracing at the same time.
+ *  Each start() opens a session, and events are only recorded by threads
+ *  which have been put into a session (with set_thread_session()); stop()
+ *  writes out the events of one session, and recording stops when the last
+ *  session is stopped.
+ *
+ *  The TRACE_* macros compile to nothing unless DCPOMATIC_TRACE is defined
+ *  (configure with --enable-trace).  Spans are only recorded by TRACE_SCOPE
+ *  so that they are closed even if an exception is thrown.
+ */
+class Trace
+{
+public:
+	Trace (Trace const&) = delete;
+	Trace& operator= (Trace const&) = delete;
+
+	/** Start a session, and start recording if we are not already.  The calling
+	 *  thread is put into the new session.
+	 *  @return Session ID to pass to set_thread_session() and stop().
+	 */
+	int start ();
+	/** Write the events recorded in a session to a Chrome trace JSON file, and
+	 *  stop recording if no other session is still open.
+	 *  @param session Session ID returned from start().
+	 */
+	void stop (int session, boost::filesystem::path output);
+
+	/** Put the calling thread into a session, so that its events are recorded there.
+	 *  @param session Session ID, or 0 to record nothing from this thread.
+	 */
+	static void set_thread_session (int session);
+	/** @return Session ID of the calling thread, or 0 */
+	static int thread_session ();
+
+	bool enabled () const {
+		return _enabled;
+	}
+
+	/* These take names which must be string literals (or otherwise live
+	 * for the life of the program) since only the pointer is stored.
+	 * begin() and end() should be used via TraceScope.
+	 */
+	void begin (char const* name);
+	void end (char const* name);
+	void counter (char const* name, int64_t value);
+
+	static Trace* instance ();
+
+private:
+	Trace ();
+
+	struct Event
+	{
+		Event (int session_, char const* name_, char phase_, int64_t time_, int64_t value_)
+			: session (session_)
+			, name (name_)
+			, phase (phase_)
+			, time (time_)
+			, value (value_)
+		{}
+
+		int session;
+		char const* name;
+		/** B for begin, E for end or C for counter, as in the Chrome format */
+		char phase;
+		/** microseconds since the Trace was created */
+		int64_t time;
+		/** value for a counter */
+		int64_t value;
+	};
+
+	struct ThreadBuffer
+	{
+		explicit ThreadBuffer (int id_)
+			: id (id_)
+		{}
+
+		/** Only contended when the trace is started or stopped */
+		boost::mutex mutex;
+		int id;
+		std::vector<Event> events;
+		/** number of events not recorded because events was full, indexed by session ID */
+		std::map<int, int64_t> dropped;
+		/** number of spans whose begin was dropped and whose end has not yet been seen */
+		int dropped_open = 0;
+	};
+
+	void add (char const* name, char phase, int64_t value);
+	ThreadBuffer* thread_buffer ();
+	int64_t now () const;
+	void clear_buffers ();
+
+	std::atomic<bool> _enabled;
+	/** time which event times are relative to */
+	std::chrono::steady_clock::time_point const _epoch;
+
+	/** mutex for _buffers, _sessions and _next_session */
+	boost::mutex _buffers_mutex;
+	/** number of start() calls which have not yet been matched with stop() */
+	int _sessions = 0;
+	int _next_session = 1;
+	/** buffers for every thread which has ever recorded anything; these are kept
+	 *  after their threads finish so that we don't lose their events.
+	 */
+	std::vector<std::shared_ptr<ThreadBuffer>> _buffers;
+};
+
+
+/** Record the span of the enclosing scope */
+class TraceScope
+{
+public:
+	explicit TraceScope (char const* name)
+		: _name (name)
+	{
+		Trace::instance()->begin (_name);
+	}
+
+	~TraceScope ()
+	{
+		Trace::instance()->end (_name);
+	}
+
+	TraceScope (TraceScope const&) = delete;
+	TraceScope& operator= (TraceScope const&) = delete;
+
+private:
+	char const* _name;
+};
+
+
+#ifdef DCPOMATIC_TRACE
+#define TRACE_COUNTER(name, value) Trace::instance()->counter(name, value)
+#define TRACE_SCOPE_CAT2(a, b) a##b
+#define TRACE_SCOPE_CAT(a, b) TRACE_SCOPE_CAT2(a, b)
+#define TRACE_SCOPE(name)          TraceScope TRACE_SCOPE_CAT(trace_scope_, __LINE__) (name)
+#else
+#define TRACE_COUNTER(name, value)
+#define TRACE_SCOPE(name)
+#endif
+
+
+#endif
@@ -35,6 +35,8 @@
 #include "film.h"
 #include "job_manager.h"
 #include "log.h"
+#include "scope_guard.h"
+#include "trace.h"
 #include "transcode_job.h"
 #include "upload_job.h"
 #include <iomanip>
@@ -124,7 +126,15 @@ TranscodeJob::run ()
 		LOG_GENERAL_NC (N_("Transcode job starting"));
 
 		DCPOMATIC_ASSERT (_encoder);
-		_encoder->go ();
+		{
+#ifdef DCPOMATIC_TRACE
+			auto const trace_session = Trace::instance()->start ();
+			ScopeGuard sg ([this, trace_session]() {
+				Trace::instance()->stop (trace_session, _film->file("trace.json"));
+			});
+#endif
+			_encoder->go ();
+		}
 
 		struct timeval finish;
 		gettimeofday (&finish, 0);
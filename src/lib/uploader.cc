@@ -20,64 +20,327 @@
 
 
 #include "compose.hpp"
+#include "config.h"
+#include "cross.h"
 #include "dcpomatic_assert.h"
+#include "dcpomatic_log.h"
+#include "exceptions.h"
 #include "uploader.h"
+#include <dcp/asset.h>
+#include <dcp/dcp.h>
+#include <dcp/exceptions.h>
+#include <dcp/pkl.h>
+#include <dcp/util.h>
+#include <boost/bind/bind.hpp>
+#include <algorithm>
+#include <cerrno>
 
 #include "i18n.h"
 
 
 using std::function;
+using std::make_shared;
+using std::max;
+using std::min;
 using std::shared_ptr;
 using std::string;
+using std::vector;
+using boost::optional;
 
 
 Uploader::Uploader (function<void (string)> set_status, function<void (float)> set_progress)
 	: _set_progress (set_progress)
 	, _set_status (set_status)
+	, _transferred (0)
+	, _cancelled (false)
 {
 	_set_status (_("connecting"));
 }
 
 
-boost::uintmax_t
-Uploader::count_file_sizes (boost::filesystem::path directory) const
+Uploader::Source::Source (Uploader* uploader, boost::filesystem::path file, boost::uintmax_t offset)
+	: _uploader (uploader)
+	, _path (file)
+	, _offset (offset)
 {
-	using namespace boost::filesystem;
+	_file = fopen_boost (file, "rb");
+	if (!_file) {
+		throw OpenFileError (file, errno, OpenFileError::READ);
+	}
 
-	boost::uintmax_t size = 0;
+	auto const total = boost::filesystem::file_size (file);
+	DCPOMATIC_ASSERT (offset <= total);
+	_size = total - offset;
 
-	for (auto i: directory_iterator(directory)) {
-		if (is_directory (i.path())) {
-			size += count_file_sizes (i.path());
-		} else {
-			size += file_size (i);
+	/* Hash the part of the file that the server already has */
+	sha1_init (&_sha1);
+	uint8_t buffer[65536];
+	auto to_do = offset;
+	while (to_do > 0) {
+		auto const this_time = min (to_do, static_cast<boost::uintmax_t>(sizeof(buffer)));
+		if (fread(buffer, 1, this_time, _file) != this_time) {
+			fclose (_file);
+			throw ReadFileError (file);
 		}
+		sha1_update (&_sha1, this_time, buffer);
+		to_do -= this_time;
 	}
+}
 
-	return size;
+
+Uploader::Source::~Source ()
+{
+	fclose (_file);
 }
 
 
-void
-Uploader::upload (boost::filesystem::path directory)
+size_t
+Uploader::Source::read (uint8_t* buffer, size_t size)
+{
+	auto const this_time = min (static_cast<boost::uintmax_t>(size), _size - _sent);
+	if (this_time == 0) {
+		return 0;
+	}
+
+	if (fread(buffer, 1, this_time, _file) != this_time) {
+		throw ReadFileError (_path);
+	}
+
+	sha1_update (&_sha1, this_time, buffer);
+	_sent += this_time;
+	_uploader->_transferred += this_time;
+	return this_time;
+}
+
+
+bool
+Uploader::Source::cancelled () const
+{
+	return _uploader->_cancelled;
+}
+
+
+vector<uint8_t>
+Uploader::Source::digest ()
 {
-	boost::uintmax_t transferred = 0;
-	upload_directory (directory.parent_path(), directory, transferred, count_file_sizes(directory));
+	DCPOMATIC_ASSERT (_sent == _size);
+	vector<uint8_t> digest (SHA1_DIGEST_SIZE);
+	sha1_digest (&_sha1, digest.size(), digest.data());
+	return digest;
 }
 
 
 void
-Uploader::upload_directory (boost::filesystem::path base, boost::filesystem::path directory, boost::uintmax_t& transferred, boost::uintmax_t total_size)
+Uploader::find_files (boost::filesystem::path base, boost::filesystem::path directory, vector<boost::filesystem::path>& directories)
 {
 	using namespace boost::filesystem;
 
-	create_directory (remove_prefix(base, directory));
+	directories.push_back (remove_prefix(base, directory));
 	for (auto i: directory_iterator(directory)) {
 		if (is_directory(i.path())) {
-			upload_directory (base, i.path(), transferred, total_size);
+			find_files (base, i.path(), directories);
 		} else {
-			_set_status (String::compose(_("copying %1"), i.path().leaf()));
-			upload_file (i.path(), remove_prefix (base, i.path()), transferred, total_size);
+			_files.push_back ({i.path(), remove_prefix(base, i.path()), file_size(i.path())});
+		}
+	}
+}
+
+
+void
+Uploader::read_pkl_hashes (boost::filesystem::path directory)
+{
+	try {
+		dcp::DCP dcp (directory);
+		dcp.read ();
+		for (auto pkl: dcp.pkls()) {
+			for (auto asset: dcp.assets()) {
+				auto hash = pkl->hash (asset->id());
+				if (!hash || !asset->file()) {
+					continue;
+				}
+				vector<uint8_t> digest (SHA1_DIGEST_SIZE);
+				if (dcp::base64_decode(*hash, digest.data(), digest.size()) == SHA1_DIGEST_SIZE) {
+					_pkl_hashes[boost::filesystem::canonical(*asset->file())] = digest;
+				}
+			}
+		}
+	} catch (std::exception& e) {
+		LOG_WARNING ("Could not read PKL hashes from %1 so uploaded files will not be checked (%2)", directory.string(), e.what());
+	}
+}
+
+
+void
+Uploader::upload (boost::filesystem::path directory)
+{
+	read_pkl_hashes (directory);
+
+	vector<boost::filesystem::path> directories;
+	find_files (directory.parent_path(), directory, directories);
+
+	for (auto i: directories) {
+		create_directory (i);
+	}
+
+	boost::uintmax_t total_size = 0;
+	for (auto const& i: _files) {
+		total_size += i.size;
+	}
+
+	/* Threads take files from the back of _files; send the biggest files first so that
+	   we don't end up waiting for one big file at the end.
+	*/
+	std::sort (_files.begin(), _files.end(), [](File const& a, File const& b) {
+		return a.size < b.size;
+	});
+
+	auto const threads = max (1, min(Config::instance()->tms_connections(), static_cast<int>(_files.size())));
+	LOG_GENERAL ("Uploading %1 files (%2 bytes) using %3 connection(s)", _files.size(), total_size, threads);
+
+	_running = threads;
+	boost::thread_group pool;
+	for (int i = 0; i < threads; ++i) {
+		pool.create_thread (boost::bind(&Uploader::upload_thread, this));
+	}
+
+	try {
+		string last_status;
+		boost::mutex::scoped_lock lm (_mutex);
+		while (_running > 0) {
+			_condition.timed_wait (lm, boost::posix_time::milliseconds(250));
+			auto const status = _current;
+			lm.unlock ();
+			if (!status.empty() && status != last_status) {
+				_set_status (String::compose(_("copying %1"), status));
+				last_status = status;
+			}
+			if (total_size > 0) {
+				_set_progress (static_cast<double>(_transferred) / total_size);
+			}
+			lm.lock ();
+		}
+	} catch (...) {
+		/* Most likely we have been interrupted (the job was cancelled) */
+		_cancelled = true;
+		pool.join_all ();
+		throw;
+	}
+
+	pool.join_all ();
+	rethrow ();
+}
+
+
+void
+Uploader::upload_thread ()
+try
+{
+	shared_ptr<Connection> connection;
+
+	while (!_cancelled) {
+		File file;
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			if (_files.empty()) {
+				break;
+			}
+			file = _files.back ();
+			_files.pop_back ();
+			_current = file.from.filename().string();
+		}
+
+		upload_file (connection, file);
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	--_running;
+	_condition.notify_all ();
+}
+catch (...)
+{
+	store_current ();
+	/* Stop the other threads too, since we have failed */
+	_cancelled = true;
+	boost::mutex::scoped_lock lm (_mutex);
+	--_running;
+	_condition.notify_all ();
+}
+
+
+/** Send one file, making as many attempts as seem reasonable.  connection may be replaced by a new one
+ *  if it is null or has failed.
+ */
+void
+Uploader::upload_file (shared_ptr<Connection>& connection, File const& file)
+{
+	int const attempts = 4;
+	/* true to send the whole file again, ignoring whatever the server has */
+	bool from_scratch = false;
+
+	for (int attempt = 1; attempt <= attempts; ++attempt) {
+		boost::uintmax_t offset = 0;
+		std::unique_ptr<Source> source;
+		try {
+			if (!connection) {
+				connection = connect ();
+			}
+
+			auto const remote = connection->remote_size (file.to);
+			if (remote && *remote <= file.size && !from_scratch) {
+				/* Carry on from wherever the server got to last time */
+				offset = *remote;
+			}
+
+			_transferred += offset;
+
+			source.reset (new Source(this, file.from, offset));
+			/* Send the file unless the server already has all of it (sending it if it's empty, so that it
+			   gets created).
+			*/
+			if (source->size() > 0 || offset == 0) {
+				connection->upload_file (*source, file.to);
+			}
+
+			if (_cancelled) {
+				return;
+			}
+
+			if (source->sent() != source->size()) {
+				throw NetworkError (String::compose(_("Could not send all of %1"), file.from.filename().string()));
+			}
+
+			auto const after = connection->remote_size (file.to);
+			if (after && *after != file.size) {
+				throw NetworkError (
+					String::compose(_("%1 has the wrong size on the server (%2 rather than %3 bytes)"), file.from.filename().string(), *after, file.size)
+					);
+			}
+
+			auto hash = _pkl_hashes.find (boost::filesystem::canonical(file.from));
+			if (hash != _pkl_hashes.end()) {
+				/* This checks what we read from the local file... */
+				if (hash->second != source->digest()) {
+					throw FileError (_("File does not match the hash in the DCP's packing list"), file.from);
+				}
+				/* ...and this what ended up on the server, if the connection can tell us */
+				auto const remote_digest = connection->remote_digest (file.to);
+				if (remote_digest && *remote_digest != hash->second) {
+					from_scratch = true;
+					throw NetworkError (String::compose(_("%1 was damaged on its way to the server"), file.from.filename().string()));
+				}
+			}
+
+			return;
+		} catch (NetworkError& e) {
+			/* Forget about this attempt's progress; the next attempt will count whatever
+			   the server ended up with.
+			*/
+			_transferred -= offset + (source ? source->sent() : 0);
+			connection.reset ();
+			if (attempt == attempts || _cancelled) {
+				throw;
+			}
+			LOG_WARNING ("Upload of %1 failed (%2); trying again", file.from.string(), e.what());
 		}
 	}
 }
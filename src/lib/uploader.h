@@ -23,33 +23,171 @@
 #define DCPOMATIC_UPLOADER_H
 
 
+#include "exception_store.h"
+#include <nettle/sha1.h>
 #include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
 
 
 class Job;
 
 
-class Uploader
+/** @class Uploader
+ *  @brief Parent for classes which copy a DCP directory to a remote server.
+ *
+ *  Files are sent in parallel over several connections (see Config::tms_connections()).
+ *  If the server can tell us how much of a file it already has we carry on from there,
+ *  so an upload which is interrupted can be resumed by running it again.  Files are hashed
+ *  as they are read and checked against the hashes in the DCP's PKL(s).  The copy on the
+ *  server is then checked by its size and, if the connection can hash remote files (see
+ *  Connection::remote_digest), by its hash.
+ */
+class Uploader : public ExceptionStore
 {
 public:
 	Uploader (std::function<void (std::string)> set_status, std::function<void (float)> set_progress);
 	virtual ~Uploader () {}
 
+	/** Upload a directory.  set_status and set_progress will only be called from the thread
+	 *  which calls this method.
+	 */
 	void upload (boost::filesystem::path directory);
 
-protected:
+	class Source;
+
+	/** @class Connection
+	 *  @brief A connection to the server, over which we can send one file at a time.
+	 */
+	class Connection
+	{
+	public:
+		virtual ~Connection () {}
+
+		/** @param to Remote path, relative to the upload root.
+		 *  @return Size of the remote file in bytes (0 if it does not exist), or none if this
+		 *  connection cannot find out.
+		 */
+		virtual boost::optional<boost::uintmax_t> remote_size (boost::filesystem::path to) = 0;
+
+		/** @return Raw SHA-1 digest of a remote file (whose path is relative to the upload root),
+		 *  or none if this connection cannot find out.
+		 */
+		virtual boost::optional<std::vector<uint8_t>> remote_digest (boost::filesystem::path) {
+			return {};
+		}
+
+		/** Send some data to a remote file.  If source.offset() is non-zero the data should be appended
+		 *  to the remote file, otherwise the remote file should be created or truncated.  This method
+		 *  may be called from any thread.
+		 *  @param to Remote path, relative to the upload root.
+		 */
+		virtual void upload_file (Source& source, boost::filesystem::path to) = 0;
+	};
+
+	/** @class Source
+	 *  @brief Source of the data for one attempt at sending one file; it counts the data
+	 *  for progress reporting and hashes it as it goes.
+	 */
+	class Source
+	{
+	public:
+		Source (Uploader* uploader, boost::filesystem::path file, boost::uintmax_t offset);
+		~Source ();
+
+		Source (Source const&) = delete;
+		Source& operator= (Source const&) = delete;
+
+		/** @return the local file that we are reading */
+		boost::filesystem::path file () const {
+			return _path;
+		}
+
+		/** @return offset in the file that the data starts at */
+		boost::uintmax_t offset () const {
+			return _offset;
+		}
+
+		/** @return number of bytes that will come from read() in total */
+		boost::uintmax_t size () const {
+			return _size;
+		}
+
+		/** @return number of bytes that have come from read() so far */
+		boost::uintmax_t sent () const {
+			return _sent;
+		}
+
+		/** Read some data, or 0 at the end of the file */
+		size_t read (uint8_t* buffer, size_t size);
+		/** @return true if the upload has been cancelled, in which case the connection should give up
+		 *  as soon as it can.
+		 */
+		bool cancelled () const;
+
+		/** @return SHA-1 digest of the whole file, if it has all been read */
+		std::vector<uint8_t> digest ();
+
+	private:
+		Uploader* _uploader;
+		boost::filesystem::path _path;
+		FILE* _file = nullptr;
+		boost::uintmax_t _offset;
+		boost::uintmax_t _size;
+		boost::uintmax_t _sent = 0;
+		sha1_ctx _sha1;
+	};
 
+protected:
+	/** Create a directory on the server; this is called for each directory in turn,
+	 *  parents first, before any files are sent.
+	 *  @param directory Remote path, relative to the upload root.
+	 */
 	virtual void create_directory (boost::filesystem::path directory) = 0;
-	virtual void upload_file (boost::filesystem::path from, boost::filesystem::path to, boost::uintmax_t& transferred, boost::uintmax_t total_size) = 0;
+	/** @return A new connection to the server; this may be called from any thread */
+	virtual std::shared_ptr<Connection> connect () = 0;
 
 	std::function<void (float)> _set_progress;
 
 private:
-	void upload_directory (boost::filesystem::path base, boost::filesystem::path directory, boost::uintmax_t& transferred, boost::uintmax_t total_size);
-	boost::uintmax_t count_file_sizes (boost::filesystem::path) const;
+	struct File
+	{
+		boost::filesystem::path from;
+		boost::filesystem::path to;
+		boost::uintmax_t size;
+	};
+
+	void find_files (boost::filesystem::path base, boost::filesystem::path directory, std::vector<boost::filesystem::path>& directories);
+	void read_pkl_hashes (boost::filesystem::path directory);
+	void upload_thread ();
+	void upload_file (std::shared_ptr<Connection>& connection, File const& file);
 	boost::filesystem::path remove_prefix (boost::filesystem::path prefix, boost::filesystem::path target) const;
 
 	std::function<void (std::string)> _set_status;
+
+	/** raw SHA-1 digests from the PKL(s), keyed by canonical local path */
+	std::map<boost::filesystem::path, std::vector<uint8_t>> _pkl_hashes;
+
+	/** mutex for _files, _current, _running */
+	boost::mutex _mutex;
+	/** condition to signal when an upload thread finishes */
+	boost::condition _condition;
+	/** files still to be sent */
+	std::vector<File> _files;
+	/** name of the most recent file that an upload thread started on */
+	std::string _current;
+	/** number of upload threads still running */
+	int _running = 0;
+
+	/** total number of bytes which have got to the server */
+	std::atomic<boost::uintmax_t> _transferred;
+	std::atomic<bool> _cancelled;
 };
 
+
 #endif
@@ -1088,10 +1088,17 @@ show_jobs_on_console (bool progress)
 }
 
 
-/** XXX: could use mmap? */
+/** Copy a file, overwriting any existing file at to.  Where the filesystem allows the copy is made
+ *  by cloning or in the kernel; otherwise we copy in chunks ourselves.
+ *  @param progress Called with progress from 0 to 1, or empty.
+ */
 void
 copy_in_bits (boost::filesystem::path from, boost::filesystem::path to, std::function<void (float)> progress)
 {
+	if (kernel_copy_file(from, to, progress)) {
+		return;
+	}
+
 	auto f = fopen_boost (from, "rb");
 	if (!f) {
 		throw OpenFileError (from, errno, OpenFileError::READ);
@@ -1131,8 +1138,10 @@ copy_in_bits (boost::filesystem::path from, boost::filesystem::path to, std::fun
 			throw WriteFileError (to, errno);
 		}
 
-		progress (1 - float(remaining) / total);
 		remaining -= this_time;
+		if (progress) {
+			progress (1 - float(remaining) / total);
+		}
 	}
 
 	fclose (f);
@@ -22,10 +22,39 @@
 #include "cross.h"
 #include "verify_dcp_job.h"
 #include "content.h"
+#include "exceptions.h"
+#include "write_verifier.h"
+#include <dcp/cpl.h>
+#include <dcp/dcp.h>
+#include <dcp/mono_picture_asset.h>
+#include <dcp/mono_picture_asset_reader.h>
+#include <dcp/mono_picture_frame.h>
+#include <dcp/pkl.h>
+#include <dcp/reel.h>
+#include <dcp/reel_closed_caption_asset.h>
+#include <dcp/reel_picture_asset.h>
+#include <dcp/reel_sound_asset.h>
+#include <dcp/reel_subtitle_asset.h>
+#include <dcp/sound_asset.h>
+#include <dcp/stereo_picture_asset.h>
+#include <dcp/stereo_picture_asset_reader.h>
+#include <dcp/stereo_picture_frame.h>
+#include <dcp/subtitle_asset.h>
+#include <dcp/util.h>
+#include <nettle/sha1.h>
+#include <boost/thread.hpp>
+#include <atomic>
+#include <cmath>
+#include <set>
 
 #include "i18n.h"
 
 
+using std::dynamic_pointer_cast;
+using std::function;
+using std::make_shared;
+using std::max;
+using std::set;
 using std::string;
 using std::vector;
 using std::shared_ptr;
@@ -35,9 +64,11 @@ using namespace boost::placeholders;
 #endif
 
 
-VerifyDCPJob::VerifyDCPJob (vector<boost::filesystem::path> directories)
+VerifyDCPJob::VerifyDCPJob (vector<boost::filesystem::path> directories, Mode mode, bool use_write_report)
 	: Job (shared_ptr<Film>())
 	, _directories (directories)
+	, _mode (mode)
+	, _use_write_report (use_write_report)
 {
 
 }
@@ -73,10 +104,471 @@ VerifyDCPJob::update_stage (string s, optional<boost::filesystem::path> path)
 }
 
 
+/** @return the notes from the report that was written when our DCP was made, if there is one and it
+ *  still describes the DCP; the report does not cover the DCP's metadata or the hashes of its assets,
+ *  so those must still be checked.
+ */
+optional<vector<dcp::VerificationNote>>
+VerifyDCPJob::write_report_notes () const
+{
+	if (_directories.size() != 1) {
+		return {};
+	}
+
+	auto const directory = _directories.front();
+	auto const report = WriteVerifier::report_path (directory);
+	if (!boost::filesystem::exists(report)) {
+		return {};
+	}
+
+	try {
+		WriteVerifier verifier (report);
+		if (!verifier.matches(directory)) {
+			return {};
+		}
+
+		dcp::DCP dcp (directory);
+		dcp.read ();
+		if (dcp.cpls().size() != 1 || dcp.cpls()[0]->id() != verifier.cpl_id()) {
+			return {};
+		}
+
+		return verifier.notes ();
+	} catch (std::exception &) {
+		/* Something is wrong with the report or the DCP; the full verification will find out what */
+	}
+
+	return {};
+}
+
+
+/** @class FileHasher
+ *  @brief Incremental SHA-1 of a file, so that an asset can be hashed alongside the reading of
+ *  its frames.  libdcp's reader gives us the frames rather than the file's bytes, so the file is
+ *  still read twice, but the second read is close behind the first and so should mostly come
+ *  from the page cache.
+ */
+class FileHasher
+{
+public:
+	explicit FileHasher (boost::filesystem::path path)
+		: _path (path)
+		, _size (boost::filesystem::file_size(path))
+	{
+		_file = fopen_boost (path, "rb");
+		if (!_file) {
+			throw OpenFileError (path, errno, OpenFileError::READ);
+		}
+		sha1_init (&_sha1);
+	}
+
+	~FileHasher ()
+	{
+		fclose (_file);
+	}
+
+	FileHasher (FileHasher const&) = delete;
+	FileHasher& operator= (FileHasher const&) = delete;
+
+	boost::uintmax_t size () const {
+		return _size;
+	}
+
+	/** Hash the file up to a given offset from its start */
+	void hash_to (boost::uintmax_t offset)
+	{
+		uint8_t buffer[65536];
+		offset = std::min (offset, _size);
+		while (_done < offset) {
+			auto const this_time = std::min (offset - _done, static_cast<boost::uintmax_t>(sizeof(buffer)));
+			if (fread(buffer, 1, this_time, _file) != this_time) {
+				throw ReadFileError (_path);
+			}
+			sha1_update (&_sha1, this_time, buffer);
+			_done += this_time;
+		}
+	}
+
+	/** Hash the rest of the file in pieces.
+	 *  @param progress Called with the proportion of the file that has been hashed; returns false to stop.
+	 *  @return true if the whole file was hashed, false if we were stopped.
+	 */
+	bool hash_all (function<bool (float)> progress)
+	{
+		boost::uintmax_t const chunk = 1024 * 1024;
+		while (_done < _size) {
+			hash_to (_done + chunk);
+			if (!progress(static_cast<float>(_done) / _size)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** @return SHA-1 digest of the whole file */
+	vector<uint8_t> digest ()
+	{
+		hash_to (_size);
+		vector<uint8_t> digest (SHA1_DIGEST_SIZE);
+		sha1_digest (&_sha1, digest.size(), digest.data());
+		return digest;
+	}
+
+private:
+	boost::filesystem::path _path;
+	FILE* _file = nullptr;
+	boost::uintmax_t _size;
+	boost::uintmax_t _done = 0;
+	sha1_ctx _sha1;
+};
+
+
+/** Find the hash of an asset in the PKL, adding a note if it differs from the one in the CPL.
+ *  @return decoded PKL hash, or an empty vector if the PKL's hash is not a valid SHA-1 digest,
+ *  or none if the PKL has no hash for the asset.
+ */
+template <class T>
+static
+optional<vector<uint8_t>>
+pkl_hash (
+	shared_ptr<T> reel_asset,
+	vector<shared_ptr<dcp::PKL>> const& pkls,
+	boost::filesystem::path file,
+	dcp::VerificationNote::Code mismatched,
+	vector<dcp::VerificationNote>& notes
+	)
+{
+	optional<string> hash;
+	for (auto i: pkls) {
+		if (auto h = i->hash(reel_asset->id())) {
+			hash = h;
+		}
+	}
+
+	if (!hash) {
+		return {};
+	}
+
+	auto const cpl_hash = reel_asset->hash();
+	if (cpl_hash && *hash != *cpl_hash) {
+		notes.push_back (dcp::VerificationNote(dcp::VerificationNote::Type::ERROR, mismatched, file));
+	}
+
+	vector<uint8_t> digest (SHA1_DIGEST_SIZE);
+	if (dcp::base64_decode(*hash, digest.data(), digest.size()) != SHA1_DIGEST_SIZE) {
+		return vector<uint8_t>();
+	}
+	return digest;
+}
+
+
+/** Check a sound asset's hash against the PKL and CPL.
+ *  @param progress Called with our progress; returns false to stop.
+ */
+static
+vector<dcp::VerificationNote>
+check_sound (shared_ptr<dcp::ReelSoundAsset> reel_asset, vector<shared_ptr<dcp::PKL>> const& pkls, function<bool (float)> progress)
+{
+	using Type = dcp::VerificationNote::Type;
+	using Code = dcp::VerificationNote::Code;
+
+	vector<dcp::VerificationNote> notes;
+
+	auto const file = reel_asset->asset()->file().get();
+	auto const expected = pkl_hash (reel_asset, pkls, file, Code::MISMATCHED_SOUND_HASHES, notes);
+	if (expected) {
+		FileHasher hasher (file);
+		if (hasher.hash_all(progress) && hasher.digest() != *expected) {
+			notes.push_back (dcp::VerificationNote(Type::ERROR, Code::INCORRECT_SOUND_HASH, file));
+		}
+	}
+
+	return notes;
+}
+
+
+/** Check a picture asset's hash against the PKL and CPL and, optionally, its frames.  The hash
+ *  is worked out as the frames are read, rather than in a separate pass over the whole file.
+ *  @param frames true to check the picture frames as well as the asset's hash.
+ *  @param progress Called with our progress; returns false to stop.
+ */
+static
+vector<dcp::VerificationNote>
+check_picture (shared_ptr<dcp::ReelPictureAsset> reel_asset, vector<shared_ptr<dcp::PKL>> const& pkls, bool frames, function<bool (float)> progress)
+{
+	using Type = dcp::VerificationNote::Type;
+	using Code = dcp::VerificationNote::Code;
+
+	vector<dcp::VerificationNote> notes;
+
+	auto asset = reel_asset->asset ();
+	auto const file = asset->file().get();
+
+	auto const expected = pkl_hash (reel_asset, pkls, file, Code::MISMATCHED_PICTURE_HASHES, notes);
+	FileHasher hasher (file);
+
+	auto check_hash = [&]() {
+		if (expected && hasher.digest() != *expected) {
+			notes.push_back (dcp::VerificationNote(Type::ERROR, Code::INCORRECT_PICTURE_HASH, file));
+		}
+	};
+
+	if (frames && asset->encrypted()) {
+		notes.push_back (dcp::VerificationNote(Type::WARNING, Code::MISSED_CHECK_OF_ENCRYPTED));
+		frames = false;
+	}
+
+	if (!frames) {
+		if (expected && hasher.hash_all(progress)) {
+			check_hash ();
+		}
+		return notes;
+	}
+
+	int biggest_frame = 0;
+	set<string> errors;
+	auto check = [&biggest_frame, &errors, asset](shared_ptr<const dcp::Data> frame) {
+		biggest_frame = max (biggest_frame, frame->size());
+		if (auto error = WriteVerifier::codestream_error(frame->data(), frame->size(), asset->size())) {
+			errors.insert (*error);
+		}
+	};
+
+	/* Hash as far through the file as the frames we have read, assuming that they are spread roughly
+	 * evenly through it, and say whether we should carry on.
+	 */
+	auto const duration = asset->intrinsic_duration ();
+	auto step = [&hasher, &expected, progress, duration](int64_t done) {
+		if (expected) {
+			hasher.hash_to (hasher.size() * done / duration);
+		}
+		return progress (static_cast<float>(done) / duration);
+	};
+
+	if (auto mono = dynamic_pointer_cast<dcp::MonoPictureAsset>(asset)) {
+		auto reader = mono->start_read ();
+		for (int64_t i = 0; i < duration; ++i) {
+			check (reader->get_frame(i));
+			if (!step(i + 1)) {
+				return notes;
+			}
+		}
+	} else if (auto stereo = dynamic_pointer_cast<dcp::StereoPictureAsset>(asset)) {
+		auto reader = stereo->start_read ();
+		for (int64_t i = 0; i < duration; ++i) {
+			auto frame = reader->get_frame (i);
+			check (frame->left());
+			check (frame->right());
+			if (!step(i + 1)) {
+				return notes;
+			}
+		}
+	}
+
+	check_hash ();
+
+	if (auto note = WriteVerifier::picture_frame_size_note(biggest_frame, lrint(asset->edit_rate().as_float()), file)) {
+		notes.push_back (*note);
+	}
+
+	for (auto const& i: errors) {
+		notes.push_back (dcp::VerificationNote(Type::ERROR, Code::INVALID_JPEG2000_CODESTREAM, i, file));
+	}
+
+	return notes;
+}
+
+
+/** Check the DCPs' metadata here, then check their assets in parallel.  The notes about each asset
+ *  are kept separately and put together at the end, in the same order every time.
+ *  @param hashes_only true to check only the hashes of the picture and sound assets, and not their
+ *  contents, durations or texts.
+ */
+void
+VerifyDCPJob::verify_in_parallel (bool hashes_only)
+{
+	using Type = dcp::VerificationNote::Type;
+	using Code = dcp::VerificationNote::Code;
+
+	struct Task
+	{
+		/** function to make the check, or empty if notes is already complete */
+		function<vector<dcp::VerificationNote> (function<bool (float)>)> check;
+		/** size of the files involved, to weight our progress */
+		boost::uintmax_t size = 0;
+		vector<dcp::VerificationNote> notes;
+	};
+
+	vector<Task> tasks;
+
+	auto add_notes = [&tasks](vector<dcp::VerificationNote> notes) {
+		Task task;
+		task.notes = notes;
+		tasks.push_back (task);
+	};
+
+	auto add_check = [&tasks](boost::filesystem::path file, function<vector<dcp::VerificationNote> (function<bool (float)>)> check) {
+		Task task;
+		task.check = check;
+		boost::system::error_code ec;
+		task.size = boost::filesystem::file_size (file, ec);
+		tasks.push_back (task);
+	};
+
+	sub (_("Checking DCP metadata"));
+
+	/* Keep the DCPs until we have finished with the assets in them */
+	vector<shared_ptr<dcp::DCP>> dcps;
+
+	for (auto const& directory: _directories) {
+		auto dcp = make_shared<dcp::DCP>(directory);
+		vector<dcp::VerificationNote> notes;
+		try {
+			dcp->read (&notes);
+		} catch (std::exception& e) {
+			notes.push_back (dcp::VerificationNote(Type::ERROR, Code::FAILED_READ, string(e.what())));
+			add_notes (notes);
+			continue;
+		}
+		add_notes (notes);
+		dcps.push_back (dcp);
+
+		auto const pkls = dcp->pkls ();
+
+		for (auto cpl: dcp->cpls()) {
+			auto const standard = cpl->standard().get_value_or(dcp::Standard::SMPTE);
+			int reel_index = 0;
+			for (auto reel: cpl->reels()) {
+				auto picture = reel->main_picture ();
+				if (picture && picture->asset_ref().resolved() && picture->asset()->file()) {
+					add_check (*picture->asset()->file(), [picture, pkls, hashes_only](function<bool (float)> progress) {
+						return check_picture (picture, pkls, !hashes_only, progress);
+					});
+				}
+
+				auto sound = reel->main_sound ();
+				if (sound && sound->asset_ref().resolved() && sound->asset()->file()) {
+					add_check (*sound->asset()->file(), [sound, pkls](function<bool (float)> progress) {
+						return check_sound (sound, pkls, progress);
+					});
+				}
+
+				if (hashes_only) {
+					continue;
+				}
+
+				auto subtitle = reel->main_subtitle ();
+				if (subtitle && subtitle->asset_ref().resolved()) {
+					add_notes (WriteVerifier::text_asset_notes(subtitle->asset(), TextType::OPEN_SUBTITLE, standard));
+				}
+
+				for (auto ccap: reel->closed_captions()) {
+					if (ccap->asset_ref().resolved()) {
+						add_notes (WriteVerifier::text_asset_notes(ccap->asset(), TextType::CLOSED_CAPTION, standard));
+					}
+				}
+
+				/* The picture size is only used for checks that we are not asking for here */
+				auto const fps = picture ? lrint(picture->edit_rate().as_float()) : 24;
+				WriteVerifier durations (fps, dcp::Size(), standard);
+				durations.reel (reel_index++, reel);
+				add_notes (durations.notes());
+			}
+		}
+	}
+
+	sub (_("Checking assets"));
+
+	boost::uintmax_t total_size = 0;
+	for (auto const& i: tasks) {
+		total_size += i.size;
+	}
+
+	std::atomic<size_t> next (0);
+	std::atomic<size_t> finished (0);
+	std::atomic<bool> stop (false);
+	std::unique_ptr<std::atomic<float>[]> progress (new std::atomic<float>[tasks.size()]);
+	for (size_t i = 0; i < tasks.size(); ++i) {
+		progress[i] = 0;
+	}
+
+	auto worker = [&tasks, &next, &finished, &stop, &progress]() {
+		while (!stop) {
+			auto const index = next++;
+			if (index >= tasks.size()) {
+				break;
+			}
+			auto& task = tasks[index];
+			if (task.check) {
+				try {
+					/* The check gives up, returning whatever it has found so far, if we are stopped */
+					task.notes = task.check([&stop, &progress, index](float p) {
+						progress[index] = p;
+						return !stop;
+					});
+				} catch (std::exception& e) {
+					task.notes.push_back (dcp::VerificationNote(Type::ERROR, Code::FAILED_READ, string(e.what())));
+				}
+			}
+			progress[index] = 1;
+			++finished;
+		}
+	};
+
+	boost::thread_group threads;
+	auto const thread_count = max (1U, boost::thread::hardware_concurrency());
+	for (auto i = 0U; i < thread_count; ++i) {
+		threads.create_thread (worker);
+	}
+
+	try {
+		while (finished < tasks.size()) {
+			dcpomatic_sleep_milliseconds (250);
+			if (total_size > 0) {
+				double done = 0;
+				for (size_t i = 0; i < tasks.size(); ++i) {
+					done += progress[i] * tasks[i].size;
+				}
+				set_progress (done / total_size);
+			} else {
+				set_progress (float(finished) / tasks.size());
+			}
+		}
+	} catch (...) {
+		/* We are being cancelled */
+		stop = true;
+		threads.join_all ();
+		throw;
+	}
+
+	threads.join_all ();
+
+	_notes.clear ();
+	for (auto const& i: tasks) {
+		_notes.insert (_notes.end(), i.notes.begin(), i.notes.end());
+	}
+}
+
+
 void
 VerifyDCPJob::run ()
 {
-	_notes = dcp::verify (_directories, bind (&VerifyDCPJob::update_stage, this, _1, _2), bind (&VerifyDCPJob::set_progress, this, _1, false), xsd_path());
+	auto written = _use_write_report ? write_report_notes() : optional<vector<dcp::VerificationNote>>();
+	if (written) {
+		verify_in_parallel (true);
+		_notes.insert (_notes.end(), written->begin(), written->end());
+		_used_write_report = true;
+		set_message (_("Some checks were taken from the report written when the DCP was made"));
+	} else {
+		switch (_mode) {
+		case Mode::FULL:
+			_notes = dcp::verify (_directories, bind (&VerifyDCPJob::update_stage, this, _1, _2), bind (&VerifyDCPJob::set_progress, this, _1, false), xsd_path());
+			break;
+		case Mode::PARALLEL:
+			verify_in_parallel (false);
+			break;
+		}
+	}
 
 	bool failed = false;
 	for (auto i: _notes) {
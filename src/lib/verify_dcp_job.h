@@ -29,7 +29,21 @@ class Content;
 class VerifyDCPJob : public Job
 {
 public:
-	explicit VerifyDCPJob (std::vector<boost::filesystem::path> directories);
+	enum class Mode {
+		/** use dcp::verify, which makes every check that libdcp knows about, one asset at a time */
+		FULL,
+		/** read the DCPs' metadata, then check their assets' hashes, J2K frames, durations and text
+		 *  sizes using a thread per CPU.  This is quicker than FULL but does not make all of its checks
+		 *  (for example XSD validation of the XML files).
+		 */
+		PARALLEL
+	};
+
+	/** @param use_write_report true to use a report from WriteVerifier, if there is one and it
+	 *  still describes the DCP, rather than checking the contents of all the DCP's assets.  The
+	 *  DCP's metadata and the hashes of its assets are always checked.
+	 */
+	explicit VerifyDCPJob (std::vector<boost::filesystem::path> directories, Mode mode = Mode::FULL, bool use_write_report = false);
 	~VerifyDCPJob ();
 
 	std::string name () const override;
@@ -40,9 +54,19 @@ public:
 		return _notes;
 	}
 
+	/** @return true if some of our notes were taken from a report written when the DCP was made */
+	bool used_write_report () const {
+		return _used_write_report;
+	}
+
 private:
 	void update_stage (std::string s, boost::optional<boost::filesystem::path> path);
+	boost::optional<std::vector<dcp::VerificationNote>> write_report_notes () const;
+	void verify_in_parallel (bool hashes_only);
 
 	std::vector<boost::filesystem::path> _directories;
+	Mode _mode;
+	bool _use_write_report;
+	bool _used_write_report = false;
 	std::vector<dcp::VerificationNote> _notes;
 };
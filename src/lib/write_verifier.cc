@@ -0,0 +1,351 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/write_verifier.cc
+ *  @brief WriteVerifier class.
+ */
+
+
+#include "compose.hpp"
+#include "exceptions.h"
+#include "util.h"
+#include "warnings.h"
+#include "write_verifier.h"
+#include <dcp/data.h>
+#include <dcp/picture_asset.h>
+#include <dcp/raw_convert.h>
+#include <dcp/reel.h>
+#include <dcp/reel_atmos_asset.h>
+#include <dcp/reel_closed_caption_asset.h>
+#include <dcp/reel_picture_asset.h>
+#include <dcp/reel_sound_asset.h>
+#include <dcp/reel_subtitle_asset.h>
+#include <dcp/subtitle_asset.h>
+#include <dcp/version.h>
+#include <libcxml/cxml.h>
+DCPOMATIC_DISABLE_WARNINGS
+#include <libxml++/libxml++.h>
+DCPOMATIC_ENABLE_WARNINGS
+#include <cmath>
+
+
+using std::make_shared;
+using std::map;
+using std::max;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using boost::optional;
+using dcp::raw_convert;
+
+
+int const WriteVerifier::_current_state_version = 2;
+
+
+WriteVerifier::WriteVerifier (int video_frame_rate, dcp::Size frame_size, dcp::Standard standard)
+	: _video_frame_rate (video_frame_rate)
+	, _frame_size (frame_size)
+	, _standard (standard)
+{
+
+}
+
+
+WriteVerifier::WriteVerifier (boost::filesystem::path report)
+{
+	cxml::Document f ("WriteVerification");
+	f.read_file (report);
+
+	if (f.number_child<int>("Version") != _current_state_version) {
+		throw OldFormatError ("Write verification report is of an unknown version");
+	}
+
+	/* Notes are stored using libdcp's enum values, which may change from one version to the next */
+	if (f.optional_string_child("Libdcp").get_value_or("") != dcp::git_commit) {
+		throw OldFormatError ("Write verification report was written by a different version of libdcp");
+	}
+
+	_cpl_id = f.string_child ("CPL");
+
+	for (auto i: f.node_children("File")) {
+		_files[i->string_child("Path")] = i->number_child<boost::uintmax_t>("Size");
+	}
+
+	for (auto i: f.node_children("Note")) {
+		auto const type = static_cast<dcp::VerificationNote::Type>(i->number_child<int>("Type"));
+		auto const code = static_cast<dcp::VerificationNote::Code>(i->number_child<int>("Code"));
+		auto const note = i->optional_string_child("Note");
+		auto const file = i->optional_string_child("File");
+		if (note && file) {
+			_notes.push_back (dcp::VerificationNote(type, code, *note, boost::filesystem::path(*file)));
+		} else if (note) {
+			_notes.push_back (dcp::VerificationNote(type, code, *note));
+		} else if (file) {
+			_notes.push_back (dcp::VerificationNote(type, code, boost::filesystem::path(*file)));
+		} else {
+			_notes.push_back (dcp::VerificationNote(type, code));
+		}
+	}
+}
+
+
+optional<string>
+WriteVerifier::codestream_error (uint8_t const* p, int size, dcp::Size expected_size)
+{
+	auto u32 = [p](int offset) {
+		return (static_cast<uint32_t>(p[offset]) << 24) | (p[offset + 1] << 16) | (p[offset + 2] << 8) | p[offset + 3];
+	};
+
+	/* We just check the markers at the start and end, and the image size in SIZ, which is enough to catch
+	 * truncated or otherwise mangled frames without parsing the whole codestream.
+	 */
+	if (size < 24 || p[0] != 0xff || p[1] != 0x4f) {
+		return string("missing SOC marker");
+	} else if (p[2] != 0xff || p[3] != 0x51) {
+		return string("missing SIZ marker after SOC");
+	} else if (p[size - 2] != 0xff || p[size - 1] != 0xd9) {
+		return string("missing EOC marker");
+	}
+
+	/* SIZ is Lsiz (2 bytes), Rsiz (2), Xsiz (4), Ysiz (4), XOsiz (4), YOsiz (4), ... */
+	dcp::Size const image (u32(8) - u32(16), u32(12) - u32(20));
+	if (image != expected_size) {
+		return String::compose("image size %1x%2 does not match the DCP's %3x%4", image.width, image.height, expected_size.width, expected_size.height);
+	}
+
+	return {};
+}
+
+
+void
+WriteVerifier::picture_frame (int reel, shared_ptr<const dcp::Data> data)
+{
+	picture_frame (reel, data->data(), data->size());
+}
+
+
+void
+WriteVerifier::picture_frame (int reel, uint8_t const* data, int size)
+{
+	auto const error = codestream_error (data, size, _frame_size);
+
+	boost::mutex::scoped_lock lm (_mutex);
+	auto& picture = _pictures[reel];
+	picture.biggest_frame = max (picture.biggest_frame, size);
+	if (error) {
+		picture.codestream_errors.insert (*error);
+	}
+}
+
+
+void
+WriteVerifier::picture_frame_size (int reel, int size)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	auto& picture = _pictures[reel];
+	picture.biggest_frame = max (picture.biggest_frame, size);
+}
+
+
+vector<dcp::VerificationNote>
+WriteVerifier::text_asset_notes (shared_ptr<dcp::SubtitleAsset> asset, TextType type, dcp::Standard standard)
+{
+	vector<dcp::VerificationNote> notes;
+
+	/* These limits are from SMPTE Bv2.1 so they only apply to SMPTE DCPs */
+	if (standard != dcp::Standard::SMPTE || !asset->file()) {
+		return notes;
+	}
+
+	auto const file = *asset->file();
+
+	auto const size = boost::filesystem::file_size (file);
+	if (size > MAX_TEXT_MXF_SIZE) {
+		notes.push_back (
+			dcp::VerificationNote(dcp::VerificationNote::Type::BV21_ERROR, dcp::VerificationNote::Code::INVALID_TIMED_TEXT_SIZE_IN_BYTES, raw_convert<string>(size), file)
+			);
+	}
+
+	if (type == TextType::CLOSED_CAPTION) {
+		auto const xml_size = asset->xml_as_string().length();
+		if (xml_size > MAX_CLOSED_CAPTION_XML_SIZE) {
+			notes.push_back (
+				dcp::VerificationNote(dcp::VerificationNote::Type::BV21_ERROR, dcp::VerificationNote::Code::INVALID_CLOSED_CAPTION_XML_SIZE_IN_BYTES, raw_convert<string>(xml_size), file)
+				);
+		}
+	}
+
+	return notes;
+}
+
+
+void
+WriteVerifier::text_asset (shared_ptr<dcp::SubtitleAsset> asset, TextType type)
+{
+	auto const notes = text_asset_notes (asset, type, _standard);
+
+	boost::mutex::scoped_lock lm (_mutex);
+	_notes.insert (_notes.end(), notes.begin(), notes.end());
+}
+
+
+optional<dcp::VerificationNote>
+WriteVerifier::picture_frame_size_note (int biggest_frame, int video_frame_rate, boost::filesystem::path file)
+{
+	/* The same limits as dcp::verify uses */
+	auto const max_frame = lrint(250 * 1000000 / (8.0 * video_frame_rate));
+	auto const risky_frame = lrint(230 * 1000000 / (8.0 * video_frame_rate));
+	if (biggest_frame > max_frame) {
+		return dcp::VerificationNote(dcp::VerificationNote::Type::ERROR, dcp::VerificationNote::Code::INVALID_PICTURE_FRAME_SIZE_IN_BYTES, file);
+	} else if (biggest_frame > risky_frame) {
+		return dcp::VerificationNote(dcp::VerificationNote::Type::WARNING, dcp::VerificationNote::Code::NEARLY_INVALID_PICTURE_FRAME_SIZE_IN_BYTES, file);
+	}
+
+	return {};
+}
+
+
+void
+WriteVerifier::reel (int index, shared_ptr<dcp::Reel> reel)
+{
+	using Type = dcp::VerificationNote::Type;
+	using Code = dcp::VerificationNote::Code;
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	auto picture = _pictures.find (index);
+	if (picture != _pictures.end() && reel->main_picture()) {
+		auto const file = reel->main_picture()->asset()->file().get_value_or("");
+		if (auto note = picture_frame_size_note(picture->second.biggest_frame, _video_frame_rate, file)) {
+			_notes.push_back (*note);
+		}
+		for (auto const& i: picture->second.codestream_errors) {
+			_notes.push_back (dcp::VerificationNote(Type::ERROR, Code::INVALID_JPEG2000_CODESTREAM, i, file));
+		}
+	}
+
+	vector<shared_ptr<dcp::ReelAsset>> assets;
+	if (reel->main_picture()) {
+		assets.push_back (reel->main_picture());
+	}
+	if (reel->main_sound()) {
+		assets.push_back (reel->main_sound());
+	}
+	if (reel->main_subtitle()) {
+		assets.push_back (reel->main_subtitle());
+	}
+	for (auto i: reel->closed_captions()) {
+		assets.push_back (i);
+	}
+	if (reel->atmos()) {
+		assets.push_back (reel->atmos());
+	}
+
+	bool mismatched = false;
+	for (auto i: assets) {
+		if (i->actual_duration() < _video_frame_rate) {
+			_notes.push_back (dcp::VerificationNote(Type::ERROR, Code::INVALID_DURATION, i->id()));
+		}
+		if (i->intrinsic_duration() < _video_frame_rate) {
+			_notes.push_back (dcp::VerificationNote(Type::ERROR, Code::INVALID_INTRINSIC_DURATION, i->id()));
+		}
+		if (i->actual_duration() != assets.front()->actual_duration()) {
+			mismatched = true;
+		}
+	}
+
+	if (mismatched && _standard == dcp::Standard::SMPTE) {
+		_notes.push_back (dcp::VerificationNote(Type::BV21_ERROR, Code::MISMATCHED_ASSET_DURATION));
+	}
+}
+
+
+vector<dcp::VerificationNote>
+WriteVerifier::notes () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _notes;
+}
+
+
+boost::filesystem::path
+WriteVerifier::report_path (boost::filesystem::path dcp_dir)
+{
+	return dcp_dir.parent_path() / (dcp_dir.filename().string() + ".verify.xml");
+}
+
+
+map<string, boost::uintmax_t>
+WriteVerifier::files (boost::filesystem::path dcp_dir)
+{
+	map<string, boost::uintmax_t> files;
+	auto const prefix = dcp_dir.generic_string().length() + 1;
+	for (auto i = boost::filesystem::recursive_directory_iterator(dcp_dir); i != boost::filesystem::recursive_directory_iterator(); ++i) {
+		if (boost::filesystem::is_regular_file(i->path())) {
+			files[i->path().generic_string().substr(prefix)] = boost::filesystem::file_size(i->path());
+		}
+	}
+	return files;
+}
+
+
+void
+WriteVerifier::write (boost::filesystem::path dcp_dir, string cpl_id) const
+{
+	auto doc = make_shared<xmlpp::Document>();
+	auto root = doc->create_root_node ("WriteVerification");
+
+	root->add_child("Version")->add_child_text(raw_convert<string>(_current_state_version));
+	root->add_child("Libdcp")->add_child_text(dcp::git_commit);
+	root->add_child("CPL")->add_child_text(cpl_id);
+
+	for (auto const& i: files(dcp_dir)) {
+		auto file = root->add_child("File");
+		file->add_child("Path")->add_child_text(i.first);
+		file->add_child("Size")->add_child_text(raw_convert<string>(i.second));
+	}
+
+	for (auto const& i: notes()) {
+		auto note = root->add_child("Note");
+		note->add_child("Type")->add_child_text(raw_convert<string>(static_cast<int>(i.type())));
+		note->add_child("Code")->add_child_text(raw_convert<string>(static_cast<int>(i.code())));
+		if (i.note()) {
+			note->add_child("Note")->add_child_text(*i.note());
+		}
+		if (i.file()) {
+			/* Just the leaf, since that is all anybody shows, and the DCP might have moved by the time the report is read */
+			note->add_child("File")->add_child_text(i.file()->filename().string());
+		}
+	}
+
+	doc->write_to_file_formatted (report_path(dcp_dir).string());
+}
+
+
+bool
+WriteVerifier::matches (boost::filesystem::path dcp_dir) const
+{
+	try {
+		return !_cpl_id.empty() && files(dcp_dir) == _files;
+	} catch (boost::filesystem::filesystem_error &) {
+		return false;
+	}
+}
@@ -0,0 +1,134 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_WRITE_VERIFIER_H
+#define DCPOMATIC_WRITE_VERIFIER_H
+
+
+/** @file  src/lib/write_verifier.h
+ *  @brief WriteVerifier class.
+ */
+
+
+#include "types.h"
+#include <dcp/types.h>
+#include <dcp/verify.h>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+
+namespace dcp {
+	class Data;
+	class Reel;
+	class SubtitleAsset;
+}
+
+
+/** @class WriteVerifier
+ *  @brief Checker of a DCP's assets as they are written.
+ *
+ *  Many of the checks that dcp::verify makes (J2K frame sizes and codestreams, reel durations
+ *  and text asset sizes) can be made while we are writing the DCP, when we have the data to hand.
+ *  The results are written to a report next to the DCP, and VerifyDCPJob can then use this report
+ *  instead of reading the whole DCP back in again, as long as the DCP has not changed since.
+ */
+class WriteVerifier
+{
+public:
+	WriteVerifier (int video_frame_rate, dcp::Size frame_size, dcp::Standard standard);
+	/** Read a report that was written by write() */
+	explicit WriteVerifier (boost::filesystem::path report);
+
+	WriteVerifier (WriteVerifier const&) = delete;
+	WriteVerifier& operator= (WriteVerifier const&) = delete;
+
+	/** Check a J2K frame that is being written to the picture asset of a reel */
+	void picture_frame (int reel, std::shared_ptr<const dcp::Data> data);
+	void picture_frame (int reel, uint8_t const* data, int size);
+	/** Check the size of a J2K frame whose data we do not have (because it was written on
+	 *  a previous run and it is being kept).
+	 */
+	void picture_frame_size (int reel, int size);
+	/** Check a subtitle or closed caption asset that we have just written */
+	void text_asset (std::shared_ptr<dcp::SubtitleAsset> asset, TextType type);
+	/** Check a reel that we have just made */
+	void reel (int index, std::shared_ptr<dcp::Reel> reel);
+
+	/** Write our report for a DCP, which must be complete */
+	void write (boost::filesystem::path dcp_dir, std::string cpl_id) const;
+
+	/** @return true if a DCP still contains exactly the files (with the same sizes) that it did
+	 *  when our report was written.
+	 */
+	bool matches (boost::filesystem::path dcp_dir) const;
+
+	std::string cpl_id () const {
+		return _cpl_id;
+	}
+
+	std::vector<dcp::VerificationNote> notes () const;
+
+	/** @return the path of the report for a DCP */
+	static boost::filesystem::path report_path (boost::filesystem::path dcp_dir);
+
+	/* These are the checks that we make, for use by anything else which wants to make them */
+
+	/** @return a description of what is wrong with a J2K codestream, or none */
+	static boost::optional<std::string> codestream_error (uint8_t const* data, int size, dcp::Size expected_size);
+	/** @return a note if biggest_frame is too big (or nearly too big) for a picture asset */
+	static boost::optional<dcp::VerificationNote> picture_frame_size_note (int biggest_frame, int video_frame_rate, boost::filesystem::path file);
+	static std::vector<dcp::VerificationNote> text_asset_notes (std::shared_ptr<dcp::SubtitleAsset> asset, TextType type, dcp::Standard standard);
+
+private:
+	static std::map<std::string, boost::uintmax_t> files (boost::filesystem::path dcp_dir);
+
+	/** What we found out about the J2K frames in one reel's picture asset */
+	struct Picture
+	{
+		int biggest_frame = 0;
+		/** distinct problems found in the codestreams */
+		std::set<std::string> codestream_errors;
+	};
+
+	int _video_frame_rate = 24;
+	dcp::Size _frame_size;
+	dcp::Standard _standard = dcp::Standard::SMPTE;
+
+	mutable boost::mutex _mutex;
+	/** pictures, indexed by reel; these are turned into notes by reel() since we don't know the
+	 *  final name of the picture asset's file until then.
+	 */
+	std::map<int, Picture> _pictures;
+	std::vector<dcp::VerificationNote> _notes;
+
+	/** CPL ID and the DCP's files (relative to its directory) with their sizes; only set when we have been read from a report */
+	std::string _cpl_id;
+	std::map<std::string, boost::uintmax_t> _files;
+
+	static int const _current_state_version;
+};
+
+
+#endif
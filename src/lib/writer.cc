@@ -31,11 +31,15 @@
 #include "font_data.h"
 #include "job.h"
 #include "log.h"
+#include "metrics.h"
 #include "ratio.h"
 #include "reel_writer.h"
+#include "subtitle_image_encoder.h"
 #include "text_content.h"
+#include "trace.h"
 #include "util.h"
 #include "version.h"
+#include "write_verifier.h"
 #include "writer.h"
 #include <dcp/cpl.h>
 #include <dcp/locale_convert.h>
@@ -76,6 +80,7 @@ using namespace dcpomatic;
 Writer::Writer (weak_ptr<const Film> weak_film, weak_ptr<Job> j, bool text_only)
 	: WeakConstFilm (weak_film)
 	, _job (j)
+	, _subtitle_image_encoder (make_shared<SubtitleImageEncoder>(film()->file(boost::filesystem::unique_path("subtitle_images_%%%%%%%%.tmp"))))
 	/* These will be reset to sensible values when J2KEncoder is created */
 	, _maximum_frames_in_memory (8)
 	, _maximum_queue_size (8)
@@ -83,10 +88,16 @@ Writer::Writer (weak_ptr<const Film> weak_film, weak_ptr<Job> j, bool text_only)
 {
 	auto job = _job.lock ();
 
+	if (!text_only) {
+		_verifier = make_shared<WriteVerifier>(
+			film()->video_frame_rate(), film()->frame_size(), film()->interop() ? dcp::Standard::INTEROP : dcp::Standard::SMPTE
+			);
+	}
+
 	int reel_index = 0;
 	auto const reels = film()->reels();
 	for (auto p: reels) {
-		_reels.push_back (ReelWriter(weak_film, p, job, reel_index++, reels.size(), text_only));
+		_reels.push_back (ReelWriter(weak_film, p, job, reel_index++, reels.size(), text_only, _subtitle_image_encoder, _verifier));
 	}
 
 	_last_written.resize (reels.size());
@@ -106,6 +117,8 @@ Writer::Writer (weak_ptr<const Film> weak_film, weak_ptr<Job> j, bool text_only)
 	if (!Config::instance()->signer_chain()->valid(&reason)) {
 		throw InvalidSignerError (reason);
 	}
+
+	_metrics_source = Metrics::instance()->add_source (boost::bind(&Writer::add_metrics, this, _1, film()->name()));
 }
 
 
@@ -113,6 +126,7 @@ void
 Writer::start ()
 {
 	if (!_text_only) {
+		_trace_session = Trace::thread_session ();
 		_thread = boost::thread (boost::bind(&Writer::thread, this));
 #ifdef DCPOMATIC_LINUX
 		pthread_setname_np (_thread.native_handle(), "writer");
@@ -123,6 +137,8 @@ Writer::start ()
 
 Writer::~Writer ()
 {
+	Metrics::instance()->remove_source (_metrics_source);
+
 	if (!_text_only) {
 		terminate_thread (false);
 	}
@@ -381,6 +397,7 @@ Writer::thread ()
 try
 {
 	start_of_thread ("Writer");
+	Trace::set_thread_session (_trace_session);
 
 	while (true)
 	{
@@ -395,7 +412,10 @@ try
 
 			/* Nothing to do: wait until something happens which may indicate that we do */
 			LOG_TIMING (N_("writer-sleep queue=%1"), _queue.size());
-			_empty_condition.wait (lock);
+			{
+				TRACE_SCOPE ("writer-sleep");
+				_empty_condition.wait (lock);
+			}
 			LOG_TIMING (N_("writer-wake queue=%1"), _queue.size());
 		}
 
@@ -427,11 +447,14 @@ try
 			if (qi.type == QueueItem::Type::FULL && qi.encoded) {
 				--_queued_full_in_memory;
 			}
+			TRACE_COUNTER ("writer-queue", _queue.size());
+			TRACE_COUNTER ("writer-frames-in-memory", _queued_full_in_memory);
 
 			lock.unlock ();
 
 			auto& reel = _reels[qi.reel];
 
+			TRACE_SCOPE ("writer-write");
 			switch (qi.type) {
 			case QueueItem::Type::FULL:
 				LOG_DEBUG_ENCODE (N_("Writer FULL-writes %1 (%2)"), qi.frame, (int) qi.eyes);
@@ -482,6 +505,7 @@ try
 
 			LOG_GENERAL ("Writer full; pushes %1 to disk while awaiting %2", i->frame, awaiting);
 
+			TRACE_SCOPE ("writer-push-to-disk");
 			i->encoded->write_via_temp (
 				film()->j2c_path(i->reel, i->frame, i->eyes, true),
 				film()->j2c_path(i->reel, i->frame, i->eyes, false)
@@ -571,6 +595,25 @@ Writer::calculate_digests ()
 }
 
 
+void
+Writer::add_metrics (vector<Metrics::Metric>& metrics, string film) const
+{
+	using Metric = Metrics::Metric;
+	auto const counter = Metrics::Type::COUNTER;
+	auto const gauge = Metrics::Type::GAUGE;
+
+	boost::mutex::scoped_lock lm (_state_mutex);
+	metrics.push_back (Metric("dcpomatic_writer_full_frames_total", "Frames written to the picture asset", counter, _full_written, {{"film", film}}));
+	metrics.push_back (Metric("dcpomatic_writer_fake_frames_total", "Frames which were already in the picture asset", counter, _fake_written, {{"film", film}}));
+	metrics.push_back (Metric("dcpomatic_writer_repeat_frames_total", "Frames written by repeating the previous one", counter, _repeat_written, {{"film", film}}));
+	metrics.push_back (Metric("dcpomatic_writer_pushed_to_disk_total", "Frames written to disk temporarily because too many were held in memory", counter, _pushed_to_disk, {{"film", film}}));
+	metrics.push_back (Metric("dcpomatic_writer_queue_length", "Items waiting to be written", gauge, _queue.size(), {{"film", film}}));
+	metrics.push_back (Metric("dcpomatic_writer_frames_in_memory", "Encoded frames being held in memory", gauge, _queued_full_in_memory, {{"film", film}}));
+	metrics.push_back (Metric("dcpomatic_writer_subtitle_image_bytes_in_memory", "Bytes of PNG subtitle images being held in memory", gauge, _subtitle_image_bytes, {{"film", film}}));
+	metrics.push_back (Metric("dcpomatic_writer_subtitle_image_bytes_spooled", "Bytes of PNG subtitle images written to disk until their reel is finished", counter, _subtitle_image_encoder->bytes_spooled(), {{"film", film}}));
+}
+
+
 /** @param output_dcp Path to DCP folder to write */
 void
 Writer::finish (boost::filesystem::path output_dcp)
@@ -584,6 +627,9 @@ Writer::finish (boost::filesystem::path output_dcp)
 
 	for (auto& i: _reels) {
 		write_hanging_text (i);
+	}
+
+	for (auto& i: _reels) {
 		i.finish (output_dcp);
 	}
 
@@ -603,8 +649,29 @@ Writer::finish (boost::filesystem::path output_dcp)
 
 	/* Add reels */
 
+	int reel_index = 0;
 	for (auto& i: _reels) {
-		cpl->add (i.create_reel(_reel_assets, _fonts, output_dcp, _have_subtitles, _have_closed_captions));
+		/* Add this reel's bitmap subtitles to its assets, reading them back from disk; the other
+		 * reels' stay where they are until we need them.
+		 */
+		_subtitle_image_encoder->flush (reel_index);
+		auto const held = i.subtitle_image_bytes ();
+		{
+			boost::mutex::scoped_lock lm (_state_mutex);
+			_subtitle_image_bytes += held;
+		}
+		auto reel = i.create_reel(_reel_assets, _fonts, output_dcp, _have_subtitles, _have_closed_captions);
+		if (_verifier) {
+			_verifier->reel (reel_index, reel);
+		}
+		cpl->add (reel);
+		/* This reel's assets are written now so we don't need its images any more */
+		i.release_subtitle_images ();
+		{
+			boost::mutex::scoped_lock lm (_state_mutex);
+			_subtitle_image_bytes -= held - i.subtitle_image_bytes();
+		}
+		++reel_index;
 	}
 
 	/* Add metadata */
@@ -698,9 +765,16 @@ Writer::finish (boost::filesystem::path output_dcp)
 		);
 
 	LOG_GENERAL (
-		N_("Wrote %1 FULL, %2 FAKE, %3 REPEAT, %4 pushed to disk"), _full_written, _fake_written, _repeat_written, _pushed_to_disk
+		N_("Wrote %1 FULL, %2 FAKE, %3 REPEAT, %4 pushed to disk; %5 bytes of subtitle images in memory, %6 spooled to disk"),
+		_full_written, _fake_written, _repeat_written, _pushed_to_disk,
+		_subtitle_image_bytes, _subtitle_image_encoder->bytes_spooled()
 		);
 
+	if (_verifier) {
+		_verifier->write (output_dcp, cpl->id());
+		LOG_GENERAL ("Write verification found %1 problem(s)", _verifier->notes().size());
+	}
+
 	write_cover_sheet (output_dcp);
 }
 
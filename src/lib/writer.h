@@ -28,6 +28,7 @@
 #include "types.h"
 #include "player_text.h"
 #include "exception_store.h"
+#include "metrics.h"
 #include "dcp_text_track.h"
 #include "weak_film.h"
 #include <dcp/atmos_frame.h>
@@ -49,6 +50,9 @@ class AudioBuffers;
 class Job;
 class ReferencedReelAsset;
 class ReelWriter;
+class SubtitleImageEncoder;
+class WriteVerifier;
+struct writer_release_subtitle_images_test;
 
 
 struct QueueItem
@@ -122,6 +126,8 @@ public:
 	void set_encoder_threads (int threads);
 
 private:
+	friend struct ::writer_release_subtitle_images_test;
+
 	void thread ();
 	void terminate_thread (bool);
 	bool have_sequenced_image_at_queue_head ();
@@ -131,8 +137,12 @@ private:
 	void calculate_referenced_digests (std::function<void (float)> set_progress);
 	void write_hanging_text (ReelWriter& reel);
 	void calculate_digests ();
+	void add_metrics (std::vector<Metrics::Metric>& metrics, std::string film) const;
 
 	std::weak_ptr<Job> _job;
+	std::shared_ptr<SubtitleImageEncoder> _subtitle_image_encoder;
+	/** checker of what we write, shared with the ReelWriters, or nullptr in text-only mode */
+	std::shared_ptr<WriteVerifier> _verifier;
 	std::vector<ReelWriter> _reels;
 	std::vector<ReelWriter>::iterator _audio_reel;
 	std::vector<ReelWriter>::iterator _subtitle_reel;
@@ -141,6 +151,8 @@ private:
 
 	/** our thread */
 	boost::thread _thread;
+	/** Trace session that our thread should record its events in */
+	int _trace_session = 0;
 	/** true if our thread should finish */
 	bool _finish = false;
 	/** queue of things to write to disk */
@@ -192,8 +204,11 @@ private:
 	    due to the limit of frames to be held in memory.
 	*/
 	int _pushed_to_disk = 0;
+	/** bytes of PNG data held by the bitmap subtitles in our reels; protected by _state_mutex */
+	int64_t _subtitle_image_bytes = 0;
 
 	bool _text_only;
+	int _metrics_source;
 
 	boost::mutex _digest_progresses_mutex;
 	std::map<boost::thread::id, float> _digest_progresses;
@@ -0,0 +1,212 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/lib/xyz_converter.cc
+ *  @brief XYZConverter class.
+ */
+
+
+#include "compose.hpp"
+#include "dcpomatic_assert.h"
+#include "image.h"
+#include "xyz_converter.h"
+#include <dcp/openjpeg_image.h>
+#include <dcp/rgb_xyz.h>
+#include <dcp/transfer_function.h>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+
+using std::make_shared;
+using std::map;
+using std::max;
+using std::min;
+using std::shared_ptr;
+using std::string;
+using boost::optional;
+
+
+XYZConverter::XYZConverter (ColourConversion const& conversion)
+	: _in (4096)
+	, _out (65536)
+{
+	auto lut_in = conversion.in()->lut (12, false);
+	std::copy (lut_in, lut_in + 4096, _in.begin());
+
+	dcp::combined_rgb_to_xyz (conversion, _matrix);
+
+	auto lut_out = conversion.out()->lut (16, true);
+	for (int i = 0; i < 65536; ++i) {
+		_out[i] = lrint (lut_out[i] * 4095);
+	}
+}
+
+
+shared_ptr<const XYZConverter>
+XYZConverter::get (ColourConversion const& conversion)
+{
+	static boost::mutex mutex;
+	static map<string, shared_ptr<const XYZConverter>> cache;
+
+	auto const id = conversion.identifier ();
+
+	boost::mutex::scoped_lock lm (mutex);
+	auto i = cache.find (id);
+	if (i != cache.end()) {
+		return i->second;
+	}
+
+	/* A film will generally use only one or two conversions, so if we have lots
+	   in here they are left over from something else.
+	*/
+	if (cache.size() > 16) {
+		cache.clear ();
+	}
+
+	auto converter = make_shared<const XYZConverter>(conversion);
+	cache[id] = converter;
+	return converter;
+}
+
+
+shared_ptr<dcp::OpenJPEGImage>
+XYZConverter::convert (shared_ptr<const Image> image, optional<double> fade, optional<dcp::NoteHandler> note) const
+{
+	return convert (image, Crop(), image->size(), optional<PositionImage>(), fade, note);
+}
+
+
+shared_ptr<dcp::OpenJPEGImage>
+XYZConverter::convert (
+	shared_ptr<const Image> image, Crop crop, dcp::Size out_size, optional<PositionImage> text, optional<double> fade, optional<dcp::NoteHandler> note
+	) const
+{
+	/* XYZ12LE has the same layout as RGB48LE, and is treated as RGB if a conversion is requested */
+	DCPOMATIC_ASSERT (image->pixel_format() == AV_PIX_FMT_RGB48LE || image->pixel_format() == AV_PIX_FMT_XYZ12LE);
+	/* Blending is only the same as Image::alpha_blend for RGB */
+	DCPOMATIC_ASSERT (!text || image->pixel_format() == AV_PIX_FMT_RGB48LE);
+
+	dcp::Size const in_size (image->size().width - crop.left - crop.right, image->size().height - crop.top - crop.bottom);
+	DCPOMATIC_ASSERT (in_size.width > 0 && in_size.height > 0);
+	DCPOMATIC_ASSERT (in_size.width <= out_size.width && in_size.height <= out_size.height);
+
+	/* Where the cropped image goes in the output */
+	int const corner_x = (out_size.width - in_size.width) / 2;
+	int const corner_y = (out_size.height - in_size.height) / 2;
+
+	auto xyz = make_shared<dcp::OpenJPEGImage>(out_size);
+
+	/* Same as Image::fade */
+	float const f = fade.get_value_or (1);
+	bool const fading = static_cast<bool>(fade);
+
+	int red = 0;
+	int blue = 2;
+	if (text) {
+		DCPOMATIC_ASSERT (text->image->pixel_format() == AV_PIX_FMT_BGRA || text->image->pixel_format() == AV_PIX_FMT_RGBA);
+		if (text->image->pixel_format() == AV_PIX_FMT_BGRA) {
+			std::swap (red, blue);
+		}
+	}
+
+	int clamped = 0;
+	int* xyz_x = xyz->data (0);
+	int* xyz_y = xyz->data (1);
+	int* xyz_z = xyz->data (2);
+	auto const in = _in.data();
+	auto const out = _out.data();
+	auto const m = _matrix;
+	uint16_t const black[3] = { 0, 0, 0 };
+
+	for (int y = 0; y < out_size.height; ++y) {
+		int const iy = y - corner_y;
+		uint16_t const* row = nullptr;
+		if (iy >= 0 && iy < in_size.height) {
+			row = reinterpret_cast<uint16_t const *>(image->data()[0] + (iy + crop.top) * image->stride()[0]) + crop.left * 3;
+		}
+
+		/* Part of the subtitle on this line, if there is any */
+		uint8_t const* text_row = nullptr;
+		int text_start = 0;
+		int text_end = 0;
+		if (text) {
+			int const ty = y - text->position.y;
+			if (ty >= 0 && ty < text->image->size().height) {
+				text_row = text->image->data()[0] + ty * text->image->stride()[0];
+				text_start = max (0, text->position.x);
+				text_end = min (out_size.width, text->position.x + text->image->size().width);
+			}
+		}
+
+		for (int x = 0; x < out_size.width; ++x) {
+			int const ix = x - corner_x;
+			auto p = (row && ix >= 0 && ix < in_size.width) ? row + ix * 3 : black;
+			int r = p[0];
+			int g = p[1];
+			int b = p[2];
+
+			if (text_row && x >= text_start && x < text_end) {
+				/* Same as Image::alpha_blend, which only blends the high bytes */
+				auto op = text_row + (x - text->position.x) * 4;
+				float const alpha = float (op[3]) / 255;
+				r = (static_cast<uint8_t>(op[red] * alpha + (r >> 8) * (1 - alpha)) << 8) | (r & 0xff);
+				g = (static_cast<uint8_t>(op[1] * alpha + (g >> 8) * (1 - alpha)) << 8) | (g & 0xff);
+				b = (static_cast<uint8_t>(op[blue] * alpha + (b >> 8) * (1 - alpha)) << 8) | (b & 0xff);
+			}
+
+			if (fading) {
+				r = int(float(r) * f);
+				g = int(float(g) * f);
+				b = int(float(b) * f);
+			}
+
+			/* In gamma LUT (converting 16-bit to 12-bit) */
+			double const sr = in[r >> 4];
+			double const sg = in[g >> 4];
+			double const sb = in[b >> 4];
+
+			/* RGB to XYZ, Bradford transform and DCI companding */
+			double dx = sr * m[0] + sg * m[1] + sb * m[2];
+			double dy = sr * m[3] + sg * m[4] + sb * m[5];
+			double dz = sr * m[6] + sg * m[7] + sb * m[8];
+
+			if (dx < 0 || dy < 0 || dz < 0 || dx > 65535 || dy > 65535 || dz > 65535) {
+				++clamped;
+				dx = max (0.0, min (65535.0, dx));
+				dy = max (0.0, min (65535.0, dy));
+				dz = max (0.0, min (65535.0, dz));
+			}
+
+			/* Out gamma LUT */
+			*xyz_x++ = out[lrint(dx)];
+			*xyz_y++ = out[lrint(dy)];
+			*xyz_z++ = out[lrint(dz)];
+		}
+	}
+
+	if (clamped && note) {
+		note.get()(dcp::NoteType::NOTE, String::compose("%1 XYZ value(s) clamped", clamped));
+	}
+
+	return xyz;
+}
@@ -0,0 +1,109 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef DCPOMATIC_XYZ_CONVERTER_H
+#define DCPOMATIC_XYZ_CONVERTER_H
+
+
+/** @file  src/lib/xyz_converter.h
+ *  @brief XYZConverter class.
+ */
+
+
+#include "colour_conversion.h"
+#include "position_image.h"
+#include "types.h"
+#include <dcp/types.h>
+#include <boost/optional.hpp>
+#include <memory>
+#include <vector>
+
+
+namespace dcp {
+	class OpenJPEGImage;
+}
+
+class Image;
+
+
+/** @class XYZConverter
+ *  @brief Converter from RGB48LE images to 12-bit XYZ using tables which are
+ *  built once for a given ColourConversion.
+ *
+ *  The conversion does the same thing as dcp::rgb_to_xyz but can also crop,
+ *  pad, blend a subtitle and apply a fade as it goes.  Each output pixel is made
+ *  from one read of its source pixel, so none of those steps needs its own pass
+ *  over the frame.
+ */
+class XYZConverter
+{
+public:
+	explicit XYZConverter (ColourConversion const& conversion);
+
+	XYZConverter (XYZConverter const&) = delete;
+	XYZConverter& operator= (XYZConverter const&) = delete;
+
+	/** @param image RGB48LE image to convert.
+	 *  @param fade Fade to apply to the RGB values before conversion, or none.
+	 *  @param note Handler for notes about the conversion, or none.
+	 */
+	std::shared_ptr<dcp::OpenJPEGImage> convert (
+		std::shared_ptr<const Image> image,
+		boost::optional<double> fade,
+		boost::optional<dcp::NoteHandler> note
+		) const;
+
+	/** @param image RGB48LE image to convert.
+	 *  @param crop Crop to apply to image.
+	 *  @param out_size Size of the output.  The cropped image is put in the middle, as
+	 *  Image::crop_scale_window does, with black around it.
+	 *  @param text Subtitle to blend onto the output before it is faded and converted, as Image::alpha_blend
+	 *  would, or none.
+	 *  @param fade Fade to apply to the RGB values before conversion, or none.
+	 *  @param note Handler for notes about the conversion, or none.
+	 */
+	std::shared_ptr<dcp::OpenJPEGImage> convert (
+		std::shared_ptr<const Image> image,
+		Crop crop,
+		dcp::Size out_size,
+		boost::optional<PositionImage> text,
+		boost::optional<double> fade,
+		boost::optional<dcp::NoteHandler> note
+		) const;
+
+	/** @return A converter for conversion, which will be shared with anything
+	 *  else that asks for the same conversion.
+	 */
+	static std::shared_ptr<const XYZConverter> get (ColourConversion const& conversion);
+
+private:
+	/** input transfer function indexed by 12-bit value */
+	std::vector<double> _in;
+	/** product of the RGB to XYZ matrix, the Bradford transform and the DCI companding,
+	 *  scaled so that its results are indices into _out.
+	 */
+	double _matrix[9];
+	/** output transfer function indexed by 16-bit value, giving final 12-bit values */
+	std::vector<int> _out;
+};
+
+
+#endif
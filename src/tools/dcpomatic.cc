@@ -70,6 +70,7 @@
 #include "lib/dkdm_wrapper.h"
 #include "lib/emailer.h"
 #include "lib/encode_server_finder.h"
+#include "lib/examined_content_cache.h"
 #include "lib/exceptions.h"
 #include "lib/ffmpeg_encoder.h"
 #include "lib/film.h"
@@ -1179,6 +1180,9 @@ private:
 		/* Also stop hearing about analytics-related stuff */
 		_analytics_message_connection.disconnect ();
 
+		/* Write out any examination results that have not yet been saved */
+		ExaminedContentCache::drop ();
+
 		ev.Skip ();
 	}
 
@@ -32,6 +32,7 @@
 #include "lib/film.h"
 #include "lib/job.h"
 #include "lib/job_manager.h"
+#include "lib/json_server.h"
 #include "lib/make_dcp.h"
 #include "lib/transcode_job.h"
 #include "lib/util.h"
@@ -62,6 +63,7 @@ using namespace boost::placeholders;
 
 
 static list<boost::filesystem::path> films_to_load;
+static boost::optional<int> json_port;
 
 
 enum {
@@ -357,6 +359,7 @@ private:
 
 
 static const wxCmdLineEntryDesc command_line_description[] = {
+	{ wxCMD_LINE_OPTION, "j", "json", "run a JSON server (with metrics at /metrics) on the specified port", wxCMD_LINE_VAL_NUMBER, wxCMD_LINE_PARAM_OPTIONAL },
 	{ wxCMD_LINE_PARAM, 0, 0, "film to load", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_MULTIPLE | wxCMD_LINE_PARAM_OPTIONAL },
 	{ wxCMD_LINE_NONE, "", "", "", wxCmdLineParamType (0), 0 }
 };
@@ -442,6 +445,10 @@ class App : public wxApp
 		auto server = new JobServer (_frame);
 		new thread (boost::bind (&JobServer::run, server));
 
+		if (json_port) {
+			new JSONServer (json_port.get());
+		}
+
 		signal_manager = new wxSignalManager (this);
 		this->Bind (wxEVT_IDLE, boost::bind (&App::idle, this));
 
@@ -482,6 +489,11 @@ class App : public wxApp
 			films_to_load.push_back (wx_to_std(parser.GetParam(i)));
 		}
 
+		long port;
+		if (parser.Found(wxT("json"), &port)) {
+			json_port = port;
+		}
+
 		return true;
 	}
 
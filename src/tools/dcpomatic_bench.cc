@@ -0,0 +1,638 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  src/tools/dcpomatic_bench.cc
+ *  @brief Run reproducible synthetic workloads through each stage of the
+ *  encoding pipeline and report their throughput and latency.
+ */
+
+
+#include "lib/audio_buffers.h"
+#include "lib/audio_filter.h"
+#include "lib/audio_mapping.h"
+#include "lib/colour_conversion.h"
+#include "lib/cross.h"
+#include "lib/dcp_video.h"
+#include "lib/encode_server.h"
+#include "lib/encode_server_description.h"
+#include "lib/exceptions.h"
+#include "lib/ffmpeg_content.h"
+#include "lib/ffmpeg_file_encoder.h"
+#include "lib/film.h"
+#include "lib/image.h"
+#include "lib/image_content.h"
+#include "lib/image_png.h"
+#include "lib/j2k_image_proxy.h"
+#include "lib/player.h"
+#include "lib/player_video.h"
+#include "lib/raw_image_proxy.h"
+#include "lib/resampler.h"
+#include "lib/scope_guard.h"
+#include "lib/util.h"
+#include "lib/video_content.h"
+#include "lib/version.h"
+#include "lib/writer.h"
+#include <dcp/mono_picture_asset.h>
+#include <dcp/openjpeg_image.h>
+#include <dcp/picture_asset_writer.h>
+#include <dcp/util.h>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+using std::cerr;
+using std::cout;
+using std::function;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using std::weak_ptr;
+using boost::optional;
+
+
+/** Result of running one stage */
+struct Result
+{
+	string name;
+	/** time taken by each iteration in seconds */
+	vector<double> latencies;
+	/** frames processed by each iteration */
+	int frames_per_iteration = 1;
+	/** bytes of input processed by each iteration */
+	int64_t bytes_per_iteration = 0;
+
+	double total () const {
+		double t = 0;
+		for (auto i: latencies) {
+			t += i;
+		}
+		return t;
+	}
+
+	double frames_per_second () const {
+		return latencies.size() * frames_per_iteration / total();
+	}
+
+	double megabytes_per_second () const {
+		return latencies.size() * bytes_per_iteration / (total() * 1e6);
+	}
+
+	/** @param p Percentile in the range [0, 100]
+	 *  @return latency in milliseconds.
+	 */
+	double percentile (double p) const {
+		auto sorted = latencies;
+		std::sort (sorted.begin(), sorted.end());
+		auto const index = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size() / 100));
+		return sorted[index] * 1000;
+	}
+};
+
+
+/** Run one stage of the benchmark.
+ *  @param name Stage name.
+ *  @param iterations Number of times to time run.
+ *  @param run Function to run the workload once.
+ */
+static Result
+time_stage (string name, int iterations, function<void ()> run)
+{
+	Result r;
+	r.name = name;
+
+	/* Once to warm caches, allocators and so on */
+	run ();
+
+	for (int i = 0; i < iterations; ++i) {
+		auto const start = std::chrono::steady_clock::now();
+		run ();
+		r.latencies.push_back (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	return r;
+}
+
+
+/** @return a test image with a reproducible pattern */
+static shared_ptr<Image>
+make_image (AVPixelFormat format, dcp::Size size)
+{
+	auto image = make_shared<Image>(format, size, Image::Alignment::PADDED);
+	for (int c = 0; c < image->planes(); ++c) {
+		auto const lines = image->sample_size(c).height;
+		for (int y = 0; y < lines; ++y) {
+			auto p = image->data()[c] + y * image->stride()[c];
+			for (int x = 0; x < image->line_size()[c]; ++x) {
+				*p++ = (x * 7 + y * 13 + c * 29) & 0xff;
+			}
+		}
+	}
+
+	return image;
+}
+
+
+static shared_ptr<PlayerVideo>
+make_player_video (shared_ptr<Image> image, dcp::Size out_size)
+{
+	return make_shared<PlayerVideo>(
+		make_shared<RawImageProxy>(image),
+		Crop(),
+		optional<double>(),
+		out_size,
+		out_size,
+		Eyes::BOTH,
+		Part::WHOLE,
+		ColourConversion(),
+		VideoRange::FULL,
+		weak_ptr<Content>(),
+		optional<Frame>(),
+		false
+		);
+}
+
+
+static int64_t
+image_bytes (shared_ptr<const Image> image)
+{
+	int64_t bytes = 0;
+	for (int i = 0; i < image->planes(); ++i) {
+		bytes += static_cast<int64_t>(image->line_size()[i]) * image->sample_size(i).height;
+	}
+	return bytes;
+}
+
+
+static void
+output_text (vector<Result> const& results)
+{
+	cout << std::left << std::setw(20) << "stage"
+	     << std::right << std::setw(12) << "frames/s"
+	     << std::setw(12) << "MB/s"
+	     << std::setw(12) << "p50 ms"
+	     << std::setw(12) << "p90 ms"
+	     << std::setw(12) << "p99 ms" << "\n";
+
+	cout << std::fixed << std::setprecision(2);
+	for (auto const& i: results) {
+		cout << std::left << std::setw(20) << i.name
+		     << std::right << std::setw(12) << i.frames_per_second()
+		     << std::setw(12) << i.megabytes_per_second()
+		     << std::setw(12) << i.percentile(50)
+		     << std::setw(12) << i.percentile(90)
+		     << std::setw(12) << i.percentile(99) << "\n";
+	}
+}
+
+
+/** @return x as a JSON number, or null if it is not finite (e.g. a rate from a stage which took no measurable time) */
+static string
+json_number (double x)
+{
+	if (!std::isfinite(x)) {
+		return "null";
+	}
+
+	std::ostringstream s;
+	s << x;
+	return s.str();
+}
+
+
+static void
+output_json (vector<Result> const& results)
+{
+	cout << "{\n";
+	cout << "  \"version\": \"" << dcpomatic_version << "\",\n";
+	cout << "  \"git_commit\": \"" << dcpomatic_git_commit << "\",\n";
+	cout << "  \"threads\": " << boost::thread::hardware_concurrency() << ",\n";
+	cout << "  \"stages\": [\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+		auto const& r = results[i];
+		cout << "    {"
+		     << "\"name\": \"" << r.name << "\", "
+		     << "\"iterations\": " << r.latencies.size() << ", "
+		     << "\"frames_per_second\": " << json_number(r.frames_per_second()) << ", "
+		     << "\"megabytes_per_second\": " << json_number(r.megabytes_per_second()) << ", "
+		     << "\"latency_ms\": {"
+		     << "\"p50\": " << json_number(r.percentile(50)) << ", "
+		     << "\"p90\": " << json_number(r.percentile(90)) << ", "
+		     << "\"p99\": " << json_number(r.percentile(99)) << ", "
+		     << "\"max\": " << json_number(r.percentile(100))
+		     << "}}" << (i == results.size() - 1 ? "" : ",") << "\n";
+	}
+	cout << "  ]\n";
+	cout << "}\n";
+}
+
+
+static void
+help (string n)
+{
+	cerr << "Syntax: " << n << " [OPTION]\n"
+	     << "  -h, --help             show this help\n"
+	     << "  -s, --stage <name>     run only the given stage (may be given more than once)\n"
+	     << "  -i, --iterations <n>   number of timed iterations of each stage (default 20)\n"
+	     << "  -4, --4k               use 4K frames rather than 2K\n"
+	     << "  -f, --film <dir>       film to use for the decode and writer stages (the writer stage will write a DCP into it)\n"
+	     << "  -j, --json             write results as JSON\n"
+	     << "\n"
+	     << "Stages: crop-scale-window alpha-blend convert-to-xyz j2k-encode j2k-decode\n"
+	     << "        remote-encode audio-remap audio-resample audio-filter-direct audio-filter-fft mxf-hash\n"
+	     << "        ffmpeg-decode player-pass decode writer\n";
+}
+
+
+int
+main (int argc, char* argv[])
+{
+	vector<string> stages;
+	int iterations = 20;
+	bool four_k = false;
+	bool json = false;
+	optional<boost::filesystem::path> film_dir;
+
+	while (true) {
+		static struct option long_options[] = {
+			{ "help", no_argument, 0, 'h'},
+			{ "stage", required_argument, 0, 's'},
+			{ "iterations", required_argument, 0, 'i'},
+			{ "4k", no_argument, 0, '4'},
+			{ "film", required_argument, 0, 'f'},
+			{ "json", no_argument, 0, 'j'},
+			{ 0, 0, 0, 0 }
+		};
+
+		int option_index = 0;
+		int c = getopt_long (argc, argv, "hs:i:4f:j", long_options, &option_index);
+
+		if (c == -1) {
+			break;
+		}
+
+		switch (c) {
+		case 'h':
+			help (argv[0]);
+			exit (EXIT_SUCCESS);
+		case 's':
+			stages.push_back (optarg);
+			break;
+		case 'i':
+			iterations = atoi (optarg);
+			break;
+		case '4':
+			four_k = true;
+			break;
+		case 'f':
+			film_dir = optarg;
+			break;
+		case 'j':
+			json = true;
+			break;
+		}
+	}
+
+	if (iterations < 1) {
+		help (argv[0]);
+		exit (EXIT_FAILURE);
+	}
+
+	dcpomatic_setup_path_encoding ();
+	dcpomatic_setup ();
+
+	auto want = [&stages](string name) {
+		return stages.empty() || std::find(stages.begin(), stages.end(), name) != stages.end();
+	};
+
+	auto const size = four_k ? dcp::Size(4096, 2160) : dcp::Size(2048, 1080);
+	auto const resolution = four_k ? Resolution::FOUR_K : Resolution::TWO_K;
+	int const j2k_bandwidth = 250000000;
+
+	vector<Result> results;
+
+	try {
+		auto yuv = make_image (AV_PIX_FMT_YUV420P10LE, dcp::Size(3840, 2160));
+		auto rgb = make_image (AV_PIX_FMT_RGB48LE, size);
+		auto subtitle = make_image (AV_PIX_FMT_BGRA, dcp::Size(size.width / 2, size.height / 8));
+
+		if (want("crop-scale-window")) {
+			auto r = time_stage ("crop-scale-window", iterations, [yuv, size]() {
+				yuv->crop_scale_window (
+					Crop(0, 0, 60, 60), size, size, dcp::YUVToRGB::REC709, VideoRange::VIDEO,
+					AV_PIX_FMT_RGB48LE, VideoRange::FULL, Image::Alignment::PADDED, false
+					);
+			});
+			r.bytes_per_iteration = image_bytes (yuv);
+			results.push_back (r);
+		}
+
+		if (want("alpha-blend")) {
+			auto target = make_shared<Image>(*rgb);
+			auto r = time_stage ("alpha-blend", iterations, [target, subtitle, size]() {
+				target->alpha_blend (subtitle, Position<int>(size.width / 4, size.height * 3 / 4));
+			});
+			r.bytes_per_iteration = image_bytes (subtitle);
+			results.push_back (r);
+		}
+
+		auto player_video = make_player_video (rgb, size);
+
+		if (want("convert-to-xyz")) {
+			auto r = time_stage ("convert-to-xyz", iterations, [player_video]() {
+				DCPVideo::convert_to_xyz (player_video, [](dcp::NoteType, string) {});
+			});
+			r.bytes_per_iteration = image_bytes (rgb);
+			results.push_back (r);
+		}
+
+		DCPVideo dcp_video (player_video, 0, 24, j2k_bandwidth, resolution);
+		auto encoded = dcp_video.encode_locally ();
+
+		if (want("j2k-encode")) {
+			auto r = time_stage ("j2k-encode", iterations, [&dcp_video]() {
+				dcp_video.encode_locally ();
+			});
+			r.bytes_per_iteration = image_bytes (rgb);
+			results.push_back (r);
+		}
+
+		if (want("j2k-decode")) {
+			auto r = time_stage ("j2k-decode", iterations, [encoded, size]() {
+				J2KImageProxy proxy (encoded, size, AV_PIX_FMT_XYZ12LE);
+				proxy.prepare (Image::Alignment::PADDED);
+			});
+			r.bytes_per_iteration = encoded.size();
+			results.push_back (r);
+		}
+
+		if (want("remote-encode")) {
+			/* Encode on a server running on this machine, first with as many requests in flight
+			   as the server has encode threads, then with as many as it asks for; the difference
+			   shows what the server gains by reading requests ahead of its encode threads.
+			*/
+			auto const threads = std::max (1U, boost::thread::hardware_concurrency());
+			EncodeServer server (false, threads);
+			boost::thread server_thread (boost::bind(&EncodeServer::run, &server));
+			ScopeGuard sg ([&server, &server_thread]() {
+				server.stop ();
+				server_thread.join ();
+			});
+
+			/* Let the server get itself ready */
+			dcpomatic_sleep_seconds (1);
+
+			auto frame = make_shared<DCPVideo>(player_video, 0, 24, j2k_bandwidth, resolution);
+			int const frames_per_request = 4;
+
+			for (auto in_flight: { static_cast<int>(threads), server.advertised_threads() }) {
+				EncodeServerDescription description ("127.0.0.1", in_flight, SERVER_LINK_VERSION);
+				auto r = time_stage ("remote-encode-" + std::to_string(in_flight), iterations, [frame, description, in_flight]() {
+					boost::thread_group clients;
+					for (int i = 0; i < in_flight; ++i) {
+						clients.create_thread ([frame, description]() {
+							for (int j = 0; j < frames_per_request; ++j) {
+								frame->encode_remotely (description);
+							}
+						});
+					}
+					clients.join_all ();
+				});
+				r.frames_per_iteration = in_flight * frames_per_request;
+				r.bytes_per_iteration = static_cast<int64_t>(r.frames_per_iteration) * image_bytes(rgb);
+				results.push_back (r);
+			}
+		}
+
+		/* 10 seconds of 16-channel 48kHz audio */
+		int const audio_frames = 480000;
+		auto audio = make_shared<AudioBuffers>(16, audio_frames);
+		for (int c = 0; c < audio->channels(); ++c) {
+			for (int i = 0; i < audio_frames; ++i) {
+				audio->data(c)[i] = sin(2 * M_PI * (c + 1) * 100 * i / 48000);
+			}
+		}
+
+		if (want("audio-remap")) {
+			AudioMapping mapping (16, 16);
+			for (int i = 0; i < 16; ++i) {
+				mapping.set (i, 15 - i, 0.5);
+				mapping.set (i, i, 0.5);
+			}
+			auto r = time_stage ("audio-remap", iterations, [audio, mapping]() {
+				remap (audio, 16, mapping);
+			});
+			r.frames_per_iteration = audio_frames;
+			r.bytes_per_iteration = static_cast<int64_t>(audio_frames) * 16 * sizeof(float);
+			results.push_back (r);
+		}
+
+		if (want("audio-resample")) {
+			auto r = time_stage ("audio-resample", iterations, [audio]() {
+				Resampler resampler (44100, 48000, 16);
+				resampler.run (audio);
+				resampler.flush ();
+			});
+			r.frames_per_iteration = audio_frames;
+			r.bytes_per_iteration = static_cast<int64_t>(audio_frames) * 16 * sizeof(float);
+			results.push_back (r);
+		}
+
+		for (auto method: { AudioFilter::Method::DIRECT, AudioFilter::Method::FFT }) {
+			auto const name = string("audio-filter-") + (method == AudioFilter::Method::DIRECT ? "direct" : "fft");
+			if (want(name)) {
+				/* One of the upmixer's filters, run over the audio in blocks of one video frame */
+				auto r = time_stage (name, iterations, [audio, method]() {
+					BandPassAudioFilter filter (0.02, 1900.0 / 48000, 4800.0 / 48000);
+					filter.set_method (method);
+					for (int i = 0; i < audio->frames(); i += 2000) {
+						filter.run (make_shared<AudioBuffers>(audio, 2000, i));
+					}
+				});
+				r.frames_per_iteration = audio_frames;
+				r.bytes_per_iteration = static_cast<int64_t>(audio_frames) * 16 * sizeof(float);
+				results.push_back (r);
+			}
+		}
+
+		if (want("mxf-hash")) {
+			/* A picture MXF of about 256MB, hashed as Writer::calculate_digests does */
+			auto const path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("dcpomatic_bench_%%%%%%%%.mxf");
+			ScopeGuard sg ([path]() {
+				boost::system::error_code ec;
+				boost::filesystem::remove (path, ec);
+			});
+			int const frames = std::max (1, static_cast<int>(256 * 1024 * 1024 / encoded.size()));
+			{
+				auto asset = make_shared<dcp::MonoPictureAsset>(dcp::Fraction(24, 1), dcp::Standard::SMPTE);
+				auto writer = asset->start_write (path, false);
+				for (int i = 0; i < frames; ++i) {
+					writer->write (encoded.data(), encoded.size());
+				}
+				writer->finalize ();
+			}
+
+			auto r = time_stage ("mxf-hash", iterations, [path]() {
+				dcp::make_digest (path, [](float) {});
+			});
+			r.frames_per_iteration = frames;
+			r.bytes_per_iteration = boost::filesystem::file_size (path);
+			results.push_back (r);
+		}
+
+		if (want("ffmpeg-decode")) {
+			/* Decode an H.264 file which we make here, so that this stage needs no --film and gives
+			   the same workload every time.
+			*/
+			auto const dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("dcpomatic_bench_%%%%-%%%%");
+			boost::filesystem::create_directories (dir);
+			ScopeGuard sg ([dir]() {
+				boost::system::error_code ec;
+				boost::filesystem::remove_all (dir, ec);
+			});
+
+			auto const video = dir / "video.mov";
+			int const frames = 48;
+			{
+				auto source = make_image (AV_PIX_FMT_RGB24, size);
+				FFmpegFileEncoder encoder (size, 24, 48000, 2, ExportFormat::H264_PCM, false, 23, video);
+				auto silence = make_shared<AudioBuffers>(2, 2000);
+				silence->make_silent ();
+				for (int i = 0; i < frames; ++i) {
+					encoder.video (make_player_video(source, size), dcpomatic::DCPTime::from_frames(i, 24));
+					encoder.audio (silence);
+				}
+				encoder.flush ();
+			}
+
+			auto film = make_shared<Film>(dir / "film");
+			film->set_video_frame_rate (24);
+			auto content = make_shared<FFmpegContent>(video);
+			content->examine (film, shared_ptr<Job>());
+			film->add_content (content);
+
+			auto r = time_stage ("ffmpeg-decode", iterations, [film]() {
+				auto player = make_shared<Player>(film, Image::Alignment::PADDED);
+				player->set_ignore_audio ();
+				player->set_ignore_text ();
+				while (!player->pass()) {}
+			});
+			r.frames_per_iteration = frames;
+			r.bytes_per_iteration = boost::filesystem::file_size (video);
+			results.push_back (r);
+		}
+
+		if (want("player-pass")) {
+			/* Films of many one-second stills, like a pre-show playlist, to see how the cost
+			   of Player::pass() grows with the number of pieces of content.  The frames
+			   per second here are calls to pass() per second.
+			*/
+			auto const dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("dcpomatic_bench_%%%%-%%%%");
+			boost::filesystem::create_directories (dir);
+			ScopeGuard sg ([dir]() {
+				boost::system::error_code ec;
+				boost::filesystem::remove_all (dir, ec);
+			});
+			auto const still = dir / "still.png";
+			image_as_png(make_image(AV_PIX_FMT_RGBA, dcp::Size(64, 64))).write(still);
+
+			for (auto pieces: { 10, 100, 500 }) {
+				auto film = make_shared<Film>(dir / ("film_" + std::to_string(pieces)));
+				film->set_video_frame_rate (24);
+				for (int i = 0; i < pieces; ++i) {
+					auto content = make_shared<ImageContent>(still);
+					content->examine (film, shared_ptr<Job>());
+					content->video->set_length (24);
+					film->add_content (content);
+				}
+
+				int passes = 0;
+				auto r = time_stage ("player-pass-" + std::to_string(pieces), iterations, [film, &passes]() {
+					auto player = make_shared<Player>(film, Image::Alignment::PADDED);
+					player->set_ignore_audio ();
+					player->set_ignore_text ();
+					passes = 0;
+					while (!player->pass()) {
+						++passes;
+					}
+				});
+				r.frames_per_iteration = passes;
+				results.push_back (r);
+			}
+		}
+
+		if (film_dir && (want("decode") || want("writer"))) {
+			auto film = make_shared<Film>(*film_dir);
+			film->read_metadata ();
+			auto const length = film->length().frames_round(film->video_frame_rate());
+
+			if (want("decode")) {
+				auto r = time_stage ("decode", iterations, [film]() {
+					auto player = make_shared<Player>(film, Image::Alignment::PADDED);
+					player->set_ignore_audio ();
+					player->set_ignore_text ();
+					while (!player->pass()) {}
+				});
+				r.frames_per_iteration = length;
+				results.push_back (r);
+			}
+
+			if (want("writer")) {
+				auto data = make_shared<dcp::ArrayData>(encoded);
+				auto r = time_stage ("writer", iterations, [film, data, length]() {
+					auto writer = make_shared<Writer>(film, weak_ptr<Job>());
+					writer->start ();
+					for (Frame i = 0; i < length; ++i) {
+						writer->write (data, i, Eyes::BOTH);
+					}
+					writer->finish (film->dir(film->dcp_name()));
+				});
+				r.frames_per_iteration = length;
+				r.bytes_per_iteration = length * encoded.size();
+				results.push_back (r);
+			}
+		} else if (!stages.empty() && (want("decode") || want("writer"))) {
+			cerr << argv[0] << ": the decode and writer stages need a film; use --film\n";
+		}
+	} catch (std::exception& e) {
+		cerr << argv[0] << ": " << e.what() << "\n";
+		exit (EXIT_FAILURE);
+	}
+
+	if (json) {
+		output_json (results);
+	} else {
+		output_text (results);
+	}
+
+	return 0;
+}
@@ -23,6 +23,7 @@
 #include "lib/cross.h"
 #include "lib/dcpomatic_log.h"
 #include "lib/encode_server_finder.h"
+#include "lib/examined_content_cache.h"
 #include "lib/film.h"
 #include "lib/filter.h"
 #include "lib/job_manager.h"
@@ -372,6 +373,8 @@ main (int argc, char* argv[])
 
 	EncodeServerFinder::drop ();
 
+	ExaminedContentCache::drop ();
+
 	if (dcp_path && !error) {
 		cout << film->dir (film->dcp_name (false)).string() << "\n";
 	}
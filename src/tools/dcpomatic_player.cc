@@ -124,6 +124,7 @@ enum {
 	ID_view_scale_quarter,
 	ID_help_report_a_problem,
 	ID_tools_verify,
+	ID_tools_quick_verify,
 	ID_tools_check_for_updates,
 	ID_tools_timing,
 	ID_tools_system_information,
@@ -185,7 +186,8 @@ public:
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::set_decode_reduction, this, optional<int>(2)), ID_view_scale_quarter);
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::help_about, this), wxID_ABOUT);
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::help_report_a_problem, this), ID_help_report_a_problem);
-		Bind (wxEVT_MENU, boost::bind (&DOMFrame::tools_verify, this), ID_tools_verify);
+		Bind (wxEVT_MENU, boost::bind (&DOMFrame::tools_verify, this, false), ID_tools_verify);
+		Bind (wxEVT_MENU, boost::bind (&DOMFrame::tools_verify, this, true), ID_tools_quick_verify);
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::tools_check_for_updates, this), ID_tools_check_for_updates);
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::tools_timing, this), ID_tools_timing);
 		Bind (wxEVT_MENU, boost::bind (&DOMFrame::tools_system_information, this), ID_tools_system_information);
@@ -537,6 +539,7 @@ private:
 
 		auto tools = new wxMenu;
 		_tools_verify = tools->Append (ID_tools_verify, _("Verify DCP..."));
+		_tools_quick_verify = tools->Append (ID_tools_quick_verify, _("Quick verify DCP..."));
 		tools->AppendSeparator ();
 		tools->Append (ID_tools_check_for_updates, _("Check for updates"));
 		tools->Append (ID_tools_timing, _("Timing..."));
@@ -827,12 +830,16 @@ private:
 		_viewer->show_closed_captions ();
 	}
 
-	void tools_verify ()
+	/** @param quick true to take the results of checks on the DCP's assets from the report written
+	 *  when the DCP was made, if there is one which still describes it, and otherwise to make
+	 *  a quicker set of checks using a thread per CPU.
+	 */
+	void tools_verify (bool quick)
 	{
 		auto dcp = std::dynamic_pointer_cast<DCPContent>(_film->content().front());
 		DCPOMATIC_ASSERT (dcp);
 
-		auto job = make_shared<VerifyDCPJob>(dcp->directories());
+		auto job = make_shared<VerifyDCPJob>(dcp->directories(), quick ? VerifyDCPJob::Mode::PARALLEL : VerifyDCPJob::Mode::FULL, quick);
 		auto progress = new VerifyDCPProgressDialog(this, _("DCP-o-matic Player"));
 		bool const completed = progress->run (job);
 		progress->Destroy ();
@@ -984,6 +991,7 @@ private:
 	void set_menu_sensitivity ()
 	{
 		_tools_verify->Enable (static_cast<bool>(_film));
+		_tools_quick_verify->Enable (static_cast<bool>(_film));
 		_file_add_ov->Enable (static_cast<bool>(_film));
 		_file_add_kdm->Enable (static_cast<bool>(_film));
 		_file_save_frame->Enable (static_cast<bool>(_film));
@@ -1046,6 +1054,7 @@ private:
 	wxMenuItem* _file_add_kdm = nullptr;
 	wxMenuItem* _file_save_frame = nullptr;
 	wxMenuItem* _tools_verify = nullptr;
+	wxMenuItem* _tools_quick_verify = nullptr;
 	wxMenuItem* _view_full_screen = nullptr;
 	wxMenuItem* _view_dual_screen = nullptr;
 	wxSizer* _main_sizer = nullptr;
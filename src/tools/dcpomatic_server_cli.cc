@@ -28,6 +28,7 @@
 #include "lib/null_log.h"
 #include "lib/version.h"
 #include "lib/encode_server.h"
+#include "lib/json_server.h"
 #include "lib/dcpomatic_log.h"
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
@@ -55,6 +56,8 @@ help (string n)
 	     << "  -v, --version      show DCP-o-matic version\n"
 	     << "  -h, --help         show this help\n"
 	     << "  -t, --threads      number of parallel encoding threads to use\n"
+	     << "  -j, --json <port>  run a JSON server (with metrics at /metrics) on the specified port\n"
+	     << "  --numa             give each NUMA node its own encoding threads\n"
 	     << "  --verbose          be verbose to stdout\n"
 	     << "  --log              write a log file of activity\n";
 }
@@ -68,6 +71,7 @@ main (int argc, char* argv[])
 	int num_threads = Config::instance()->server_encoding_threads ();
 	bool verbose = false;
 	bool write_log = false;
+	boost::optional<int> json_port;
 
 	int option_index = 0;
 	while (true) {
@@ -75,12 +79,14 @@ main (int argc, char* argv[])
 			{ "version", no_argument, 0, 'v'},
 			{ "help", no_argument, 0, 'h'},
 			{ "threads", required_argument, 0, 't'},
+			{ "json", required_argument, 0, 'j'},
 			{ "verbose", no_argument, 0, 'A'},
 			{ "log", no_argument, 0, 'B'},
+			{ "numa", no_argument, 0, 'C'},
 			{ 0, 0, 0, 0 }
 		};
 
-		int c = getopt_long (argc, argv, "vht:AB", long_options, &option_index);
+		int c = getopt_long (argc, argv, "vht:j:ABC", long_options, &option_index);
 
 		if (c == -1) {
 			break;
@@ -96,12 +102,18 @@ main (int argc, char* argv[])
 		case 't':
 			num_threads = atoi (optarg);
 			break;
+		case 'j':
+			json_port = atoi (optarg);
+			break;
 		case 'A':
 			verbose = true;
 			break;
 		case 'B':
 			write_log = true;
 			break;
+		case 'C':
+			Config::instance()->set_server_numa_pinning (true);
+			break;
 		}
 	}
 
@@ -111,6 +123,10 @@ main (int argc, char* argv[])
 
 	EncodeServer server (verbose, num_threads);
 
+	if (json_port) {
+		new JSONServer (json_port.get());
+	}
+
 	try {
 		server.run ();
 	} catch (boost::system::system_error& e) {
@@ -654,6 +654,10 @@ FilmViewer::time () const
 }
 
 
+/** Called by RtAudio on its real-time thread, so this must not block.  The butler
+ *  has already mapped the audio to our output channels, and NON_BLOCKING get_audio()
+ *  takes no locks.
+ */
 int
 FilmViewer::audio_callback (void* out_p, unsigned int frames)
 {
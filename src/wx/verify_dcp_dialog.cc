@@ -70,8 +70,11 @@ VerifyDCPDialog::VerifyDCPDialog (wxWindow* parent, shared_ptr<VerifyDCPJob> job
 		i.second->GetCaret()->Hide();
 	}
 
+	wxString const write_report_text = job->used_write_report() ?
+		wxString(_(" Some checks were taken from the report written when the DCP was made.")) : wxString();
+
 	if (job->finished_ok() && job->notes().empty()) {
-		summary->SetLabel (_("DCP validates OK."));
+		summary->SetLabel (_("DCP validates OK.") + write_report_text);
 		return;
 	}
 
@@ -400,7 +403,7 @@ VerifyDCPDialog::VerifyDCPDialog (wxWindow* parent, shared_ptr<VerifyDCPJob> job
 		summary_text += wxString::Format("and %d warnings.", counts[dcp::VerificationNote::Type::WARNING]);
 	}
 
-	summary->SetLabel(summary_text);
+	summary->SetLabel(summary_text + write_report_text);
 
 	if (counts[dcp::VerificationNote::Type::ERROR] == 0) {
 		add_bullet (dcp::VerificationNote::Type::ERROR, _("No errors found."));
@@ -31,6 +31,7 @@
 #include "lib/analyse_audio_job.h"
 #include "lib/audio_analysis.h"
 #include "lib/audio_content.h"
+#include "lib/config.h"
 #include "lib/content_factory.h"
 #include "lib/dcp_content_type.h"
 #include "lib/ffmpeg_content.h"
@@ -39,6 +40,8 @@
 #include "lib/job_manager.h"
 #include "lib/playlist.h"
 #include "lib/ratio.h"
+#include "lib/util.h"
+#include <boost/filesystem/fstream.hpp>
 #include <boost/test/unit_test.hpp>
 #include <iostream>
 
@@ -100,6 +103,78 @@ BOOST_AUTO_TEST_CASE (audio_analysis_serialisation_test)
 }
 
 
+/** Check that an old XML analysis file is read correctly, left alone, and can be written in the binary format */
+BOOST_AUTO_TEST_CASE (audio_analysis_xml_migration_test)
+{
+	boost::filesystem::path const path = "build/test/audio_analysis_xml_migration_test";
+
+	{
+		boost::filesystem::ofstream f (path);
+		f << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		  << "<AudioAnalysis>\n"
+		  << "  <Version>3</Version>\n"
+		  << "  <Channel>\n"
+		  << "    <Point><Peak>0.5</Peak><RMS>0.25</RMS></Point>\n"
+		  << "    <Point><Peak>0.75</Peak><RMS>0.125</RMS></Point>\n"
+		  << "  </Channel>\n"
+		  << "  <SamplePeak Time=\"96000\">0.75</SamplePeak>\n"
+		  << "  <TruePeak>0.8</TruePeak>\n"
+		  << "  <IntegratedLoudness>-23.5</IntegratedLoudness>\n"
+		  << "  <SamplesPerPoint>1000</SamplesPerPoint>\n"
+		  << "  <SampleRate>48000</SampleRate>\n"
+		  << "</AudioAnalysis>\n";
+	}
+
+	auto check = [](AudioAnalysis const& a) {
+		BOOST_REQUIRE_EQUAL (a.channels(), 1);
+		BOOST_REQUIRE_EQUAL (a.points(0), 2);
+		BOOST_CHECK_CLOSE (a.get_point(0, 0)[AudioPoint::PEAK], 0.5, 0.1);
+		BOOST_CHECK_CLOSE (a.get_point(0, 0)[AudioPoint::RMS], 0.25, 0.1);
+		BOOST_CHECK_CLOSE (a.get_point(0, 1)[AudioPoint::PEAK], 0.75, 0.1);
+		BOOST_CHECK_CLOSE (a.get_point(0, 1)[AudioPoint::RMS], 0.125, 0.1);
+		BOOST_REQUIRE_EQUAL (a.sample_peak().size(), 1U);
+		BOOST_CHECK_EQUAL (a.sample_peak()[0].time.get(), 96000);
+		BOOST_REQUIRE_EQUAL (a.true_peak().size(), 1U);
+		BOOST_CHECK_CLOSE (a.true_peak()[0], 0.8, 0.1);
+		BOOST_REQUIRE (a.integrated_loudness());
+		BOOST_CHECK_CLOSE (*a.integrated_loudness(), -23.5, 0.1);
+		BOOST_CHECK (!a.loudness_range());
+		BOOST_CHECK (!a.leqm());
+		BOOST_CHECK_EQUAL (a.samples_per_point(), 1000);
+		BOOST_CHECK_EQUAL (a.sample_rate(), 48000);
+	};
+
+	AudioAnalysis from_xml (path);
+	check (from_xml);
+
+	/* Reading the file should not have changed it */
+	{
+		boost::filesystem::ifstream f (path);
+		char c;
+		f.get (c);
+		BOOST_CHECK_EQUAL (c, '<');
+	}
+
+	boost::filesystem::path const binary_path = "build/test/audio_analysis_xml_migration_test.binary";
+	from_xml.write (binary_path);
+
+	{
+		boost::filesystem::ifstream f (binary_path);
+		char c;
+		f.get (c);
+		BOOST_CHECK (c != '<');
+	}
+
+	auto from_binary = make_shared<AudioAnalysis>(binary_path);
+	check (*from_binary);
+
+	/* A copy must still be usable once the original has gone */
+	AudioAnalysis copy (*from_binary);
+	from_binary.reset ();
+	check (copy);
+}
+
+
 BOOST_AUTO_TEST_CASE (audio_analysis_test)
 {
 	auto film = new_test_film ("audio_analysis_test");
@@ -219,3 +294,125 @@ BOOST_AUTO_TEST_CASE (analyse_audio_leqm_test)
 	/* The CLI tool of leqm_nrt gives this value for betty_stereo_48k.wav */
 	BOOST_CHECK_CLOSE (analysis.leqm().get_value_or(0), 88.276, 0.001);
 }
+
+
+/** Check that an analysis of non-overlapping content made from separate analyses of each piece agrees
+ *  with analyses of the individual pieces, and that a change of gain only needs the analysis to be combined again.
+ */
+BOOST_AUTO_TEST_CASE (analyse_audio_by_content_test)
+{
+	ConfigRestorer cr;
+	Config::instance()->set_analyse_ebur128 (false);
+
+	auto film = new_test_film2 ("analyse_audio_by_content_test");
+	auto sine = content_factory("test/data/sine_440.wav").front();
+	auto white = content_factory("test/data/white.wav").front();
+	film->examine_and_add_content (sine);
+	film->examine_and_add_content (white);
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	sine->set_position (film, DCPTime());
+	white->set_position (film, sine->end(film) + DCPTime::from_seconds(1));
+
+	auto analyse = [film]() {
+		boost::signals2::connection c;
+		JobManager::instance()->analyse_audio(film, film->playlist(), false, c, []() {});
+		BOOST_REQUIRE (!wait_for_jobs());
+		return AudioAnalysis (film->audio_analysis_path(film->playlist()));
+	};
+
+	auto const combined = analyse ();
+	BOOST_REQUIRE (boost::filesystem::exists(film->content_audio_analysis_path(sine)));
+	BOOST_REQUIRE (boost::filesystem::exists(film->content_audio_analysis_path(white)));
+
+	AudioAnalysis sine_analysis (film->content_audio_analysis_path(sine));
+	AudioAnalysis white_analysis (film->content_audio_analysis_path(white));
+
+	BOOST_REQUIRE_EQUAL (combined.channels(), film->audio_channels());
+	BOOST_CHECK_EQUAL (combined.points(0), 1024);
+	for (int i = 0; i < std::min(combined.channels(), sine_analysis.channels()); ++i) {
+		auto const peak = std::max(sine_analysis.sample_peak()[i].peak, white_analysis.sample_peak()[i].peak);
+		BOOST_CHECK_CLOSE (combined.sample_peak()[i].peak, peak, 0.001);
+	}
+
+	/* Changing the gain of one piece of content should change the combined result without
+	   re-analysing the content.
+	*/
+	auto const white_time = boost::filesystem::last_write_time(film->content_audio_analysis_path(white));
+	white->audio->set_gain (-6);
+	auto const quieter = analyse ();
+	BOOST_CHECK (boost::filesystem::last_write_time(film->content_audio_analysis_path(white)) == white_time);
+	for (int i = 0; i < std::min(quieter.channels(), white_analysis.channels()); ++i) {
+		auto const peak = std::max(sine_analysis.sample_peak()[i].peak, white_analysis.sample_peak()[i].peak * static_cast<float>(db_to_linear(-6)));
+		BOOST_CHECK_CLOSE (quieter.sample_peak()[i].peak, peak, 0.001);
+	}
+}
+
+
+/** Check that per-content analyses are removed once they can no longer be used */
+BOOST_AUTO_TEST_CASE (analyse_audio_by_content_stale_test)
+{
+	ConfigRestorer cr;
+	Config::instance()->set_analyse_ebur128 (false);
+
+	auto film = new_test_film2 ("analyse_audio_by_content_stale_test");
+	auto sine = content_factory("test/data/sine_440.wav").front();
+	auto white = content_factory("test/data/white.wav").front();
+	film->examine_and_add_content (sine);
+	film->examine_and_add_content (white);
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	white->set_position (film, sine->end(film) + DCPTime::from_seconds(1));
+
+	auto analyse = [film]() {
+		boost::signals2::connection c;
+		JobManager::instance()->analyse_audio(film, film->playlist(), false, c, []() {});
+		BOOST_REQUIRE (!wait_for_jobs());
+	};
+
+	analyse ();
+	auto const old_white = film->content_audio_analysis_path(white);
+	BOOST_REQUIRE (boost::filesystem::exists(old_white));
+
+	/* A new delay means a new analysis, and the old one is useless */
+	white->audio->set_delay (40);
+	analyse ();
+	BOOST_CHECK (boost::filesystem::exists(film->content_audio_analysis_path(white)));
+	BOOST_CHECK (!boost::filesystem::exists(old_white));
+
+	/* Removing content leaves its analysis until the next analysis job tidies up */
+	auto const sine_path = film->content_audio_analysis_path(sine);
+	BOOST_REQUIRE (boost::filesystem::exists(sine_path));
+	film->remove_content (sine);
+	BOOST_CHECK (boost::filesystem::exists(sine_path));
+	analyse ();
+	BOOST_CHECK (!boost::filesystem::exists(sine_path));
+	BOOST_CHECK (boost::filesystem::exists(film->content_audio_analysis_path(white)));
+}
+
+
+/** Check that non-overlapping content is analysed as a whole if we need EBU R128 loudness values,
+ *  since those can't be made from analyses of each piece of content.
+ */
+BOOST_AUTO_TEST_CASE (analyse_audio_by_content_ebur128_test)
+{
+	auto film = new_test_film2 ("analyse_audio_by_content_ebur128_test");
+	auto sine = content_factory("test/data/sine_440.wav").front();
+	auto white = content_factory("test/data/white.wav").front();
+	film->examine_and_add_content (sine);
+	film->examine_and_add_content (white);
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	white->set_position (film, sine->end(film) + DCPTime::from_seconds(1));
+
+	boost::signals2::connection c;
+	JobManager::instance()->analyse_audio(film, film->playlist(), false, c, []() {});
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	BOOST_CHECK (!boost::filesystem::exists(film->content_audio_analysis_path(sine)));
+	BOOST_CHECK (!boost::filesystem::exists(film->content_audio_analysis_path(white)));
+
+	AudioAnalysis analysis (film->audio_analysis_path(film->playlist()));
+	BOOST_CHECK (analysis.integrated_loudness());
+	BOOST_CHECK (analysis.loudness_range());
+}
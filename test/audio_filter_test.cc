@@ -28,14 +28,16 @@
 #include <boost/test/unit_test.hpp>
 #include "lib/audio_filter.h"
 #include "lib/audio_buffers.h"
+#include <cmath>
 
 
 using std::make_shared;
 using std::shared_ptr;
 
 
+/** @param tolerance Maximum allowed difference between an output sample and what we expect */
 static void
-audio_filter_impulse_test_one (AudioFilter& f, int block_size, int num_blocks)
+audio_filter_impulse_test_one (AudioFilter& f, int block_size, int num_blocks, float tolerance)
 {
 	int c = 0;
 
@@ -49,7 +51,11 @@ audio_filter_impulse_test_one (AudioFilter& f, int block_size, int num_blocks)
 		auto out = f.run (in);
 
 		for (int j = 0; j < out->frames(); ++j) {
-			BOOST_CHECK_EQUAL (out->data()[0][j], c + j);
+			if (tolerance == 0) {
+				BOOST_CHECK_EQUAL (out->data()[0][j], c + j);
+			} else {
+				BOOST_CHECK_SMALL (out->data()[0][j] - (c + j), tolerance);
+			}
 		}
 
 		c += block_size;
@@ -62,17 +68,23 @@ audio_filter_impulse_test_one (AudioFilter& f, int block_size, int num_blocks)
  */
 BOOST_AUTO_TEST_CASE (audio_filter_impulse_kernel_test)
 {
-	AudioFilter f (0.02);
+	for (auto method: { AudioFilter::Method::DIRECT, AudioFilter::Method::FFT }) {
+		AudioFilter f (0.02);
+		f.set_method (method);
+
+		f._ir.resize(f._M + 1);
+		f._ir[0] = 1;
+		for (int i = 1; i <= f._M; ++i) {
+			f._ir[i] = 0;
+		}
 
-	f._ir.reserve(f._M + 1);
-	f._ir[0] = 1;
-	for (int i = 1; i <= f._M; ++i) {
-		f._ir[i] = 0;
-	}
+		/* The FFT method has some rounding error which is bigger for bigger inputs */
+		float const tolerance = method == AudioFilter::Method::DIRECT ? 0 : 2e-3;
 
-	audio_filter_impulse_test_one (f, 32, 1);
-	audio_filter_impulse_test_one (f, 256, 1);
-	audio_filter_impulse_test_one (f, 2048, 1);
+		audio_filter_impulse_test_one (f, 32, 1, tolerance);
+		audio_filter_impulse_test_one (f, 256, 1, tolerance);
+		audio_filter_impulse_test_one (f, 2048, 1, tolerance);
+	}
 }
 
 
@@ -81,33 +93,83 @@ BOOST_AUTO_TEST_CASE (audio_filter_impulse_kernel_test)
  */
 BOOST_AUTO_TEST_CASE (audio_filter_impulse_input_test)
 {
-	LowPassAudioFilter lpf (0.02, 0.3);
-
-	auto in = make_shared<AudioBuffers>(1, 1751);
-	in->make_silent ();
-	in->data(0)[0] = 1;
-
-	auto out = lpf.run (in);
-	for (int j = 0; j < out->frames(); ++j) {
-		if (j <= lpf._M) {
-			BOOST_CHECK_EQUAL (out->data(0)[j], lpf._ir[j]);
-		} else {
-			BOOST_CHECK_EQUAL (out->data(0)[j], 0);
+	for (auto method: { AudioFilter::Method::DIRECT, AudioFilter::Method::FFT }) {
+		/* The FFT method has some rounding error */
+		float const tolerance = method == AudioFilter::Method::DIRECT ? 0 : 1e-5f;
+
+		LowPassAudioFilter lpf (0.02, 0.3);
+		lpf.set_method (method);
+
+		auto in = make_shared<AudioBuffers>(1, 1751);
+		in->make_silent ();
+		in->data(0)[0] = 1;
+
+		auto out = lpf.run (in);
+		for (int j = 0; j < out->frames(); ++j) {
+			if (j <= lpf._M) {
+				BOOST_CHECK_SMALL (out->data(0)[j] - lpf._ir[j], tolerance);
+			} else {
+				BOOST_CHECK_SMALL (out->data(0)[j], tolerance);
+			}
 		}
-	}
 
-	HighPassAudioFilter hpf (0.02, 0.3);
+		HighPassAudioFilter hpf (0.02, 0.3);
+		hpf.set_method (method);
 
-	in = make_shared<AudioBuffers>(1, 9133);
-	in->make_silent ();
-	in->data(0)[0] = 1;
+		in = make_shared<AudioBuffers>(1, 9133);
+		in->make_silent ();
+		in->data(0)[0] = 1;
 
-	out = hpf.run (in);
-	for (int j = 0; j < out->frames(); ++j) {
-		if (j <= hpf._M) {
-			BOOST_CHECK_EQUAL (out->data(0)[j], hpf._ir[j]);
-		} else {
-			BOOST_CHECK_EQUAL (out->data(0)[j], 0);
+		out = hpf.run (in);
+		for (int j = 0; j < out->frames(); ++j) {
+			if (j <= hpf._M) {
+				BOOST_CHECK_SMALL (out->data(0)[j] - hpf._ir[j], tolerance);
+			} else {
+				BOOST_CHECK_SMALL (out->data(0)[j], tolerance);
+			}
 		}
 	}
 }
+
+
+/** Check that the FFT method gives the same results as the direct one */
+BOOST_AUTO_TEST_CASE (audio_filter_fft_test)
+{
+	auto check = [](AudioFilter& direct, AudioFilter& fft) {
+		direct.set_method (AudioFilter::Method::DIRECT);
+		fft.set_method (AudioFilter::Method::FFT);
+
+		srand (1);
+		/* Various block sizes, including some smaller than the filter and some bigger than an FFT */
+		for (auto frames: { 1, 37, 2000, 401, 4096, 10000, 3 }) {
+			/* An odd number of channels, as the FFT method does channels in pairs */
+			auto in = make_shared<AudioBuffers>(3, frames);
+			for (int c = 0; c < in->channels(); ++c) {
+				for (int i = 0; i < frames; ++i) {
+					in->data(c)[i] = float(rand()) / RAND_MAX * 2 - 1;
+				}
+			}
+
+			auto direct_out = direct.run (in);
+			auto fft_out = fft.run (in);
+			BOOST_REQUIRE_EQUAL (fft_out->frames(), frames);
+			for (int c = 0; c < in->channels(); ++c) {
+				for (int i = 0; i < frames; ++i) {
+					BOOST_REQUIRE_SMALL (fft_out->data(c)[i] - direct_out->data(c)[i], 1e-5f);
+				}
+			}
+		}
+	};
+
+	LowPassAudioFilter lpf_direct (0.01, 150.0 / 48000);
+	LowPassAudioFilter lpf_fft (0.01, 150.0 / 48000);
+	check (lpf_direct, lpf_fft);
+
+	HighPassAudioFilter hpf_direct (0.02, 0.3);
+	HighPassAudioFilter hpf_fft (0.02, 0.3);
+	check (hpf_direct, hpf_fft);
+
+	BandPassAudioFilter bpf_direct (0.02, 1900.0 / 48000, 4800.0 / 48000);
+	BandPassAudioFilter bpf_fft (0.02, 1900.0 / 48000, 4800.0 / 48000);
+	check (bpf_direct, bpf_fft);
+}
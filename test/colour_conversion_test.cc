@@ -27,7 +27,11 @@
 
 #include "lib/colour_conversion.h"
 #include "lib/film.h"
+#include "lib/image.h"
+#include "lib/xyz_converter.h"
 #include <dcp/gamma_transfer_function.h>
+#include <dcp/openjpeg_image.h>
+#include <dcp/rgb_xyz.h>
 #include <libxml++/libxml++.h>
 #include <boost/test/unit_test.hpp>
 #include <iostream>
@@ -121,3 +125,103 @@ BOOST_AUTO_TEST_CASE (colour_conversion_test4)
 		BOOST_CHECK (ColourConversion::from_xml(in, Film::current_state_version).get() == i.conversion);
 	}
 }
+
+
+/** Check that XYZConverter gives the same results as dcp::rgb_to_xyz, with and without a fade */
+BOOST_AUTO_TEST_CASE (colour_conversion_xyz_converter_test)
+{
+	dcp::Size const size (640, 480);
+	auto image = make_shared<Image>(AV_PIX_FMT_RGB48LE, size, Image::Alignment::PADDED);
+	for (int y = 0; y < size.height; ++y) {
+		auto p = reinterpret_cast<uint16_t*>(image->data()[0] + y * image->stride()[0]);
+		for (int x = 0; x < size.width; ++x) {
+			*p++ = (x * 97 + y * 13) & 0xffff;
+			*p++ = (x * 31 + y * 211) & 0xffff;
+			*p++ = (x * 7 + y * 1009) & 0xffff;
+		}
+	}
+
+	for (auto const& conversion: PresetColourConversion::all()) {
+		for (auto fade: { boost::optional<double>(), boost::optional<double>(0.37) }) {
+			auto reference_input = make_shared<Image>(*image);
+			if (fade) {
+				reference_input->fade (*fade);
+			}
+			auto reference = dcp::rgb_to_xyz (
+				reference_input->data()[0], size, reference_input->stride()[0], conversion.conversion, boost::optional<dcp::NoteHandler>()
+				);
+
+			auto check = XYZConverter::get(conversion.conversion)->convert(image, fade, boost::optional<dcp::NoteHandler>());
+
+			for (int c = 0; c < 3; ++c) {
+				auto r = reference->data(c);
+				auto k = check->data(c);
+				for (int i = 0; i < size.width * size.height; ++i) {
+					BOOST_REQUIRE (std::abs(*r++ - *k++) <= 1);
+				}
+			}
+		}
+	}
+}
+
+
+/** Check that XYZConverter's crop, padding, subtitle blend and fade give the same results
+ *  as doing those things with Image and then using dcp::rgb_to_xyz.
+ */
+BOOST_AUTO_TEST_CASE (colour_conversion_xyz_converter_fused_test)
+{
+	dcp::Size const size (640, 480);
+	auto image = make_shared<Image>(AV_PIX_FMT_RGB48LE, size, Image::Alignment::PADDED);
+	for (int y = 0; y < size.height; ++y) {
+		auto p = reinterpret_cast<uint16_t*>(image->data()[0] + y * image->stride()[0]);
+		for (int x = 0; x < size.width; ++x) {
+			*p++ = (x * 97 + y * 13) & 0xffff;
+			*p++ = (x * 31 + y * 211) & 0xffff;
+			*p++ = (x * 7 + y * 1009) & 0xffff;
+		}
+	}
+
+	dcp::Size const text_size (200, 40);
+	auto text_image = make_shared<Image>(AV_PIX_FMT_BGRA, text_size, Image::Alignment::PADDED);
+	for (int y = 0; y < text_size.height; ++y) {
+		auto p = text_image->data()[0] + y * text_image->stride()[0];
+		for (int x = 0; x < text_size.width; ++x) {
+			*p++ = x & 0xff;
+			*p++ = y * 5;
+			*p++ = 255 - x;
+			*p++ = (x * 3 + y) & 0xff;
+		}
+	}
+	/* Partly off the bottom-left of the output, and partly over the padding */
+	PositionImage const text (text_image, Position<int>(-20, 470));
+
+	Crop const crop (10, 30, 4, 16);
+	dcp::Size const cropped = crop.apply (size);
+	dcp::Size const out_size (cropped.width + 60, cropped.height + 40);
+
+	auto const conversion = PresetColourConversion::all().front().conversion;
+
+	for (auto fade: { boost::optional<double>(), boost::optional<double>(0.61) }) {
+		auto reference_input = image->crop_scale_window (
+			crop, cropped, out_size, dcp::YUVToRGB::REC709, VideoRange::FULL, AV_PIX_FMT_RGB48LE, VideoRange::FULL, Image::Alignment::COMPACT, false
+			);
+		reference_input->alpha_blend (text.image, text.position);
+		if (fade) {
+			reference_input->fade (*fade);
+		}
+		auto reference = dcp::rgb_to_xyz (
+			reference_input->data()[0], out_size, reference_input->stride()[0], conversion, boost::optional<dcp::NoteHandler>()
+			);
+
+		auto check = XYZConverter::get(conversion)->convert(image, crop, out_size, text, fade, boost::optional<dcp::NoteHandler>());
+		BOOST_REQUIRE (check->size() == out_size);
+
+		for (int c = 0; c < 3; ++c) {
+			auto r = reference->data(c);
+			auto k = check->data(c);
+			for (int i = 0; i < out_size.width * out_size.height; ++i) {
+				BOOST_REQUIRE (std::abs(*r++ - *k++) <= 1);
+			}
+		}
+	}
+}
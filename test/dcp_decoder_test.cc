@@ -88,6 +88,8 @@ BOOST_AUTO_TEST_CASE (check_reuse_old_data_test)
 	test->examine_and_add_content (ov_content);
 	BOOST_REQUIRE (!wait_for_jobs());
 	auto player = make_shared<Player>(test, Image::Alignment::COMPACT);
+	/* Decoders are made when they are first needed, so make this one now */
+	player->open_decoder (player->_pieces.front());
 
 	auto decoder = std::dynamic_pointer_cast<DCPDecoder>(player->_pieces.front()->decoder);
 	BOOST_REQUIRE (decoder);
@@ -106,6 +108,7 @@ BOOST_AUTO_TEST_CASE (check_reuse_old_data_test)
 	test->examine_and_add_content (vf_content);
 	BOOST_REQUIRE (!wait_for_jobs());
 	player = make_shared<Player>(test, Image::Alignment::COMPACT);
+	player->open_decoder (player->_pieces.front());
 
 	decoder = std::dynamic_pointer_cast<DCPDecoder>(player->_pieces.front()->decoder);
 	BOOST_REQUIRE (decoder);
@@ -124,6 +127,7 @@ BOOST_AUTO_TEST_CASE (check_reuse_old_data_test)
 	test->examine_and_add_content (encrypted_content);
 	BOOST_REQUIRE (!wait_for_jobs());
 	player = make_shared<Player>(test, Image::Alignment::COMPACT);
+	player->open_decoder (player->_pieces.front());
 
 	decoder = std::dynamic_pointer_cast<DCPDecoder>(player->_pieces.front()->decoder);
 	BOOST_REQUIRE (decoder);
@@ -0,0 +1,137 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/examined_content_cache_test.cc
+ *  @brief Test ExaminedContentCache.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/cross.h"
+#include "lib/examined_content_cache.h"
+#include "lib/ffmpeg_audio_stream.h"
+#include "lib/ffmpeg_content.h"
+#include "lib/film.h"
+#include "lib/util.h"
+#include "lib/video_content.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include <ctime>
+
+
+using std::make_shared;
+using std::vector;
+
+
+BOOST_AUTO_TEST_CASE (examined_content_cache_test)
+{
+	auto const dir = boost::filesystem::path("build/test/examined_content_cache_test_files");
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+	auto const file = dir / "count300bd24.m2ts";
+	boost::filesystem::copy_file ("test/data/count300bd24.m2ts", file);
+
+	auto cache = ExaminedContentCache::instance ();
+	cache->clear ();
+
+	/* Files which have only just been written are not cached */
+	auto content = make_shared<FFmpegContent>(file);
+	auto film = new_test_film2 ("examined_content_cache_test", { content });
+	BOOST_CHECK (!cache->examination(vector<boost::filesystem::path>{file}, "FFmpeg"));
+
+	boost::filesystem::last_write_time (file, time(nullptr) - 60);
+
+	auto first = make_shared<FFmpegContent>(file);
+	film->examine_and_add_content (first);
+	BOOST_REQUIRE (!wait_for_jobs());
+	BOOST_CHECK (cache->examination(vector<boost::filesystem::path>{file}, "FFmpeg"));
+	BOOST_CHECK_EQUAL (cache->digest({file}), simple_digest({file}));
+
+	/* The second examination should come from the cache, and give the same results */
+	auto second = make_shared<FFmpegContent>(file);
+	film->examine_and_add_content (second);
+	BOOST_REQUIRE (!wait_for_jobs());
+	BOOST_CHECK_EQUAL (first->digest(), second->digest());
+	BOOST_REQUIRE (second->video);
+	BOOST_CHECK_EQUAL (first->video->length(), second->video->length());
+	BOOST_CHECK (first->video->size() == second->video->size());
+	BOOST_CHECK (first->first_video() == second->first_video());
+	BOOST_REQUIRE (second->audio);
+	BOOST_REQUIRE_EQUAL (first->ffmpeg_audio_streams().size(), second->ffmpeg_audio_streams().size());
+	BOOST_CHECK (first->ffmpeg_audio_streams()[0]->first_audio == second->ffmpeg_audio_streams()[0]->first_audio);
+
+	/* A change to the file means that the cached results are not used */
+	{
+		auto f = fopen_boost (file, "ab");
+		BOOST_REQUIRE (f);
+		fputc (0, f);
+		fclose (f);
+	}
+	boost::filesystem::last_write_time (file, time(nullptr) - 30);
+	BOOST_CHECK (!cache->examination(vector<boost::filesystem::path>{file}, "FFmpeg"));
+	BOOST_CHECK (second->changed());
+}
+
+
+/** Two caches (as if in different processes) writing to the same file should not lose each other's entries */
+BOOST_AUTO_TEST_CASE (examined_content_cache_merge_test)
+{
+	auto const dir = boost::filesystem::path("build/test/examined_content_cache_merge_test_files");
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+	auto const a = dir / "a";
+	auto const b = dir / "b";
+	for (auto i: { a, b }) {
+		auto f = fopen_boost (i, "wb");
+		BOOST_REQUIRE (f);
+		fputc (0, f);
+		fclose (f);
+		boost::filesystem::last_write_time (i, time(nullptr) - 60);
+	}
+
+	auto cache = ExaminedContentCache::instance ();
+	cache->clear ();
+	cache->flush ();
+
+	{
+		ExaminedContentCache other;
+		other.read ();
+		other.set_examination ({a}, "Test", "<A/>");
+		other.flush ();
+	}
+
+	/* Nothing is written until we flush */
+	cache->set_examination ({b}, "Test", "<B/>");
+	{
+		ExaminedContentCache check;
+		check.read ();
+		BOOST_CHECK (check.examination({a}, "Test"));
+		BOOST_CHECK (!check.examination({b}, "Test"));
+	}
+
+	cache->flush ();
+
+	ExaminedContentCache check;
+	check.read ();
+	BOOST_CHECK (check.examination({a}, "Test").get_value_or("") == "<A/>");
+	BOOST_CHECK (check.examination({b}, "Test").get_value_or("") == "<B/>");
+	BOOST_CHECK (cache->examination({a}, "Test"));
+}
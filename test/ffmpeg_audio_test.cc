@@ -32,6 +32,10 @@
 #include "lib/ratio.h"
 #include "lib/ffmpeg_content.h"
 #include "lib/content_factory.h"
+#include "lib/audio_buffers.h"
+#include "lib/audio_content.h"
+#include "lib/audio_decoder.h"
+#include "lib/ffmpeg_decoder.h"
 #include "lib/player.h"
 #include "test.h"
 #include <dcp/cpl.h>
@@ -42,9 +46,11 @@
 #include <dcp/sound_asset_reader.h>
 #include <dcp/reel.h>
 #include <boost/test/unit_test.hpp>
+#include <cmath>
 
 
 using std::make_shared;
+using std::map;
 using std::string;
 using std::shared_ptr;
 
@@ -167,3 +173,45 @@ BOOST_AUTO_TEST_CASE (ffmpeg_audio_test4)
 	BOOST_CHECK_NO_THROW (while (!player->pass()) {});
 }
 
+
+
+/** Check that audio streams with nothing mapped are not decoded, and that this does not change
+ *  what comes out of the streams that are.
+ */
+BOOST_AUTO_TEST_CASE (ffmpeg_audio_test5)
+{
+	auto film = new_test_film2 ("ffmpeg_audio_test5");
+	auto content = make_shared<FFmpegContent>(TestPaths::private_data() / "RockyTop10 Playlist Flat.m4v");
+	film->examine_and_add_content (content);
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	auto streams = content->audio->streams();
+	BOOST_REQUIRE_EQUAL (streams.size(), 2U);
+
+	auto decode = [film, content]() {
+		map<AudioStreamPtr, double> sums;
+		auto decoder = make_shared<FFmpegDecoder>(film, content, false);
+		decoder->audio->Data.connect ([&sums](AudioStreamPtr stream, ContentAudio audio) {
+			auto& sum = sums[stream];
+			for (int c = 0; c < audio.audio->channels(); ++c) {
+				for (int f = 0; f < audio.audio->frames(); ++f) {
+					sum += std::abs(audio.audio->data(c)[f]);
+				}
+			}
+		});
+		while (!decoder->pass()) {}
+		return sums;
+	};
+
+	auto const both = decode ();
+	BOOST_CHECK (both.find(streams[0]) != both.end());
+	BOOST_CHECK (both.find(streams[1]) != both.end());
+
+	streams[1]->set_mapping (AudioMapping(streams[1]->channels(), MAX_DCP_AUDIO_CHANNELS));
+	BOOST_REQUIRE_EQUAL (content->audio->used_streams().size(), 1U);
+
+	auto const one = decode ();
+	BOOST_CHECK (one.find(streams[1]) == one.end());
+	BOOST_REQUIRE (one.find(streams[0]) != one.end());
+	BOOST_CHECK_EQUAL (one.at(streams[0]), both.at(streams[0]));
+}
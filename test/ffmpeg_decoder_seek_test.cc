@@ -37,6 +37,8 @@
 #include "test.h"
 #include <boost/filesystem.hpp>
 #include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <vector>
 
@@ -102,3 +104,41 @@ BOOST_AUTO_TEST_CASE (ffmpeg_decoder_seek_test)
 	test ("prophet_long_clip.mkv", { 15, 42, 999, 15 });
 	test ("dolby_aurora.vob", { 0, 125, 250, 41 });
 }
+
+
+/** Check that examining a long-GOP file gives a keyframe index, and that seeks using it are accurate */
+BOOST_AUTO_TEST_CASE (ffmpeg_decoder_keyframe_index_test)
+{
+	auto film = new_test_film2 ("ffmpeg_decoder_keyframe_index_test");
+	auto content = make_shared<FFmpegContent>("test/data/count300bd24.m2ts");
+	film->examine_and_add_content (content);
+	BOOST_REQUIRE (!wait_for_jobs());
+
+	auto keyframes = content->video_keyframes ();
+	BOOST_REQUIRE (!keyframes.empty());
+	BOOST_CHECK (std::is_sorted(keyframes.begin(), keyframes.end()));
+
+	auto const fps = content->video_frame_rate().get();
+
+	/* MPEG-TS timestamps are always in units of 1/90000s */
+	int64_t longest_gop = 0;
+	for (size_t i = 1; i < keyframes.size(); ++i) {
+		longest_gop = std::max (longest_gop, keyframes[i] - keyframes[i - 1]);
+	}
+	auto const longest_gop_frames = static_cast<int>(std::ceil(longest_gop * fps / 90000));
+
+	auto decoder = make_shared<FFmpegDecoder>(film, content, false);
+	decoder->video->Data.connect (bind (&store, _1));
+
+	for (auto frame: { 0, 42, 299, 7, 150 }) {
+		decoder->seek (ContentTime::from_frames(frame, fps), true);
+		stored = optional<ContentVideo> ();
+		while (!decoder->pass() && !stored) {}
+		BOOST_REQUIRE (stored);
+		/* An accurate seek goes to the keyframe at or before 1s before the target, and the frames
+		 * from there on come out of the decoder, so we should be no more than 1s plus one GOP early.
+		 */
+		BOOST_CHECK (stored->frame <= frame);
+		BOOST_CHECK (frame - stored->frame <= longest_gop_frames + static_cast<int>(std::ceil(fps)));
+	}
+}
@@ -127,3 +127,68 @@ BOOST_AUTO_TEST_CASE (file_group_test)
 	BOOST_CHECK_EQUAL (fg.read(test, 256), 256);
 	BOOST_CHECK_EQUAL (memcmp(data + total_length - 1077, test, 256), 0);
 }
+
+
+/** Check that a FileGroup gives the same data when it reads ahead, with buffers smaller and bigger than its files */
+BOOST_AUTO_TEST_CASE (file_group_read_ahead_test)
+{
+	uint8_t data[65536];
+	for (int i = 0; i < 65536; ++i) {
+		data[i] = rand() & 0xff;
+	}
+
+	int const length[] = {
+		99,
+		18941,
+		33110,
+		42
+	};
+
+	boost::filesystem::create_directories ("build/test/file_group_read_ahead_test");
+	vector<boost::filesystem::path> name = {
+		"build/test/file_group_read_ahead_test/A",
+		"build/test/file_group_read_ahead_test/B",
+		"build/test/file_group_read_ahead_test/C",
+		"build/test/file_group_read_ahead_test/D"
+	};
+
+	int total_length = 0;
+	for (size_t i = 0; i < name.size(); ++i) {
+		auto f = fopen (name[i].string().c_str(), "wb");
+		fwrite (data + total_length, 1, length[i], f);
+		fclose (f);
+		total_length += length[i];
+	}
+
+	for (int64_t read_ahead: { 4096, 1024 * 1024 }) {
+		FileGroup fg (name);
+		fg.set_read_ahead (read_ahead);
+		uint8_t test[65536];
+
+		/* Small sequential reads, as FFmpeg does, across all the files */
+		int pos = 0;
+		while (pos < total_length) {
+			int const n = fg.read (test, 1000);
+			BOOST_REQUIRE (n > 0);
+			BOOST_REQUIRE_EQUAL (memcmp(data + pos, test, n), 0);
+			pos += n;
+		}
+		BOOST_CHECK_EQUAL (pos, total_length);
+		BOOST_CHECK_EQUAL (fg.read(test, 1), 0);
+
+		/* Seek back to before what has been read ahead */
+		BOOST_CHECK_EQUAL (fg.seek(17, SEEK_SET), 17);
+		BOOST_CHECK_EQUAL (fg.read(test, 256), 256);
+		BOOST_CHECK_EQUAL (memcmp(data + 17, test, 256), 0);
+
+		/* Seek forward over the boundary between B and C */
+		BOOST_CHECK_EQUAL (fg.seek(99 + 18941 - 10, SEEK_SET), 99 + 18941 - 10);
+		BOOST_CHECK_EQUAL (fg.read(test, 20), 20);
+		BOOST_CHECK_EQUAL (memcmp(data + 99 + 18941 - 10, test, 20), 0);
+
+		/* Over-read from near the end */
+		BOOST_CHECK_EQUAL (fg.seek(100, SEEK_END), total_length - 100);
+		BOOST_CHECK_EQUAL (fg.read(test, 4096), 100);
+		BOOST_CHECK_EQUAL (memcmp(data + total_length - 100, test, 100), 0);
+	}
+}
@@ -26,6 +26,7 @@
 #include "lib/film.h"
 #include "lib/font.h"
 #include "lib/hints.h"
+#include "lib/ratio.h"
 #include "lib/text_content.h"
 #include "lib/util.h"
 #include "test.h"
@@ -257,3 +258,49 @@ BOOST_AUTO_TEST_CASE (hints_audio_with_no_language)
 
 }
 
+
+
+BOOST_AUTO_TEST_CASE (hints_scan_reused_after_unrelated_change)
+{
+	string const name = "hints_scan_reused_after_unrelated_change";
+
+	auto subs = fopen_boost (String::compose("build/test/%1.srt", name), "w");
+	BOOST_REQUIRE (subs);
+	fprintf (subs, "1\n00:00:01,000 --> 00:00:03,000\nToo early for %s\n\n", name.c_str());
+	fclose (subs);
+
+	auto content = content_factory("build/test/" + name + ".srt").front();
+	content->text.front()->set_type (TextType::OPEN_SUBTITLE);
+	content->text.front()->set_language (dcp::LanguageTag("en-US"));
+	auto film = new_test_film2 (name, { content });
+
+	auto run = [film](int expected_scanned) {
+		current_hints.clear ();
+		Hints hints (film);
+		hints.disable_audio_analysis ();
+		hints.Hint.connect (collect_hint);
+		hints.start ();
+		hints.join ();
+		while (signal_manager->ui_idle()) {}
+		BOOST_CHECK_EQUAL (hints.contents_scanned(), expected_scanned);
+		BOOST_REQUIRE_EQUAL (current_hints.size(), 1U);
+		BOOST_CHECK_EQUAL (current_hints[0], "It is advisable to put your first subtitle at least 4 seconds after the start of the DCP to make sure it is seen.");
+	};
+
+	run (1);
+
+	/* Nothing to do with the subtitles, so the scan should be re-used */
+	film->set_name ("Something else");
+	film->set_j2k_bandwidth (film->j2k_bandwidth() - 1000000);
+	run (0);
+
+	/* This changes the subtitles so we must look at them again */
+	content->text.front()->set_y_offset (0.1);
+	run (1);
+
+	/* So do these, as they change the frame size that bitmap subtitles are rendered at */
+	film->set_resolution (film->resolution() == Resolution::TWO_K ? Resolution::FOUR_K : Resolution::TWO_K);
+	run (1);
+	film->set_container (Ratio::from_id(film->container()->id() == "185" ? "239" : "185"));
+	run (1);
+}
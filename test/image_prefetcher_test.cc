@@ -0,0 +1,78 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/image_prefetcher_test.cc
+ *  @brief Test ImagePrefetcher.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/exceptions.h"
+#include "lib/ffmpeg_image_proxy.h"
+#include "lib/image_prefetcher.h"
+#include <boost/test/unit_test.hpp>
+#include <map>
+
+
+using std::make_shared;
+using std::map;
+using std::shared_ptr;
+
+
+BOOST_AUTO_TEST_CASE (image_prefetcher_test)
+{
+	boost::mutex mutex;
+	map<Frame, shared_ptr<ImageProxy>> made;
+
+	auto loader = [&mutex, &made](Frame frame) -> shared_ptr<ImageProxy> {
+		if (frame == 42) {
+			throw FileError ("Could not open file", "42.tif");
+		}
+		auto proxy = make_shared<FFmpegImageProxy>(dcp::ArrayData(1000));
+		boost::mutex::scoped_lock lm (mutex);
+		made[frame] = proxy;
+		return proxy;
+	};
+
+	ImagePrefetcher prefetcher (loader, 100, 10000, 4);
+
+	auto check = [&](Frame frame) {
+		auto proxy = prefetcher.get (frame);
+		boost::mutex::scoped_lock lm (mutex);
+		BOOST_REQUIRE (made.find(frame) != made.end());
+		BOOST_CHECK (proxy == made[frame]);
+	};
+
+	for (Frame i = 0; i < 20; ++i) {
+		check (i);
+	}
+
+	/* Skip forwards, then go back */
+	check (30);
+	check (31);
+	check (10);
+	check (11);
+
+	/* Errors should come out of get() */
+	BOOST_CHECK_THROW (prefetcher.get(42), FileError);
+	check (43);
+	check (99);
+}
@@ -0,0 +1,195 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/interleaved_audio_ring_buffer_test.cc
+ *  @brief Test InterleavedAudioRingBuffer.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/audio_buffers.h"
+#include "lib/exceptions.h"
+#include "lib/interleaved_audio_ring_buffer.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+using namespace dcpomatic;
+
+
+/** @return some audio where sample `i' of channel `c' is (first + i + 1) * (c + 1) */
+static shared_ptr<AudioBuffers>
+ramp (int channels, int frames, int first)
+{
+	auto buffers = make_shared<AudioBuffers>(channels, frames);
+	for (int c = 0; c < channels; ++c) {
+		for (int i = 0; i < frames; ++i) {
+			buffers->data(c)[i] = (first + i + 1) * (c + 1);
+		}
+	}
+	return buffers;
+}
+
+
+BOOST_AUTO_TEST_CASE (interleaved_audio_ring_buffer_test1)
+{
+	InterleavedAudioRingBuffer rb (6, 4096);
+	BOOST_CHECK_EQUAL (rb.size(), 0);
+
+	/* Getting some data should give an underrun and write zeros */
+	vector<float> buffer (256 * 6, 42);
+	BOOST_CHECK (!rb.get(buffer.data(), 240));
+	for (int i = 0; i < 240 * 6; ++i) {
+		BOOST_REQUIRE_EQUAL (buffer[i], 0);
+	}
+	BOOST_CHECK_EQUAL (buffer[240 * 6], 42);
+	BOOST_CHECK_EQUAL (rb.underruns(), 1U);
+	BOOST_CHECK_EQUAL (rb.underrun_frames(), 240U);
+
+	rb.put (ramp(6, 91, 0), DCPTime(), 48000);
+	BOOST_CHECK_EQUAL (rb.size(), 91);
+	BOOST_CHECK (*rb.peek() == DCPTime());
+
+	/* Get part of it out, interleaved */
+	BOOST_CHECK (*rb.get(buffer.data(), 40) == DCPTime());
+	for (int i = 0; i < 40; ++i) {
+		for (int c = 0; c < 6; ++c) {
+			BOOST_REQUIRE_EQUAL (buffer[i * 6 + c], (i + 1) * (c + 1));
+		}
+	}
+	BOOST_CHECK_EQUAL (rb.size(), 51);
+	BOOST_CHECK (*rb.peek() == DCPTime::from_frames(40, 48000));
+
+	/* Get more than there is; the rest should be silence and counted as an underrun */
+	BOOST_CHECK (*rb.get(buffer.data(), 60) == DCPTime::from_frames(40, 48000));
+	for (int i = 0; i < 51; ++i) {
+		for (int c = 0; c < 6; ++c) {
+			BOOST_REQUIRE_EQUAL (buffer[i * 6 + c], (i + 41) * (c + 1));
+		}
+	}
+	for (int i = 51 * 6; i < 60 * 6; ++i) {
+		BOOST_REQUIRE_EQUAL (buffer[i], 0);
+	}
+	BOOST_CHECK_EQUAL (rb.size(), 0);
+	BOOST_CHECK (!rb.peek());
+	BOOST_CHECK_EQUAL (rb.underruns(), 2U);
+	BOOST_CHECK_EQUAL (rb.underrun_frames(), 249U);
+
+	/* An underrun which we are told not to count should still give silence */
+	BOOST_CHECK (!rb.get(buffer.data(), 60, false));
+	for (int i = 0; i < 60 * 6; ++i) {
+		BOOST_REQUIRE_EQUAL (buffer[i], 0);
+	}
+	BOOST_CHECK_EQUAL (rb.underruns(), 2U);
+	BOOST_CHECK_EQUAL (rb.underrun_frames(), 249U);
+}
+
+
+/** Check that data wraps around the end of the buffer correctly */
+BOOST_AUTO_TEST_CASE (interleaved_audio_ring_buffer_wrap_test)
+{
+	InterleavedAudioRingBuffer rb (2, 50);
+	BOOST_CHECK_EQUAL (rb.capacity(), 64);
+
+	vector<float> buffer (24 * 2);
+	for (int i = 0; i < 20; ++i) {
+		rb.put (ramp(2, 24, i * 24), DCPTime::from_frames(i * 24, 48000), 48000);
+		BOOST_REQUIRE (*rb.get(buffer.data(), 24) == DCPTime::from_frames(i * 24, 48000));
+		for (int j = 0; j < 24; ++j) {
+			BOOST_REQUIRE_EQUAL (buffer[j * 2], i * 24 + j + 1);
+			BOOST_REQUIRE_EQUAL (buffer[j * 2 + 1], (i * 24 + j + 1) * 2);
+		}
+	}
+
+	BOOST_CHECK_EQUAL (rb.underruns(), 0U);
+
+	/* This would overwrite data which has not been read */
+	rb.put (ramp(2, 60, 0), DCPTime::from_frames(480, 48000), 48000);
+	BOOST_CHECK_THROW (rb.put(ramp(2, 5, 60), DCPTime::from_frames(540, 48000), 48000), ProgrammingError);
+}
+
+
+/** Check that clear() discards data even if it has not been read, and that times are correct afterwards */
+BOOST_AUTO_TEST_CASE (interleaved_audio_ring_buffer_clear_test)
+{
+	InterleavedAudioRingBuffer rb (1, 64);
+
+	rb.put (ramp(1, 60, 0), DCPTime(), 48000);
+	rb.clear ();
+	BOOST_CHECK_EQUAL (rb.size(), 0);
+	BOOST_CHECK (!rb.peek());
+
+	vector<float> buffer (32);
+	BOOST_CHECK (!rb.get(buffer.data(), 32));
+
+	/* There should be room for a full buffer again, even though the consumer never read the discarded data */
+	auto const seek = DCPTime::from_seconds(10);
+	rb.put (ramp(1, 64, 1000), seek, 48000);
+	BOOST_CHECK_EQUAL (rb.size(), 64);
+
+	BOOST_CHECK (*rb.get(buffer.data(), 32) == seek);
+	BOOST_CHECK_EQUAL (buffer[0], 1001);
+	BOOST_CHECK (*rb.get(buffer.data(), 32) == seek + DCPTime::from_frames(32, 48000));
+	BOOST_CHECK_EQUAL (buffer[0], 1033);
+}
+
+
+/** Check that a producer and consumer on different threads see the right data */
+BOOST_AUTO_TEST_CASE (interleaved_audio_ring_buffer_threads_test)
+{
+	int const total = 200000;
+	int const chunk = 37;
+
+	InterleavedAudioRingBuffer rb (2, 1024);
+
+	boost::thread producer ([&rb]() {
+		for (int done = 0; done < total; done += chunk) {
+			while (rb.size() > rb.capacity() - chunk) {
+				boost::this_thread::yield ();
+			}
+			rb.put (ramp(2, chunk, done), DCPTime::from_frames(done, 48000), 48000);
+		}
+	});
+
+	vector<float> buffer (64 * 2);
+	int expected = 0;
+	while (expected < total) {
+		auto time = rb.get (buffer.data(), 64);
+		if (!time) {
+			continue;
+		}
+		BOOST_REQUIRE (*time == DCPTime::from_frames(expected, 48000));
+		int i = 0;
+		for (; i < 64 && buffer[i * 2] != 0; ++i) {
+			BOOST_REQUIRE_EQUAL (buffer[i * 2], expected + 1);
+			BOOST_REQUIRE_EQUAL (buffer[i * 2 + 1], (expected + 1) * 2);
+			++expected;
+		}
+		for (; i < 64; ++i) {
+			BOOST_REQUIRE_EQUAL (buffer[i * 2], 0);
+		}
+	}
+
+	producer.join ();
+}
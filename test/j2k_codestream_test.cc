@@ -0,0 +1,110 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/j2k_codestream_test.cc
+ *  @brief Test J2KCodestream and the passthrough of JPEG2000 image sequences.
+ *  @ingroup feature
+ */
+
+
+#include "lib/content_factory.h"
+#include "lib/cross.h"
+#include "lib/exceptions.h"
+#include "lib/film.h"
+#include "lib/image_content.h"
+#include "lib/j2k_codestream.h"
+#include "test.h"
+#include <dcp/j2k_transcode.h>
+#include <dcp/mono_picture_asset.h>
+#include <dcp/mono_picture_asset_reader.h>
+#include <dcp/mono_picture_frame.h>
+#include <dcp/openjpeg_image.h>
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+
+
+using std::dynamic_pointer_cast;
+using std::make_shared;
+
+
+static dcp::ArrayData
+make_j2k (dcp::Size size)
+{
+	auto image = make_shared<dcp::OpenJPEGImage>(size);
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < (size.width * size.height); ++j) {
+			image->data(i)[j] = (j * 7 + i * 1000) % 4096;
+		}
+	}
+
+	return dcp::compress_j2k(image, 100000000, 24, false, false);
+}
+
+
+BOOST_AUTO_TEST_CASE (j2k_codestream_test)
+{
+	auto j2k = make_j2k (dcp::Size(1998, 1080));
+
+	J2KCodestream codestream (j2k.data(), j2k.size());
+	BOOST_CHECK (codestream.size() == dcp::Size(1998, 1080));
+	BOOST_CHECK (!codestream.dci_problem());
+
+	/* Change Rsiz to say that this is not a DCI profile */
+	j2k.data()[6] = 0;
+	j2k.data()[7] = 0;
+	BOOST_CHECK (J2KCodestream(j2k.data(), j2k.size()).dci_problem());
+
+	/* The main header ends before the COD marker */
+	BOOST_CHECK_THROW (J2KCodestream(j2k.data(), 50), DecodeError);
+}
+
+
+BOOST_AUTO_TEST_CASE (j2k_passthrough_test)
+{
+	auto const dir = boost::filesystem::path("build/test/j2k_passthrough_test_frames");
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	auto const j2k = make_j2k (dcp::Size(1998, 1080));
+	for (int i = 0; i < 24; ++i) {
+		char name[64];
+		snprintf (name, sizeof(name), "%04d.j2c", i);
+		j2k.write (dir / name);
+	}
+
+	auto content = dynamic_pointer_cast<ImageContent>(content_factory(dir).front());
+	BOOST_REQUIRE (content);
+	auto film = new_test_film2 ("j2k_passthrough_test", { content });
+	BOOST_CHECK (content->j2k_passthrough(24));
+	/* Much too big for the DCI limit at this frame rate */
+	BOOST_CHECK (!content->j2k_passthrough(10000));
+
+	make_and_verify_dcp (film, { dcp::VerificationNote::Code::MISSING_CPL_METADATA });
+
+	/* The frames should have gone into the DCP without being touched */
+	dcp::MonoPictureAsset asset (dcp_file(film, "j2c"));
+	auto reader = asset.start_read ();
+	for (int i = 0; i < 24; ++i) {
+		auto frame = reader->get_frame (i);
+		BOOST_REQUIRE_EQUAL (frame->size(), j2k.size());
+		BOOST_CHECK (memcmp(frame->data(), j2k.data(), j2k.size()) == 0);
+	}
+}
@@ -0,0 +1,112 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/metrics_test.cc
+ *  @brief Test Metrics formatting.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/metrics.h"
+#include <boost/test/unit_test.hpp>
+#include <limits>
+
+
+using std::string;
+using std::vector;
+
+
+BOOST_AUTO_TEST_CASE (metrics_test)
+{
+	using Metric = Metrics::Metric;
+
+	auto metrics = Metrics::instance();
+
+	auto a = metrics->add_source ([](vector<Metric>& m) {
+		m.push_back (Metric("test_frames_total", "Frames", Metrics::Type::COUNTER, 42, {{"server", "a"}}));
+		m.push_back (Metric("test_queue_length", "Queue", Metrics::Type::GAUGE, 0.5));
+	});
+
+	auto b = metrics->add_source ([](vector<Metric>& m) {
+		m.push_back (Metric("test_frames_total", "Frames", Metrics::Type::COUNTER, 7, {{"server", "b\"c"}}));
+	});
+
+	BOOST_CHECK_EQUAL (
+		metrics->prometheus(),
+		"# HELP test_frames_total Frames\n"
+		"# TYPE test_frames_total counter\n"
+		"test_frames_total{server=\"a\"} 42\n"
+		"test_frames_total{server=\"b\\\"c\"} 7\n"
+		"# HELP test_queue_length Queue\n"
+		"# TYPE test_queue_length gauge\n"
+		"test_queue_length 0.5\n"
+		);
+
+	metrics->remove_source (a);
+
+	BOOST_CHECK_EQUAL (
+		metrics->json(),
+		"{ \"metrics\": [{ \"name\": \"test_frames_total\", \"type\": \"counter\", \"labels\": { \"server\": \"b\\\"c\" }, \"value\": 7 }] }"
+		);
+
+	metrics->remove_source (b);
+
+	BOOST_CHECK_EQUAL (metrics->json(), "{ \"metrics\": [] }");
+}
+
+
+/** Check that values which aren't finite are written in a way that each format can read */
+BOOST_AUTO_TEST_CASE (metrics_non_finite_test)
+{
+	using Metric = Metrics::Metric;
+
+	auto metrics = Metrics::instance();
+
+	auto a = metrics->add_source ([](vector<Metric>& m) {
+		m.push_back (Metric("test_inf", "Inf", Metrics::Type::GAUGE, std::numeric_limits<double>::infinity()));
+		m.push_back (Metric("test_minus_inf", "Minus inf", Metrics::Type::GAUGE, -std::numeric_limits<double>::infinity()));
+		m.push_back (Metric("test_nan", "NaN", Metrics::Type::GAUGE, std::numeric_limits<double>::quiet_NaN()));
+	});
+
+	BOOST_CHECK_EQUAL (
+		metrics->prometheus(),
+		"# HELP test_inf Inf\n"
+		"# TYPE test_inf gauge\n"
+		"test_inf +Inf\n"
+		"# HELP test_minus_inf Minus inf\n"
+		"# TYPE test_minus_inf gauge\n"
+		"test_minus_inf -Inf\n"
+		"# HELP test_nan NaN\n"
+		"# TYPE test_nan gauge\n"
+		"test_nan NaN\n"
+		);
+
+	BOOST_CHECK_EQUAL (
+		metrics->json(),
+		"{ \"metrics\": ["
+		"{ \"name\": \"test_inf\", \"type\": \"gauge\", \"labels\": { }, \"value\": null }, "
+		"{ \"name\": \"test_minus_inf\", \"type\": \"gauge\", \"labels\": { }, \"value\": null }, "
+		"{ \"name\": \"test_nan\", \"type\": \"gauge\", \"labels\": { }, \"value\": null }"
+		"] }"
+		);
+
+	metrics->remove_source (a);
+}
@@ -466,3 +466,91 @@ BOOST_AUTO_TEST_CASE (player_silence_at_end_crash)
 	film2->set_video_frame_rate (24);
 	make_and_verify_dcp (film2);
 }
+
+
+/** Check that decoders are only opened when they are needed, and that no more than the
+ *  maximum number are open at once.
+ */
+BOOST_AUTO_TEST_CASE (player_lazy_decoders_test)
+{
+	std::vector<shared_ptr<Content>> content;
+	for (int i = 0; i < 48; ++i) {
+		content.push_back (content_factory("test/data/flat_red.png").front());
+	}
+
+	auto film = new_test_film2 ("player_lazy_decoders_test", content);
+	for (auto i: content) {
+		i->video->set_length (2);
+	}
+
+	auto player = make_shared<Player>(film, Image::Alignment::COMPACT);
+	BOOST_CHECK_EQUAL (player->_open_decoders, 0);
+
+	int frames = 0;
+	player->Video.connect ([&frames](shared_ptr<PlayerVideo>, DCPTime) { ++frames; });
+	while (!player->pass()) {
+		BOOST_REQUIRE (player->_open_decoders <= player->_max_open_decoders);
+	}
+
+	BOOST_CHECK_EQUAL (frames, 48 * 2);
+
+	/* Seeking into the middle should open nothing until we pass */
+	player->seek (DCPTime::from_frames(48, film->video_frame_rate()), true);
+	BOOST_CHECK_EQUAL (player->_open_decoders, 0);
+	player->pass ();
+	BOOST_CHECK_EQUAL (player->_open_decoders, 1);
+}
+
+
+/** Check that pieces which overlap can all have their decoders open at once */
+BOOST_AUTO_TEST_CASE (player_overlapping_decoders_test)
+{
+	std::vector<shared_ptr<Content>> content;
+	for (int i = 0; i < 40; ++i) {
+		content.push_back (content_factory("test/data/sine_440.wav").front());
+	}
+
+	auto film = new_test_film2 ("player_overlapping_decoders_test", content);
+	for (auto i: content) {
+		i->set_position (film, DCPTime());
+	}
+
+	auto player = make_shared<Player>(film, Image::Alignment::COMPACT);
+	BOOST_CHECK_EQUAL (player->_max_open_decoders, 40);
+
+	while (!player->pass()) {}
+	BOOST_CHECK (player->_open_decoders <= 40);
+}
+
+
+/** Check that closing and re-opening decoders of overlapping pieces does not give us
+ *  any audio twice.
+ */
+BOOST_AUTO_TEST_CASE (player_reopened_decoders_test)
+{
+	auto sine = content_factory("test/data/sine_440.wav").front();
+	auto white = content_factory("test/data/white.wav").front();
+	auto film = new_test_film2 ("player_reopened_decoders_test", { sine, white });
+	white->set_position (film, DCPTime());
+
+	auto play = [film](int max_open_decoders) {
+		auto player = make_shared<Player>(film, Image::Alignment::COMPACT);
+		player->_max_open_decoders = max_open_decoders;
+		auto all = make_shared<AudioBuffers>(film->audio_channels(), 0);
+		player->Audio.connect ([all](shared_ptr<AudioBuffers> audio, DCPTime, int) {
+			all->append (audio);
+		});
+		while (!player->pass()) {}
+		return all;
+	};
+
+	auto reference = play (2);
+	auto reopened = play (1);
+
+	BOOST_REQUIRE_EQUAL (reference->frames(), reopened->frames());
+	for (int c = 0; c < reference->channels(); ++c) {
+		for (int i = 0; i < reference->frames(); ++i) {
+			BOOST_REQUIRE (std::abs(reference->data(c)[i] - reopened->data(c)[i]) < 1e-5);
+		}
+	}
+}
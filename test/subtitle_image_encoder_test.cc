@@ -0,0 +1,125 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/subtitle_image_encoder_test.cc
+ *  @brief Test SubtitleImageEncoder.
+ *  @ingroup selfcontained
+ */
+
+
+#include "lib/image.h"
+#include "lib/image_png.h"
+#include "lib/subtitle_image_encoder.h"
+#include <boost/test/unit_test.hpp>
+
+
+using std::make_shared;
+using std::vector;
+
+
+BOOST_AUTO_TEST_CASE (subtitle_image_encoder_test)
+{
+	auto red = make_shared<Image>(AV_PIX_FMT_RGBA, dcp::Size(64, 32), Image::Alignment::PADDED);
+	red->make_black ();
+	auto red_data = red->data()[0];
+	for (int y = 0; y < 32; ++y) {
+		for (int x = 0; x < 64; ++x) {
+			red_data[y * red->stride()[0] + x * 4] = 255;
+			red_data[y * red->stride()[0] + x * 4 + 3] = 255;
+		}
+	}
+
+	/* Same pixels but a different alignment, so it should still be spotted as a duplicate */
+	auto red_again = make_shared<Image>(red, Image::Alignment::COMPACT);
+
+	auto black = make_shared<Image>(AV_PIX_FMT_RGBA, dcp::Size(64, 32), Image::Alignment::PADDED);
+	black->make_black ();
+
+	SubtitleImageEncoder encoder;
+
+	vector<dcp::ArrayData> pngs;
+	for (auto image: { red, black, red_again, black }) {
+		encoder.encode (image, [&pngs](dcp::ArrayData png) {
+			pngs.push_back (png);
+		});
+	}
+
+	/* Nothing should be handed back until flush() */
+	BOOST_CHECK (pngs.empty());
+	encoder.flush ();
+	BOOST_REQUIRE_EQUAL (pngs.size(), 4U);
+
+	/* Handlers are called in order, and duplicates share the same data */
+	BOOST_CHECK (pngs[0] == image_as_png(red));
+	BOOST_CHECK (pngs[1] == image_as_png(black));
+	BOOST_CHECK (pngs[0].data() == pngs[2].data());
+	BOOST_CHECK (pngs[1].data() == pngs[3].data());
+	BOOST_CHECK (pngs[0].data() != pngs[1].data());
+}
+
+
+BOOST_AUTO_TEST_CASE (subtitle_image_encoder_spool_test)
+{
+	auto red = make_shared<Image>(AV_PIX_FMT_RGBA, dcp::Size(64, 32), Image::Alignment::PADDED);
+	red->make_black ();
+	auto red_data = red->data()[0];
+	for (int y = 0; y < 32; ++y) {
+		for (int x = 0; x < 64; ++x) {
+			red_data[y * red->stride()[0] + x * 4] = 255;
+			red_data[y * red->stride()[0] + x * 4 + 3] = 255;
+		}
+	}
+
+	auto black = make_shared<Image>(AV_PIX_FMT_RGBA, dcp::Size(64, 32), Image::Alignment::PADDED);
+	black->make_black ();
+
+	boost::filesystem::path const spool = "build/test/subtitle_image_encoder_spool_test.tmp";
+	boost::filesystem::remove (spool);
+
+	{
+		SubtitleImageEncoder encoder (spool);
+
+		vector<dcp::ArrayData> first;
+		vector<dcp::ArrayData> second;
+		encoder.encode (red, [&first](dcp::ArrayData png) { first.push_back(png); }, 0);
+		encoder.encode (black, [&second](dcp::ArrayData png) { second.push_back(png); }, 1);
+		encoder.encode (red, [&second](dcp::ArrayData png) { second.push_back(png); }, 1);
+
+		/* Only the second group's handlers should be called */
+		encoder.flush (1);
+		BOOST_CHECK (first.empty());
+		BOOST_REQUIRE_EQUAL (second.size(), 2U);
+		BOOST_CHECK (second[0] == image_as_png(black));
+		BOOST_CHECK (second[1] == image_as_png(red));
+
+		/* Everything should have gone to disk */
+		BOOST_CHECK (boost::filesystem::exists(spool));
+		BOOST_CHECK_EQUAL (encoder.bytes_in_memory(), 0);
+		BOOST_CHECK_EQUAL (encoder.bytes_spooled(), image_as_png(red).size() + image_as_png(black).size());
+
+		encoder.flush (0);
+		BOOST_REQUIRE_EQUAL (first.size(), 1U);
+		BOOST_CHECK (first[0] == image_as_png(red));
+	}
+
+	/* The spool should be cleaned up */
+	BOOST_CHECK (!boost::filesystem::exists(spool));
+}
@@ -117,6 +117,7 @@ setup_test_config ()
 		LogEntry::TYPE_ERROR | LogEntry::TYPE_DISK
 		);
 	Config::instance()->set_automatic_audio_analysis (false);
+	Config::instance()->set_analyse_ebur128 (true);
 	auto signer = make_shared<dcp::CertificateChain>(dcp::file_to_string("test/data/signer_chain"));
 	signer->set_key(dcp::file_to_string("test/data/signer_key"));
 	Config::instance()->set_signer_chain (signer);
@@ -0,0 +1,195 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/upload_test.cc
+ *  @brief Test Uploader using a stand-in for a server which writes to a local directory.
+ *  @ingroup feature
+ */
+
+
+#include "lib/config.h"
+#include "lib/content_factory.h"
+#include "lib/cross.h"
+#include "lib/exceptions.h"
+#include "lib/film.h"
+#include "lib/uploader.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using boost::optional;
+
+
+/** Connection which writes files to a local directory, and which can fail part-way
+ *  through sending files to check that we retry and resume.  The number of bytes
+ *  written is added to *bytes_sent.
+ */
+class LocalConnection : public Uploader::Connection
+{
+public:
+	LocalConnection (boost::filesystem::path root, std::atomic<int>* failures, std::atomic<boost::uintmax_t>* bytes_sent)
+		: _root (root)
+		, _failures (failures)
+		, _bytes_sent (bytes_sent)
+	{}
+
+	optional<boost::uintmax_t> remote_size (boost::filesystem::path to) override
+	{
+		auto const path = _root / to;
+		if (!boost::filesystem::exists(path)) {
+			return boost::uintmax_t(0);
+		}
+		return boost::filesystem::file_size(path);
+	}
+
+	void upload_file (Uploader::Source& source, boost::filesystem::path to) override
+	{
+		auto f = fopen_boost (_root / to, source.offset() > 0 ? "ab" : "wb");
+		BOOST_REQUIRE (f);
+
+		uint8_t buffer[4096];
+		while (auto const read = source.read(buffer, sizeof(buffer))) {
+			fwrite (buffer, 1, read, f);
+			*_bytes_sent += read;
+			if (source.sent() > 8192 && (*_failures)-- > 0) {
+				fclose (f);
+				throw NetworkError ("Simulated network failure");
+			}
+		}
+
+		fclose (f);
+	}
+
+private:
+	boost::filesystem::path _root;
+	std::atomic<int>* _failures;
+	std::atomic<boost::uintmax_t>* _bytes_sent;
+};
+
+
+class LocalUploader : public Uploader
+{
+public:
+	LocalUploader (boost::filesystem::path root, int failures)
+		: Uploader ([](string) {}, [](float) {})
+		, _root (root)
+		, _failures (failures)
+		, _bytes_sent (0)
+	{}
+
+	int failures_left () const {
+		return std::max(0, _failures.load());
+	}
+
+	/** @return total number of bytes written to the remote directory by our connections */
+	boost::uintmax_t bytes_sent () const {
+		return _bytes_sent;
+	}
+
+protected:
+	void create_directory (boost::filesystem::path directory) override
+	{
+		boost::filesystem::create_directories (_root / directory);
+	}
+
+	std::shared_ptr<Connection> connect () override
+	{
+		return make_shared<LocalConnection>(_root, &_failures, &_bytes_sent);
+	}
+
+private:
+	boost::filesystem::path _root;
+	std::atomic<int> _failures;
+	std::atomic<boost::uintmax_t> _bytes_sent;
+};
+
+
+static
+void
+check_upload (boost::filesystem::path dcp, boost::filesystem::path remote)
+{
+	for (auto i: boost::filesystem::directory_iterator(dcp)) {
+		check_file (i.path(), remote / dcp.filename() / i.path().filename());
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE (upload_test)
+{
+	ConfigRestorer cr;
+	Config::instance()->set_tms_connections (3);
+
+	auto content = content_factory("test/data/flat_red.png").front();
+	auto film = new_test_film2 ("upload_test", { content });
+	make_and_verify_dcp (film);
+	auto const dcp = film->dir(film->dcp_name());
+
+	/* An upload with some network failures, which should be retried */
+	auto remote = boost::filesystem::path("build/test/upload_test_remote");
+	boost::filesystem::remove_all (remote);
+	LocalUploader uploader (remote, 3);
+	uploader.upload (dcp);
+	BOOST_CHECK_EQUAL (uploader.failures_left(), 0);
+	check_upload (dcp, remote);
+
+	/* Upload again with the largest file half-sent; it should be resumed */
+	boost::filesystem::path largest;
+	for (auto i: boost::filesystem::directory_iterator(dcp)) {
+		if (largest.empty() || boost::filesystem::file_size(i.path()) > boost::filesystem::file_size(largest)) {
+			largest = i.path();
+		}
+	}
+	auto const remote_largest = remote / dcp.filename() / largest.filename();
+	auto const largest_size = boost::filesystem::file_size(largest);
+	boost::filesystem::resize_file (remote_largest, largest_size / 2);
+	LocalUploader resume_uploader (remote, 0);
+	resume_uploader.upload (dcp);
+	check_upload (dcp, remote);
+	/* Only the missing part of the largest file should have been sent */
+	BOOST_CHECK_EQUAL (resume_uploader.bytes_sent(), largest_size - largest_size / 2);
+}
+
+
+BOOST_AUTO_TEST_CASE (upload_test_bad_hash)
+{
+	auto content = content_factory("test/data/flat_red.png").front();
+	auto film = new_test_film2 ("upload_test_bad_hash", { content });
+	make_and_verify_dcp (film);
+
+	/* Change a byte in the picture asset so that it no longer matches the PKL */
+	auto const picture = dcp_file (film, "j2c");
+	auto f = fopen_boost (picture, "r+b");
+	BOOST_REQUIRE (f);
+	fseek (f, boost::filesystem::file_size(picture) - 16, SEEK_SET);
+	auto const c = fgetc (f);
+	fseek (f, boost::filesystem::file_size(picture) - 16, SEEK_SET);
+	fputc (c ^ 0xff, f);
+	fclose (f);
+
+	auto remote = boost::filesystem::path("build/test/upload_test_bad_hash_remote");
+	boost::filesystem::remove_all (remote);
+	LocalUploader uploader (remote, 0);
+	BOOST_CHECK_THROW (uploader.upload(film->dir(film->dcp_name())), FileError);
+}
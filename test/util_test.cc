@@ -148,3 +148,15 @@ BOOST_AUTO_TEST_CASE (copy_in_bits_test)
 		check_file ("build/test/random.dat", "build/test/random.dat2");
 	}
 }
+
+
+/** Check that copying over a longer file leaves nothing of it behind */
+BOOST_AUTO_TEST_CASE (copy_in_bits_overwrite_test)
+{
+	make_random_file ("build/test/random.dat", 4 * 1024 * 1024);
+	make_random_file ("build/test/random.dat2", 9 * 1024 * 1024);
+
+	copy_in_bits ("build/test/random.dat", "build/test/random.dat2", {});
+	BOOST_CHECK_EQUAL (boost::filesystem::file_size("build/test/random.dat2"), 4 * 1024 * 1024U);
+	check_file ("build/test/random.dat", "build/test/random.dat2");
+}
@@ -0,0 +1,181 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/** @file  test/write_verifier_test.cc
+ *  @brief Test WriteVerifier and its use by VerifyDCPJob.
+ *  @ingroup feature
+ */
+
+
+#include "lib/content_factory.h"
+#include "lib/cross.h"
+#include "lib/exceptions.h"
+#include "lib/film.h"
+#include "lib/job_manager.h"
+#include "lib/verify_dcp_job.h"
+#include "lib/write_verifier.h"
+#include "test.h"
+#include <dcp/util.h>
+#include <dcp/version.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <set>
+
+
+using std::make_shared;
+using std::string;
+
+
+BOOST_AUTO_TEST_CASE (write_verifier_report_test)
+{
+	auto content = content_factory("test/data/flat_red.png").front();
+	auto film = new_test_film2 ("write_verifier_report_test", { content });
+	make_and_verify_dcp (film, { dcp::VerificationNote::Code::MISSING_CPL_METADATA });
+
+	auto const dcp_dir = film->dir(film->dcp_name());
+	auto const report = WriteVerifier::report_path(dcp_dir);
+	BOOST_REQUIRE (boost::filesystem::exists(report));
+
+	WriteVerifier verifier (report);
+	BOOST_CHECK (verifier.matches(dcp_dir));
+	BOOST_CHECK (verifier.notes().empty());
+
+	auto job = make_shared<VerifyDCPJob>(std::vector<boost::filesystem::path>{dcp_dir}, VerifyDCPJob::Mode::PARALLEL, true);
+	JobManager::instance()->add (job);
+	BOOST_REQUIRE (!wait_for_jobs());
+	BOOST_CHECK (job->finished_ok());
+	BOOST_CHECK (job->used_write_report());
+
+	/* The report is only used when asked for */
+	job = make_shared<VerifyDCPJob>(std::vector<boost::filesystem::path>{dcp_dir});
+	JobManager::instance()->add (job);
+	BOOST_REQUIRE (!wait_for_jobs());
+	BOOST_CHECK (job->finished_ok());
+	BOOST_CHECK (!job->used_write_report());
+
+	/* A report written by a different libdcp may have different values for its notes, so it is not used */
+	auto const xml = dcp::file_to_string (report);
+	auto other_libdcp = xml;
+	boost::algorithm::replace_all (other_libdcp, string("<Libdcp>") + dcp::git_commit + "</Libdcp>", "<Libdcp>0123456</Libdcp>");
+	BOOST_REQUIRE (other_libdcp != xml);
+	dcp::write_string_to_file (other_libdcp, report);
+	BOOST_CHECK_THROW (WriteVerifier(report), OldFormatError);
+	job = make_shared<VerifyDCPJob>(std::vector<boost::filesystem::path>{dcp_dir}, VerifyDCPJob::Mode::FULL, true);
+	JobManager::instance()->add (job);
+	BOOST_REQUIRE (!wait_for_jobs());
+	BOOST_CHECK (job->finished_ok());
+	BOOST_CHECK (!job->used_write_report());
+	dcp::write_string_to_file (xml, report);
+
+	/* Changing an asset means that the report no longer applies */
+	auto const mxf = dcp_file(film, "j2c");
+	auto f = fopen_boost (mxf, "ab");
+	BOOST_REQUIRE (f);
+	fputc (0, f);
+	fclose (f);
+	BOOST_CHECK (!verifier.matches(dcp_dir));
+}
+
+
+BOOST_AUTO_TEST_CASE (verify_dcp_job_parallel_test)
+{
+	auto content = content_factory("test/data/flat_red.png").front();
+	auto film = new_test_film2 ("verify_dcp_job_parallel_test", { content });
+	make_and_verify_dcp (film, { dcp::VerificationNote::Code::MISSING_CPL_METADATA });
+
+	auto const dcp_dir = film->dir(film->dcp_name());
+
+	auto job = make_shared<VerifyDCPJob>(std::vector<boost::filesystem::path>{dcp_dir}, VerifyDCPJob::Mode::PARALLEL, false);
+	JobManager::instance()->add (job);
+	BOOST_REQUIRE (!wait_for_jobs());
+	BOOST_CHECK (job->finished_ok());
+	for (auto i: job->notes()) {
+		BOOST_CHECK (i.type() != dcp::VerificationNote::Type::ERROR);
+	}
+
+	auto const mxf = dcp_file(film, "j2c");
+	auto f = fopen_boost (mxf, "ab");
+	BOOST_REQUIRE (f);
+	fputc (0, f);
+	fclose (f);
+
+	job = make_shared<VerifyDCPJob>(std::vector<boost::filesystem::path>{dcp_dir}, VerifyDCPJob::Mode::PARALLEL, false);
+	JobManager::instance()->add (job);
+	BOOST_REQUIRE (!wait_for_jobs());
+	auto const notes = job->notes ();
+	BOOST_CHECK (std::find_if(notes.begin(), notes.end(), [](dcp::VerificationNote const& note) {
+		return note.code() == dcp::VerificationNote::Code::INCORRECT_PICTURE_HASH;
+	}) != notes.end());
+}
+
+
+/** PARALLEL mode should give the same notes as FULL for the checks that it makes */
+BOOST_AUTO_TEST_CASE (verify_dcp_job_parallel_matches_full_test)
+{
+	using Code = dcp::VerificationNote::Code;
+
+	auto content = content_factory("test/data/flat_red.png").front();
+	auto film = new_test_film2 ("verify_dcp_job_parallel_matches_full_test", { content });
+	make_and_verify_dcp (film, { Code::MISSING_CPL_METADATA });
+
+	auto const dcp_dir = film->dir(film->dcp_name());
+
+	std::set<Code> const parallel_codes = {
+		Code::INCORRECT_PICTURE_HASH,
+		Code::MISMATCHED_PICTURE_HASHES,
+		Code::INCORRECT_SOUND_HASH,
+		Code::MISMATCHED_SOUND_HASHES,
+		Code::INVALID_PICTURE_FRAME_SIZE_IN_BYTES,
+		Code::NEARLY_INVALID_PICTURE_FRAME_SIZE_IN_BYTES,
+		Code::INVALID_DURATION,
+		Code::INVALID_INTRINSIC_DURATION,
+		Code::MISMATCHED_ASSET_DURATION,
+		Code::INVALID_TIMED_TEXT_SIZE_IN_BYTES,
+		Code::INVALID_CLOSED_CAPTION_XML_SIZE_IN_BYTES
+	};
+
+	auto verify = [dcp_dir, &parallel_codes](VerifyDCPJob::Mode mode) {
+		auto job = make_shared<VerifyDCPJob>(std::vector<boost::filesystem::path>{dcp_dir}, mode, false);
+		JobManager::instance()->add (job);
+		BOOST_REQUIRE (!wait_for_jobs());
+		std::multiset<std::pair<dcp::VerificationNote::Type, Code>> notes;
+		for (auto i: job->notes()) {
+			if (parallel_codes.find(i.code()) != parallel_codes.end()) {
+				notes.insert (std::make_pair(i.type(), i.code()));
+			}
+		}
+		return notes;
+	};
+
+	BOOST_CHECK (verify(VerifyDCPJob::Mode::PARALLEL) == verify(VerifyDCPJob::Mode::FULL));
+
+	/* and also when something is wrong */
+	auto const mxf = dcp_file(film, "j2c");
+	auto f = fopen_boost (mxf, "ab");
+	BOOST_REQUIRE (f);
+	fputc (0, f);
+	fclose (f);
+
+	auto const parallel = verify(VerifyDCPJob::Mode::PARALLEL);
+	BOOST_CHECK (parallel.find(std::make_pair(dcp::VerificationNote::Type::ERROR, Code::INCORRECT_PICTURE_HASH)) != parallel.end());
+	BOOST_CHECK (parallel == verify(VerifyDCPJob::Mode::FULL));
+}
@@ -24,18 +24,28 @@
 #include "lib/content_factory.h"
 #include "lib/cross.h"
 #include "lib/film.h"
+#include "lib/image.h"
 #include "lib/job.h"
+#include "lib/player_text.h"
+#include "lib/reel_writer.h"
 #include "lib/video_content.h"
 #include "lib/writer.h"
 #include "test.h"
+#include <dcp/cpl.h>
+#include <dcp/dcp.h>
 #include <dcp/openjpeg_image.h>
 #include <dcp/j2k_transcode.h>
+#include <dcp/reel.h>
+#include <dcp/reel_subtitle_asset.h>
+#include <dcp/subtitle_asset.h>
+#include <dcp/subtitle_image.h>
 #include <boost/test/unit_test.hpp>
 #include <memory>
 
 
 using std::make_shared;
 using std::shared_ptr;
+using boost::optional;
 
 
 BOOST_AUTO_TEST_CASE (test_write_odd_amount_of_silence)
@@ -101,3 +111,44 @@ BOOST_AUTO_TEST_CASE (interrupt_writer)
 	cl.run ();
 }
 
+
+/** Each reel's subtitle images should be dropped once that reel has been written */
+BOOST_AUTO_TEST_CASE (writer_release_subtitle_images_test)
+{
+	auto A = content_factory("test/data/flat_red.png").front();
+	auto B = content_factory("test/data/flat_red.png").front();
+	auto film = new_test_film2 ("writer_release_subtitle_images_test", { A, B });
+	film->set_reel_type (ReelType::BY_VIDEO_CONTENT);
+	auto const reels = film->reels();
+	BOOST_REQUIRE_EQUAL (reels.size(), 2U);
+
+	auto image = make_shared<Image>(AV_PIX_FMT_RGBA, dcp::Size(64, 32), Image::Alignment::PADDED);
+	image->make_black ();
+
+	auto writer = make_shared<Writer>(film, shared_ptr<Job>(), true);
+	for (auto const& reel: reels) {
+		PlayerText text;
+		text.bitmap.push_back (BitmapText(image, dcpomatic::Rect<double>(0.1, 0.8, 0.1, 0.1)));
+		writer->write (text, TextType::OPEN_SUBTITLE, optional<DCPTextTrack>(), dcpomatic::DCPTimePeriod(reel.from, reel.from + dcpomatic::DCPTime::from_seconds(1)));
+	}
+
+	writer->finish (film->dir(film->dcp_name()));
+
+	for (auto const& reel: writer->_reels) {
+		BOOST_CHECK_EQUAL (reel.subtitle_image_bytes(), 0);
+	}
+	BOOST_CHECK_EQUAL (writer->_subtitle_image_bytes, 0);
+
+	/* but they should still have been written */
+	dcp::DCP dcp (film->dir(film->dcp_name()));
+	dcp.read ();
+	BOOST_REQUIRE_EQUAL (dcp.cpls().size(), 1U);
+	for (auto reel: dcp.cpls()[0]->reels()) {
+		BOOST_REQUIRE (reel->main_subtitle());
+		auto subtitles = reel->main_subtitle()->asset()->subtitles();
+		BOOST_REQUIRE_EQUAL (subtitles.size(), 1U);
+		auto subtitle_image = std::dynamic_pointer_cast<const dcp::SubtitleImage>(subtitles[0]);
+		BOOST_REQUIRE (subtitle_image);
+		BOOST_CHECK (subtitle_image->png_image().size() > 0);
+	}
+}